@@ -33,25 +33,50 @@
 /// ATTENTION FONCTIONNE SEULEMENT AVEC LA v5.13.1 (un problème sur le 5.13.2 que je n'ai pas investigué)
 #include <ArduinoJson.h>
 
+#include "memoire.h"
+#include "capture.h"
+#include "budget.h"
 #include "sensors.h"
-#include "alert.h"
+#include "diagnostic.h"
+#include "alertengine.h"
+#include "statistiques.h"
+#include "energie.h"
+#include "liaison.h"
+#include "acquisition.h"
+#include "miseajour.h"
 #include "communication.h"
+#include "backlog.h"
 
-/// Temps en secondes entre deux mesures de distance.
-#define INTERVAL_MESURES (5*60)
+/// Serveur de l'API, peut être redéfini dans secrets.h pour viser un serveur local de test.
+#ifndef API_SERVER
+#define API_SERVER "api.picolimno.fr"
+#endif
+#ifndef API_PORT
+#define API_PORT 80
+#endif
+
+/// Nombre maximum de mesures matérielles pour une sonde rapide entre deux mesures (veille d'alerte).
+#define RANGE_SONDE 3
+/// Marge en mm autour des seuils d'alerte déclenchant une mesure complète après une sonde rapide.
+#define ALERT_MARGE 100
 
-/// Temps en seconde entre deux transmissions.
-#define INTERVAL_TRANSMISSION (15 *60)
+/// Nombre de mesures de distance d'une rafale regroupées dans une même transmission.
+#define RAFALE_LOT 16
+/// Tension de la batterie en mV en deçà de laquelle une rafale est interrompue.
+#define RAFALE_VBAT_MIN 3600
 
-/// Nombre d'échantillons matériels nécessaires pour faire un échantillon brut après médiane (minimum sinon l'échantillon est invalide).
-#define RANGE_SEQ_MIN 20
-/// Nombre maximum de mesures matérielles pou obtenir le nombre d'échantillons matériels nécessaires.
-#define RANGE_SEQ_MAX 60
+/// Variation de distance en mm justifiant une transmission quand le forfait de données est serré.
+#define BUDGET_DELTA_RANGE 20
+/// Temps maximum en secondes sans transmission quand le forfait de données est serré (battement).
+#define BUDGET_BATTEMENT (3 * 3600UL)
+/// Intervalle en secondes entre deux lectures des paramètres quand le forfait est consommé.
+#define BUDGET_PARAMETRES_EPUISE (24 * 3600UL)
 
-// Indique la méthode de transmission :
-// Si PETITES_TRAMES est defini : chaque variable est transmise séparément ;
-// Sinon : toutes les variables sont transmises dans une unique requête (array JSON).
-#define PETITES_TRAMES
+/// Temps minimum en secondes entre deux transmissions du diagnostic des mesures de distance, sauf à la demande du serveur.
+#define DIAGNOSTIC_PERIODE (24 * 3600UL)
+
+/// Nombre maximum d'échantillons d'une transmission périodique (distance, température, hygrométrie, batterie).
+#define TRANSMISSION_ECHANTILLONS 4
 
 /**
  * Classe principale qui implémente l'application.
@@ -78,15 +103,29 @@ public:
  * @return boolean value to indicate if execution was right or not. A faulty exec. means the program can't continue and should be aborted.
  */
   bool setup() {
-    DEBUG(F("Configuration\n-------------\n"));
-    DEBUG(F("- Mesures toutes les ")); DEBUG(INTERVAL_MESURES); DEBUG(F("s ;\n"));
-    DEBUG(F("- Transmissions toutes les ")); DEBUG(INTERVAL_TRANSMISSION); DEBUG(F("s ;\n"));
-    DEBUG(F("- Nombre d'echantillons matériels par mesure ")); DEBUG(RANGE_SEQ_MIN); DEBUG(F(" pour ")); DEBUG(RANGE_SEQ_MAX); DEBUG(F(" tentatives ;\n"));
-#ifdef PETITES_TRAMES
-    DEBUG(F("- Transmission des valeurs par trames distinctes (PETITES).\n"));
-#else
-    DEBUG(F("- Transmission des valeurs regroupees par trames (GRANDES).\n"));
+    Memoire::peindre();
+#if defined(CAPTURE) || defined(REJEU)
+    Capture::begin();
+#endif
+#ifdef MISE_A_JOUR
+    MiseAJour::begin();
 #endif
+    Budget::charger();
+    Serveurs::charger();    // Derniers serveurs reçus, ou le serveur compilé
+    liaison.charger();      // Historique de la liaison avant le dernier reset
+    parametres.acquisition = Acquisition::charger();    // Derniers paramètres reçus, ou ceux compilés
+    const acquisition_t& acquisition = parametres.acquisition;
+
+    DEBUG(F("Configuration\n-------------\n"));
+    DEBUG(F("- Mesures toutes les ")); DEBUG(acquisition.mesures); DEBUG(F("s ;\n"));
+    DEBUG(F("- Transmissions toutes les ")); DEBUG(acquisition.transmission); DEBUG(F("s ;\n"));
+    DEBUG(F("- Nombre d'echantillons matériels par mesure ")); DEBUG(acquisition.echantillons); DEBUG(F(" pour ")); DEBUG(acquisition.tentatives); DEBUG(F(" tentatives ;\n"));
+    DEBUG(F("- Veille d'alerte entre deux mesures par sonde de ")); DEBUG(RANGE_SONDE); DEBUG(F(" tentatives, marge ")); DEBUG(ALERT_MARGE); DEBUG(F("mm ;\n"));
+    if (acquisition.petitesTrames) {
+      DEBUG(F("- Transmission des valeurs par trames distinctes (PETITES).\n"));
+    } else {
+      DEBUG(F("- Transmission des valeurs regroupees par trames (GRANDES).\n"));
+    }
 
     DEBUG(F("-------------\n"));
     DEBUG(F("Communication setup\n"));
@@ -97,16 +136,15 @@ public:
 
     rtc.begin();
 
-// Get Parameters & datetime
+// Get Parameters & datetime : au démarrage, l'heure et la version des paramètres sont inconnues
+    communication.lier(rtc, alertes, parametres);
     DEBUG(F("Get parameters...")); DEBUG(F("\n"));
-    const bool ok = communication.getParameters(imei, rtc, alert1, alert2, startTime, stopTime, reset);
+    const bool ok = communication.getParameters(imei);
     DEBUG(ok);
     DEBUG('\n');
-
-// Sending Status
-    DEBUG(F("Sending Initial Status Starting\n"));
-    if (!communication.sendStatus(rtc, F("Starting"), imei)) {
-      DEBUG(F("Echec de transmission. Poursuite !\n"));
+    Budget::sauvegarder(rtc.getEpoch());    // Changement de période de facturation pendant l'arrêt
+    if (communication.economiser(PSM_PERIODE_MULTIPLE * parametres.acquisition.transmission, PSM_ACTIF, EDRX_CYCLE)) {
+      DEBUG(F("PSM actif.\n"));
     }
 
 // Start all sensors (init...)
@@ -114,12 +152,18 @@ public:
       DEBUG(F("Erreur d'initialisation des capteurs. ABANDON !\n"));
       return false;
     }
+    energie.mettreAJour(rtc.getEpoch(), sensors.sampleBattery());
+
+// Sending Status
+    DEBUG(F("Sending Initial Status Starting\n"));
+    if (!communication.sendStatus(rtc, F("Starting"), imei, energie)) {
+      DEBUG(F("Echec de transmission. Poursuite !\n"));
+    }
 
 // Mesurer la distance et initialiser les alertes
     const unsigned distance = mesurerDistance();
     if (distance > 0) {   // Pas d'alerte en cas de valeur à 0
-      if (alert1.enabled()) alert1.test(distance / 10.0f);
-      if (alert2.enabled()) alert2.test(distance / 10.0f);
+      alertes.test(rtc.getEpoch(), distance);
     } else {
       DEBUG(F("Première mesure de distance invalide. Poursuite !\n"));
     }
@@ -130,6 +174,9 @@ public:
     rtc.enableAlarm(rtc.MATCH_SS);
     rtc.attachInterrupt(App::intTimer);
     App::fIntTimer = false;
+#ifdef CAPTURE
+    Capture::vider();
+#endif
     
     return true;
   }
@@ -143,7 +190,10 @@ public:
 //    rtc.standbyMode();
     
 // Si on a détecté un changement de minute
-    if (!App::fIntTimer) return true;
+    if (!App::fIntTimer) {
+      if (dormance) rtc.standbyMode();    // Seule l'alarme de fin de dormance réveillera le processeur
+      return true;
+    }
 
     const byte sec = rtc.getSeconds();
     const byte minu = rtc.getMinutes();
@@ -152,105 +202,215 @@ public:
     App::fIntTimer = false;
 
     DEBUG(F("Wakeup @ ")); DEBUG(getTimestamp()); DEBUG("\n");
+#ifdef CAPTURE
+    Capture::vider();
+#endif
 
-// Vérification de l'heure de RESET quotidien
-    if ((reset >= 0) && (static_cast<unsigned>(reset) == minu + 60U * heure)) {
-      NVIC_SystemReset();
+// Vérification de l'heure de RESET quotidien, le diagnostic en cours étant transmis avant d'être perdu ;
+// l'arriéré, seulement en RAM, est vidé avant, et le reset est remis au lendemain s'il n'a pas pu l'être
+    if ((parametres.reset >= 0) && (static_cast<unsigned>(parametres.reset) == minu + 60U * heure)) {
+      const uint32_t epoch = rtc.getEpoch();
+      const Budget::niveau_t niveau = Budget::niveau(epoch);
+      if (!diagnostic.vide() && (niveau != Budget::EPUISE) &&
+          !communication.sendStatus(rtc, F("Diagnostic"), imei, energie, diagnostic.json())) {
+        DEBUG(F("Echec de transmission du diagnostic avant reset.\n"));
+      }
+      if (!backlog.vide() && (niveau <= Budget::ECONOME)) backlog.vider(communication, imei, epoch);
+      if (backlog.vide()) {
+        Budget::sauvegarder(epoch, true);
+        liaison.enregistrer();
+        NVIC_SystemReset();
+      }
+      DEBUG(F("Arriere non vide, reset remis au lendemain.\n"));
     }
 
-// Vérification de la période de veille
-    if ((startTime > 0) && (heure < startTime)) return true;      // Pas encore l'heure (veille)
-    if ((stopTime > 0) && (heure >= stopTime)) return true;       // Trop tard (veille)
+// Commande de rafale reçue par SMS, sauf modem éteint ou en PSM
+    if (communication.lireSms()) {
+      DEBUG(F("Commande recue par SMS.\n"));
+    }
+    const bool rafale = enRafale();
+    const unsigned long mesures = rafale ? parametres.rafaleMesures : parametres.acquisition.mesures * energie.multiplicateur();
+    const unsigned long transmission = rafale ? parametres.rafaleTransmission : parametres.acquisition.transmission * energie.multiplicateur();
+
+// Palier d'énergie MINIMAL : modem éteint hors des minutes de transmission, rallumé par la connexion suivante
+    if (energie.modemEteint() && (t % transmission) && !communication.estEteint()) communication.eteindre();
+
+// Vérification de la période de veille, sauf pendant une rafale : dormance jusqu'à la fin de la veille
+    const unsigned minute = minu + 60U * heure;
+    if (!rafale && enVeille(minute)) {
+      if (!dormance) endormir(minute);
+      return true;
+    }
+    if (dormance) reveiller();
       
 // Présence d'un intervale pour déclencher une mesure de distance
-    if ((t % INTERVAL_MESURES) && (t % INTERVAL_TRANSMISSION)) return true;  // pas de mesure à cette minute
+    if ((t % mesures) && (t % transmission)) {  // pas de mesure à cette minute
+// Veille d'alerte : sonde rapide, mesure complète seulement à l'approche d'un seuil
+      if (!alertes.enabled() || !energie.veilleAlertes()) return true;
+      const unsigned sonde = sonder();
+      if ((sonde == 0) || !alertes.proche(rtc.getEpoch(), sonde, ALERT_MARGE)) return true;
+      DEBUG(F("Sonde proche d'un seuil d'alerte, mesure complete.\n"));
+      const unsigned distance = mesurerDistance();
+      if (distance > 0) {
+        intervalle.ajouter(rtc.getEpoch(), distance);
+        traiterAlertes(distance);
+      }
+      return true;
+    }
 
 // Mesure de distance
     const unsigned distance = mesurerDistance();
 
     if (distance > 0) {   // Pas d'alerte en cas de valeur à 0
-      if (alert1.enabled() && alert1.test(distance / 10.0f)) {    // Alerte activée et dépassement de seuil (montant ou descendant)
-        const Communication::sample_t sample = { rtc.getEpoch(), F("alert1"), distance / 10.0f };
-        if (!communication.sendSample(sample, imei)) {
-          DEBUG(F("Echec de transmission. Poursuite !\n"));
-        }
-      }
-  
-      if (alert2.enabled() && alert2.test(distance / 10.0f)) {    // Alerte activée et dépassement de seuil (montant ou descendant)
-        const Communication::sample_t sample = { rtc.getEpoch(), F("alert2"), distance / 10.0f };
-        if (!communication.sendSample(sample, imei)) {
-          DEBUG(F("Echec de transmission. Poursuite !\n"));
-        }
+      intervalle.ajouter(rtc.getEpoch(), distance);
+      traiterAlertes(distance);
+      if (rafale && (t % transmission)) {   // Mesure intermédiaire de la rafale, transmise avec le lot
+        lotRafale[nbRafale++] = { rtc.getEpoch(), F("range"), static_cast<int32_t>(distance), 1 };
+        if (nbRafale == RAFALE_LOT) transmettreRafale();
       }
     } else {  // Transmettre une trame d'erreur (distance invalide)
-      const Communication::sample_t sample = { rtc.getEpoch(), F("invalide range"), 0};
-      if (!communication.sendSample(sample, imei)) {
-        DEBUG(F("Echec de transmission. Poursuite !\n"));
-      }
+      const Communication::sample_t sample = { rtc.getEpoch(), F("invalide range"), 0, 0 };
+      transmettre(sample);
     }
       
-    if ((t % INTERVAL_TRANSMISSION) == 0) {   // C'est le moment de transmission
-      Communication::sample_t samples[4];
+    if ((t % transmission) == 0) {   // C'est le moment de transmission
+// Gouverneur du forfait de données, les alertes n'y sont pas soumises
+      const uint32_t epoch = rtc.getEpoch();
+      Budget::sauvegarder(epoch);
+      const Budget::niveau_t niveau = Budget::niveau(epoch);
+      DEBUG(F("Forfait : ")); DEBUG(Budget::consomme()); DEBUG(F(" octets, projection ")); DEBUG(Budget::projection(epoch)); DEBUG(F(", niveau ")); DEBUG(niveau); DEBUG('\n');
+
+      if (nbRafale) transmettreRafale(niveau);
+
+      Communication::sample_t samples[TRANSMISSION_ECHANTILLONS];
       size_t s = 0;
       
-// Transmission distance si non nulle.
+// Distance si non nulle.
       if (distance > 0) { // Ne pas transmettre de mesure invalide.
-        samples[s] = { rtc.getEpoch(), F("range"), distance / 10.0f };  // Utilisation du dernier échantillon (valide).
-#ifdef PETITES_TRAMES
-        if (!communication.sendSample(samples[s], imei)) {
-          DEBUG(F("Echec de transmission. Poursuite !\n"));
+        samples[s++] = { epoch, F("range"), static_cast<int32_t>(distance), 1 };  // Utilisation du dernier échantillon (valide), mm -> cm.
+      }
+
+// Temp & hygro si OK
+      int16_t temp = 0;     // 1/100 °C
+      uint16_t hygro = 0;   // pour-mille
+      if (!energie.environnement()) {
+        DEBUG(F("Temperature & hygro non mesurees (energie).\n"));
+      } else if (sensors.sampleAM2302(temp, hygro)) {
+        samples[s++] = { epoch, F("temp"), temp, 2 };
+        DEBUG(F("Temperature : ")); DEBUG(temp); DEBUG(F(" c°C\n"));
+        samples[s++] = { epoch, F("hygro"), hygro, 1 };
+        DEBUG(F("Hygrometrie : ")); DEBUG(hygro); DEBUG(F(" pour-mille\n"));
+      } else { 
+        DEBUG(F("Echec de mesure de temps & hygro!\n"));
+      }
+
+// Vbat
+      const uint16_t vBat = sensors.sampleBattery();    // mV
+      samples[s++] = { epoch, F("vbat"), vBat, 3 };
+      DEBUG("Batterie : "); DEBUG(vBat); DEBUG(F(" mV\n"));
+      if (energie.mettreAJour(epoch, vBat)) {   // Changement de palier d'énergie signalé par un statut
+        communication.sendStatus(rtc, F("Energie"), imei, energie);
+      }
+
+// Forfait consommé : tout part dans l'arriéré jusqu'à la prochaine période
+      if (niveau == Budget::EPUISE) {
+        DEBUG(F("Forfait epuise, transmission differee.\n"));
+        for (size_t i = 0; i < s; ++i) backlog.ajouter(samples[i]);
+        if (epoch - dernierParametres >= BUDGET_PARAMETRES_EPUISE) {   // Une lecture par jour : reset, rafale, nouveaux serveurs...
+          dernierParametres = epoch;
+          DEBUG(F("Get parameters..."));
+          const bool ok = communication.getParameters(imei);
+          DEBUG(ok);
+          DEBUG('\n');
         }
-#endif
-        ++s;
+        return true;
       }
 
-// Transmission temp & hygro si OK
-      float temp, hygro = 0.0;
-      if (sensors.sampleAM2302(temp, hygro)) {
-        samples[s] = { rtc.getEpoch(), F("temp"), temp };
-#ifdef PETITES_TRAMES
-        if (!communication.sendSample(samples[s], imei)) {
-          DEBUG(F("Echec de transmission. Poursuite !\n"));
+// Forfait serré : transmission seulement sur variation de la distance ou au battement
+      const unsigned ecart = (distance > dernierRange) ? distance - dernierRange : dernierRange - distance;
+      if ((niveau == Budget::SEVERE) && (ecart < BUDGET_DELTA_RANGE) && (epoch - dernierEnvoi < BUDGET_BATTEMENT)) {
+        DEBUG(F("Forfait serre, pas de variation : pas de transmission.\n"));
+        return true;
+      }
+
+// Signal faible : report dans l'arriéré si une heure proche offre habituellement une meilleure liaison
+      const int csq = communication.qualiteSignal();
+      liaison.noter(heure, csq);
+      if (!rafale && liaison.differer(epoch, heure, csq)) {
+        DEBUG(F("Signal faible (")); DEBUG(csq); DEBUG(F("), transmission differee.\n"));
+        for (size_t i = 0; i < s; ++i) backlog.ajouter(samples[i]);
+        return true;
+      }
+
+// Résumé des distances de l'intervalle (n, min, max, moyenne, écart-type), si le forfait le permet
+      const Communication::resume_t resume = { intervalle.premierEpoch(), intervalle.dernierEpoch() - intervalle.premierEpoch(),
+                                               F("range"), 1, intervalle };
+      const bool avecResume = (intervalle.n() > 1) && (niveau <= Budget::ECONOME);
+
+// Petites trames seulement si le forfait le permet, sinon transmission de l'ensemble
+      bool transmis = true;
+      const bool petites = parametres.acquisition.petitesTrames && (niveau == Budget::NORMAL);
+      if (petites) {
+        for (size_t i = 0; i < s; ++i) transmis &= transmettre(samples[i]);
+        if (transmis && avecResume && !communication.sendSummaries(&resume, 1, imei)) {
+          DEBUG(F("Echec de transmission du resume. Poursuite !\n"));
         }
-#endif
-        ++s;
-        DEBUG(F("Temperature : ")); DEBUG(temp); DEBUG('\n');
-          
-        samples[s] = { rtc.getEpoch(), F("hygro"), hygro };
-#ifdef PETITES_TRAMES
-        if (!communication.sendSample(samples[s], imei)) {
+      } else if (!communication.sendSamples(samples, s, imei, avecResume ? &resume : NULL)) {
+        DEBUG(F("Echec de transmission. Poursuite !\n"));
+        for (size_t i = 0; i < s; ++i) backlog.ajouter(samples[i]);
+        transmis = false;
+      }
+      liaison.noterAttache(heure, communication.dureeAttache());
+      if (transmis) {   // Sinon le résumé suivant couvrira aussi cet intervalle
+        intervalle.raz();
+        liaison.transmis();
+        dernierEnvoi = epoch;
+        if (distance > 0) dernierRange = distance;
+      }
+
+// Vidange de l'arriéré si le réseau est revenu
+      if (transmis && (niveau <= Budget::ECONOME) && !backlog.vide()) {
+        DEBUG(F("Vidange de l'arriere...\n"));
+        if (!backlog.vider(communication, imei, rtc.getEpoch())) {
           DEBUG(F("Echec de transmission. Poursuite !\n"));
         }
-#endif
-        ++s;
-        DEBUG(F("Hygrometrie : ")); DEBUG(hygro); DEBUG('\n');
-      } else { 
-        DEBUG(F("Echec de mesure de temps & hygro!\n"));
       }
 
-// Transmission vbat
-      const float vBat = sensors.sampleBattery();
-      samples[s] = { rtc.getEpoch(), F("vbat"), vBat };
-#ifdef PETITES_TRAMES
-        if (!communication.sendSample(samples[s], imei)) {
+// Récupération des paramètres, seulement si les réponses aux transmissions ne les ont pas confirmés
+      if (!communication.parametresAJour()) {
+        DEBUG(F("Get parameters..."));
+        const bool ok = communication.getParameters(imei);
+        DEBUG(ok);
+        DEBUG('\n');
+      }
+
+// Diagnostic des mesures de distance, à la demande du serveur ou chaque jour si le forfait le permet (dès la première transmission après un démarrage)
+      if (transmis && !diagnostic.vide() &&
+          (parametres.diagnostic || ((niveau == Budget::NORMAL) && (epoch - dernierDiagnostic >= DIAGNOSTIC_PERIODE)))) {
+        if (communication.sendStatus(rtc, F("Diagnostic"), imei, energie, diagnostic.json())) {
+          diagnostic.raz();
+          parametres.diagnostic = false;
+          dernierDiagnostic = epoch;
+        } else {
           DEBUG(F("Echec de transmission. Poursuite !\n"));
         }
-#endif
-      ++s;
-      DEBUG("Batterie : "); DEBUG(vBat); DEBUG('\n');
+      }
 
-// Si grandes trames, transmission de l'ensemble
-#ifndef PETITES_TRAMES
-      if (!communication.sendSamples(samples, s, imei)) {
-        DEBUG(F("Echec de transmission. Poursuite !\n"));
+#ifdef MISE_A_JOUR
+// Téléchargement d'une mise à jour du firmware, seulement si le forfait et la batterie le permettent
+      if (transmis && (niveau == Budget::NORMAL) && (energie.palier() == Energie::NORMAL) && MiseAJour::annoncee()) {
+        mettreAJour();
       }
 #endif
 
-// Récupération des paramètres
-      DEBUG(F("Get parameters..."));
-      const bool ok = communication.getParameters(imei, rtc, alert1, alert2, startTime, stopTime, reset);
-      DEBUG(ok);
-      DEBUG('\n');
+// Retransmission à pleine résolution des échantillons résumés, à la demande du serveur
+      if (parametres.raw && (niveau <= Budget::ECONOME)) {
+        if (backlog.rejouer(communication, imei, parametres.raw)) {
+          parametres.raw = 0;
+        } else {
+          DEBUG(F("Echec de transmission. Poursuite !\n"));
+        }
+      }
     }  
     return true;
   }
@@ -265,12 +425,21 @@ protected:
  */
   App(const __FlashStringHelper apn[], const __FlashStringHelper login[], const __FlashStringHelper password[]) :
     sensors(TRIGGER, ECHO, AM2302),       ///< Initialisation de capteurs (broches de connexion)
-    communication(Communication::getInstance(apn, login, password, F("api.picolimno.fr"), 80)),  ///< Initialisation de la communication.
-    alert1(),                             ///< Initialisation de l'alerte Rouge (seuil et hystérésis)
-    alert2(),                             ///< Initialisation de l'alerte Orange  (seuil et hystérésis)
-    startTime(0),                         ///< Heure de démarrage des mesures (HH) 
-    stopTime(0),                          ///< Heure de fin des mesures (HH)
-    reset(-1)
+    communication(Communication::getInstance(apn, login, password, F(API_SERVER), API_PORT)),  ///< Initialisation de la communication.
+    alertes(),                            ///< Initialisation des règles d'alerte (toutes désactivées)
+    parametres({ -1, -1, -1, F(SMS_GATEWAY), 0, 0, 0, 0, Acquisition::defaut(), false }),   ///< Pas de veille, de reset ni de rafale, passerelle SMS des alertes en l'absence de GPRS
+    backlog(),
+    energie(),
+    liaison(),
+    diagnostic(),
+    intervalle(),
+    lotRafale(),
+    nbRafale(0),
+    dernierRange(0),
+    dernierEnvoi(0),
+    dernierDiagnostic(0),
+    dernierParametres(0),
+    dormance(false)
   {
   }
 
@@ -295,6 +464,188 @@ protected:
     return String(buffer);
   }
 
+/**
+ * @param minute La minute de la journée.
+ * @return true si la minute est hors de la fenêtre de mesure startTime/stopTime.
+ */
+  bool enVeille(const unsigned minute) const {
+    if ((parametres.startTime >= 0) && (minute < static_cast<unsigned>(parametres.startTime))) return true;   // Pas encore l'heure
+    if ((parametres.stopTime >= 0) && (minute >= static_cast<unsigned>(parametres.stopTime))) return true;    // Trop tard
+    return false;
+  }
+
+/**
+ * Retourne la fin de la veille : le début de la fenêtre de mesure (minuit s'il n'y en a pas),
+ * ou la minute du reset quotidien si elle vient avant.
+ *
+ * @param minute La minute de la journée.
+ * @return La minute de la journée où finit la veille.
+ */
+  unsigned finVeille(const unsigned minute) const {
+    unsigned fin = (parametres.startTime >= 0) ? parametres.startTime : 0;
+    const unsigned attente = (fin + 1440 - minute) % 1440;
+    if (parametres.reset >= 0) {
+      const unsigned reset = (parametres.reset + 1440 - minute) % 1440;
+      if (reset && (!attente || (reset < attente))) fin = parametres.reset;
+    }
+    return fin;
+  }
+
+/**
+ * Entre en dormance : vide les transmissions en attente, éteint complètement le modem
+ * et remplace l'alarme de chaque minute par une alarme unique à la fin de la veille.
+ *
+ * @param minute La minute de la journée.
+ */
+  void endormir(const unsigned minute) {
+    const uint32_t epoch = rtc.getEpoch();
+    const Budget::niveau_t niveau = Budget::niveau(epoch);
+    if (nbRafale) transmettreRafale(niveau);
+    if ((niveau <= Budget::ECONOME) && !backlog.vide()) {
+      DEBUG(F("Vidange de l'arriere avant dormance...\n"));
+      if (!backlog.vider(communication, imei, epoch)) {
+        DEBUG(F("Echec de transmission. Poursuite !\n"));
+      }
+    }
+    Budget::sauvegarder(epoch, true);
+    liaison.enregistrer();
+    communication.eteindre(true);
+
+    const unsigned fin = finVeille(minute);
+    DEBUG(F("Dormance jusqu'a ")); DEBUG(fin / 60); DEBUG(':'); DEBUG(fin % 60); DEBUG('\n');
+    rtc.setAlarmTime(fin / 60, fin % 60, 0);
+    rtc.enableAlarm(rtc.MATCH_HHMMSS);
+    dormance = true;
+  }
+
+/**
+ * Sort de dormance : rétablit l'alarme de chaque minute ; le modem sera rallumé par la connexion suivante.
+ */
+  void reveiller() {
+    DEBUG(F("Fin de dormance.\n"));
+    rtc.setAlarmSeconds(59);
+    rtc.enableAlarm(rtc.MATCH_SS);
+    dormance = false;
+  }
+
+#ifdef MISE_A_JOUR
+/**
+ * Télécharge la suite du delta de la mise à jour annoncée, au plus MISE_A_JOUR_TRANSMISSION octets ;
+ * une fois le delta complet, reconstruit et vérifie la nouvelle image, l'annonce par un statut puis l'installe.
+ */
+  void mettreAJour() {
+    uint32_t total = 0;
+    for (;;) {
+      File delta = MiseAJour::delta();
+      if (!delta) return;
+      const uint32_t restant = MiseAJour::restant();
+      if (!restant || (total >= MISE_A_JOUR_TRANSMISSION)) {
+        delta.close();
+        break;
+      }
+      const size_t n = communication.telecharger(MiseAJour::chemin(), MiseAJour::position(), min(restant, static_cast<uint32_t>(MISE_A_JOUR_BLOC)), delta);
+      delta.close();
+      if (!n) {
+        DEBUG(F("Echec de telechargement. Poursuite !\n"));
+        return;
+      }
+      total += n;
+    }
+    DEBUG(F("Mise a jour : ")); DEBUG(MiseAJour::position()); DEBUG(F(" octets telecharges.\n"));
+    if (MiseAJour::restant()) return;   // suite à la prochaine transmission
+
+    if (!MiseAJour::reconstruire()) {
+      communication.sendStatus(rtc, F("Firmware invalide"), imei, energie);
+      return;
+    }
+    communication.sendStatus(rtc, String(F("Firmware ")) + MiseAJour::version(), imei, energie);
+    communication.eteindre();
+    MiseAJour::installer();
+  }
+
+#endif
+/**
+ * Transmet un échantillon, ou le place dans l'arriéré en cas d'échec.
+ *
+ * @param sample L'échantillon.
+ * @return Le succès de la transmission.
+ */
+  bool transmettre(const Communication::sample_t& sample) {
+    if (communication.sendSample(sample, imei)) return true;
+    DEBUG(F("Echec de transmission. Poursuite !\n"));
+    backlog.ajouter(sample);
+    return false;
+  }
+
+/**
+ * Indique si une rafale est en cours et y met fin à son terme ou si la batterie est trop faible.
+ *
+ * @return true pendant une rafale.
+ */
+  bool enRafale() {
+    if (!parametres.rafaleFin) return false;
+    if (rtc.getEpoch() >= parametres.rafaleFin) {
+      DEBUG(F("Fin de rafale.\n"));
+      parametres.rafaleFin = 0;
+      return false;
+    }
+    if (sensors.sampleBattery() < RAFALE_VBAT_MIN) {
+      DEBUG(F("Batterie faible, fin de rafale.\n"));
+      parametres.rafaleFin = 0;
+      return false;
+    }
+    return true;
+  }
+
+/**
+ * Transmet en une requête les mesures intermédiaires de la rafale, ou les place dans l'arriéré en cas d'échec
+ * ou si le forfait de données est épuisé.
+ *
+ * @param niveau Le niveau d'économie du forfait de données.
+ */
+  void transmettreRafale(const Budget::niveau_t niveau = Budget::NORMAL) {
+    if ((niveau == Budget::EPUISE) || !communication.sendSamples(lotRafale, nbRafale, imei)) {
+      DEBUG(F("Echec de transmission. Poursuite !\n"));
+      for (byte i = 0; i < nbRafale; ++i) backlog.ajouter(lotRafale[i]);
+    }
+    nbRafale = 0;
+  }
+
+/**
+ * Teste toutes les règles d'alerte avec une nouvelle distance et transmet les changements d'état.
+ *
+ * @param distance La distance mesurée en mm (non nulle).
+ */
+  void traiterAlertes(const unsigned distance) {
+    const uint32_t epoch = rtc.getEpoch();
+    const uint16_t changements = alertes.test(epoch, distance);   // Toutes les règles en une passe
+    for (byte i = 0; i < ALERT_REGLES_MAX; ++i) {
+      if (!(changements & (1U << i))) continue;   // Pas de changement d'état (montant ou descendant)
+      const Communication::sample_t sample = { epoch, AlertEngine::nom(i), alertes.mesure(i), alertes.decimales(i) };
+      backlog.alerte(epoch);    // Les échantillons voisins seront transmis à pleine résolution
+      if (!communication.sendAlert(sample, imei, parametres.sms)) {
+        DEBUG(F("Echec de transmission. Poursuite !\n"));
+        backlog.ajouter(sample);
+      }
+    }
+  }
+
+/**
+ * Sonde rapide : retourne le premier échantillon matériel valide parmi RANGE_SONDE tentatives.
+ *
+ * @return La distance approchée en mm ou 0 si aucun échantillon n'est valide.
+ */
+  unsigned sonder() const {
+    for (unsigned i = 0; i < RANGE_SONDE; ++i) {
+      const unsigned s = sensors.sampleRange();
+      if (s > 0) {
+        DEBUG(F("Sonde : ")); DEBUG(s); DEBUG(F("mm\n"));
+        return s;
+      }
+    }
+    return 0;
+  }
+
 /**
  * Trie directement le tableau d'entiers non-signés afin d'obtenir la médiane en position centrale du tableau.
  * @warning Le tableau ne sera pas entièrement trié !
@@ -316,21 +667,13 @@ protected:
   }
 
 /**
- * 
+ * Trie les échantillons et retourne la médiane.
+ *
+ * @param d Les échantillons, triés au retour.
+ * @param n Le nombre d'échantillons.
+ * @return L'échantillon central, d[n / 2].
  */
-  unsigned mesurerDistance() const {
-    unsigned d[RANGE_SEQ_MIN];
-    unsigned n = 0; // nb échantillons valides
-    for (unsigned i = 0; i < RANGE_SEQ_MAX; ++i) {
-      const unsigned s = sensors.sampleRange();
-      if (s > 0) {
-        d[n++] = s;
-        DEBUG(s); DEBUG(F("--"));
-        if (n >= RANGE_SEQ_MIN) break; // Objectif atteint
-      }
-    }
-    DEBUG('\n');
-      
+  static unsigned mediane(unsigned d[], const unsigned n) {
     if (n > 1) {
       qsort(d, n, sizeof(unsigned), [](const void* a, const void* b) -> int { 
         const unsigned int_a = * ( (unsigned*) a );
@@ -338,9 +681,37 @@ protected:
         return (int_a > int_b) - (int_a < int_b);
       });
     }
+    return d[n / 2];
+  }
 
-    const unsigned distance = (n >= RANGE_SEQ_MIN) ? d[n / 2] : 0;            
-    DEBUG(F("Distance : ")); DEBUG(distance / 10.0f); DEBUG(F(" - Ech. : ")); DEBUG(n); DEBUG('\n');
+/**
+ * Mesure la distance : médiane des échantillons matériels valides, selon les paramètres d'acquisition.
+ *
+ * @return La distance en mm ou 0 si les échantillons valides sont insuffisants.
+ */
+  unsigned mesurerDistance() {
+    unsigned d[ACQUISITION_ECHANTILLONS_MAX];
+    const unsigned objectif = energie.echantillons(parametres.acquisition.echantillons);   // moins d'échantillons si la batterie faiblit
+    unsigned n = 0; // nb échantillons valides
+    unsigned i = 0; // nb mesures matérielles
+    while (i < parametres.acquisition.tentatives) {
+      const unsigned long pulse = sensors.samplePulse();
+      ++i;
+      diagnostic.impulsion(pulse);
+      const unsigned s = Sensors::range(pulse);
+      if (s > 0) {
+        d[n++] = s;
+        DEBUG(s); DEBUG(F("--"));
+        if (n >= objectif) break; // Objectif atteint
+      }
+    }
+    DEBUG('\n');
+      
+    Memoire::point(Memoire::MESURE);
+    const unsigned m = mediane(d, n);
+    const unsigned distance = (n >= objectif) ? m : 0;
+    diagnostic.mesure(i, distance > 0);
+    DEBUG(F("Distance : ")); DEBUG(distance); DEBUG(F("mm - Ech. : ")); DEBUG(n); DEBUG('\n');
     return distance;
   }
  
@@ -362,9 +733,23 @@ private:
   };
 
 // Parameters
-  Alert alert1, alert2;
-  byte startTime, stopTime;
-  int reset;            ///< reset time in min ou -1 if not.
+  AlertEngine alertes;  ///< Règles d'alerte, dont alert1 (Rouge) & alert2 (Orange).
+  Communication::parametres_t parametres;   ///< Veille, reset quotidien, passerelle SMS...
+
+  Backlog backlog;      ///< Échantillons non transmis, résumés après une longue coupure.
+  Energie energie;      ///< Tendance de la batterie et palier de dégradation.
+  Liaison liaison;      ///< Qualité de la liaison par heure, pour différer les transmissions non urgentes.
+  Diagnostic diagnostic;    ///< Impulsions brutes et rejets des mesures de distance.
+  Statistiques intervalle;  ///< Distances mesurées depuis la dernière transmission, résumées avec elle.
+
+  Communication::sample_t lotRafale[RAFALE_LOT];   ///< Mesures intermédiaires de la rafale en attente de transmission.
+  byte nbRafale;
+
+  unsigned dernierRange;    ///< Dernière distance transmise en mm.
+  uint32_t dernierEnvoi;    ///< Heure de la dernière transmission réussie.
+  uint32_t dernierDiagnostic;   ///< Heure de la dernière transmission du diagnostic.
+  uint32_t dernierParametres;   ///< Heure de la dernière lecture des paramètres, forfait consommé.
+  bool dormance;            ///< Modem éteint et alarme unique programmée jusqu'à la fin de la veille.
 
   static volatile
   bool fIntTimer;
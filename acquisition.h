@@ -0,0 +1,143 @@
+/*
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+/**
+ *  @file
+ *  Picolimno MKR V1.0 project
+ *  acquisition.h
+ *  Define the acquisition parameters : defaults, bounds and persistence in flash.
+ *
+ *  @author Marc Sibert
+ *  @version 1.0 14/04/2018
+ *  @Copyright 2018 Marc Sibert
+ */
+
+#pragma once
+
+#include <FlashStorage.h>
+
+/// Temps en secondes entre deux mesures de distance (par défaut).
+#define INTERVAL_MESURES (5*60)
+
+/// Temps en seconde entre deux transmissions (par défaut).
+#define INTERVAL_TRANSMISSION (15 *60)
+
+/// Nombre d'échantillons matériels nécessaires pour faire un échantillon brut après médiane (minimum sinon l'échantillon est invalide, par défaut).
+#define RANGE_SEQ_MIN 20
+/// Nombre maximum de mesures matérielles pou obtenir le nombre d'échantillons matériels nécessaires (par défaut).
+#define RANGE_SEQ_MAX 60
+
+// Indique la méthode de transmission (par défaut) :
+// Si PETITES_TRAMES est defini : chaque variable est transmise séparément ;
+// Sinon : toutes les variables sont transmises dans une unique requête (array JSON).
+#define PETITES_TRAMES
+
+/// Bornes des intervalles de mesure et de transmission en secondes, multiples de la minute.
+#define ACQUISITION_INTERVAL_MIN 60
+#define ACQUISITION_INTERVAL_MAX (12 * 3600U)
+/// Bornes du nombre d'échantillons matériels par mesure ; le maximum dimensionne le tampon de la médiane.
+#define ACQUISITION_ECHANTILLONS_MIN 3
+#define ACQUISITION_ECHANTILLONS_MAX 40
+/// Nombre maximum de mesures matérielles pour obtenir les échantillons.
+#define ACQUISITION_TENTATIVES_MAX 120
+
+/**
+ * Paramètres d'acquisition modifiables à distance.
+ */
+struct acquisition_t {
+  uint16_t mesures;         ///< Temps en secondes entre deux mesures de distance.
+  uint16_t transmission;    ///< Temps en secondes entre deux transmissions.
+  byte echantillons;        ///< Nombre d'échantillons matériels valides par mesure.
+  byte tentatives;          ///< Nombre maximum de mesures matérielles pour les obtenir.
+  bool petitesTrames;       ///< Chaque variable est transmise séparément, sinon en une unique requête (array JSON).
+};
+
+/**
+ * Registre enregistré en flash.
+ */
+struct registreAcquisition_t {
+  uint32_t magique;
+  acquisition_t acquisition;
+};
+
+FlashStorage(acquisitionFlash, registreAcquisition_t);
+
+/**
+ * Validation et conservation en flash des paramètres d'acquisition, qui survivent ainsi aux resets.
+ * Toutes les méthodes sont statiques.
+ */
+class Acquisition {
+
+public:
+/**
+ * @return Les paramètres compilés (INTERVAL_*, RANGE_SEQ_* et PETITES_TRAMES).
+ */
+  static acquisition_t defaut() {
+#ifdef PETITES_TRAMES
+    const bool petites = true;
+#else
+    const bool petites = false;
+#endif
+    const acquisition_t a = { INTERVAL_MESURES, INTERVAL_TRANSMISSION, RANGE_SEQ_MIN, RANGE_SEQ_MAX, petites };
+    return a;
+  }
+
+/**
+ * Relit les paramètres enregistrés en flash.
+ *
+ * @return Les paramètres enregistrés s'ils sont valides, les paramètres par défaut sinon.
+ */
+  static acquisition_t charger() {
+    const registreAcquisition_t r = acquisitionFlash.read();
+    if ((r.magique != MAGIQUE) || !valide(r.acquisition)) return defaut();
+    return r.acquisition;
+  }
+
+/**
+ * Enregistre les paramètres en flash s'ils ont changé (usure).
+ *
+ * @param a Les paramètres, supposés valides.
+ */
+  static void enregistrer(const acquisition_t& a) {
+    const acquisition_t e = charger();
+    if ((e.mesures == a.mesures) && (e.transmission == a.transmission) && (e.echantillons == a.echantillons) &&
+        (e.tentatives == a.tentatives) && (e.petitesTrames == a.petitesTrames)) return;
+    registreAcquisition_t r;
+    r.magique = MAGIQUE;
+    r.acquisition = a;
+    acquisitionFlash.write(r);
+  }
+
+/**
+ * Vérifie des paramètres : intervalles multiples de la minute dans leurs bornes,
+ * échantillons dans leurs bornes et obtenus en au plus ACQUISITION_TENTATIVES_MAX tentatives.
+ *
+ * @param a Les paramètres.
+ * @return true si les paramètres sont valides.
+ */
+  static bool valide(const acquisition_t& a) {
+    return intervalle(a.mesures) && intervalle(a.transmission) &&
+           (a.echantillons >= ACQUISITION_ECHANTILLONS_MIN) && (a.echantillons <= ACQUISITION_ECHANTILLONS_MAX) &&
+           (a.tentatives >= a.echantillons) && (a.tentatives <= ACQUISITION_TENTATIVES_MAX);
+  }
+
+protected:
+  static bool intervalle(const uint16_t s) {
+    return (s >= ACQUISITION_INTERVAL_MIN) && (s <= ACQUISITION_INTERVAL_MAX) && !(s % 60);
+  }
+
+private:
+  static const uint32_t MAGIQUE = 0xAC9E7101;
+
+};
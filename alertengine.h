@@ -0,0 +1,320 @@
+/*
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+/**
+ *  @file
+ *  Picolimno MKR V1.0 project
+ *  alertengine.h
+ *  Define an AlertEngine class : a table of alert rules evaluated in one pass.
+ *
+ *  @author Marc Sibert
+ *  @version 1.0 23/5/2018
+ *  @Copyright 2018 Marc Sibert
+ */
+
+#pragma once
+
+/// Nombre maximum de règles d'alerte (les 2 premières sont alert1 & alert2 historiques).
+#define ALERT_REGLES_MAX 8
+
+/// Nombre de mesures conservées pour le calcul des vitesses de montée/descente.
+#define ALERT_HISTORIQUE 16
+
+/**
+ * Moteur d'alertes.
+ * Contient une table de règles évaluées toutes ensembles à chaque nouvelle mesure de distance :
+ * - NIVEAU : franchissement d'un seuil de distance (mm) avec hystérésis ;
+ * - VITESSE : vitesse de variation (1/100 cm/min) calculée sur une fenêtre glissante (min).
+ * Tous les calculs sont faits en entiers (pas de FPU sur le SAMD21).
+ * Le sens MONTEE correspond à une montée de l'eau, donc à une distance qui diminue.
+ * Une règle ne change d'état qu'après "persistance" mesures consécutives allant dans le même sens.
+ */
+class AlertEngine {
+
+public:
+  enum type_t : byte {
+    AUCUNE,     ///< Règle désactivée
+    NIVEAU,     ///< Seuil de distance en mm
+    VITESSE     ///< Seuil de vitesse en 1/100 cm/min
+  };
+
+  enum sens_t : byte {
+    MONTEE,     ///< L'eau monte : distance qui diminue
+    DESCENTE    ///< L'eau descend : distance qui augmente
+  };
+
+/**
+ * Définition d'une règle.
+ */
+  struct regle_t {
+    type_t type;
+    sens_t sens;
+    int32_t seuil;        ///< Seuil en mm (NIVEAU) ou en 1/100 cm/min (VITESSE).
+    int32_t ecart;        ///< Écart de retour à l'état normal (hystérésis), même unité que le seuil.
+    uint16_t fenetre;     ///< Fenêtre de calcul de la vitesse en minutes (VITESSE seulement).
+    byte persistance;     ///< Nombre de mesures consécutives nécessaires pour changer d'état (1 = immédiat).
+  };
+
+/**
+ * Constructeur, toutes les règles sont désactivées.
+ */
+  AlertEngine() :
+    fHisto(),
+    fNbHisto(0),
+    fPosHisto(0)
+  {
+    for (byte i = 0; i < ALERT_REGLES_MAX; ++i) desactiver(i);
+  }
+
+/**
+ * Définit une règle.
+ * L'état de la règle est conservé si son type et son sens ne changent pas.
+ *
+ * @param i L'indice de la règle.
+ * @param regle La définition de la règle.
+ */
+  void configurer(const byte i, const regle_t& regle) {
+    if (i >= ALERT_REGLES_MAX) return;
+    etat_t& e = fEtats[i];
+    if ((e.regle.type != regle.type) || (e.regle.sens != regle.sens)) {
+      e.active = false;
+      e.compteur = 0;
+      e.mesure = 0;
+    }
+    e.regle = regle;
+    if (e.regle.persistance < 1) e.regle.persistance = 1;
+  }
+
+/**
+ * Fenêtre la plus large couverte par l'historique : au-delà, la vitesse serait calculée sur une durée plus courte que demandée.
+ * Les mesures complètes de la veille d'alerte, plus rapprochées, raccourcissent encore l'historique.
+ *
+ * @param intervalle L'intervalle entre deux mesures en secondes.
+ * @return La fenêtre maximum en minutes.
+ */
+  static uint16_t fenetreMax(const uint32_t intervalle) {
+    const uint32_t m = ALERT_HISTORIQUE * intervalle / 60;
+    return (m > 0xffff) ? 0xffff : m;
+  }
+
+/**
+ * Désactive une règle et oublie son état.
+ *
+ * @param i L'indice de la règle.
+ */
+  void desactiver(const byte i) {
+    if (i >= ALERT_REGLES_MAX) return;
+    fEtats[i] = etat_t();
+  }
+
+/**
+ * Évalue toutes les règles pour une nouvelle mesure et l'ajoute à l'historique.
+ *
+ * @param epoch L'heure de la mesure.
+ * @param value La distance mesurée en mm.
+ * @return Un masque dont le bit i indique que la règle i a changé d'état.
+ */
+  uint16_t test(const uint32_t epoch, const unsigned value) {
+    uint16_t changements = 0;
+    for (byte i = 0; i < ALERT_REGLES_MAX; ++i) {
+      etat_t& e = fEtats[i];
+      int32_t x;
+      if (!grandeur(e.regle, epoch, value, x)) continue;
+      e.mesure = (e.regle.type == NIVEAU) ? value : x;
+
+      // La condition testée est celle qui ferait changer la règle d'état
+      const int32_t s = seuil(e.regle);
+      const bool bascule = e.active ? (x < s - e.regle.ecart) : (x > s);
+      if (!bascule) {
+        e.compteur = 0;
+        continue;
+      }
+      if (++e.compteur >= e.regle.persistance) {
+        e.active = !e.active;
+        e.compteur = 0;
+        changements |= (1U << i);
+      }
+    }
+
+    fHisto[fPosHisto] = { epoch, static_cast<uint16_t>(value) };
+    fPosHisto = (fPosHisto + 1) % ALERT_HISTORIQUE;
+    if (fNbHisto < ALERT_HISTORIQUE) ++fNbHisto;
+
+    return changements;
+  }
+
+/**
+ * Indique si une valeur approchée (sonde rapide) est à moins d'une marge d'un changement d'état d'une des règles.
+ * N'ajoute pas la valeur à l'historique.
+ *
+ * @param epoch L'heure de la mesure.
+ * @param value La distance approchée en mm.
+ * @param marge La marge en mm ; pour les règles de VITESSE, elle est répartie sur la fenêtre.
+ * @return true si au moins une règle est proche de changer d'état.
+ */
+  bool proche(const uint32_t epoch, const unsigned value, const int32_t marge) const {
+    for (byte i = 0; i < ALERT_REGLES_MAX; ++i) {
+      const etat_t& e = fEtats[i];
+      int32_t x;
+      if (!grandeur(e.regle, epoch, value, x)) continue;
+      if (e.compteur > 0) return true;    // Changement d'état en cours de confirmation
+
+      const int32_t s = seuil(e.regle);
+      const int32_t m = ((e.regle.type == VITESSE) && (e.regle.fenetre > 0)) ? marge * 10 / e.regle.fenetre : marge;
+      const int32_t reste = e.active ? x - (s - e.regle.ecart) : s - x;
+      if (reste <= m) return true;
+    }
+    return false;
+  }
+
+/**
+ * @return true si au moins une règle est définie.
+ */
+  bool enabled() const {
+    for (byte i = 0; i < ALERT_REGLES_MAX; ++i) {
+      if (enabled(i)) return true;
+    }
+    return false;
+  }
+
+/**
+ * @param i L'indice de la règle.
+ * @return true si la règle est définie.
+ */
+  bool enabled(const byte i) const {
+    return (i < ALERT_REGLES_MAX) && (fEtats[i].regle.type != AUCUNE);
+  }
+
+/**
+ * @param i L'indice de la règle.
+ * @return true si la règle est en état d'alerte.
+ */
+  bool active(const byte i) const {
+    return (i < ALERT_REGLES_MAX) && fEtats[i].active;
+  }
+
+/**
+ * Retourne la dernière grandeur évaluée par la règle : la distance (mm) ou la vitesse dans le sens de la règle (1/100 cm/min).
+ *
+ * @param i L'indice de la règle.
+ */
+  int32_t mesure(const byte i) const {
+    return (i < ALERT_REGLES_MAX) ? fEtats[i].mesure : 0;
+  }
+
+/**
+ * Retourne le nombre de décimales de mesure() exprimée en cm ou en cm/min.
+ *
+ * @param i L'indice de la règle.
+ * @return 1 pour une distance en mm, 2 pour une vitesse en 1/100 cm/min.
+ */
+  byte decimales(const byte i) const {
+    return ((i < ALERT_REGLES_MAX) && (fEtats[i].regle.type == VITESSE)) ? 2 : 1;
+  }
+
+/**
+ * Retourne le nom de la variable transmise lors du changement d'état de la règle.
+ *
+ * @param i L'indice de la règle.
+ * @return "alert1" à "alert8".
+ */
+  static const __FlashStringHelper* nom(const byte i) {
+    switch (i) {
+      case 0 : return F("alert1");
+      case 1 : return F("alert2");
+      case 2 : return F("alert3");
+      case 3 : return F("alert4");
+      case 4 : return F("alert5");
+      case 5 : return F("alert6");
+      case 6 : return F("alert7");
+      default : return F("alert8");
+    }
+  }
+
+protected:
+/**
+ * Retourne le seuil de la règle orienté comme la grandeur calculée par grandeur().
+ *
+ * @param regle La règle.
+ */
+  static int32_t seuil(const regle_t& regle) {
+    return ((regle.type == NIVEAU) && (regle.sens == MONTEE)) ? -regle.seuil : regle.seuil;
+  }
+
+/**
+ * Calcule la grandeur comparée au seuil, orientée de sorte qu'une valeur croissante aille vers l'alerte.
+ *
+ * @param regle La règle.
+ * @param epoch L'heure de la mesure.
+ * @param value La distance mesurée en mm.
+ * @param x Retourne la grandeur.
+ * @return false si la grandeur ne peut être calculée (règle désactivée, historique insuffisant).
+ */
+  bool grandeur(const regle_t& regle, const uint32_t epoch, const unsigned value, int32_t& x) const {
+    switch (regle.type) {
+      case NIVEAU :
+        x = (regle.sens == MONTEE) ? -static_cast<int32_t>(value) : static_cast<int32_t>(value);
+        return true;
+      case VITESSE : {
+        int32_t v;
+        if (!vitesse(epoch, value, regle.fenetre, v)) return false;
+        x = (regle.sens == MONTEE) ? v : -v;
+        return true;
+      }
+      default :
+        return false;
+    }
+  }
+
+/**
+ * Calcule la vitesse de montée de l'eau depuis la plus ancienne mesure de la fenêtre.
+ *
+ * @param epoch L'heure de la mesure.
+ * @param value La distance mesurée en mm.
+ * @param fenetre La largeur de la fenêtre en minutes.
+ * @param v Retourne la vitesse en 1/100 cm/min (soit 1/10 mm/min), positive si l'eau monte.
+ * @return false si aucune mesure de l'historique n'est exploitable (au moins 1 min d'écart).
+ */
+  bool vitesse(const uint32_t epoch, const unsigned value, const uint16_t fenetre, int32_t& v) const {
+    const uint32_t debut = epoch - 60UL * fenetre;
+    for (byte n = fNbHisto; n > 0; --n) {   // de la plus ancienne à la plus récente
+      const mesure_t& m = fHisto[(fPosHisto + ALERT_HISTORIQUE - n) % ALERT_HISTORIQUE];
+      if (m.epoch < debut || m.epoch > epoch) continue;
+      const uint32_t duree = epoch - m.epoch;
+      if (duree < 60) return false;
+      v = (static_cast<int32_t>(m.value) - static_cast<int32_t>(value)) * 600L / static_cast<int32_t>(duree);
+      return true;
+    }
+    return false;
+  }
+
+private:
+  struct etat_t {
+    regle_t regle;
+    bool active;          ///< État d'alerte courant.
+    byte compteur;        ///< Nombre de mesures consécutives allant vers un changement d'état.
+    int32_t mesure;       ///< Dernière grandeur évaluée.
+  };
+
+  struct mesure_t {
+    uint32_t epoch;
+    uint16_t value;       ///< Distance en mm.
+  };
+
+  etat_t fEtats[ALERT_REGLES_MAX];
+  mesure_t fHisto[ALERT_HISTORIQUE];
+  byte fNbHisto;
+  byte fPosHisto;
+
+};
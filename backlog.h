@@ -0,0 +1,271 @@
+/*
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+/**
+ *  @file
+ *  Picolimno MKR V1.0 project
+ *  backlog.h
+ *  Define a Backlog class : samples not transmitted, uploaded summarised after a long outage.
+ *
+ *  @author Marc Sibert
+ *  @version 1.0 14/04/2018
+ *  @Copyright 2018 Marc Sibert
+ */
+
+#pragma once
+
+/// Nombre d'échantillons bruts non transmis conservés en RAM.
+#define BACKLOG_TAILLE 128
+/// Nombre de résumés conservés ; au-delà, les résumés d'une même variable sont fusionnés deux à deux.
+#define BACKLOG_RESUMES 24
+/// Âge en secondes en deçà duquel les échantillons sont transmis à pleine résolution.
+#define BACKLOG_RECENT (2 * 3600UL)
+/// Durée en secondes d'une tranche de résumé.
+#define BACKLOG_TRANCHE 3600UL
+/// Écart en secondes autour d'une alerte en deçà duquel les échantillons sont transmis à pleine résolution.
+#define BACKLOG_MARGE_ALERTE (30 * 60UL)
+/// Nombre d'alertes mémorisées pour protéger leurs échantillons voisins.
+#define BACKLOG_ALERTES 8
+/// Nombre d'éléments par requête lors de la vidange.
+#define BACKLOG_LOT 8
+
+/**
+ * Arriéré des échantillons non transmis.
+ * Lors du retour du réseau, les échantillons anciens sont transmis sous forme de résumés par variable et par tranche
+ * (n, min, max, moyenne, dernier), les échantillons récents ou proches d'une alerte à pleine résolution.
+ * Les échantillons bruts résumés restent dans l'anneau jusqu'à écrasement et peuvent être retransmis à la demande du serveur.
+ */
+class Backlog {
+
+public:
+  Backlog() :
+    fEntrees(),
+    fDebut(0),
+    fN(0),
+    fResumes(),
+    fNbResumes(0),
+    fAlertes(),
+    fPosAlertes(0)
+  {
+  }
+
+/**
+ * Ajoute un échantillon non transmis.
+ * Si l'anneau est plein, le plus ancien échantillon est résumé avant d'être écrasé.
+ *
+ * @param sample L'échantillon.
+ */
+  void ajouter(const Communication::sample_t& sample) {
+    if (fN == BACKLOG_TAILLE) {
+      entree_t& e = fEntrees[fDebut];
+      if (e.etat == ATTENTE) resumer(e.sample);
+      fDebut = (fDebut + 1) % BACKLOG_TAILLE;
+      --fN;
+    }
+    entree_t& e = fEntrees[(fDebut + fN) % BACKLOG_TAILLE];
+    e.sample = sample;
+    e.etat = ATTENTE;
+    ++fN;
+  }
+
+/**
+ * Mémorise l'heure d'un changement d'état d'alerte, transmis ou non.
+ *
+ * @param epoch L'heure de l'alerte.
+ */
+  void alerte(const uint32_t epoch) {
+    fAlertes[fPosAlertes] = epoch;
+    fPosAlertes = (fPosAlertes + 1) % BACKLOG_ALERTES;
+  }
+
+/**
+ * @return true s'il ne reste rien à transmettre.
+ */
+  bool vide() const {
+    if (fNbResumes) return false;
+    for (size_t i = 0; i < fN; ++i) {
+      if (entree(i).etat == ATTENTE) return false;
+    }
+    return true;
+  }
+
+/**
+ * Transmet l'arriéré : résume les échantillons anciens, transmet les résumés puis les échantillons restants par lots.
+ * S'arrête au premier échec, ce qui reste sera transmis à la prochaine vidange.
+ *
+ * @param communication La communication utilisée.
+ * @param aIMEI L'IMEI du device.
+ * @param maintenant L'heure actuelle.
+ * @return true si tout a été transmis.
+ */
+  bool vider(const Communication& communication, const String& aIMEI, const uint32_t maintenant) {
+    for (size_t i = 0; i < fN; ++i) {
+      entree_t& e = entree(i);
+      if (e.etat != ATTENTE) continue;
+      if (maintenant - e.sample.epoch < BACKLOG_RECENT) continue;
+      if (procheAlerte(e.sample.epoch)) continue;
+      resumer(e.sample);
+      e.etat = RESUME;
+    }
+
+    while (fNbResumes) {
+      const size_t n = (fNbResumes < BACKLOG_LOT) ? fNbResumes : BACKLOG_LOT;
+      if (!communication.sendSummaries(fResumes, n, aIMEI)) return false;
+      for (size_t i = n; i < fNbResumes; ++i) fResumes[i - n] = fResumes[i];
+      fNbResumes -= n;
+    }
+
+    return envoyer(communication, aIMEI, ATTENTE, 0);
+  }
+
+/**
+ * Retransmet à pleine résolution les échantillons résumés encore présents dans l'anneau.
+ *
+ * @param communication La communication utilisée.
+ * @param aIMEI L'IMEI du device.
+ * @param depuis L'heure à partir de laquelle les échantillons sont retransmis.
+ * @return true si tout a été transmis.
+ */
+  bool rejouer(const Communication& communication, const String& aIMEI, const uint32_t depuis) {
+    return envoyer(communication, aIMEI, RESUME, depuis);
+  }
+
+protected:
+  enum etat_t : byte {
+    TRANSMIS,     ///< Transmis à pleine résolution
+    ATTENTE,      ///< À transmettre
+    RESUME        ///< Transmis sous forme de résumé, disponible pour une retransmission brute
+  };
+
+  struct entree_t {
+    Communication::sample_t sample;
+    etat_t etat;
+  };
+
+/**
+ * Retourne la i-ème entrée de l'anneau, de la plus ancienne à la plus récente.
+ */
+  entree_t& entree(const size_t i) {
+    return fEntrees[(fDebut + i) % BACKLOG_TAILLE];
+  }
+
+  const entree_t& entree(const size_t i) const {
+    return fEntrees[(fDebut + i) % BACKLOG_TAILLE];
+  }
+
+/**
+ * @return true si l'heure est proche d'une alerte mémorisée.
+ */
+  bool procheAlerte(const uint32_t epoch) const {
+    for (byte i = 0; i < BACKLOG_ALERTES; ++i) {
+      const uint32_t a = fAlertes[i];
+      if (!a) continue;
+      const uint32_t ecart = (a > epoch) ? a - epoch : epoch - a;
+      if (ecart <= BACKLOG_MARGE_ALERTE) return true;
+    }
+    return false;
+  }
+
+/**
+ * Compare les noms de deux variables : deux F("range") identiques peuvent être à des adresses différentes.
+ *
+ * @return true si les noms sont égaux.
+ */
+  static bool memeVariable(const __FlashStringHelper* a, const __FlashStringHelper* b) {
+    return (a == b) || !strcmp_P(reinterpret_cast<PGM_P>(a), reinterpret_cast<PGM_P>(b));
+  }
+
+/**
+ * Ajoute un échantillon au résumé de sa variable et de sa tranche.
+ * Si tous les résumés sont occupés, ceux d'une même variable sont d'abord fusionnés deux à deux (tranches doublées).
+ *
+ * @param sample L'échantillon.
+ */
+  void resumer(const Communication::sample_t& sample) {
+    const uint32_t tranche = sample.epoch - sample.epoch % BACKLOG_TRANCHE;
+    for (byte i = fNbResumes; i > 0; --i) {   // du plus récent au plus ancien
+      Communication::resume_t& r = fResumes[i - 1];
+      if (!memeVariable(r.variable, sample.variable) || (r.decimales != sample.decimales)) continue;
+      if ((sample.epoch < r.epoch) || (sample.epoch >= r.epoch + r.duree)) break;
+      r.stats.ajouter(sample.epoch, sample.value);
+      return;
+    }
+
+    if (fNbResumes == BACKLOG_RESUMES) compacter();
+    if (fNbResumes == BACKLOG_RESUMES) {
+      DEBUG(F("Backlog : resume perdu\n"));
+      return;
+    }
+    Communication::resume_t& r = fResumes[fNbResumes++];
+    r.epoch = tranche;
+    r.duree = BACKLOG_TRANCHE;
+    r.variable = sample.variable;
+    r.decimales = sample.decimales;
+    r.stats.raz();
+    r.stats.ajouter(sample.epoch, sample.value);
+  }
+
+/**
+ * Fusionne chaque résumé avec le suivant de la même variable.
+ */
+  void compacter() {
+    for (byte i = 0; i < fNbResumes; ++i) {
+      Communication::resume_t& r = fResumes[i];
+      for (byte j = i + 1; j < fNbResumes; ++j) {
+        const Communication::resume_t& s = fResumes[j];
+        if (!memeVariable(s.variable, r.variable) || (s.decimales != r.decimales)) continue;
+        r.stats.fusionner(s.stats);
+        r.duree = s.epoch + s.duree - r.epoch;
+        for (byte k = j + 1; k < fNbResumes; ++k) fResumes[k - 1] = fResumes[k];
+        --fNbResumes;
+        break;
+      }
+    }
+    DEBUG(F("Backlog : ")); DEBUG(fNbResumes); DEBUG(F(" resumes apres compactage\n"));
+  }
+
+/**
+ * Transmet par lots les échantillons dans un état donné, qui passent à l'état TRANSMIS.
+ *
+ * @return true si tout a été transmis.
+ */
+  bool envoyer(const Communication& communication, const String& aIMEI, const etat_t etat, const uint32_t depuis) {
+    Communication::sample_t lot[BACKLOG_LOT];
+    size_t positions[BACKLOG_LOT];
+    size_t n = 0;
+    for (size_t i = 0; i <= fN; ++i) {
+      if (i < fN) {
+        const entree_t& e = entree(i);
+        if ((e.etat != etat) || (e.sample.epoch < depuis)) continue;
+        lot[n] = e.sample;
+        positions[n++] = i;
+        if (n < BACKLOG_LOT) continue;
+      }
+      if (!n) break;
+      if (!communication.sendSamples(lot, n, aIMEI)) return false;
+      while (n) entree(positions[--n]).etat = TRANSMIS;
+    }
+    return true;
+  }
+
+private:
+  entree_t fEntrees[BACKLOG_TAILLE];
+  size_t fDebut;
+  size_t fN;
+  Communication::resume_t fResumes[BACKLOG_RESUMES];
+  byte fNbResumes;
+  uint32_t fAlertes[BACKLOG_ALERTES];   ///< Heures des dernières alertes, 0 si aucune.
+  byte fPosAlertes;
+
+};
@@ -0,0 +1,212 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   banc.h
+   Purpose: Common part of the host bench : console of the firmware, input files, measures and baselines.
+
+   Chaque programme du banc est une seule unité de compilation qui inclut ce fichier puis App.h, comme le
+   croquis : les en-têtes du firmware définissent leurs membres statiques.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include "hote.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+/// Console du firmware : Serial seulement, affichée avec hote::journal.
+#define DEBUG(x) do { Serial.print(x); } while (0)
+
+#include "secrets.h"
+
+/// Répertoire du banc, où se trouvent les données enregistrées et les références.
+#ifndef BANC_SOURCE
+#define BANC_SOURCE "."
+#endif
+
+/// Nombre de répétitions d'une mesure, dont la médiane est retenue.
+#define BANC_REPETITIONS 7
+
+/// Tolérance sur le temps par opération, rapporté à l'étalon, avant de signaler une régression.
+#define BANC_TOLERANCE 1.5
+
+namespace banc {
+
+  /**
+     Lit un fichier de données du banc.
+
+     @param nom Le nom du fichier dans BANC_SOURCE/donnees.
+     @return Les lignes, sans les lignes vides ni les commentaires (#).
+  */
+  inline std::vector<std::string> lignes(const std::string& nom) {
+    std::vector<std::string> l;
+    std::ifstream f(std::string(BANC_SOURCE) + "/donnees/" + nom);
+    if (!f) {
+      fprintf(stderr, "Donnees %s introuvables.\n", nom.c_str());
+      exit(2);
+    }
+    std::string s;
+    while (std::getline(f, s)) {
+      if (!s.empty() && (s[0] != '#')) l.push_back(s);
+    }
+    return l;
+  }
+
+  /**
+     Enregistrement d'une trace CAPTURE.BIN (capture.h).
+  */
+  struct enregistrement_t {
+    uint32_t position;    ///< Position de l'en-tête dans la trace.
+    uint32_t ms;
+    uint8_t type;
+    std::string donnees;
+  };
+
+  /**
+     Lit une trace CAPTURE.BIN ; un enregistrement tronqué termine la lecture.
+  */
+  inline std::vector<enregistrement_t> trace(const std::string& fichier) {
+    std::vector<enregistrement_t> t;
+    std::ifstream f(fichier, std::ios::binary);
+    const std::string c((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    for (size_t i = 0; i + 6 <= c.size(); ) {
+      const uint8_t* const e = reinterpret_cast<const uint8_t*>(c.data() + i);
+      if (i + 6 + e[5] > c.size()) break;
+      t.push_back({ static_cast<uint32_t>(i), e[0] | (uint32_t(e[1]) << 8) | (uint32_t(e[2]) << 16) | (uint32_t(e[3]) << 24),
+                    e[4], c.substr(i + 6, e[5]) });
+      i += 6 + e[5];
+    }
+    return t;
+  }
+
+  /**
+     Coût d'une opération.
+  */
+  struct resultat_t {
+    std::string nom;
+    double ns;            ///< Temps par opération en ns, médiane des répétitions.
+    double allocations;   ///< Allocations du tas par opération.
+    double octets;        ///< Octets alloués par opération.
+  };
+
+  /**
+     Mesure une charge : une exécution à blanc, puis BANC_REPETITIONS exécutions chronométrées.
+
+     @param nom Le nom de la charge.
+     @param operations Le nombre d'opérations d'une exécution.
+     @param charge Exécute les opérations.
+     @return Le coût d'une opération.
+  */
+  template<class F>
+  resultat_t mesurer(const std::string& nom, const unsigned operations, F charge) {
+    charge();
+    std::vector<double> ns;
+    hote::Tas avant = hote::tas;
+    hote::Tas apres = hote::tas;
+    for (unsigned r = 0; r < BANC_REPETITIONS; ++r) {
+      avant = hote::tas;
+      const auto debut = std::chrono::steady_clock::now();
+      charge();
+      const auto fin = std::chrono::steady_clock::now();
+      apres = hote::tas;
+      ns.push_back(std::chrono::duration<double, std::nano>(fin - debut).count() / operations);
+    }
+    std::sort(ns.begin(), ns.end());
+    return { nom, ns[ns.size() / 2],
+             static_cast<double>(apres.allocations - avant.allocations) / operations,
+             static_cast<double>(apres.octets - avant.octets) / operations };
+  }
+
+  /**
+     Lit les références : une ligne "nom ns allocations octets" par charge.
+  */
+  inline std::map<std::string, resultat_t> references(const std::string& fichier) {
+    std::map<std::string, resultat_t> refs;
+    std::ifstream f(fichier);
+    std::string s;
+    while (std::getline(f, s)) {
+      if (s.empty() || (s[0] == '#')) continue;
+      char nom[64];
+      resultat_t r;
+      if (sscanf(s.c_str(), "%63s %lf %lf %lf", nom, &r.ns, &r.allocations, &r.octets) != 4) continue;
+      r.nom = nom;
+      refs[r.nom] = r;
+    }
+    return refs;
+  }
+
+  /**
+     Enregistre les résultats comme nouvelles références.
+  */
+  inline void enregistrer(const std::string& fichier, const std::vector<resultat_t>& resultats) {
+    FILE* f = fopen(fichier.c_str(), "w");
+    if (!f) {
+      fprintf(stderr, "Ecriture de %s impossible.\n", fichier.c_str());
+      exit(2);
+    }
+    fprintf(f, "# Références du banc (poste de développement, -O2) : nom, ns/op, allocations/op, octets alloués/op.\n");
+    fprintf(f, "# Les temps sont comparés après normalisation par la charge etalon ; réenregistrer avec --enregistrer.\n");
+    for (const resultat_t& r : resultats) fprintf(f, "%s %.1f %.3f %.1f\n", r.nom.c_str(), r.ns, r.allocations, r.octets);
+    fclose(f);
+  }
+
+  /**
+     Compare les résultats aux références : le temps, rapporté à l'étalon, ne doit pas dépasser BANC_TOLERANCE fois
+     la référence, les allocations et les octets ne doivent pas l'excéder.
+
+     @param resultats Les résultats, dont la charge "etalon".
+     @param refs Les références.
+     @return Le nombre de régressions.
+  */
+  inline int comparer(const std::vector<resultat_t>& resultats, const std::map<std::string, resultat_t>& refs) {
+    double echelle = 1;
+    for (const resultat_t& r : resultats) {
+      const auto ref = refs.find(r.nom);
+      if ((r.nom == "etalon") && (ref != refs.end()) && (r.ns > 0)) echelle = ref->second.ns / r.ns;
+    }
+    printf("%-22s %12s %12s %10s %10s %10s %10s\n", "charge", "ns/op", "ref", "allocs/op", "ref", "octets/op", "ref");
+    int regressions = 0;
+    for (const resultat_t& r : resultats) {
+      const auto ref = refs.find(r.nom);
+      if (ref == refs.end()) {
+        printf("%-22s %12.1f %12s %10.3f %10s %10.1f %10s  sans reference\n", r.nom.c_str(), r.ns * echelle, "-", r.allocations, "-", r.octets, "-");
+        ++regressions;
+        continue;
+      }
+      const resultat_t& e = ref->second;
+      std::string verdict;
+      if (r.ns * echelle > BANC_TOLERANCE * e.ns) verdict += " TEMPS";
+      if (r.allocations > e.allocations + 0.0005) verdict += " ALLOCATIONS";
+      if (r.octets > e.octets + 0.05) verdict += " OCTETS";
+      printf("%-22s %12.1f %12.1f %10.3f %10.3f %10.1f %10.1f %s\n", r.nom.c_str(), r.ns * echelle, e.ns,
+             r.allocations, e.allocations, r.octets, e.octets, verdict.empty() ? " ok" : verdict.c_str());
+      if (!verdict.empty()) ++regressions;
+    }
+    return regressions;
+  }
+}
@@ -0,0 +1,103 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   capture.cpp
+   Purpose: Record a CAPTURE.BIN trace of the firmware against the AT emulator, for the host replay (rejeu.cpp).
+
+   Usage : capture <répertoire> [--pertes]
+   Compilé avec CAPTURE. Le boîtier tourne 6 h en temps virtuel contre l'émulateur AT ; la trace est écrite dans
+   <répertoire>/CAPTURE.BIN, la carte SD simulée. Vérifie que la trace contient mesures et échanges avec le modem
+   et, sauf avec --pertes, qu'aucun enregistrement n'a été perdu ; avec --pertes (CAPTURE_RAM réduite à la compilation),
+   vérifie au contraire que la mémoire a débordé et que chaque débordement est noté par une PERTE.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#include "banc.h"
+#include "emulateur.h"
+#include "App.h"
+
+namespace {
+  int echecs = 0;
+
+  void verifier(const bool condition, const char* message) {
+    printf("%s %s\n", condition ? "ok  " : "ECHEC", message);
+    if (!condition) ++echecs;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage : capture <repertoire> [--pertes]\n");
+    return 2;
+  }
+  const std::string repertoire = argv[1];
+  const bool pertes = (argc > 2) && !strcmp(argv[2], "--pertes");
+  hote::journal = getenv("JOURNAL");
+  hote::carteSD(repertoire);
+  std::remove((repertoire + "/" CAPTURE_FICHIER).c_str());
+
+  Emulateur modem;
+  Serial1.brancher(&modem);
+  ServeurApi serveur;
+  serveur.brancher(modem);
+  serveur.configurer("{\"limit1R\":0,\"hyst1R\":0,\"limit2O\":0,\"hyst2O\":0}", "\"5f1c0e7a9b3d2c41\"");
+
+  App& app = App::getInstance(F(APN_NAME), F(APN_USERNAME), F(APN_PASSWORD));
+  try {
+    if (!app.setup()) {
+      printf("App::setup() en echec.\n");
+      return 1;
+    }
+    const uint64_t fin = hote::us + 6 * 3600ULL * 1000000ULL;
+    while (hote::us < fin) {
+      hote::attendreAlarme();
+      if (!app.loop()) {
+        printf("App::loop() en echec.\n");
+        return 1;
+      }
+    }
+    Capture::vider();   // comme au réveil suivant
+  } catch (const hote::Reset&) {
+    printf("Reset inattendu.\n");
+    return 1;
+  }
+
+  unsigned comptes[Capture::NB_TYPES] = {};
+  uint32_t perdus = 0;
+  const std::vector<banc::enregistrement_t> t = banc::trace(repertoire + "/" CAPTURE_FICHIER);
+  for (const banc::enregistrement_t& e : t) {
+    if (e.type < Capture::NB_TYPES) ++comptes[e.type];
+    if ((e.type == Capture::PERTE) && (e.donnees.size() == 4)) {
+      const uint8_t* const o = reinterpret_cast<const uint8_t*>(e.donnees.data());
+      perdus += o[0] | (uint32_t(o[1]) << 8) | (uint32_t(o[2]) << 16) | (uint32_t(o[3]) << 24);
+    }
+  }
+  printf("     %zu enregistrements : %u impulsions, %u AM2302, %u ADC, %u emis, %u recus, %u pertes (%u octets)\n",
+         t.size(), comptes[Capture::IMPULSION], comptes[Capture::AM2302], comptes[Capture::ADC],
+         comptes[Capture::MODEM_EMIS], comptes[Capture::MODEM_RECUS], comptes[Capture::PERTE], perdus);
+  verifier(comptes[Capture::DEBUT] == 1, "un DEBUT");
+  verifier(comptes[Capture::IMPULSION] && comptes[Capture::AM2302] && comptes[Capture::ADC], "mesures enregistrees");
+  verifier(comptes[Capture::MODEM_EMIS] && comptes[Capture::MODEM_RECUS], "echanges avec le modem enregistres");
+  if (pertes) {
+    verifier(comptes[Capture::PERTE] && perdus, "debordements de la memoire notes par des PERTE");
+  } else {
+    verifier(!comptes[Capture::PERTE], "aucun enregistrement perdu avec CAPTURE_RAM");
+  }
+  return echecs ? 1 : 0;
+}
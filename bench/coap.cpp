@@ -0,0 +1,199 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   coap.cpp
+   Purpose: TransportCoap against tools/serveur.py --coap-port, through the AT emulator and a local bridge.
+
+   Usage : coap <répertoire> <python3> <tools/serveur.py>
+   Compilé avec TRANSPORT_COAP. Le boîtier tourne 4 h en temps virtuel contre l'émulateur AT, dont les connexions
+   sont transmises par Passerelle à tools/serveur.py : UDP à son port CoAP, TCP (GET des paramètres) à son port http.
+   Les échantillons et statuts sont stockés en jsonl dans <répertoire>. Les paramètres sont changés après 2 h.
+   Vérifie que les PUT arrivent au serveur, que les corps de plus d'un bloc passent en Block1 (2.31 puis 2.04),
+   que chaque réponse porte l'ETag et tient dans le tampon du boîtier, qu'aucun message n'est retransmis, et que
+   les nouveaux paramètres sont remis par une réponse CoAP sans autre GET que celui du démarrage.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#include "banc.h"
+#include "emulateur.h"
+#include "passerelle.h"
+#include "App.h"
+
+#include <set>
+
+namespace {
+  int echecs = 0;
+
+  void verifier(const bool condition, const char* message) {
+    printf("%s %s\n", condition ? "ok  " : "ECHEC", message);
+    if (!condition) ++echecs;
+  }
+
+  /**
+     Ce que le banc retient d'un message CoAP.
+  */
+  struct message_t {
+    bool valide;
+    byte type;
+    byte code;
+    uint16_t mid;
+    bool etag;
+    long block1;      ///< Valeur de l'option Block1, -1 si absente.
+    size_t charge;    ///< Taille de la charge utile.
+  };
+
+  message_t lire(const std::string& d) {
+    message_t m = { false, 0, 0, 0, false, -1, 0 };
+    const uint8_t* const o = reinterpret_cast<const uint8_t*>(d.data());
+    if ((d.size() < 4) || ((o[0] >> 6) != 1)) return m;
+    m.type = (o[0] >> 4) & 0x03;
+    m.code = o[1];
+    m.mid = (o[2] << 8) | o[3];
+    size_t i = 4 + (o[0] & 0x0f);
+    unsigned numero = 0;
+    while ((i < d.size()) && (o[i] != 0xff)) {
+      unsigned delta = o[i] >> 4;
+      size_t len = o[i] & 0x0f;
+      ++i;
+      if (delta == 13) delta = o[i++] + 13;
+      if (len == 13) len = o[i++] + 13;
+      numero += delta;
+      if (numero == 4) m.etag = true;
+      if (numero == 27) {
+        m.block1 = 0;
+        for (size_t k = 0; k < len; ++k) m.block1 = (m.block1 << 8) | o[i + k];
+      }
+      i += len;
+    }
+    if (i > d.size()) return m;
+    m.charge = (i < d.size()) ? d.size() - i - 1 : 0;
+    m.valide = true;
+    return m;
+  }
+
+  bool ecrire(const std::string& nom, const std::string& contenu) {
+    std::ofstream f(nom);
+    f << contenu;
+    return f.good();
+  }
+
+  unsigned lignes(const std::string& nom) {
+    std::ifstream f(nom);
+    unsigned n = 0;
+    for (std::string l; std::getline(f, l); ) ++n;
+    return n;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 4) {
+    fprintf(stderr, "Usage : coap <repertoire> <python3> <tools/serveur.py>\n");
+    return 2;
+  }
+  const std::string repertoire = argv[1];
+  hote::journal = getenv("JOURNAL");
+  const std::string boitier = repertoire + "/GSM-869000000000001";
+  std::remove((boitier + ".samples.jsonl").c_str());
+  std::remove((boitier + ".status.jsonl").c_str());
+  const std::string parametres = repertoire + "/parametres.json";
+  if (!ecrire(parametres, "{\"defaut\":{\"limit1R\":0,\"hyst1R\":0,\"limit2O\":0,\"hyst2O\":0}}")) {
+    printf("Parametres non ecrits dans %s.\n", repertoire.c_str());
+    return 1;
+  }
+
+  Passerelle passerelle;
+  if (!passerelle.demarrer(argv[2], argv[3], { "--parametres", parametres, "--stockage", "jsonl:" + repertoire })) {
+    printf("%s %s ne demarre pas.\n", argv[2], argv[3]);
+    return 1;
+  }
+  Emulateur modem;
+  Serial1.brancher(&modem);
+  modem.serveur = [&passerelle](Emulateur::connexion_t& c, const std::string& r) {
+    return passerelle.transmettre(c.udp, r, ServeurApi::date());
+  };
+
+  App& app = App::getInstance(F(APN_NAME), F(APN_USERNAME), F(APN_PASSWORD));
+  size_t avantChangement = 0;
+  try {
+    if (!app.setup()) {
+      printf("App::setup() en echec.\n");
+      return 1;
+    }
+    const uint64_t changement = hote::us + 2 * 3600ULL * 1000000ULL;
+    const uint64_t fin = hote::us + 4 * 3600ULL * 1000000ULL;
+    while (hote::us < fin) {
+      if (!avantChangement && (hote::us >= changement)) {
+        avantChangement = passerelle.datagrammes.size();
+        ecrire(parametres, "{\"defaut\":{\"limit1R\":0,\"hyst1R\":1,\"limit2O\":0,\"hyst2O\":0}}");
+      }
+      hote::attendreAlarme();
+      if (!app.loop()) {
+        printf("App::loop() en echec.\n");
+        return 1;
+      }
+    }
+  } catch (const hote::Reset&) {
+    printf("Reset inattendu.\n");
+    return 1;
+  }
+
+  unsigned put = 0, continues = 0, finals = 0, sansEtag = 0, tropGrandes = 0, retransmis = 0, remises = 0, invalides = 0;
+  std::set<uint16_t> mids;
+  for (size_t i = 0; i < passerelle.datagrammes.size(); ++i) {
+    const Passerelle::echange_t& e = passerelle.datagrammes[i];
+    const message_t q = lire(e.requete);
+    if (!q.valide || (q.type != 0)) continue;   // ACK d'une réponse séparée
+    if (!mids.insert(q.mid).second) ++retransmis;
+    const message_t r = lire(e.reponse);
+    if (!r.valide || (r.mid != q.mid)) {
+      ++invalides;
+      continue;
+    }
+    if (e.reponse.size() > COAP_BLOC + 64) ++tropGrandes;
+    if (q.code != 0x03) continue;
+    ++put;
+    if ((q.block1 >= 0) && (q.block1 & 0x08)) {
+      if (r.code == 0x5f) ++continues;    // 2.31 Continue
+      continue;
+    }
+    if (r.code != 0x44) continue;         // 2.04 Changed
+    if (q.block1 >= 0) ++finals;
+    if (!r.etag) ++sansEtag;
+    if (r.charge && (i >= avantChangement)) ++remises;
+  }
+  unsigned get = 0;
+  for (const std::string& r : passerelle.requetes) {
+    if (!r.compare(0, 4, "GET ") && (r.find("/parameters") != std::string::npos)) ++get;
+  }
+  const unsigned echantillons = lignes(boitier + ".samples.jsonl");
+  const unsigned statuts = lignes(boitier + ".status.jsonl");
+  printf("     %zu datagrammes, %u PUT dont %u blocs 2.31 et %u derniers blocs, %u GET http des parametres\n",
+         passerelle.datagrammes.size(), put, continues, finals, get);
+  printf("     serveur.py : %u echantillons et resumes, %u statuts\n", echantillons, statuts);
+
+  verifier(!invalides, "une reponse CoAP a chaque message confirmable");
+  verifier(echantillons && statuts, "echantillons et statuts stockes par serveur.py");
+  verifier(continues && finals, "corps de plus d'un bloc transmis en Block1");
+  verifier(!sansEtag, "ETag dans chaque reponse 2.04");
+  verifier(!tropGrandes, "reponses dans le tampon de TransportCoap");
+  verifier(!retransmis, "aucune retransmission");
+  verifier(remises == 1, "nouveaux parametres remis une fois par une reponse CoAP");
+  verifier(get == 1, "parametres demandes en http au seul demarrage");
+  return echecs ? 1 : 0;
+}
@@ -0,0 +1,642 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   emulateur.h
+   Purpose: AT emulator of the modem for the host bench, and a minimal API server behind it.
+
+   L'émulateur se branche sur Serial1 (Serial1.brancher(&emulateur)) et répond aux commandes du dialecte
+   SIM800 de TinyGSM, ainsi qu'aux commandes PSM et eDRX du SARA-R4 (AT+CPSMS, AT+CEDRXS).
+   Il reste en vie jusqu'à la fin du programme : il observe les broches PWR_ON et RESETN du modem.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include "hote.h"
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <time.h>
+
+/// Heure de l'API au lancement du banc : 2018-10-01T00:00:00Z.
+#define EMULATEUR_EPOCH 1538352000UL
+
+/// Broches du modem observées : reset matériel (GSM_RESETN) et réveil de la veille profonde (MODEM_PWR_ON).
+#define EMULATEUR_RESETN 4
+#define EMULATEUR_PWR_ON 7
+
+/**
+   Modem émulé : un flux dont les réponses sont disponibles après un délai en temps virtuel.
+*/
+class Emulateur : public Stream {
+
+  public:
+    /**
+       Connexion TCP ou UDP ouverte par AT+CIPSTART.
+    */
+    struct connexion_t {
+      int mux;
+      bool udp;
+      std::string hote;
+      uint16_t port;
+      std::vector<size_t> segments;   ///< Taille de chaque AT+CIPSEND, dans l'ordre.
+      std::string emis;               ///< Octets émis par le firmware.
+      std::string recus;              ///< Octets reçus par le firmware.
+    };
+
+    /**
+       Commande AT reçue, avec l'état du modem à sa réception.
+    */
+    struct commande_t {
+      uint64_t us;          ///< Temps virtuel de réception.
+      std::string texte;    ///< La ligne, sans fin de ligne.
+      bool perdue;          ///< Reçue modem éteint ou en veille profonde, sans réponse.
+    };
+
+    /**
+       SMS reçu par le réseau, remis au modem quand il est joignable.
+    */
+    struct sms_t {
+      uint64_t us;          ///< Arrivée sur le réseau.
+      std::string expediteur;
+      std::string texte;
+      bool lu;
+      bool efface;
+    };
+
+    /// Serveur distant d'une connexion : rend la réponse à une requête complète, vide tant qu'elle est incomplète.
+    typedef std::function<std::string(connexion_t& connexion, const std::string& requete)> serveur_t;
+
+    Emulateur() :
+      allume(true),
+      gprs(false),
+      csq(18),
+      attachement(2000),
+      latence(150),
+      psm(false),
+      t3324(0),
+      t3412(0),
+      edrx(),
+      endormi(false),
+      activite(0),
+      sommeil(0),
+      reveils(0),
+      modele("SIMCOM_Ltd SIMCOM_SIM800 Revision:1418B04SIM800M32"),
+      imei("869000000000001"),
+      fEnvoi(-1),
+      fReste(0),
+      fSmsEnCours(false),
+      fBasPwrOn(false),
+      fBasReset(false),
+      fDebutSommeil(0)
+    {
+      for (int i = 0; i < 5; ++i) {
+        fOuvertes[i] = -1;
+        fFermee[i] = false;
+      }
+      hote::observer([this](uint32_t broche, uint32_t valeur) {
+        broches(broche, valeur);
+      });
+    }
+
+    int available() override {
+      int n = 0;
+      for (const auto& o : fSortie) {
+        if (o.first > hote::us) break;
+        ++n;
+      }
+      return n;
+    }
+
+    int read() override {
+      if (!available()) return -1;
+      const char c = fSortie.front().second;
+      fSortie.pop_front();
+      return static_cast<uint8_t>(c);
+    }
+
+    int peek() override {
+      return available() ? static_cast<uint8_t>(fSortie.front().second) : -1;
+    }
+
+    size_t write(uint8_t c) override {
+      recevoir(static_cast<char>(c));
+      return 1;
+    }
+
+    size_t write(const uint8_t* buffer, size_t size) override {
+      for (size_t i = 0; i < size; ++i) recevoir(static_cast<char>(buffer[i]));
+      return size;
+    }
+    using Print::write;
+
+    void flush() override {}
+
+    /**
+       Dépose un SMS sur le réseau.
+    */
+    void deposerSms(const std::string& expediteur, const std::string& texte) {
+      fSms.push_back({ hote::us, expediteur, texte, false, false });
+    }
+
+    /**
+       @return true si le modem est en veille profonde (PSM), à cet instant.
+    */
+    bool dort() {
+      if (psm && !endormi && allume && (hote::us > activite + 1000000ULL * t3324)) {
+        endormi = true;
+        fDebutSommeil = activite + 1000000ULL * t3324;
+      }
+      return endormi;
+    }
+
+    /**
+       @return Le temps passé en veille profonde en µs, jusqu'à cet instant.
+    */
+    uint64_t tempsSommeil() {
+      return sommeil + (dort() ? hote::us - fDebutSommeil : 0);
+    }
+
+    /**
+       @return Le nombre de commandes commençant par le préfixe, perdues ou non selon le filtre.
+    */
+    unsigned compter(const std::string& prefixe, const bool perdues) const {
+      unsigned n = 0;
+      for (const commande_t& c : commandes) {
+        if ((c.perdue == perdues) && !c.texte.compare(0, prefixe.size(), prefixe)) ++n;
+      }
+      return n;
+    }
+
+    /**
+       Oublie les commandes, les SMS émis et, si aucune n'est ouverte, les connexions relevées : un essai
+       d'endurance garde ainsi un tas constant du côté de l'émulateur.
+    */
+    void oublier() {
+      commandes.clear();
+      smsEmis.clear();
+      for (const int o : fOuvertes) {
+        if (o >= 0) return;
+      }
+      connexions.clear();
+    }
+
+    // Configuration du réseau et du modem
+    bool allume;             ///< Le modem est alimenté (pas de AT+CPOWD).
+    bool gprs;                ///< Le contexte PDP est actif.
+    int csq;                  ///< Qualité du signal rendue par AT+CSQ.
+    unsigned long attachement;  ///< Durée en ms de l'attachement GPRS (AT+CIICR).
+    unsigned long latence;    ///< Aller-retour en ms vers le serveur.
+    // Veille négociée (SARA-R4)
+    bool psm;                 ///< PSM demandé par AT+CPSMS=1.
+    uint32_t t3324;           ///< Temps actif en s.
+    uint32_t t3412;           ///< Période de mise à jour de zone en s.
+    std::string edrx;         ///< Cycle eDRX demandé.
+    bool endormi;             ///< En veille profonde jusqu'à une impulsion sur PWR_ON.
+    uint64_t activite;        ///< Dernière activité radio (µs), point de départ de T3324.
+    uint64_t sommeil;         ///< Veille profonde cumulée avant le dernier réveil (µs).
+    unsigned reveils;         ///< Réveils par PWR_ON.
+
+    std::string modele;       ///< Réponse à ATI.
+    std::string imei;
+
+    serveur_t serveur;                  ///< Serveur de toutes les connexions.
+    std::vector<connexion_t> connexions;  ///< Connexions, dans l'ordre d'ouverture.
+    std::vector<commande_t> commandes;  ///< Commandes reçues.
+    std::vector<std::string> smsEmis;   ///< SMS émis : "numéro:texte".
+
+  protected:
+    /**
+       Place une réponse dans le flux de sortie, disponible après un délai.
+    */
+    void repondre(const std::string& texte, const unsigned long delaiMs = 0) {
+      uint64_t t = hote::us + 1000ULL * delaiMs;
+      if (!fSortie.empty() && (fSortie.back().first > t)) t = fSortie.back().first;
+      for (const char c : texte) fSortie.push_back(std::make_pair(t, c));
+    }
+
+    void broches(const uint32_t broche, const uint32_t valeur) {
+      if (broche == EMULATEUR_PWR_ON) {
+        if (valeur == LOW) {
+          fBasPwrOn = true;
+        } else if (fBasPwrOn) {
+          fBasPwrOn = false;
+          if (dort()) {
+            sommeil += hote::us - fDebutSommeil;
+            endormi = false;
+            ++reveils;
+          }
+          activite = hote::us;
+        }
+      } else if (broche == EMULATEUR_RESETN) {
+        if (valeur == LOW) {
+          fBasReset = true;
+        } else if (fBasReset) {   // redémarrage : connexions et contexte perdus, la demande de PSM est conservée
+          fBasReset = false;
+          if (dort()) sommeil += hote::us - fDebutSommeil;
+          endormi = false;
+          allume = true;
+          gprs = false;
+          for (int& o : fOuvertes) o = -1;
+          fEnvoi = -1;
+          activite = hote::us;
+        }
+      }
+    }
+
+    void recevoir(const char c) {
+      if (fEnvoi >= 0) {    // données d'un AT+CIPSEND
+        fDonnees += c;
+        if (--fReste) return;
+        envoyer();
+        return;
+      }
+      if (fSmsEnCours) {    // texte d'un AT+CMGS, terminé par Ctrl-Z
+        if (c != 0x1a) {
+          fTexteSms += c;
+          return;
+        }
+        fSmsEnCours = false;
+        smsEmis.push_back(fNumeroSms + ":" + fTexteSms);
+        activite = hote::us;
+        repondre("\r\n+CMGS: 1\r\n\r\nOK\r\n", latence);
+        return;
+      }
+      if (c == '\r') return;
+      if (c != '\n') {
+        fLigne += c;
+        return;
+      }
+      std::string ligne;
+      ligne.swap(fLigne);
+      if (ligne.empty()) return;
+      const bool perdue = !allume || dort();
+      commandes.push_back({ hote::us, ligne, perdue });
+      if (!perdue) executer(ligne);
+    }
+
+    static bool prefixe(const std::string& s, const char* p) {
+      return !s.compare(0, strlen(p), p);
+    }
+
+    void ok() {
+      repondre("\r\nOK\r\n");
+    }
+
+    void erreur() {
+      repondre("\r\nERROR\r\n");
+    }
+
+    connexion_t* ouverte(const int mux) {
+      return ((mux >= 0) && (mux < 5) && (fOuvertes[mux] >= 0)) ? &connexions[fOuvertes[mux]] : NULL;
+    }
+
+    /**
+       Octets de la réponse du serveur non encore lus par le firmware, par connexion.
+    */
+    std::string& aLire(const int mux) {
+      return fALire[mux];
+    }
+
+    void executer(const std::string& l) {
+      if ((l == "AT") || (l == "AT&FZ") || (l == "ATE0") || (l == "AT&FZE0") || prefixe(l, "AT+CFUN=") ||
+          prefixe(l, "AT+SAPBR=") || prefixe(l, "AT+CGDCONT=") || prefixe(l, "AT+CGACT=") || (l == "AT+CIPMUX=1") ||
+          (l == "AT+CIPQSEND=1") || (l == "AT+CIPRXGET=1") || prefixe(l, "AT+CSTT=") || prefixe(l, "AT+CDNSCFG=") ||
+          (l == "AT+CMGF=1") || prefixe(l, "AT+CSCS=")) {
+        ok();
+      } else if (l == "ATI") {
+        repondre("\r\n" + modele + "\r\n\r\nOK\r\n");
+      } else if (l == "AT+ICCID") {
+        repondre("\r\n+ICCID: 8933150000000000001\r\n\r\nOK\r\n");
+      } else if (l == "AT+GSN") {
+        repondre("\r\n" + imei + "\r\n\r\nOK\r\n");
+      } else if (l == "AT+CPIN?") {
+        repondre("\r\n+CPIN: READY\r\n\r\nOK\r\n");
+      } else if (l == "AT+CBC") {
+        repondre("\r\n+CBC: 0,85,4100\r\n\r\nOK\r\n");
+      } else if (l == "AT+CSQ") {
+        repondre("\r\n+CSQ: " + std::to_string(csq) + ",0\r\n\r\nOK\r\n");
+      } else if (l == "AT+CREG?") {
+        repondre(csq < 99 ? "\r\n+CREG: 0,1\r\n\r\nOK\r\n" : "\r\n+CREG: 0,2\r\n\r\nOK\r\n");
+      } else if (l == "AT+COPS?") {
+        repondre("\r\n+COPS: 0,0,\"Orange F\"\r\n\r\nOK\r\n");
+      } else if (l == "AT+CIICR") {
+        if (csq == 99) {
+          erreur();
+          return;
+        }
+        gprs = true;
+        activite = hote::us;
+        repondre("\r\nOK\r\n", attachement);
+      } else if (l == "AT+CGATT=1") {
+        if (csq == 99) {
+          erreur();
+          return;
+        }
+        ok();
+      } else if (l == "AT+CGATT=0") {
+        gprs = false;
+        ok();
+      } else if (l == "AT+CGATT?") {
+        repondre(std::string("\r\n+CGATT: ") + (gprs ? "1" : "0") + "\r\n\r\nOK\r\n");
+      } else if (l == "AT+CIFSR;E0") {
+        if (gprs) {
+          repondre("\r\n10.64.0.2\r\n\r\nOK\r\n");
+        } else {
+          erreur();
+        }
+      } else if (l == "AT+CIPSHUT") {
+        gprs = false;
+        for (int& o : fOuvertes) o = -1;
+        repondre("\r\nSHUT OK\r\n");
+      } else if (l == "AT+CPOWD=1") {
+        repondre("\r\nNORMAL POWER DOWN\r\n");
+        allume = false;
+        gprs = false;
+        for (int& o : fOuvertes) o = -1;
+      } else if (prefixe(l, "AT+CIPSTART=")) {
+        cipstart(l);
+      } else if (prefixe(l, "AT+CIPSEND=")) {
+        int mux = -1;
+        unsigned n = 0;
+        if ((sscanf(l.c_str() + 11, "%d,%u", &mux, &n) != 2) || !ouverte(mux) || !n) {
+          erreur();
+          return;
+        }
+        fEnvoi = mux;
+        fReste = n;
+        fDonnees.clear();
+        repondre("\r\n> ");
+      } else if (prefixe(l, "AT+CIPRXGET=4,")) {
+        const int mux = atoi(l.c_str() + 14);
+        repondre("\r\n+CIPRXGET: 4," + std::to_string(mux) + "," + std::to_string(ouverte(mux) ? aLire(mux).size() : 0) + "\r\n\r\nOK\r\n");
+      } else if (prefixe(l, "AT+CIPRXGET=2,")) {
+        int mux = -1;
+        unsigned n = 0;
+        if ((sscanf(l.c_str() + 14, "%d,%u", &mux, &n) != 2) || !ouverte(mux)) {
+          erreur();
+          return;
+        }
+        std::string& reste = aLire(mux);
+        const std::string donnees = reste.substr(0, n);
+        reste.erase(0, donnees.size());
+        ouverte(mux)->recus += donnees;
+        repondre("\r\n+CIPRXGET: 2," + std::to_string(mux) + "," + std::to_string(donnees.size()) + "," + std::to_string(reste.size()) +
+                 "\r\n" + donnees + "\r\nOK\r\n");
+      } else if (prefixe(l, "AT+CIPSTATUS=")) {
+        const int mux = atoi(l.c_str() + 13);
+        const connexion_t* c = ouverte(mux);
+        const bool connectee = c && (!fFermee[mux] || aLire(mux).size());
+        repondre("\r\n+CIPSTATUS: " + std::to_string(mux) + ",0," + (c && c->udp ? "\"UDP\"" : "\"TCP\"") + ",\"" + (c ? c->hote : "") +
+                 "\",\"" + (c ? std::to_string(c->port) : "") + "\"," + (connectee ? "\"CONNECTED\"" : "\"CLOSED\"") + "\r\n\r\nOK\r\n");
+      } else if (prefixe(l, "AT+CIPCLOSE=")) {
+        const int mux = atoi(l.c_str() + 12);
+        if (!ouverte(mux)) {
+          erreur();
+          return;
+        }
+        fOuvertes[mux] = -1;
+        repondre("\r\n" + std::to_string(mux) + ", CLOSE OK\r\n");
+      } else if (prefixe(l, "AT+CMGS=\"")) {
+        fNumeroSms = l.substr(9, l.size() - 10);
+        fTexteSms.clear();
+        fSmsEnCours = true;
+        repondre("\r\n> ");
+      } else if (l == "AT+CMGL=\"REC UNREAD\"") {
+        std::string r;
+        for (size_t i = 0; i < fSms.size(); ++i) {
+          sms_t& s = fSms[i];
+          if (s.lu || s.efface || (s.us > hote::us)) continue;
+          s.lu = true;
+          r += "\r\n+CMGL: " + std::to_string(i + 1) + ",\"REC UNREAD\",\"" + s.expediteur + "\",\"\",\"18/10/01,10:00:00+08\"\r\n" + s.texte + "\r\n";
+        }
+        repondre(r + "\r\nOK\r\n");
+      } else if (l == "AT+CMGD=1,1") {
+        for (sms_t& s : fSms) {
+          if (s.lu) s.efface = true;
+        }
+        ok();
+      } else if (prefixe(l, "AT+CPSMS=")) {
+        cpsms(l);
+      } else if (prefixe(l, "AT+CEDRXS=")) {
+        const size_t q = l.find('"');
+        edrx = (q == std::string::npos) ? std::string() : l.substr(q + 1, l.find('"', q + 1) - q - 1);
+        ok();
+      } else {
+        erreur();
+      }
+    }
+
+    void cipstart(const std::string& l) {
+      int mux = -1;
+      char protocole[8] = "";
+      char hote[64] = "";
+      unsigned port = 0;
+      if ((sscanf(l.c_str() + 12, "%d,\"%7[^\"]\",\"%63[^\"]\",%u", &mux, protocole, hote, &port) != 4) || (mux < 0) || (mux >= 5) || !gprs) {
+        erreur();
+        return;
+      }
+      if (ouverte(mux)) {
+        repondre("\r\nOK\r\n\r\n" + std::to_string(mux) + ", ALREADY CONNECT\r\n");
+        return;
+      }
+      connexions.push_back({ mux, !strcmp(protocole, "UDP"), hote, static_cast<uint16_t>(port), {}, "", "" });
+      fOuvertes[mux] = connexions.size() - 1;
+      fALire[mux].clear();
+      fFermee[mux] = false;
+      fRequete[mux].clear();
+      activite = hote::us;
+      repondre("\r\nOK\r\n\r\n" + std::to_string(mux) + ", CONNECT OK\r\n", latence);
+    }
+
+    /**
+       Fin d'un AT+CIPSEND : les octets sont remis au serveur, dont la réponse est annoncée par +CIPRXGET: 1.
+    */
+    void envoyer() {
+      const int mux = fEnvoi;
+      fEnvoi = -1;
+      connexion_t& c = *ouverte(mux);
+      c.segments.push_back(fDonnees.size());
+      c.emis += fDonnees;
+      activite = hote::us;
+      repondre("\r\nDATA ACCEPT:" + std::to_string(mux) + "," + std::to_string(fDonnees.size()) + "\r\n");
+      if (c.udp) fRequete[mux].clear();    // UDP : chaque AT+CIPSEND est un datagramme, remis seul au serveur
+      fRequete[mux] += fDonnees;
+      if (!serveur) return;
+      const std::string reponse = serveur(c, fRequete[mux]);
+      if (reponse.empty()) return;
+      fRequete[mux].clear();
+      fALire[mux] += reponse;
+      fFermee[mux] = !c.udp;    // http/1.0 : le serveur ferme après sa réponse
+      activite = hote::us + 1000ULL * latence;
+      repondre("\r\n+CIPRXGET: 1," + std::to_string(mux) + "\r\n", latence);
+    }
+
+    /**
+       AT+CPSMS=1,,,"<T3412>","<T3324>" : minuteries codées selon 3GPP TS 24.008.
+    */
+    void cpsms(const std::string& l) {
+      const size_t q1 = l.find('"');
+      const size_t q3 = l.find('"', l.find('"', q1 + 1) + 1);
+      if (prefixe(l, "AT+CPSMS=0")) {
+        psm = false;
+        ok();
+        return;
+      }
+      if ((q1 == std::string::npos) || (q3 == std::string::npos)) {
+        erreur();
+        return;
+      }
+      const unsigned tau = strtoul(l.substr(q1 + 1, 8).c_str(), NULL, 2);
+      const unsigned actif = strtoul(l.substr(q3 + 1, 8).c_str(), NULL, 2);
+      static const uint32_t unites3412[] = { 600, 3600, 36000, 2, 30, 60, 1152000, 0 };
+      static const uint32_t unites3324[] = { 2, 60, 360, 0, 0, 0, 0, 0 };
+      t3412 = unites3412[tau >> 5] * (tau & 31);
+      t3324 = unites3324[actif >> 5] * (actif & 31);
+      psm = true;
+      activite = hote::us;
+      ok();
+    }
+
+  private:
+    std::deque<std::pair<uint64_t, char> > fSortie;
+    std::string fLigne;
+    int fOuvertes[5];           ///< Indice dans connexions de la connexion ouverte de chaque mux, -1 sinon.
+    std::string fALire[5];
+    std::string fRequete[5];    ///< Octets reçus depuis la dernière réponse du serveur.
+    bool fFermee[5];            ///< Le serveur a fermé la connexion après sa réponse.
+    int fEnvoi;                 ///< Mux de l'AT+CIPSEND en cours, -1 sinon.
+    size_t fReste;
+    std::string fDonnees;
+    bool fSmsEnCours;
+    std::string fNumeroSms;
+    std::string fTexteSms;
+    std::vector<sms_t> fSms;
+    bool fBasPwrOn;
+    bool fBasReset;
+    uint64_t fDebutSommeil;
+};
+
+/**
+   Serveur de l'API derrière l'émulateur, comme tools/serveur.py : paramètres par GET, ETag de la configuration
+   et paramètres joints à la réponse d'un PUT tant qu'ils n'ont pas été remis. Chaque requête est conservée.
+*/
+class ServeurApi {
+
+  public:
+    struct requete_t {
+      uint64_t us;
+      std::string methode;
+      std::string chemin;
+      std::string entetes;
+      std::string corps;
+    };
+
+    ServeurApi() :
+      parametres("{}"),
+      etag("\"0000000000000001\""),
+      statut(200),
+      remis(false)
+    {}
+
+    /**
+       Branche le serveur sur un émulateur.
+    */
+    void brancher(Emulateur& modem) {
+      modem.serveur = [this](Emulateur::connexion_t& c, const std::string& r) {
+        return repondre(c, r);
+      };
+    }
+
+    /**
+       Change la configuration : elle sera remise à la prochaine réponse.
+    */
+    void configurer(const std::string& aParametres, const std::string& aEtag) {
+      parametres = aParametres;
+      etag = aEtag;
+      remis = false;
+    }
+
+    /**
+       @return L'en-tête Date à l'heure virtuelle.
+    */
+    static std::string date() {
+      const time_t t = EMULATEUR_EPOCH + hote::us / 1000000ULL;
+      struct tm tm;
+      gmtime_r(&t, &tm);
+      char s[40];
+      strftime(s, sizeof(s), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+      return s;
+    }
+
+    /**
+       @return Le nombre de requêtes dont la méthode et le chemin contiennent le texte.
+    */
+    unsigned compter(const std::string& methode, const std::string& fin) const {
+      unsigned n = 0;
+      for (const requete_t& r : requetes) {
+        if ((r.methode == methode) && (r.chemin.size() >= fin.size()) && !r.chemin.compare(r.chemin.size() - fin.size(), fin.size(), fin)) ++n;
+      }
+      return n;
+    }
+
+    std::string parametres;   ///< Corps JSON des paramètres.
+    std::string etag;         ///< Version de la configuration, entre guillemets.
+    int statut;               ///< Statut des réponses aux PUT.
+    bool remis;               ///< Les paramètres ont été remis au boîtier.
+    std::vector<requete_t> requetes;
+
+  protected:
+    std::string repondre(Emulateur::connexion_t& c, const std::string& r) {
+      if (c.udp) return std::string();
+      const size_t fin = r.find("\r\n\r\n");
+      if (fin == std::string::npos) return std::string();
+      size_t longueur = 0;
+      const size_t cl = r.find("Content-Length: ");
+      if ((cl != std::string::npos) && (cl < fin)) longueur = strtoul(r.c_str() + cl + 16, NULL, 10);
+      if (r.size() < fin + 4 + longueur) return std::string();
+
+      const size_t sp1 = r.find(' ');
+      const size_t sp2 = r.find(' ', sp1 + 1);
+      const requete_t q = { hote::us, r.substr(0, sp1), r.substr(sp1 + 1, sp2 - sp1 - 1), r.substr(0, fin + 4), r.substr(fin + 4, longueur) };
+      requetes.push_back(q);
+
+      if (q.methode == "GET") {
+        remis = true;
+        return reponse(200, parametres);
+      }
+      if (statut / 100 != 2) return reponse(statut, std::string());
+      const bool joindre = !remis;
+      remis = true;
+      return reponse(statut, joindre ? parametres : std::string());
+    }
+
+    std::string reponse(const int aStatut, const std::string& corps) const {
+      std::string s = "HTTP/1.0 " + std::to_string(aStatut) + (aStatut / 100 == 2 ? " OK" : " Error") + "\r\n";
+      s += "Date: " + date() + "\r\n";
+      s += "ETag: " + etag + "\r\n";
+      if (!corps.empty()) s += "Content-Type: application/json\r\n";
+      s += "Content-Length: " + std::to_string(corps.size()) + "\r\n\r\n";
+      return s + corps;
+    }
+};
@@ -0,0 +1,112 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   endurance.cpp
+   Purpose: Heap endurance test : 4320 cycles of App::loop() against the AT emulator, without drift of the heap.
+
+   Le boîtier tourne 3 jours en temps virtuel, une alarme par minute, avec une marée quotidienne qui franchit le seuil
+   d'alerte de niveau. Après chaque cycle, les octets vivants du tas (hote::tas.vivants) et Memoire::tas() sont relevés ;
+   l'émulateur et le serveur oublient leurs relevés pour ne pas compter dans le tas. Le premier jour sert à la mise en
+   régime (arriéré, historiques horaires, diagnostic) ; le maximum du troisième jour ne doit pas dépasser celui du deuxième.
+   Le reset quotidien n'est pas programmé : l'essai montre que le tas ne dérive pas sans lui.
+   Memoire::tas() n'est vérifié que sans le tcache de la glibc (GLIBC_TUNABLES=glibc.malloc.tcache_count=0, comme sous ctest).
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#include "banc.h"
+#include "emulateur.h"
+#include "App.h"
+
+#include <cmath>
+
+/// Nombre de cycles d'une minute : 3 jours.
+#define ENDURANCE_CYCLES 4320
+
+namespace {
+  int echecs = 0;
+
+  void verifier(const bool condition, const char* message) {
+    printf("%s %s\n", condition ? "ok  " : "ECHEC", message);
+    if (!condition) ++echecs;
+  }
+
+  /**
+     Maximum des relevés d'une journée.
+  */
+  struct jour_t {
+    int64_t vivants;
+    uint32_t tas;
+    unsigned alertes;
+  };
+}
+
+int main() {
+  hote::journal = getenv("JOURNAL");
+
+  Emulateur modem;
+  Serial1.brancher(&modem);
+  ServeurApi serveur;
+  serveur.brancher(modem);
+  serveur.configurer("{\"limit1R\":100,\"hyst1R\":5,\"limit2O\":0,\"hyst2O\":0}", "\"5f1c0e7a9b3d2c41\"");
+
+  App& app = App::getInstance(F(APN_NAME), F(APN_USERNAME), F(APN_PASSWORD));
+  try {
+    if (!app.setup()) {
+      printf("App::setup() en echec.\n");
+      return 1;
+    }
+    jour_t jours[ENDURANCE_CYCLES / 1440] = {};
+    for (unsigned cycle = 0; cycle < ENDURANCE_CYCLES; ++cycle) {
+      // Marée : distance de 700 à 1500 mm sur 24 h, sous le seuil de 100 cm une partie de la journée
+      hote::capteurs.distance = 1100 + lround(400 * cos(2 * M_PI * cycle / 1440.0));
+      hote::attendreAlarme();
+      if (!app.loop()) {
+        printf("App::loop() en echec au cycle %u.\n", cycle);
+        return 1;
+      }
+      jour_t& j = jours[cycle / 1440];
+      for (const ServeurApi::requete_t& r : serveur.requetes) {
+        if (r.corps.find("\"alert") != std::string::npos) ++j.alertes;
+      }
+      modem.oublier();
+      serveur.requetes.clear();
+      j.vivants = std::max(j.vivants, hote::tas.vivants);
+      j.tas = std::max(j.tas, Memoire::tas());
+    }
+
+    for (unsigned i = 0; i < ENDURANCE_CYCLES / 1440; ++i) {
+      printf("     jour %u : %lld octets vivants, Memoire::tas() %u octets, %u alertes\n",
+             i + 1, static_cast<long long>(jours[i].vivants), jours[i].tas, jours[i].alertes);
+    }
+    verifier(jours[1].alertes > 0, "alertes transmises chaque jour");
+    verifier(jours[2].vivants <= jours[1].vivants, "pas de croissance des octets vivants apres la mise en regime");
+    // Les blocs du cache par fil de la glibc (tcache) sont comptés en usage par mallinfo() : sans lui, Memoire::tas()
+    // suit les blocs vivants comme la newlib-nano de la carte ; ctest lance l'essai ainsi.
+    const char* const reglages = getenv("GLIBC_TUNABLES");
+    if (reglages && strstr(reglages, "glibc.malloc.tcache_count=0")) {
+      verifier(jours[2].tas <= jours[1].tas, "pas de croissance de Memoire::tas() apres la mise en regime");
+    } else {
+      printf("     Memoire::tas() non verifie : lancer avec GLIBC_TUNABLES=glibc.malloc.tcache_count=0.\n");
+    }
+  } catch (const hote::Reset&) {
+    printf("Reset inattendu.\n");
+    return 1;
+  }
+  return echecs ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   liaison.cpp
+   Purpose: Replay of a CSQ trace through Liaison : attach time saved by deferring uploads, with and without the flash history.
+
+   La trace bench/donnees/liaison.txt (synthétique) donne, à chaque transmission, le CSQ lu et la durée d'attachement
+   GPRS qu'elle demanderait. Chaque transmission suit App::loop() : noter(), differer(), puis, si elle a lieu avec
+   l'arriéré, noterAttache() et transmis() ; sa durée d'attachement est comptée. Le reset quotidien de 03:15 remplace
+   le modèle, sans ou avec son historique enregistré en flash (enregistrer() avant le reset, charger() au démarrage).
+   Compare le temps d'attachement à celui de la transmission systématique, et échoue si l'historique en flash
+   n'économise pas davantage, ou s'il est écrit plus d'une fois par jour.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#include "banc.h"
+#include "App.h"
+
+#include <sstream>
+
+/// Minute du reset quotidien.
+#define SIMULATION_RESET (3 * 60 + 15)
+
+namespace {
+  int echecs = 0;
+
+  void verifier(const bool condition, const char* message) {
+    printf("%s %s\n", condition ? "ok  " : "ECHEC", message);
+    if (!condition) ++echecs;
+  }
+
+  struct transmission_t {
+    uint32_t epoch;
+    int csq;
+    unsigned long attache;
+  };
+
+  struct bilan_t {
+    unsigned transmissions;
+    unsigned reports;
+    uint32_t retardMax;       ///< Plus long report, en s.
+    double attache;           ///< Durée totale d'attachement, en s.
+    unsigned ecritures;       ///< Écritures en flash.
+  };
+
+  /**
+     Rejoue la trace ; sans differe, chaque transmission a lieu.
+  */
+  bilan_t simuler(const std::vector<transmission_t>& trace, const bool differe, const bool flash) {
+    bilan_t b = {};
+    const unsigned ecritures = hote::ecrituresFlash;
+    Liaison liaison;
+    uint32_t premierReport = 0;
+    uint32_t jour = trace.front().epoch / 86400;
+    for (const transmission_t& t : trace) {
+      const unsigned minute = (t.epoch % 86400) / 60;
+      if ((t.epoch / 86400 != jour) && (minute >= SIMULATION_RESET)) {   // reset quotidien
+        jour = t.epoch / 86400;
+        if (flash) liaison.enregistrer();
+        liaison = Liaison();
+        if (flash) liaison.charger();
+      }
+      const byte heure = minute / 60;
+      liaison.noter(heure, t.csq);
+      if (differe && liaison.differer(t.epoch, heure, t.csq)) {
+        ++b.reports;
+        if (!premierReport) premierReport = t.epoch;
+        continue;
+      }
+      ++b.transmissions;
+      b.attache += t.attache / 1000.0;
+      liaison.noterAttache(heure, t.attache);
+      liaison.transmis();
+      if (premierReport) b.retardMax = std::max(b.retardMax, t.epoch - premierReport);
+      premierReport = 0;
+    }
+    b.ecritures = hote::ecrituresFlash - ecritures;
+    return b;
+  }
+
+  void afficher(const char* nom, const bilan_t& b, const bilan_t& reference) {
+    printf("%-20s %13u %8u %9u %13.0f %10.1f %9u\n", nom, b.transmissions, b.reports, b.retardMax / 60, b.attache,
+           100.0 * (reference.attache - b.attache) / reference.attache, b.ecritures);
+  }
+}
+
+int main() {
+  hote::journal = getenv("JOURNAL");
+
+  std::vector<transmission_t> trace;
+  for (const std::string& l : banc::lignes("liaison.txt")) {
+    std::istringstream s(l);
+    transmission_t t;
+    if (s >> t.epoch >> t.csq >> t.attache) trace.push_back(t);
+  }
+  if (trace.empty()) {
+    printf("Trace vide.\n");
+    return 1;
+  }
+  const unsigned jours = (trace.back().epoch - trace.front().epoch) / 86400 + 1;
+  printf("     %zu transmissions sur %u jours (donnees synthetiques)\n", trace.size(), jours);
+
+  const bilan_t toujours = simuler(trace, false, false);
+  const bilan_t sansFlash = simuler(trace, true, false);
+  const bilan_t avecFlash = simuler(trace, true, true);
+  printf("%-20s %13s %8s %9s %13s %10s %9s\n", "", "transmissions", "reports", "retard", "attachement", "economie", "ecritures");
+  printf("%-20s %13s %8s %9s %13s %10s %9s\n", "", "", "", "max (min)", "(s)", "(%)", "flash");
+  afficher("sans report", toujours, toujours);
+  afficher("historique en RAM", sansFlash, toujours);
+  afficher("historique en flash", avecFlash, toujours);
+
+  verifier(avecFlash.attache < toujours.attache, "le report economise du temps d'attachement");
+  verifier(avecFlash.attache < sansFlash.attache, "l'historique en flash economise davantage que celui en RAM");
+  verifier(avecFlash.retardMax <= LIAISON_TOLERANCE, "aucun report au-dela de LIAISON_TOLERANCE");
+  verifier(avecFlash.ecritures <= jours, "au plus une ecriture en flash par jour");
+  return echecs ? 1 : 0;
+}
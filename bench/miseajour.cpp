@@ -0,0 +1,190 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   miseajour.cpp
+   Purpose: Round trip of a firmware delta : built by tools/delta.py, applied by MiseAJour to an image in a host flash.
+
+   Usage : miseajour <répertoire> <python3> <tools/delta.py>
+   Compilé avec MISE_A_JOUR, l'image en cours étant lue dans flashHote, une flash du poste de MISE_A_JOUR_FLASH octets
+   effacée (0xFF). Deux images synthétiques sont écrites dans <répertoire>, la carte SD simulée : l'ancienne, des mots
+   de 16 bits tirés d'un petit jeu et des adresses de 32 bits, et la nouvelle, où du code est inséré, supprimé et ajouté
+   à la fin, et où les adresses qui suivent l'insertion sont décalées, comme après une recompilation.
+   tools/delta.py en fait le delta et affiche l'annonce, qui est passée à MiseAJour::annoncer() ; le delta est
+   écrit par MiseAJour::delta() comme s'il avait été téléchargé, puis MiseAJour::reconstruire() doit donner NOUVEAU.BIN
+   identique à la nouvelle image. Le même delta, un octet modifié, doit être refusé, puis son annonce.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#include "banc.h"
+
+/// Flash du poste lue par MiseAJour (MISE_A_JOUR_EN_COURS), définie après miseajour.h qui en donne la taille.
+extern uint8_t flashHote[];
+
+#include "App.h"
+
+uint8_t flashHote[MISE_A_JOUR_FLASH];
+
+namespace {
+  int echecs = 0;
+
+  void verifier(const bool condition, const char* message) {
+    printf("%s %s\n", condition ? "ok  " : "ECHEC", message);
+    if (!condition) ++echecs;
+  }
+
+  /// Générateur congruentiel : mêmes images à chaque essai.
+  uint32_t graine = 12345;
+
+  uint32_t aleatoire() {
+    graine = graine * 1103515245UL + 12345;
+    return graine >> 8;
+  }
+
+  void ajouterMot(std::string& image, const uint32_t mot, const byte n) {
+    for (byte i = 0; i < n; ++i) image += static_cast<char>(mot >> (8 * i));
+  }
+
+  /// Adresses de l'image : 0x2000 + position.
+  bool adresse(const uint32_t mot, const uint32_t taille) {
+    return (mot >= MISE_A_JOUR_ORIGINE) && (mot < MISE_A_JOUR_ORIGINE + taille);
+  }
+
+  std::string ancienneImage(const uint32_t taille) {
+    uint16_t jeu[300];
+    for (uint16_t& m : jeu) m = aleatoire();
+    std::string image;
+    while (image.size() < taille) {
+      if (aleatoire() % 10 == 0) {
+        ajouterMot(image, MISE_A_JOUR_ORIGINE + aleatoire() % taille, 4);
+      } else {
+        ajouterMot(image, jeu[aleatoire() % 300], 2);
+      }
+    }
+    return image;
+  }
+
+  /**
+     Nouvelle version : 300 octets insérés à 40000, 100 supprimés à 90000, 1000 ajoutés à la fin,
+     adresses au-delà de l'insertion décalées de 300.
+  */
+  std::string nouvelleImage(const std::string& a) {
+    std::string insere, ajoute;
+    for (int i = 0; i < 300; ++i) insere += static_cast<char>(aleatoire());
+    for (int i = 0; i < 1000; ++i) ajoute += static_cast<char>(aleatoire());
+    std::string b = a.substr(0, 40000) + insere + a.substr(40000, 50000) + a.substr(90100) + ajoute;
+    for (size_t i = 0; i + 4 <= b.size(); i += 4) {
+      const uint8_t* const o = reinterpret_cast<const uint8_t*>(b.data() + i);
+      const uint32_t mot = o[0] | (uint32_t(o[1]) << 8) | (uint32_t(o[2]) << 16) | (uint32_t(o[3]) << 24);
+      if (adresse(mot, a.size()) && (mot >= MISE_A_JOUR_ORIGINE + 40000)) {
+        std::string d;
+        ajouterMot(d, mot + 300, 4);
+        b.replace(i, 4, d);
+      }
+    }
+    return b;
+  }
+
+  bool ecrire(const std::string& nom, const std::string& contenu) {
+    std::ofstream f(nom, std::ios::binary);
+    f.write(contenu.data(), contenu.size());
+    return f.good();
+  }
+
+  std::string lire(const std::string& nom) {
+    std::ifstream f(nom, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+  }
+
+  /**
+     Télécharge le delta comme App : ajouté à DELTA.BIN par plages de MISE_A_JOUR_BLOC octets.
+  */
+  void telecharger(const std::string& delta) {
+    while (true) {
+      File f = MiseAJour::delta();
+      const uint32_t n = std::min(MiseAJour::restant(), static_cast<uint32_t>(MISE_A_JOUR_BLOC));
+      if (!f || !n) {
+        f.close();
+        return;
+      }
+      f.write(reinterpret_cast<const uint8_t*>(delta.data()) + MiseAJour::position(), n);
+      f.close();
+    }
+  }
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 4) {
+    fprintf(stderr, "Usage : miseajour <repertoire> <python3> <tools/delta.py>\n");
+    return 2;
+  }
+  const std::string repertoire = argv[1];
+  hote::journal = getenv("JOURNAL");
+  hote::carteSD(repertoire);
+
+  const std::string a = ancienneImage(120000);
+  const std::string b = nouvelleImage(a);
+  const std::string ancienne = repertoire + "/ancienne.bin";
+  const std::string nouvelle = repertoire + "/nouvelle.bin";
+  const std::string delta = repertoire + "/1-2.hs";
+  if (!ecrire(ancienne, a) || !ecrire(nouvelle, b)) {
+    printf("Images non ecrites dans %s.\n", repertoire.c_str());
+    return 1;
+  }
+  memset(flashHote, 0xff, sizeof(flashHote));
+  memcpy(flashHote, a.data(), a.size());
+
+  const std::string commande = std::string(argv[2]) + " " + argv[3] + " " + ancienne + " " + nouvelle + " " + delta + " --version 2";
+  FILE* const p = popen(commande.c_str(), "r");
+  char ligne[512] = "";
+  if (!p || !fgets(ligne, sizeof(ligne), p)) ligne[0] = '\0';
+  if (p) pclose(p);
+  DynamicJsonBuffer jsonBuffer;
+  const JsonObject& annonce = jsonBuffer.parseObject(ligne);
+  if (!annonce.success()) {
+    printf("Annonce illisible : %s\n", ligne);
+    return 1;
+  }
+  const std::string d = lire(delta);
+  printf("     image %zu -> %zu octets, delta compresse %zu octets (%.1f %%)\n", a.size(), b.size(), d.size(), 100.0 * d.size() / b.size());
+
+  for (const char* nom : { MISE_A_JOUR_DELTA, MISE_A_JOUR_EMPREINTE, MISE_A_JOUR_REFUSEE, MISE_A_JOUR_IMAGE }) {
+    std::remove((repertoire + "/" + nom).c_str());
+  }
+  verifier(MiseAJour::begin(), "carte SD");
+  verifier(MiseAJour::annoncer(annonce["version"].as<unsigned long>(), annonce["fromSize"].as<uint32_t>(), annonce["fromSha256"].as<String>(),
+                               annonce["path"].as<String>(), annonce["size"].as<uint32_t>(), annonce["sha256"].as<String>()),
+           "annonce retenue pour l'image en cours");
+  telecharger(d);
+  verifier(!MiseAJour::restant() && (lire(repertoire + "/" MISE_A_JOUR_DELTA) == d), "delta telecharge");
+  verifier(MiseAJour::reconstruire(), "image reconstruite et verifiee");
+  verifier(lire(repertoire + "/" MISE_A_JOUR_IMAGE) == b, "NOUVEAU.BIN identique a la nouvelle image");
+
+  // Même annonce, DELTA.BIN remplacé par le delta dont un octet est modifié : l'image reconstruite est refusée
+  std::string corrompu = d;
+  corrompu[corrompu.size() / 2] ^= 0x10;
+  std::remove((repertoire + "/" MISE_A_JOUR_DELTA).c_str());
+  telecharger(corrompu);
+  verifier(!MiseAJour::reconstruire(), "delta corrompu refuse");
+  verifier(lire(repertoire + "/" MISE_A_JOUR_REFUSEE) == annonce["sha256"].as<String>().c_str(), "empreinte refusee conservee");
+  verifier(!MiseAJour::annoncer(annonce["version"].as<unsigned long>(), annonce["fromSize"].as<uint32_t>(), annonce["fromSha256"].as<String>(),
+                                annonce["path"].as<String>(), annonce["size"].as<uint32_t>(), annonce["sha256"].as<String>()),
+           "annonce refusee ensuite");
+
+  return echecs ? 1 : 0;
+}
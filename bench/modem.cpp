@@ -0,0 +1,134 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   modem.cpp
+   Purpose: Test of the SARA-R4 power saving against the AT emulator : PSM & eDRX timers, deep sleep, SMS burst.
+
+   Compilé avec MODEM_SARA_R4. Le boîtier tourne 7 h en temps virtuel ; l'émulateur s'endort T3324 après la
+   dernière activité radio et ne se réveille que par une impulsion sur PWR_ON. Vérifie :
+   - les minuteries demandées par AT+CPSMS et AT+CEDRXS ;
+   - la veille profonde entre les transmissions, et le réveil par PWR_ON avant chacune ;
+   - qu'aucune lecture des SMS (AT+CMGL) ni autre commande que les sondes AT n'est tentée pendant la veille profonde ;
+   - qu'une commande de rafale reçue par SMS pendant la veille est lue au temps actif suivant et appliquée.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#include "banc.h"
+#include "emulateur.h"
+#include "App.h"
+
+namespace {
+  int echecs = 0;
+
+  void verifier(const bool condition, const char* message) {
+    printf("%s %s\n", condition ? "ok  " : "ECHEC", message);
+    if (!condition) ++echecs;
+  }
+
+  /**
+     @return Le nombre de distances transmises entre deux instants, échantillons et lots de rafale.
+  */
+  unsigned distances(const ServeurApi& serveur, const uint64_t debut, const uint64_t fin) {
+    unsigned n = 0;
+    for (const ServeurApi::requete_t& r : serveur.requetes) {
+      if ((r.us < debut) || (r.us >= fin) || (r.methode != "PUT")) continue;
+      for (size_t p = r.corps.find("\"key\":\"range\",\"value\""); p != std::string::npos; p = r.corps.find("\"key\":\"range\",\"value\"", p + 1)) ++n;
+    }
+    return n;
+  }
+
+  /**
+     Fait tourner le boîtier pendant une durée, minute par minute.
+  */
+  void tourner(App& app, const uint64_t duree) {
+    const uint64_t fin = hote::us + duree;
+    while (hote::us < fin) {
+      hote::attendreAlarme();
+      if (!app.loop()) {
+        printf("App::loop() en echec.\n");
+        exit(1);
+      }
+    }
+  }
+}
+
+int main() {
+  hote::journal = getenv("JOURNAL");
+  const uint64_t heure = 3600ULL * 1000000ULL;
+  const std::string passerelle = "+33612345678";
+
+  Emulateur modem;
+  modem.modele = "u-blox SARA-R410M-02B";
+  Serial1.brancher(&modem);
+  ServeurApi serveur;
+  serveur.brancher(modem);
+  serveur.configurer("{\"limit1R\":0,\"hyst1R\":0,\"limit2O\":0,\"hyst2O\":0,\"sms\":\"" + passerelle + "\"}", "\"5f1c0e7a9b3d2c41\"");
+
+  App& app = App::getInstance(F(APN_NAME), F(APN_USERNAME), F(APN_PASSWORD));
+  if (!app.setup()) {
+    printf("App::setup() en echec.\n");
+    return 1;
+  }
+
+  // Transmissions toutes les 15 min : T3412 = 4 x 900 s = 1 h (6 x 10 min), T3324 = 60 s (30 x 2 s), eDRX 10,24 s
+  verifier(modem.compter("AT+CPSMS=1,,,\"00000110\",\"00011110\"", false) == 1, "AT+CPSMS : T3412 1 h, T3324 60 s");
+  verifier(modem.compter("AT+CEDRXS=1,4,\"0001\"", false) == 1, "AT+CEDRXS : LTE-M, cycle 10,24 s");
+  verifier(modem.psm && (modem.t3412 == 3600) && (modem.t3324 == 60), "minuteries acceptees par le modem");
+
+  // Régime établi : le modem dort entre les transmissions et PWR_ON le réveille avant chacune
+  const uint64_t debut = hote::us;
+  const unsigned reveils = modem.reveils;
+  const uint64_t sommeil = modem.tempsSommeil();
+  tourner(app, 4 * heure);
+  const double part = double(modem.tempsSommeil() - sommeil) / double(hote::us - debut);
+  printf("     veille profonde %.1f %% du temps, %u reveils par PWR_ON, %u distances transmises\n",
+         100 * part, modem.reveils - reveils, distances(serveur, debut, hote::us));
+  verifier(part > 0.8, "veille profonde plus de 80 % du temps");
+  verifier(modem.reveils - reveils >= 15, "reveil par PWR_ON avant chaque transmission");
+  verifier(distances(serveur, debut, hote::us) >= 15, "transmissions toutes les 15 min");
+
+  // Commande de rafale déposée pendant la veille profonde, et un SMS d'un inconnu
+  while (!modem.dort()) tourner(app, 60ULL * 1000000ULL);
+  const uint64_t depot = hote::us;
+  modem.deposerSms("+33700000000", "{\"burst\":{\"mesures\":60,\"transmission\":300,\"duree\":180}}");
+  modem.deposerSms(passerelle, "{\"burst\":{\"mesures\":60,\"transmission\":300,\"duree\":120}}");
+  const unsigned lectures = modem.compter("AT+CMGL", false);
+  tourner(app, 20ULL * 60 * 1000000ULL);
+  verifier(modem.compter("AT+CMGL", false) > lectures, "SMS lus au temps actif suivant");
+  const uint64_t rafale = hote::us;
+  tourner(app, heure);
+  const unsigned enRafale = distances(serveur, rafale, hote::us);
+  printf("     %u distances transmises dans l'heure de rafale\n", enRafale);
+  verifier(enRafale >= 40, "rafale appliquee : une distance par minute");
+  tourner(app, 2 * heure);
+  const unsigned apres = distances(serveur, hote::us - heure, hote::us);
+  verifier(apres <= 5, "fin de la rafale apres 2 h, pas de rafale de 3 h de l'inconnu");
+
+  // Seules les sondes AT du réveil visent un modem en veille profonde : ni lecture des SMS, ni AT+CSQ
+  unsigned perdues = 0;
+  for (const Emulateur::commande_t& c : modem.commandes) {
+    if (c.perdue && (c.texte != "AT")) ++perdues;
+  }
+  printf("     %u commandes perdues en veille profonde, dont %u autres que les sondes AT ; depot a %.0f s\n",
+         modem.compter("AT", true), perdues, depot / 1e6);
+  verifier(modem.compter("AT+CMGL", true) == 0, "pas de lecture des SMS pendant la veille profonde");
+  verifier(perdues == 0, "le modem est reveille avant toute autre commande");
+
+  return echecs ? 1 : 0;
+}
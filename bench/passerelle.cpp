@@ -0,0 +1,163 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   passerelle.cpp
+   Purpose: Sockets and process of the bridge to tools/serveur.py.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#include "passerelle.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+  sockaddr_in local(const uint16_t port) {
+    sockaddr_in a = {};
+    a.sin_family = AF_INET;
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    a.sin_port = htons(port);
+    return a;
+  }
+
+  /**
+     @return Un port du poste libre pour ce type de socket, 0 si aucun.
+  */
+  uint16_t portLibre(const int type) {
+    const int s = socket(AF_INET, type, 0);
+    sockaddr_in a = local(0);
+    socklen_t l = sizeof(a);
+    const bool ok = (s >= 0) && !bind(s, reinterpret_cast<sockaddr*>(&a), sizeof(a)) &&
+                    !getsockname(s, reinterpret_cast<sockaddr*>(&a), &l);
+    if (s >= 0) close(s);
+    return ok ? ntohs(a.sin_port) : 0;
+  }
+
+  /// Délai de réception, en temps réel, des réponses du serveur.
+  void delai(const int s, const int secondes) {
+    const timeval t = { secondes, 0 };
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &t, sizeof(t));
+  }
+
+  /**
+     @return La longueur d'un message http complet (en-têtes et Content-Length octets de corps), 0 s'il est incomplet.
+  */
+  size_t complet(const std::string& m) {
+    const size_t fin = m.find("\r\n\r\n");
+    if (fin == std::string::npos) return 0;
+    size_t longueur = 0;
+    const size_t cl = m.find("Content-Length: ");
+    if ((cl != std::string::npos) && (cl < fin)) longueur = strtoul(m.c_str() + cl + 16, NULL, 10);
+    return (m.size() >= fin + 4 + longueur) ? fin + 4 + longueur : 0;
+  }
+}
+
+Passerelle::Passerelle() :
+  fPid(-1),
+  fPortHttp(0),
+  fPortCoap(0),
+  fUdp(-1)
+{}
+
+Passerelle::~Passerelle() {
+  if (fUdp >= 0) close(fUdp);
+  if (fPid > 0) {
+    kill(fPid, SIGTERM);
+    waitpid(fPid, NULL, 0);
+  }
+}
+
+bool Passerelle::demarrer(const std::string& python, const std::string& script, const std::vector<std::string>& options) {
+  fPortHttp = portLibre(SOCK_STREAM);
+  fPortCoap = portLibre(SOCK_DGRAM);
+  if (!fPortHttp || !fPortCoap) return false;
+
+  std::vector<std::string> arguments = { python, script, "--port", std::to_string(fPortHttp), "--coap-port", std::to_string(fPortCoap) };
+  arguments.insert(arguments.end(), options.begin(), options.end());
+  fPid = fork();
+  if (fPid < 0) return false;
+  if (fPid == 0) {
+    std::vector<char*> argv;
+    for (std::string& a : arguments) argv.push_back(&a[0]);
+    argv.push_back(NULL);
+    execv(argv[0], argv.data());
+    _exit(127);
+  }
+
+  // Le serveur est prêt quand son port http accepte une connexion : 10 s au plus
+  for (int i = 0; i < 100; ++i) {
+    const int s = socket(AF_INET, SOCK_STREAM, 0);
+    const sockaddr_in a = local(fPortHttp);
+    const bool ok = !connect(s, reinterpret_cast<const sockaddr*>(&a), sizeof(a));
+    close(s);
+    if (ok) {
+      fUdp = socket(AF_INET, SOCK_DGRAM, 0);
+      const sockaddr_in c = local(fPortCoap);
+      delai(fUdp, 2);
+      return (fUdp >= 0) && !connect(fUdp, reinterpret_cast<const sockaddr*>(&c), sizeof(c));
+    }
+    if (waitpid(fPid, NULL, WNOHANG) == fPid) {
+      fPid = -1;
+      return false;
+    }
+    usleep(100000);
+  }
+  return false;
+}
+
+std::string Passerelle::transmettre(const bool udp, const std::string& requete, const std::string& date) {
+  if (udp) {
+    echange_t e = { requete, "" };
+    if ((send(fUdp, requete.data(), requete.size(), 0) == static_cast<ssize_t>(requete.size())) &&
+        (requete.size() >= 4) && !((static_cast<uint8_t>(requete[0]) >> 4) & 0x03)) {    // CON : réponse attendue
+      char buf[2048];
+      const ssize_t n = recv(fUdp, buf, sizeof(buf), 0);
+      if (n > 0) e.reponse.assign(buf, n);
+    }
+    datagrammes.push_back(e);
+    return e.reponse;
+  }
+
+  if (!complet(requete)) return std::string();
+  requetes.push_back(requete.substr(0, requete.find(" HTTP/")));
+  const int s = socket(AF_INET, SOCK_STREAM, 0);
+  const sockaddr_in a = local(fPortHttp);
+  std::string reponse;
+  if ((s >= 0) && !connect(s, reinterpret_cast<const sockaddr*>(&a), sizeof(a)) &&
+      (send(s, requete.data(), requete.size(), 0) == static_cast<ssize_t>(requete.size()))) {
+    delai(s, 2);
+    char buf[2048];
+    ssize_t n;
+    while (!complet(reponse) && ((n = recv(s, buf, sizeof(buf), 0)) > 0)) reponse.append(buf, n);
+  }
+  if (s >= 0) close(s);
+
+  const size_t d = reponse.find("\r\nDate: ");
+  if ((d != std::string::npos) && (d < reponse.find("\r\n\r\n"))) {
+    const size_t fin = reponse.find("\r\n", d + 2);
+    reponse.replace(d + 8, fin - d - 8, date);
+  }
+  return reponse;
+}
@@ -0,0 +1,77 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   passerelle.h
+   Purpose: Bridge from the AT emulator to a tools/serveur.py process : TCP to its http port, UDP to its CoAP port.
+
+   Le serveur est lancé par demarrer() sur deux ports libres du poste, et arrêté par le destructeur. Les sockets et
+   le processus sont dans passerelle.cpp, une unité de compilation à part : unistd.h, qu'ils demandent, déclare sbrk
+   autrement que memoire.h.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+class Passerelle {
+
+  public:
+    /**
+       Datagramme émis par le boîtier et la réponse du serveur, vide s'il n'en attend pas.
+    */
+    struct echange_t {
+      std::string requete;
+      std::string reponse;
+    };
+
+    Passerelle();
+    ~Passerelle();
+
+    /**
+       Lance python3 tools/serveur.py --port <http> --coap-port <CoAP> <options> et attend qu'il accepte les connexions.
+
+       @return true si le serveur répond.
+    */
+    bool demarrer(const std::string& python, const std::string& script, const std::vector<std::string>& options);
+
+    /**
+       Transmet au serveur les octets émis par le boîtier sur une connexion de l'émulateur (Emulateur::serveur_t).
+       Une requête http n'est transmise que complète ; l'en-tête Date de la réponse est remplacé par l'heure du banc.
+       Un datagramme confirmable (CON) attend la réponse du serveur, au plus 2 s.
+
+       @param udp La connexion est une socket UDP : la requête est un datagramme CoAP.
+       @param requete Les octets émis depuis la dernière réponse.
+       @param date L'en-tête Date à l'heure virtuelle (ServeurApi::date()).
+       @return La réponse, vide si la requête est incomplète ou sans réponse.
+    */
+    std::string transmettre(const bool udp, const std::string& requete, const std::string& date);
+
+    std::vector<echange_t> datagrammes;   ///< Datagrammes CoAP et leurs réponses, dans l'ordre.
+    std::vector<std::string> requetes;    ///< Ligne de chaque requête http, "GET /device/...".
+
+  private:
+    int fPid;
+    uint16_t fPortHttp;
+    uint16_t fPortCoap;
+    int fUdp;
+};
@@ -0,0 +1,253 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   performances.cpp
+   Purpose: Host micro-benchmark of the hot paths of the firmware, against the committed baselines.
+
+   Usage : performances [--enregistrer]
+   Sans argument, compare aux références de references.txt et échoue en cas de régression ;
+   avec --enregistrer, remplace les références par les mesures.
+
+   Les temps sont ceux du poste, pas du SAMD21 : seuls comptent leurs rapports à l'étalon et aux références.
+   Les allocations et les octets sont ceux du firmware (String, ArduinoJson), à l'identique sur la carte.
+   valeur_entiere et valeur_flottante comparent la mise en texte entière des valeurs à l'ancienne, par String(float) :
+   sur le poste, la seconde profite d'une unité flottante ; le coût des flottants émulés du SAMD21 n'est pas mesuré.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#include "banc.h"
+#include "App.h"
+
+#include <sstream>
+
+namespace {
+
+  /// Accès aux méthodes protégées mesurées.
+  struct AccesApp : App {
+    using App::mediane;
+  };
+
+  struct AccesCommunication : Communication {
+    using Communication::json;
+    using Communication::appliquer;
+    using Communication::regler;
+    using Communication::valeur;
+  };
+
+  /// Résultat des charges, pour que le compilateur ne les supprime pas.
+  volatile unsigned long puits = 0;
+
+  /**
+     Médiane des échantillons valides d'une mesure de distance, comme App::mesurerDistance().
+  */
+  banc::resultat_t mediane() {
+    std::vector<std::vector<unsigned long> > mesures;
+    for (const std::string& l : banc::lignes("impulsions.txt")) {
+      std::istringstream s(l);
+      std::vector<unsigned long> impulsions;
+      unsigned long p;
+      while (s >> p) impulsions.push_back(p);
+      mesures.push_back(impulsions);
+    }
+    return banc::mesurer("mediane", mesures.size(), [&]() {
+      for (const std::vector<unsigned long>& impulsions : mesures) {
+        unsigned d[ACQUISITION_ECHANTILLONS_MAX];
+        unsigned n = 0;
+        for (const unsigned long p : impulsions) {
+          const unsigned s = Sensors::range(p);
+          if (s > 0) d[n++] = s;
+        }
+        puits += AccesApp::mediane(d, n);
+      }
+    });
+  }
+
+  struct point_t {
+    uint32_t epoch;
+    unsigned distance;
+  };
+
+  std::vector<point_t> crue() {
+    std::vector<point_t> points;
+    for (const std::string& l : banc::lignes("crue.txt")) {
+      point_t p;
+      if (sscanf(l.c_str(), "%u %u", &p.epoch, &p.distance) == 2) points.push_back(p);
+    }
+    return points;
+  }
+
+  /**
+     Évaluation des règles d'alerte à chaque mesure d'une crue : deux seuils de niveau et deux de vitesse.
+  */
+  banc::resultat_t alertes() {
+    const std::vector<point_t> points = crue();
+    return banc::mesurer("alertes", points.size(), [&]() {
+      AlertEngine moteur;
+      moteur.configurer(0, { AlertEngine::NIVEAU, AlertEngine::MONTEE, 800, 50, 0, 1 });
+      moteur.configurer(1, { AlertEngine::NIVEAU, AlertEngine::MONTEE, 1000, 50, 0, 1 });
+      moteur.configurer(2, { AlertEngine::VITESSE, AlertEngine::MONTEE, 50, 20, 15, 2 });
+      moteur.configurer(3, { AlertEngine::VITESSE, AlertEngine::DESCENTE, 50, 20, 30, 1 });
+      for (const point_t& p : points) puits += moteur.test(p.epoch, p.distance);
+    });
+  }
+
+  /**
+     Corps de sendSamples() pour chaque transmission d'une crue : distance, température, hygrométrie et résumé
+     des trois mesures de l'intervalle.
+  */
+  banc::resultat_t echantillons() {
+    const std::vector<point_t> points = crue();
+    struct trame_t {
+      Communication::sample_t samples[TRANSMISSION_ECHANTILLONS];
+      Communication::resume_t resume;
+    };
+    std::vector<trame_t> trames;
+    for (size_t i = 0; i + 3 <= points.size(); i += 3) {
+      trame_t t;
+      t.resume = { points[i].epoch, points[i + 2].epoch - points[i].epoch, F("range"), 1, Statistiques() };
+      for (size_t j = i; j < i + 3; ++j) t.resume.stats.ajouter(points[j].epoch, points[j].distance);
+      const uint32_t epoch = points[i + 2].epoch;
+      t.samples[0] = { epoch, F("range"), static_cast<int32_t>(points[i + 2].distance), 1 };
+      t.samples[1] = { epoch, F("temp"), static_cast<int32_t>(1500 + i % 700), 2 };
+      t.samples[2] = { epoch, F("hygro"), static_cast<int32_t>(450 + i % 400), 1 };
+      trames.push_back(t);
+    }
+    return banc::mesurer("echantillons", trames.size(), [&]() {
+      for (const trame_t& t : trames) puits += AccesCommunication::json(t.samples, 3, &t.resume).length();
+    });
+  }
+
+  /**
+     Valeurs des échantillons d'une crue : distance (mm, 1 décimale), température (1/100 °C) et hygrométrie (‰).
+  */
+  std::vector<Communication::sample_t> valeurs() {
+    std::vector<Communication::sample_t> v;
+    const std::vector<point_t> points = crue();
+    for (size_t i = 0; i < points.size(); ++i) {
+      v.push_back({ points[i].epoch, F("range"), static_cast<int32_t>(points[i].distance), 1 });
+      v.push_back({ points[i].epoch, F("temp"), static_cast<int32_t>(i % 3000) - 500, 2 });
+      v.push_back({ points[i].epoch, F("hygro"), static_cast<int32_t>(450 + i % 400), 1 });
+    }
+    return v;
+  }
+
+  /**
+     Valeur d'un échantillon en texte par le chemin entier, Communication::valeur(int32_t, decimales).
+  */
+  banc::resultat_t valeurEntiere() {
+    const std::vector<Communication::sample_t> v = valeurs();
+    return banc::mesurer("valeur_entiere", v.size(), [&]() {
+      for (const Communication::sample_t& e : v) puits += AccesCommunication::valeur(e.value, e.decimales).length();
+    });
+  }
+
+  /**
+     La même valeur par l'ancien chemin flottant, String(float) : division par 10^decimales puis conversion.
+     Le poste a une unité flottante, pas le Cortex-M0+ : le coût de l'émulation logicielle n'est pas mesuré ici.
+  */
+  banc::resultat_t valeurFlottante() {
+    const std::vector<Communication::sample_t> v = valeurs();
+    return banc::mesurer("valeur_flottante", v.size(), [&]() {
+      for (const Communication::sample_t& e : v) {
+        float diviseur = 1;
+        for (byte i = 0; i < e.decimales; ++i) diviseur *= 10;
+        puits += String(e.value / diviseur).length();
+      }
+    });
+  }
+
+  /**
+     Application des paramètres reçus du serveur, analyse JSON comprise.
+  */
+  banc::resultat_t parametres(Communication& communication) {
+    std::vector<String> corps;
+    for (const std::string& l : banc::lignes("parametres.json")) corps.push_back(String(l.c_str()));
+    return banc::mesurer("parametres", corps.size(), [&]() {
+      for (const String& c : corps) puits += (communication.*(&AccesCommunication::appliquer))(c);
+    });
+  }
+
+  /**
+     Mise à l'heure par l'en-tête Date d'une réponse (strptime).
+  */
+  banc::resultat_t date(Communication& communication) {
+    std::vector<reponse_t> reponses;
+    for (const std::string& l : banc::lignes("dates.txt")) {
+      reponse_t r = {};
+      strncpy(r.date, l.c_str(), sizeof(r.date) - 1);
+      reponses.push_back(r);
+    }
+    return banc::mesurer("date", reponses.size(), [&]() {
+      for (const reponse_t& r : reponses) (communication.*(&AccesCommunication::regler))(r);
+    });
+  }
+
+  /**
+     Charge d'étalonnage, indépendante du firmware : rapporte les temps du poste à ceux des références.
+  */
+  banc::resultat_t etalon() {
+    return banc::mesurer("etalon", 2000, []() {
+      uint32_t x = 2463534242UL;
+      for (unsigned i = 0; i < 2000; ++i) {
+        unsigned t[32];
+        for (unsigned& v : t) {
+          x ^= x << 13;
+          x ^= x >> 17;
+          x ^= x << 5;
+          v = x % 5000;
+        }
+        std::sort(t, t + 32);
+        char s[16];
+        puits += snprintf(s, sizeof(s), "%u.%u", t[16] / 10, t[16] % 10);
+      }
+    });
+  }
+}
+
+int main(int argc, char* argv[]) {
+  const bool enregistrement = (argc > 1) && !strcmp(argv[1], "--enregistrer");
+  const std::string fichier = std::string(BANC_SOURCE) + "/references.txt";
+
+  RTCZero rtc;
+  rtc.begin();
+  rtc.setEpoch(1538352000UL);
+  AlertEngine moteur;
+  Communication::parametres_t reglages = { -1, -1, -1, String(), 0, 0, 0, 0, Acquisition::defaut(), false };
+  Communication& communication = Communication::getInstance(F(APN_NAME), F(APN_USERNAME), F(APN_PASSWORD), F(API_SERVER), API_PORT);
+  communication.lier(rtc, moteur, reglages);
+
+  std::vector<banc::resultat_t> resultats;
+  resultats.push_back(etalon());
+  resultats.push_back(mediane());
+  resultats.push_back(alertes());
+  resultats.push_back(echantillons());
+  resultats.push_back(valeurEntiere());
+  resultats.push_back(valeurFlottante());
+  resultats.push_back(parametres(communication));
+  resultats.push_back(date(communication));
+
+  if (enregistrement) {
+    banc::enregistrer(fichier, resultats);
+    printf("References enregistrees dans %s.\n", fichier.c_str());
+    return 0;
+  }
+  const int regressions = banc::comparer(resultats, banc::references(fichier));
+  if (regressions) printf("%d regression(s).\n", regressions);
+  return regressions ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   rejeu.cpp
+   Purpose: Host replay of a CAPTURE.BIN trace, without board : sensors, modem replies, millis() and RTC from the trace.
+
+   Usage : rejeu <répertoire> [--corrompre]
+   Compilé avec REJEU. Le firmware rejoue <répertoire>/CAPTURE.BIN, sans modem : les mesures sont relues, l'horloge
+   virtuelle suit le millis() des enregistrements (CAPTURE_HORLOGE) et la RTC est réglée par les en-têtes Date de la trace.
+   Chaque octet émis vers le modem est comparé à la trace, et une réponse n'est servie qu'après les commandes qui la
+   précèdent. Une trace rejouée à l'identique est émise en entier, sans divergence, et toutes ses réponses sont servies.
+   Avec --corrompre, un octet d'une commande de la seconde moitié de la trace est modifié dans une copie
+   (<répertoire>/corrompue) : le rejeu doit s'arrêter exactement à cet octet.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#include "banc.h"
+
+namespace {
+  /**
+     Horloge virtuelle du rejeu : avance jusqu'au millis() de l'enregistrement relu, sans jamais reculer.
+  */
+  void horloge(const uint32_t ms) {
+    const uint64_t us = 1000ULL * ms;
+    if (us > hote::us) hote::us = us;
+  }
+
+  /**
+     Levée à l'arrêt du rejeu : le firmware, privé de modem, n'a plus qu'à épuiser ses délais.
+  */
+  struct Arret {};
+}
+
+#define CAPTURE_HORLOGE(ms) horloge(ms)
+#define CAPTURE_ARRET() throw Arret()
+
+#include "App.h"
+
+namespace {
+  int echecs = 0;
+
+  void verifier(const bool condition, const char* message) {
+    printf("%s %s\n", condition ? "ok  " : "ECHEC", message);
+    if (!condition) ++echecs;
+  }
+
+  /**
+     Copie la trace en modifiant un chiffre d'un MODEM_EMIS de sa seconde moitié.
+
+     @return Le nombre d'octets émis qui précèdent l'octet modifié, -1 si aucun ne convient.
+  */
+  long corrompre(const std::string& source, const std::string& copie) {
+    std::vector<banc::enregistrement_t> t = banc::trace(source);
+    const uint32_t milieu = t.empty() ? 0 : t.back().position / 2;
+    long avant = 0;
+    long modifie = -1;
+    for (banc::enregistrement_t& e : t) {
+      if (e.type != Capture::MODEM_EMIS) continue;
+      if ((modifie < 0) && (e.position > milieu)) {
+        const size_t i = e.donnees.find_first_of("0123456789");
+        if (i != std::string::npos) {
+          e.donnees[i] = (e.donnees[i] == '9') ? '0' : e.donnees[i] + 1;
+          modifie = avant + i;
+        }
+      }
+      avant += e.donnees.size();
+    }
+    FILE* f = fopen(copie.c_str(), "wb");
+    if (!f) return -1;
+    for (const banc::enregistrement_t& e : t) {
+      const uint8_t entete[] = { uint8_t(e.ms), uint8_t(e.ms >> 8), uint8_t(e.ms >> 16), uint8_t(e.ms >> 24), e.type, uint8_t(e.donnees.size()) };
+      fwrite(entete, 1, sizeof(entete), f);
+      fwrite(e.donnees.data(), 1, e.donnees.size(), f);
+    }
+    fclose(f);
+    return modifie;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage : rejeu <repertoire> [--corrompre]\n");
+    return 2;
+  }
+  std::string repertoire = argv[1];
+  const bool corrompue = (argc > 2) && !strcmp(argv[2], "--corrompre");
+  hote::journal = getenv("JOURNAL");
+
+  long divergence = -1;
+  if (corrompue) {
+    const std::string source = repertoire + "/" CAPTURE_FICHIER;
+    repertoire += "/corrompue";
+    hote::carteSD(repertoire);
+    divergence = corrompre(source, repertoire + "/" CAPTURE_FICHIER);
+    if (divergence < 0) {
+      printf("Trace %s sans commande a corrompre.\n", source.c_str());
+      return 1;
+    }
+  }
+  hote::carteSD(repertoire);
+
+  const std::vector<banc::enregistrement_t> t = banc::trace(repertoire + "/" CAPTURE_FICHIER);
+  if (t.empty()) {
+    printf("Trace %s/%s vide ou absente.\n", repertoire.c_str(), CAPTURE_FICHIER);
+    return 1;
+  }
+  uint32_t emis = 0;
+  uint32_t taille = 0;
+  for (const banc::enregistrement_t& e : t) {
+    if (e.type == Capture::MODEM_EMIS) emis += e.donnees.size();
+    taille = e.position + 6 + e.donnees.size();
+  }
+
+  // Le rejeu dure jusqu'au dernier enregistrement : le réveil suivant n'est pas dans la trace
+  App& app = App::getInstance(F(APN_NAME), F(APN_USERNAME), F(APN_PASSWORD));
+  try {
+    if (!app.setup()) {
+      printf("App::setup() en echec.\n");
+      return 1;
+    }
+    const uint64_t fin = 1000ULL * t.back().ms;
+    while (hote::us < fin) {
+      hote::attendreAlarme();
+      if (!app.loop()) {
+        printf("App::loop() en echec.\n");
+        return 1;
+      }
+    }
+  } catch (const Arret&) {
+  } catch (const hote::Reset&) {
+    printf("Reset inattendu.\n");
+    return 1;
+  }
+
+  printf("     %u octets emis conformes sur %u, rejeu %s a %.0f s\n", fluxModem.conformes(), emis,
+         Capture::arrete() ? "arrete" : "termine", hote::us / 1e6);
+  if (corrompue) {
+    verifier(Capture::arrete(), "divergence detectee, rejeu arrete");
+    verifier(fluxModem.conformes() == static_cast<uint32_t>(divergence), "arret a l'octet modifie");
+  } else {
+    verifier(!Capture::arrete(), "aucune divergence");
+    verifier(fluxModem.conformes() == emis, "toutes les commandes de la trace emises a l'identique");
+    verifier(Capture::prochain(Capture::MODEM_RECUS) == taille, "toutes les reponses de la trace servies");
+  }
+  return echecs ? 1 : 0;
+}
@@ -0,0 +1,172 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   requetes.cpp
+   Purpose: Bytes and AT+CIPSEND segments of each http request, against the writes of ArduinoHttpClient 0.3.x.
+
+   Le boîtier tourne une heure en temps virtuel contre l'émulateur AT ; la première requête de chaque sorte
+   (GET /parameters, PUT /samples, PUT /status) est ensuite rejouée telle qu'ArduinoHttpClient 0.3.x l'écrivait :
+   ligne de requête, Host, User-Agent: Arduino/2.2.0, Connection: close, Content-Type et Content-Length, ligne vide,
+   corps ; chaque print est une écriture du client TinyGSM, donc un AT+CIPSEND. Les octets et les segments sont ceux
+   que l'émulateur a reçus. Échoue si une requête du firmware n'est pas écrite en un seul AT+CIPSEND ou n'est pas
+   plus courte que sa reproduction.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#include "banc.h"
+#include "emulateur.h"
+#include "App.h"
+
+namespace {
+  int echecs = 0;
+
+  void verifier(const bool condition, const char* message) {
+    printf("%s %s\n", condition ? "ok  " : "ECHEC", message);
+    if (!condition) ++echecs;
+  }
+
+  /**
+     Écrit une requête comme HttpClient::startRequest() d'ArduinoHttpClient 0.3.x, client par défaut
+     (en-têtes par défaut, Connection: close, port 80), puis lit la réponse jusqu'à la fermeture.
+  */
+  void arduinoHttpClient(TinyGsmClient& client, const std::string& methode, const std::string& chemin,
+                         const std::string& type, const std::string& corps) {
+    // sendInitialHeaders()
+    client.print(methode.c_str());
+    client.print(" ");
+    client.print(chemin.c_str());
+    client.println(" HTTP/1.1");
+    client.print("Host: ");
+    client.print(API_SERVER);
+    client.println();
+    client.print("User-Agent");   // sendHeader(HTTP_HEADER_USER_AGENT, kUserAgent)
+    client.print(": ");
+    client.println("Arduino/2.2.0");
+    client.print("Connection");
+    client.print(": ");
+    client.println("close");
+    if (!type.empty()) {
+      client.print("Content-Type");
+      client.print(": ");
+      client.println(type.c_str());
+      client.print("Content-Length");
+      client.print(": ");
+      client.println(static_cast<int>(corps.size()));
+    }
+    client.println();   // finishHeaders()
+    if (!corps.empty()) client.write(reinterpret_cast<const uint8_t*>(corps.data()), corps.size());
+
+    const unsigned long debut = millis();
+    while ((client.connected() || client.available()) && (millis() - debut < HTTP_TIMEOUT)) {
+      if (client.available()) client.read();
+    }
+    client.stop();
+  }
+
+  /**
+     Requête relevée par l'émulateur.
+  */
+  struct mesure_t {
+    std::string methode;
+    std::string chemin;
+    std::string type;
+    std::string corps;
+    size_t entetes;     ///< Octets des en-têtes, ligne vide comprise.
+    size_t octets;      ///< Octets émis, corps compris.
+    size_t segments;    ///< Nombre d'AT+CIPSEND.
+  };
+
+  mesure_t mesure(const Emulateur::connexion_t& c) {
+    const std::string& r = c.emis;
+    const size_t fin = r.find("\r\n\r\n");
+    const size_t sp1 = r.find(' ');
+    const size_t sp2 = r.find(' ', sp1 + 1);
+    mesure_t m = { r.substr(0, sp1), r.substr(sp1 + 1, sp2 - sp1 - 1), "", "", 0, r.size(), c.segments.size() };
+    const size_t ct = r.find("Content-Type: ");
+    if ((ct != std::string::npos) && (ct < fin)) m.type = r.substr(ct + 14, r.find("\r\n", ct) - ct - 14);
+    if (fin != std::string::npos) {
+      m.entetes = fin + 4;
+      m.corps = r.substr(fin + 4);
+    }
+    return m;
+  }
+
+  /**
+     @return La sorte d'une requête : méthode et dernier élément du chemin.
+  */
+  std::string sorte(const mesure_t& m) {
+    return m.methode + " /" + m.chemin.substr(m.chemin.rfind('/') + 1);
+  }
+}
+
+int main() {
+  hote::journal = getenv("JOURNAL");
+
+  Emulateur modem;
+  Serial1.brancher(&modem);
+  ServeurApi serveur;
+  serveur.brancher(modem);
+  serveur.configurer("{\"limit1R\":0,\"hyst1R\":0,\"limit2O\":0,\"hyst2O\":0}", "\"5f1c0e7a9b3d2c41\"");
+
+  App& app = App::getInstance(F(APN_NAME), F(APN_USERNAME), F(APN_PASSWORD));
+  if (!app.setup()) {
+    printf("App::setup() en echec.\n");
+    return 1;
+  }
+  const uint64_t fin = hote::us + 3600ULL * 1000000ULL;
+  while (hote::us < fin) {
+    hote::attendreAlarme();
+    if (!app.loop()) {
+      printf("App::loop() en echec.\n");
+      return 1;
+    }
+  }
+
+  // Première requête de chaque sorte, dans l'ordre d'apparition
+  std::vector<mesure_t> firmware;
+  for (const Emulateur::connexion_t& c : modem.connexions) {
+    if (c.udp || c.emis.empty()) continue;
+    const mesure_t m = mesure(c);
+    bool connue = false;
+    for (const mesure_t& f : firmware) connue = connue || (sorte(f) == sorte(m));
+    if (!connue) firmware.push_back(m);
+  }
+  verifier(firmware.size() == 3, "GET /parameters, PUT /samples et PUT /status observes");
+
+  // Reproduction d'ArduinoHttpClient sur le même modem, rallumé et attaché
+  modem.allume = true;
+  modem.gprs = true;
+  TinyGsm at(Serial1);
+  printf("%-16s %28s %28s\n", "", "firmware", "ArduinoHttpClient 0.3.x");
+  printf("%-16s %9s %9s %8s %9s %9s %8s\n", "requete", "en-tetes", "octets", "CIPSEND", "en-tetes", "octets", "CIPSEND");
+  for (const mesure_t& f : firmware) {
+    TinyGsmClient client(at);
+    if (!client.connect(API_SERVER, API_PORT)) {
+      verifier(false, "connexion de la reproduction");
+      continue;
+    }
+    arduinoHttpClient(client, f.methode, f.chemin, f.type, f.corps);
+    const mesure_t a = mesure(modem.connexions.back());
+    printf("%-16s %9zu %9zu %8zu %9zu %9zu %8zu\n", sorte(f).c_str(), f.entetes, f.octets, f.segments, a.entetes, a.octets, a.segments);
+    verifier(f.segments == 1, "requete du firmware en un seul AT+CIPSEND");
+    verifier((a.corps == f.corps) && (f.octets < a.octets), "meme corps, moins d'octets que la reproduction");
+  }
+
+  return echecs ? 1 : 0;
+}
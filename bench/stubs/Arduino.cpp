@@ -0,0 +1,1037 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   Arduino.cpp
+   Purpose: Host stand-in of the Arduino SAMD core for the bench.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#include "hote.h"
+
+#include <time.h>
+#include <vector>
+
+namespace hote {
+
+  uint64_t us = 0;
+  unsigned pas = 100;
+  bool journal = false;
+  unsigned long ecrituresFlash = 0;
+  Capteurs capteurs = { 3, 5, 1500, 0, 0, 215, 550, 4000 };
+
+  namespace {
+    uint8_t modes[64];
+    uint8_t etats[64];
+    std::vector<std::function<void(uint32_t, uint32_t)> >& observateurs() {
+      static std::vector<std::function<void(uint32_t, uint32_t)> > o;
+      return o;
+    }
+
+    uint32_t alea = 1;
+    uint32_t suivant() {    // xorshift32, déterministe
+      alea ^= alea << 13;
+      alea ^= alea >> 17;
+      alea ^= alea << 5;
+      return alea;
+    }
+
+    unsigned echantillons = 0;    // échantillons du télémètre depuis le lancement
+    uint8_t am2302[41];           // impulsions de la prochaine lecture de l'AM2302
+    unsigned am2302Lues = sizeof(am2302);
+
+    /**
+       Prépare les impulsions d'une lecture de l'AM2302 : réponse de 80 µs puis hygrométrie, température
+       et somme de contrôle, 70 µs pour un bit à 1 et 26 µs pour un bit à 0.
+    */
+    void preparerAm2302() {
+      const uint16_t h = capteurs.hygrometrie;
+      const uint16_t t = (capteurs.temperature < 0) ? (0x8000 | -capteurs.temperature) : capteurs.temperature;
+      const uint8_t chk = (h >> 8) + (h & 0xff) + (t >> 8) + (t & 0xff);
+      const uint64_t bits = (uint64_t(h) << 24) | (uint64_t(t) << 8) | chk;
+      am2302[0] = 80;
+      for (int i = 0; i < 40; ++i) am2302[1 + i] = ((bits >> (39 - i)) & 1) ? 70 : 26;
+      am2302Lues = 0;
+    }
+
+    // Le RTC et mktime() du firmware sont en UTC.
+    struct Initialisation {
+      Initialisation() {
+        setenv("TZ", "UTC", 1);
+        tzset();
+      }
+    } initialisation;
+  }
+
+  void observer(std::function<void(uint32_t, uint32_t)> observateur) {
+    observateurs().push_back(observateur);
+  }
+}
+
+unsigned long millis() {
+  hote::us += hote::pas;
+  return hote::us / 1000;
+}
+
+unsigned long micros() {
+  hote::us += hote::pas;
+  return hote::us;
+}
+
+void delay(unsigned long ms) {
+  hote::us += 1000ULL * ms;
+}
+
+void delayMicroseconds(unsigned int us) {
+  hote::us += us;
+}
+
+void pinMode(uint32_t pin, uint32_t mode) {
+  if (pin >= sizeof(hote::modes)) return;
+  hote::modes[pin] = mode;
+  if ((pin == hote::capteurs.am2302) && (mode == INPUT_PULLUP)) hote::preparerAm2302();   // fin de l'impulsion de départ
+}
+
+void digitalWrite(uint32_t pin, uint32_t value) {
+  if (pin >= sizeof(hote::etats)) return;
+  hote::etats[pin] = value;
+  for (auto& o : hote::observateurs()) o(pin, value);
+}
+
+int digitalRead(uint32_t pin) {
+  return (pin < sizeof(hote::etats)) ? hote::etats[pin] : LOW;
+}
+
+unsigned long pulseIn(uint32_t pin, uint32_t state, unsigned long timeout) {
+  unsigned long largeur = 0;
+  if (pin == hote::capteurs.echo) {
+    const hote::Capteurs& c = hote::capteurs;
+    ++hote::echantillons;
+    if (!c.sansEcho || (hote::echantillons % c.sansEcho)) {
+      const long bruit = c.bruit ? static_cast<long>(hote::suivant() % (2 * c.bruit + 1)) - static_cast<long>(c.bruit) : 0;
+      largeur = max(0L, static_cast<long>(c.distance) + bruit);
+    }
+  } else if ((pin == hote::capteurs.am2302) && (hote::am2302Lues < sizeof(hote::am2302))) {
+    largeur = hote::am2302[hote::am2302Lues++];
+  }
+  if (largeur > timeout) largeur = 0;
+  hote::us += largeur ? largeur : timeout;
+  return largeur;
+}
+
+int analogRead(uint32_t pin) {
+  if (pin != ADC_BATTERY) return 0;
+  return (hote::capteurs.vbat * 12288UL + 25245UL) / 50490UL;    // inverse de Sensors::sampleBattery() sur 10 lectures
+}
+
+void analogReadResolution(int) {}
+
+void attachInterrupt(uint32_t, void (*)(), uint32_t) {}
+
+int digitalPinToInterrupt(uint32_t pin) {
+  return pin;
+}
+
+long random(long howbig) {
+  return howbig ? hote::suivant() % howbig : 0;
+}
+
+long random(long howsmall, long howbig) {
+  return (howsmall >= howbig) ? howsmall : howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed) {
+  if (seed) hote::alea = seed;
+}
+
+void NVIC_SystemReset() {
+  throw hote::Reset();
+}
+
+int pinPeripheral(uint32_t, int) {
+  return 0;
+}
+
+/*
+   Fin du tas du firmware : memoire.h peint l'espace entre sbrk(0) et la pile. Sur le poste, le tas est loin de la pile ;
+   sbrk(0) est donc placé MEMOIRE_PILE octets sous la pile du lancement, dans une zone de pile déjà touchée.
+   Le tas de la glibc n'utilise pas ce symbole.
+*/
+#define MEMOIRE_PILE (48 * 1024)
+
+namespace {
+  char* basePile;
+
+  void toucherPile(const unsigned n) {
+    volatile char zone[4096];
+    zone[0] = 0;
+    zone[sizeof(zone) - 1] = 0;
+    if (n) toucherPile(n - 1);
+  }
+
+  struct Pile {
+    Pile() {
+      char marqueur;
+      basePile = &marqueur;
+      toucherPile(MEMOIRE_PILE / 4096 + 4);
+    }
+  } pile;
+}
+
+extern "C" char* sbrk(int) {
+  return basePile - MEMOIRE_PILE;
+}
+
+/* String (WString du cœur Arduino) */
+
+String::String(const char* cstr) {
+  init();
+  if (cstr) copy(cstr, strlen(cstr));
+}
+
+String::String(const String& value) {
+  init();
+  *this = value;
+}
+
+String::String(String&& rval) {
+  init();
+  move(rval);
+}
+
+String::String(const __FlashStringHelper* pstr) {
+  init();
+  *this = pstr;
+}
+
+String::String(char c) {
+  init();
+  char buf[2] = { c, 0 };
+  *this = buf;
+}
+
+String::String(unsigned char value, unsigned char base) {
+  init();
+  char buf[1 + 8 * sizeof(unsigned char)];
+  if (base == 16) snprintf(buf, sizeof(buf), "%x", value); else snprintf(buf, sizeof(buf), "%u", value);
+  *this = buf;
+}
+
+String::String(int value, unsigned char base) {
+  init();
+  char buf[2 + 8 * sizeof(int)];
+  if (base == 16) snprintf(buf, sizeof(buf), "%x", value); else snprintf(buf, sizeof(buf), "%d", value);
+  *this = buf;
+}
+
+String::String(unsigned int value, unsigned char base) {
+  init();
+  char buf[1 + 8 * sizeof(unsigned int)];
+  if (base == 16) snprintf(buf, sizeof(buf), "%x", value); else snprintf(buf, sizeof(buf), "%u", value);
+  *this = buf;
+}
+
+String::String(long value, unsigned char base) {
+  init();
+  char buf[2 + 8 * sizeof(long)];
+  if (base == 16) snprintf(buf, sizeof(buf), "%lx", value); else snprintf(buf, sizeof(buf), "%ld", value);
+  *this = buf;
+}
+
+String::String(unsigned long value, unsigned char base) {
+  init();
+  char buf[1 + 8 * sizeof(unsigned long)];
+  if (base == 16) snprintf(buf, sizeof(buf), "%lx", value); else snprintf(buf, sizeof(buf), "%lu", value);
+  *this = buf;
+}
+
+String::String(float value, unsigned char decimalPlaces) {
+  init();
+  char buf[33];
+  snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
+  *this = buf;
+}
+
+String::String(double value, unsigned char decimalPlaces) {
+  init();
+  char buf[33];
+  snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
+  *this = buf;
+}
+
+String::~String() {
+  free(buffer);
+}
+
+inline void String::init() {
+  buffer = NULL;
+  capacity = 0;
+  len = 0;
+}
+
+void String::invalidate() {
+  if (buffer) free(buffer);
+  buffer = NULL;
+  capacity = len = 0;
+}
+
+bool String::reserve(unsigned int size) {
+  if (buffer && capacity >= size) return true;
+  if (changeBuffer(size)) {
+    if (len == 0) buffer[0] = 0;
+    return true;
+  }
+  return false;
+}
+
+bool String::changeBuffer(unsigned int maxStrLen) {
+  char* newbuffer = static_cast<char*>(realloc(buffer, maxStrLen + 1));
+  if (newbuffer) {
+    buffer = newbuffer;
+    capacity = maxStrLen;
+    return true;
+  }
+  return false;
+}
+
+String& String::copy(const char* cstr, unsigned int length) {
+  if (!reserve(length)) {
+    invalidate();
+    return *this;
+  }
+  len = length;
+  memcpy(buffer, cstr, length);
+  buffer[len] = 0;
+  return *this;
+}
+
+void String::move(String& rhs) {
+  if (buffer) {
+    if (rhs && capacity >= rhs.len) {
+      memcpy(buffer, rhs.buffer, rhs.len + 1);
+      len = rhs.len;
+      rhs.len = 0;
+      return;
+    }
+    free(buffer);
+  }
+  buffer = rhs.buffer;
+  capacity = rhs.capacity;
+  len = rhs.len;
+  rhs.buffer = NULL;
+  rhs.capacity = 0;
+  rhs.len = 0;
+}
+
+String& String::operator=(const String& rhs) {
+  if (this == &rhs) return *this;
+  if (rhs.buffer) copy(rhs.buffer, rhs.len);
+  else invalidate();
+  return *this;
+}
+
+String& String::operator=(String&& rval) {
+  if (this != &rval) move(rval);
+  return *this;
+}
+
+String& String::operator=(const char* cstr) {
+  if (cstr) copy(cstr, strlen(cstr));
+  else invalidate();
+  return *this;
+}
+
+String& String::operator=(const __FlashStringHelper* pstr) {
+  return *this = reinterpret_cast<const char*>(pstr);
+}
+
+bool String::concat(const String& s) {
+  return concat(s.buffer, s.len);
+}
+
+bool String::concat(const char* cstr, unsigned int length) {
+  const unsigned int newlen = len + length;
+  if (!cstr) return false;
+  if (length == 0) return true;
+  if (!reserve(newlen)) return false;
+  memmove(buffer + len, cstr, length);
+  len = newlen;
+  buffer[len] = 0;
+  return true;
+}
+
+bool String::concat(const char* cstr) {
+  if (!cstr) return false;
+  return concat(cstr, strlen(cstr));
+}
+
+bool String::concat(char c) {
+  char buf[2] = { c, 0 };
+  return concat(buf, 1);
+}
+
+bool String::concat(unsigned char num) {
+  char buf[1 + 3 * sizeof(unsigned char)];
+  snprintf(buf, sizeof(buf), "%u", num);
+  return concat(buf, strlen(buf));
+}
+
+bool String::concat(int num) {
+  char buf[2 + 3 * sizeof(int)];
+  snprintf(buf, sizeof(buf), "%d", num);
+  return concat(buf, strlen(buf));
+}
+
+bool String::concat(unsigned int num) {
+  char buf[1 + 3 * sizeof(unsigned int)];
+  snprintf(buf, sizeof(buf), "%u", num);
+  return concat(buf, strlen(buf));
+}
+
+bool String::concat(long num) {
+  char buf[2 + 3 * sizeof(long)];
+  snprintf(buf, sizeof(buf), "%ld", num);
+  return concat(buf, strlen(buf));
+}
+
+bool String::concat(unsigned long num) {
+  char buf[1 + 3 * sizeof(unsigned long)];
+  snprintf(buf, sizeof(buf), "%lu", num);
+  return concat(buf, strlen(buf));
+}
+
+bool String::concat(float num) {
+  char buf[20];
+  snprintf(buf, sizeof(buf), "%.2f", num);
+  return concat(buf, strlen(buf));
+}
+
+bool String::concat(double num) {
+  char buf[20];
+  snprintf(buf, sizeof(buf), "%.2f", num);
+  return concat(buf, strlen(buf));
+}
+
+bool String::concat(const __FlashStringHelper* str) {
+  return concat(reinterpret_cast<const char*>(str));
+}
+
+StringSumHelper& operator+(const StringSumHelper& lhs, const String& rhs) {
+  StringSumHelper& a = const_cast<StringSumHelper&>(lhs);
+  if (!a.concat(rhs)) a = String();
+  return a;
+}
+
+StringSumHelper& operator+(const StringSumHelper& lhs, const char* cstr) {
+  StringSumHelper& a = const_cast<StringSumHelper&>(lhs);
+  if (!cstr || !a.concat(cstr)) a = String();
+  return a;
+}
+
+StringSumHelper& operator+(const StringSumHelper& lhs, char c) {
+  StringSumHelper& a = const_cast<StringSumHelper&>(lhs);
+  a.concat(c);
+  return a;
+}
+
+StringSumHelper& operator+(const StringSumHelper& lhs, unsigned char num) {
+  StringSumHelper& a = const_cast<StringSumHelper&>(lhs);
+  a.concat(num);
+  return a;
+}
+
+StringSumHelper& operator+(const StringSumHelper& lhs, int num) {
+  StringSumHelper& a = const_cast<StringSumHelper&>(lhs);
+  a.concat(num);
+  return a;
+}
+
+StringSumHelper& operator+(const StringSumHelper& lhs, unsigned int num) {
+  StringSumHelper& a = const_cast<StringSumHelper&>(lhs);
+  a.concat(num);
+  return a;
+}
+
+StringSumHelper& operator+(const StringSumHelper& lhs, long num) {
+  StringSumHelper& a = const_cast<StringSumHelper&>(lhs);
+  a.concat(num);
+  return a;
+}
+
+StringSumHelper& operator+(const StringSumHelper& lhs, unsigned long num) {
+  StringSumHelper& a = const_cast<StringSumHelper&>(lhs);
+  a.concat(num);
+  return a;
+}
+
+StringSumHelper& operator+(const StringSumHelper& lhs, const __FlashStringHelper* rhs) {
+  StringSumHelper& a = const_cast<StringSumHelper&>(lhs);
+  a.concat(rhs);
+  return a;
+}
+
+int String::compareTo(const String& s) const {
+  if (!buffer || !s.buffer) {
+    if (s.buffer && s.len > 0) return 0 - *(unsigned char*)s.buffer;
+    if (buffer && len > 0) return *(unsigned char*)buffer;
+    return 0;
+  }
+  return strcmp(buffer, s.buffer);
+}
+
+bool String::equals(const String& s2) const {
+  return (len == s2.len && compareTo(s2) == 0);
+}
+
+bool String::equals(const char* cstr) const {
+  if (len == 0) return (cstr == NULL || *cstr == 0);
+  if (cstr == NULL) return buffer[0] == 0;
+  return strcmp(buffer, cstr) == 0;
+}
+
+bool String::equalsIgnoreCase(const String& s2) const {
+  if (this == &s2) return true;
+  if (len != s2.len) return false;
+  if (len == 0) return true;
+  const char* p1 = buffer;
+  const char* p2 = s2.buffer;
+  while (*p1) {
+    if (tolower(*p1++) != tolower(*p2++)) return false;
+  }
+  return true;
+}
+
+bool String::startsWith(const String& s2) const {
+  if (len < s2.len) return false;
+  return startsWith(s2, 0);
+}
+
+bool String::startsWith(const String& s2, unsigned int offset) const {
+  if (offset > len - s2.len || !buffer || !s2.buffer) return false;
+  return strncmp(&buffer[offset], s2.buffer, s2.len) == 0;
+}
+
+bool String::endsWith(const String& s2) const {
+  if (len < s2.len || !buffer || !s2.buffer) return false;
+  return strcmp(&buffer[len - s2.len], s2.buffer) == 0;
+}
+
+char String::charAt(unsigned int loc) const {
+  return operator[](loc);
+}
+
+void String::setCharAt(unsigned int loc, char c) {
+  if (loc < len) buffer[loc] = c;
+}
+
+char& String::operator[](unsigned int index) {
+  static char dummy_writable_char;
+  if (index >= len || !buffer) {
+    dummy_writable_char = 0;
+    return dummy_writable_char;
+  }
+  return buffer[index];
+}
+
+char String::operator[](unsigned int index) const {
+  if (index >= len || !buffer) return 0;
+  return buffer[index];
+}
+
+void String::getBytes(unsigned char* buf, unsigned int bufsize, unsigned int index) const {
+  if (!bufsize || !buf) return;
+  if (index >= len) {
+    buf[0] = 0;
+    return;
+  }
+  unsigned int n = bufsize - 1;
+  if (n > len - index) n = len - index;
+  strncpy(reinterpret_cast<char*>(buf), buffer + index, n);
+  buf[n] = 0;
+}
+
+int String::indexOf(char c) const {
+  return indexOf(c, 0);
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const {
+  if (fromIndex >= len) return -1;
+  const char* temp = strchr(buffer + fromIndex, ch);
+  if (temp == NULL) return -1;
+  return temp - buffer;
+}
+
+int String::indexOf(const String& s2) const {
+  return indexOf(s2, 0);
+}
+
+int String::indexOf(const String& s2, unsigned int fromIndex) const {
+  if (fromIndex >= len) return -1;
+  const char* found = strstr(buffer + fromIndex, s2.buffer);
+  if (found == NULL) return -1;
+  return found - buffer;
+}
+
+int String::lastIndexOf(char theChar) const {
+  return lastIndexOf(theChar, len - 1);
+}
+
+int String::lastIndexOf(char ch, unsigned int fromIndex) const {
+  if (fromIndex >= len) return -1;
+  const char tempchar = buffer[fromIndex + 1];
+  buffer[fromIndex + 1] = '\0';
+  const char* temp = strrchr(buffer, ch);
+  buffer[fromIndex + 1] = tempchar;
+  if (temp == NULL) return -1;
+  return temp - buffer;
+}
+
+int String::lastIndexOf(const String& s2) const {
+  return lastIndexOf(s2, len - s2.len);
+}
+
+int String::lastIndexOf(const String& s2, unsigned int fromIndex) const {
+  if (s2.len == 0 || len == 0 || s2.len > len) return -1;
+  if (fromIndex >= len) fromIndex = len - 1;
+  int found = -1;
+  for (char* p = buffer; p <= buffer + fromIndex; p++) {
+    p = strstr(p, s2.buffer);
+    if (!p) break;
+    if ((unsigned int)(p - buffer) <= fromIndex) found = p - buffer;
+  }
+  return found;
+}
+
+String String::substring(unsigned int left, unsigned int right) const {
+  if (left > right) std::swap(left, right);
+  String out;
+  if (left >= len) return out;
+  if (right > len) right = len;
+  const char temp = buffer[right];
+  buffer[right] = '\0';
+  out = buffer + left;
+  buffer[right] = temp;
+  return out;
+}
+
+void String::replace(char find, char replace) {
+  if (!buffer) return;
+  for (char* p = buffer; *p; p++) {
+    if (*p == find) *p = replace;
+  }
+}
+
+void String::replace(const String& find, const String& replace) {
+  if (len == 0 || find.len == 0) return;
+  const int diff = replace.len - find.len;
+  char* readFrom = buffer;
+  char* foundAt;
+  if (diff == 0) {
+    while ((foundAt = strstr(readFrom, find.buffer)) != NULL) {
+      memcpy(foundAt, replace.buffer, replace.len);
+      readFrom = foundAt + replace.len;
+    }
+  } else if (diff < 0) {
+    char* writeTo = buffer;
+    while ((foundAt = strstr(readFrom, find.buffer)) != NULL) {
+      const unsigned int n = foundAt - readFrom;
+      memmove(writeTo, readFrom, n);
+      writeTo += n;
+      memcpy(writeTo, replace.buffer, replace.len);
+      writeTo += replace.len;
+      readFrom = foundAt + find.len;
+      len += diff;
+    }
+    memmove(writeTo, readFrom, strlen(readFrom) + 1);
+  } else {
+    unsigned int size = len;
+    while ((foundAt = strstr(readFrom, find.buffer)) != NULL) {
+      readFrom = foundAt + find.len;
+      size += diff;
+    }
+    if (size == len) return;
+    if (size > capacity && !changeBuffer(size)) return;
+    int index = len - 1;
+    while (index >= 0 && (index = lastIndexOf(find, index)) >= 0) {
+      readFrom = buffer + index + find.len;
+      memmove(readFrom + diff, readFrom, len - (readFrom - buffer));
+      len += diff;
+      buffer[len] = 0;
+      memcpy(buffer + index, replace.buffer, replace.len);
+      index--;
+    }
+  }
+}
+
+void String::remove(unsigned int index) {
+  remove(index, (unsigned int)-1);
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+  if (index >= len) return;
+  if (count <= 0) return;
+  if (count > len - index) count = len - index;
+  char* writeTo = buffer + index;
+  len = len - count;
+  memmove(writeTo, buffer + index + count, len - index);
+  buffer[len] = 0;
+}
+
+void String::toLowerCase() {
+  if (!buffer) return;
+  for (char* p = buffer; *p; p++) *p = tolower(*p);
+}
+
+void String::toUpperCase() {
+  if (!buffer) return;
+  for (char* p = buffer; *p; p++) *p = toupper(*p);
+}
+
+void String::trim() {
+  if (!buffer || len == 0) return;
+  char* begin = buffer;
+  while (isspace(*begin)) begin++;
+  char* end = buffer + len - 1;
+  while (isspace(*end) && end >= begin) end--;
+  len = end + 1 - begin;
+  if (begin > buffer) memmove(buffer, begin, len);
+  buffer[len] = 0;
+}
+
+long String::toInt() const {
+  return buffer ? atol(buffer) : 0;
+}
+
+float String::toFloat() const {
+  return float(toDouble());
+}
+
+double String::toDouble() const {
+  return buffer ? atof(buffer) : 0;
+}
+
+/* Print */
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    if (write(*buffer++)) n++;
+    else break;
+  }
+  return n;
+}
+
+size_t Print::print(const __FlashStringHelper* ifsh) {
+  return print(reinterpret_cast<const char*>(ifsh));
+}
+
+size_t Print::print(const String& s) {
+  return write(s.c_str(), s.length());
+}
+
+size_t Print::print(const char str[]) {
+  return write(str);
+}
+
+size_t Print::print(char c) {
+  return write(static_cast<uint8_t>(c));
+}
+
+size_t Print::print(unsigned char b, int base) {
+  return print(static_cast<unsigned long>(b), base);
+}
+
+size_t Print::print(int n, int base) {
+  return print(static_cast<long>(n), base);
+}
+
+size_t Print::print(unsigned int n, int base) {
+  return print(static_cast<unsigned long>(n), base);
+}
+
+size_t Print::print(long n, int base) {
+  if (base == 0) return write(static_cast<uint8_t>(n));
+  if (base == 10 && n < 0) {
+    const size_t t = print('-');
+    return printNumber(-static_cast<unsigned long>(n), 10) + t;
+  }
+  return printNumber(n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+  if (base == 0) return write(static_cast<uint8_t>(n));
+  return printNumber(n, base);
+}
+
+size_t Print::print(double n, int digits) {
+  return printFloat(n, digits);
+}
+
+size_t Print::println() {
+  return write("\r\n");
+}
+
+size_t Print::println(const __FlashStringHelper* s) {
+  const size_t n = print(s);
+  return n + println();
+}
+
+size_t Print::println(const String& s) {
+  const size_t n = print(s);
+  return n + println();
+}
+
+size_t Print::println(const char c[]) {
+  const size_t n = print(c);
+  return n + println();
+}
+
+size_t Print::println(char c) {
+  const size_t n = print(c);
+  return n + println();
+}
+
+size_t Print::println(unsigned char b, int base) {
+  const size_t n = print(b, base);
+  return n + println();
+}
+
+size_t Print::println(int num, int base) {
+  const size_t n = print(num, base);
+  return n + println();
+}
+
+size_t Print::println(unsigned int num, int base) {
+  const size_t n = print(num, base);
+  return n + println();
+}
+
+size_t Print::println(long num, int base) {
+  const size_t n = print(num, base);
+  return n + println();
+}
+
+size_t Print::println(unsigned long num, int base) {
+  const size_t n = print(num, base);
+  return n + println();
+}
+
+size_t Print::println(double num, int digits) {
+  const size_t n = print(num, digits);
+  return n + println();
+}
+
+size_t Print::printNumber(unsigned long n, uint8_t base) {
+  char buf[8 * sizeof(long) + 1];
+  char* str = &buf[sizeof(buf) - 1];
+  *str = '\0';
+  if (base < 2) base = 10;
+  do {
+    const char c = n % base;
+    n /= base;
+    *--str = c < 10 ? c + '0' : c + 'A' - 10;
+  } while (n);
+  return write(str);
+}
+
+size_t Print::printFloat(double number, uint8_t digits) {
+  char buf[40];
+  if (isnan(number)) return print("nan");
+  if (isinf(number)) return print("inf");
+  if (number > 4294967040.0 || number < -4294967040.0) return print("ovf");
+  snprintf(buf, sizeof(buf), "%.*f", digits, number);
+  return write(buf);
+}
+
+/* Stream */
+
+int Stream::timedRead() {
+  _startMillis = millis();
+  do {
+    const int c = read();
+    if (c >= 0) return c;
+  } while (millis() - _startMillis < _timeout);
+  return -1;
+}
+
+int Stream::timedPeek() {
+  _startMillis = millis();
+  do {
+    const int c = peek();
+    if (c >= 0) return c;
+  } while (millis() - _startMillis < _timeout);
+  return -1;
+}
+
+int Stream::peekNextDigit() {
+  for (;;) {
+    const int c = timedPeek();
+    if (c < 0) return c;
+    if (c == '-') return c;
+    if (c >= '0' && c <= '9') return c;
+    read();
+  }
+}
+
+bool Stream::find(const char* target) {
+  return findUntil(target, NULL);
+}
+
+bool Stream::find(const char* target, size_t length) {
+  size_t index = 0;
+  if (length == 0) return true;
+  for (;;) {
+    const int c = timedRead();
+    if (c < 0) return false;
+    if (c == target[index]) {
+      if (++index >= length) return true;
+    } else {
+      index = (c == target[0]) ? 1 : 0;
+    }
+  }
+}
+
+bool Stream::findUntil(const char* target, const char* terminator) {
+  const size_t targetLen = strlen(target);
+  const size_t termLen = terminator ? strlen(terminator) : 0;
+  size_t index = 0;
+  size_t termIndex = 0;
+  if (targetLen == 0) return true;
+  for (;;) {
+    const int c = timedRead();
+    if (c < 0) return false;
+    if (c == target[index]) {
+      if (++index >= targetLen) return true;
+    } else {
+      index = (c == target[0]) ? 1 : 0;
+    }
+    if (termLen > 0 && c == terminator[termIndex]) {
+      if (++termIndex >= termLen) return false;
+    } else {
+      termIndex = 0;
+    }
+  }
+}
+
+long Stream::parseInt() {
+  bool isNegative = false;
+  long value = 0;
+  int c = peekNextDigit();
+  if (c < 0) return 0;
+  do {
+    if (c == '-') isNegative = true;
+    else if (c >= '0' && c <= '9') value = value * 10 + c - '0';
+    read();
+    c = timedPeek();
+  } while ((c >= '0' && c <= '9'));
+  return isNegative ? -value : value;
+}
+
+float Stream::parseFloat() {
+  String s;
+  int c = peekNextDigit();
+  if (c < 0) return 0;
+  do {
+    s += static_cast<char>(c);
+    read();
+    c = timedPeek();
+  } while ((c >= '0' && c <= '9') || c == '.');
+  return s.toFloat();
+}
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    const int c = timedRead();
+    if (c < 0) break;
+    *buffer++ = static_cast<char>(c);
+    count++;
+  }
+  return count;
+}
+
+size_t Stream::readBytesUntil(char terminator, char* buffer, size_t length) {
+  size_t index = 0;
+  while (index < length) {
+    const int c = timedRead();
+    if (c < 0 || c == terminator) break;
+    *buffer++ = static_cast<char>(c);
+    index++;
+  }
+  return index;
+}
+
+String Stream::readString() {
+  String ret;
+  int c = timedRead();
+  while (c >= 0) {
+    ret += static_cast<char>(c);
+    c = timedRead();
+  }
+  return ret;
+}
+
+String Stream::readStringUntil(char terminator) {
+  String ret;
+  int c = timedRead();
+  while (c >= 0 && c != terminator) {
+    ret += static_cast<char>(c);
+    c = timedRead();
+  }
+  return ret;
+}
+
+/* Ports série */
+
+int HardwareSerial::available() {
+  return fCible ? fCible->available() : 0;
+}
+
+int HardwareSerial::read() {
+  return fCible ? fCible->read() : -1;
+}
+
+int HardwareSerial::peek() {
+  return fCible ? fCible->peek() : -1;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  if (fCible) return fCible->write(buffer, size);
+  if (fConsole && hote::journal) fwrite(buffer, 1, size, stdout);
+  return size;
+}
+
+void HardwareSerial::flush() {
+  if (fCible) fCible->flush();
+}
+
+SERCOM sercom3;
+HardwareSerial Serial;
+Uart Serial1(&sercom3, 0, 1, SERCOM_RX_PAD_1, UART_TX_PAD_0);
+
+namespace {
+  struct Console {
+    Console() {
+      Serial.console(true);
+    }
+  } console;
+}
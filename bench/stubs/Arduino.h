@@ -0,0 +1,424 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   Arduino.h
+   Purpose: Host stand-in of the Arduino SAMD core for the bench : virtual clock, pins, String, Print & Stream.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <ctype.h>
+#include <algorithm>
+
+// Comme le cœur SAMD : min et max exigent deux arguments du même type.
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 2
+#define RISING 3
+#define FALLING 4
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define A1 16
+#define ADC_BATTERY 32
+#define SDCARD_SS_PIN 28
+#define USB_PRODUCT "Banc"
+#define PIO_SERCOM 2
+#define SERCOM_RX_PAD_1 1
+#define UART_TX_PAD_0 0
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define PGM_P const char*
+#define strcmp_P strcmp
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define memcpy_P memcpy
+#define pgm_read_byte(p) (*reinterpret_cast<const uint8_t*>(p))
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(PSTR(s)))
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// Horloge virtuelle (voir hote.h) : chaque appel à millis() ou micros() avance le temps de hote::pas µs,
+// ce qui termine les attentes actives ; delay() avance du temps demandé.
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// Broches : états mémorisés, observables par les stand-ins des périphériques (voir hote.h)
+void pinMode(uint32_t pin, uint32_t mode);
+void digitalWrite(uint32_t pin, uint32_t value);
+int digitalRead(uint32_t pin);
+unsigned long pulseIn(uint32_t pin, uint32_t state, unsigned long timeout = 1000000L);
+int analogRead(uint32_t pin);
+void analogReadResolution(int bits);
+void attachInterrupt(uint32_t pin, void (*callback)(), uint32_t mode);
+int digitalPinToInterrupt(uint32_t pin);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+/// Lève hote::Reset : le banc reprend la main comme au redémarrage du processeur.
+void NVIC_SystemReset();
+
+/**
+   Chaîne de caractères du cœur Arduino (WString) : même tampon exact réalloué à chaque agrandissement,
+   afin que les allocations comptées sur le poste soient celles du boîtier.
+*/
+class String {
+
+    typedef void (String::*StringIfHelperType)() const;
+    void StringIfHelper() const {}
+
+  public:
+    String(const char* cstr = "");
+    String(const String& str);
+    String(String&& rval);
+    String(const __FlashStringHelper* str);
+    explicit String(char c);
+    explicit String(unsigned char value, unsigned char base = 10);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(float value, unsigned char decimalPlaces = 2);
+    explicit String(double value, unsigned char decimalPlaces = 2);
+    ~String();
+
+    String& operator=(const String& rhs);
+    String& operator=(const char* cstr);
+    String& operator=(const __FlashStringHelper* str);
+    String& operator=(String&& rval);
+
+    bool reserve(unsigned int size);
+    unsigned int length() const {
+      return len;
+    }
+    operator StringIfHelperType() const {
+      return buffer ? &String::StringIfHelper : 0;
+    }
+
+    bool concat(const String& str);
+    bool concat(const char* cstr);
+    bool concat(const char* cstr, unsigned int length);
+    bool concat(char c);
+    bool concat(unsigned char num);
+    bool concat(int num);
+    bool concat(unsigned int num);
+    bool concat(long num);
+    bool concat(unsigned long num);
+    bool concat(float num);
+    bool concat(double num);
+    bool concat(const __FlashStringHelper* str);
+
+    template<typename T>
+    String& operator+=(const T& rhs) {
+      concat(rhs);
+      return *this;
+    }
+    String& operator+=(const char* cstr) {
+      concat(cstr);
+      return *this;
+    }
+
+    int compareTo(const String& s) const;
+    bool equals(const String& s) const;
+    bool equals(const char* cstr) const;
+    bool equalsIgnoreCase(const String& s) const;
+    bool operator==(const String& rhs) const {
+      return equals(rhs);
+    }
+    bool operator==(const char* cstr) const {
+      return equals(cstr);
+    }
+    bool operator!=(const String& rhs) const {
+      return !equals(rhs);
+    }
+    bool operator!=(const char* cstr) const {
+      return !equals(cstr);
+    }
+    bool operator<(const String& rhs) const {
+      return compareTo(rhs) < 0;
+    }
+    bool startsWith(const String& prefix) const;
+    bool startsWith(const String& prefix, unsigned int offset) const;
+    bool endsWith(const String& suffix) const;
+
+    char charAt(unsigned int index) const;
+    void setCharAt(unsigned int index, char c);
+    char operator[](unsigned int index) const;
+    char& operator[](unsigned int index);
+    void getBytes(unsigned char* buf, unsigned int bufsize, unsigned int index = 0) const;
+    void toCharArray(char* buf, unsigned int bufsize, unsigned int index = 0) const {
+      getBytes(reinterpret_cast<unsigned char*>(buf), bufsize, index);
+    }
+    const char* c_str() const {
+      return buffer;
+    }
+
+    int indexOf(char ch) const;
+    int indexOf(char ch, unsigned int fromIndex) const;
+    int indexOf(const String& str) const;
+    int indexOf(const String& str, unsigned int fromIndex) const;
+    int lastIndexOf(char ch) const;
+    int lastIndexOf(char ch, unsigned int fromIndex) const;
+    int lastIndexOf(const String& str) const;
+    int lastIndexOf(const String& str, unsigned int fromIndex) const;
+    String substring(unsigned int beginIndex) const {
+      return substring(beginIndex, len);
+    }
+    String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+    void replace(char find, char replace);
+    void replace(const String& find, const String& replace);
+    void remove(unsigned int index);
+    void remove(unsigned int index, unsigned int count);
+    void toLowerCase();
+    void toUpperCase();
+    void trim();
+
+    long toInt() const;
+    float toFloat() const;
+    double toDouble() const;
+
+  protected:
+    void init();
+    void invalidate();
+    bool changeBuffer(unsigned int maxStrLen);
+    String& copy(const char* cstr, unsigned int length);
+    void move(String& rhs);
+
+    char* buffer;
+    unsigned int capacity;
+    unsigned int len;
+};
+
+/**
+   Concaténation en chaîne du cœur Arduino : a + b + c ajoute b puis c à une seule copie de a.
+*/
+class StringSumHelper : public String {
+
+  public:
+    StringSumHelper(const String& s) : String(s) {}
+    StringSumHelper(const char* p) : String(p) {}
+    StringSumHelper(char c) : String(c) {}
+    StringSumHelper(unsigned char num) : String(num) {}
+    StringSumHelper(int num) : String(num) {}
+    StringSumHelper(unsigned int num) : String(num) {}
+    StringSumHelper(long num) : String(num) {}
+    StringSumHelper(unsigned long num) : String(num) {}
+};
+
+StringSumHelper& operator+(const StringSumHelper& lhs, const String& rhs);
+StringSumHelper& operator+(const StringSumHelper& lhs, const char* cstr);
+StringSumHelper& operator+(const StringSumHelper& lhs, char c);
+StringSumHelper& operator+(const StringSumHelper& lhs, unsigned char num);
+StringSumHelper& operator+(const StringSumHelper& lhs, int num);
+StringSumHelper& operator+(const StringSumHelper& lhs, unsigned int num);
+StringSumHelper& operator+(const StringSumHelper& lhs, long num);
+StringSumHelper& operator+(const StringSumHelper& lhs, unsigned long num);
+StringSumHelper& operator+(const StringSumHelper& lhs, const __FlashStringHelper* rhs);
+
+/**
+   Sortie formatée du cœur Arduino.
+*/
+class Print {
+
+  public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* str) {
+      return str ? write(reinterpret_cast<const uint8_t*>(str), strlen(str)) : 0;
+    }
+    size_t write(const char* buffer, size_t size) {
+      return write(reinterpret_cast<const uint8_t*>(buffer), size);
+    }
+    virtual int availableForWrite() {
+      return 0;
+    }
+
+    size_t print(const __FlashStringHelper* s);
+    size_t print(const String& s);
+    size_t print(const char s[]);
+    size_t print(char c);
+    size_t print(unsigned char n, int base = DEC);
+    size_t print(int n, int base = DEC);
+    size_t print(unsigned int n, int base = DEC);
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+
+    size_t println(const __FlashStringHelper* s);
+    size_t println(const String& s);
+    size_t println(const char s[]);
+    size_t println(char c);
+    size_t println(unsigned char n, int base = DEC);
+    size_t println(int n, int base = DEC);
+    size_t println(unsigned int n, int base = DEC);
+    size_t println(long n, int base = DEC);
+    size_t println(unsigned long n, int base = DEC);
+    size_t println(double n, int digits = 2);
+    size_t println();
+
+    virtual void flush() {}
+
+  private:
+    size_t printNumber(unsigned long n, uint8_t base);
+    size_t printFloat(double number, uint8_t digits);
+};
+
+/**
+   Flux d'entrée du cœur Arduino, lectures bornées par setTimeout() sur l'horloge virtuelle.
+*/
+class Stream : public Print {
+
+  public:
+    Stream() :
+      _timeout(1000),
+      _startMillis(0)
+    {}
+
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long timeout) {
+      _timeout = timeout;
+    }
+    unsigned long getTimeout() const {
+      return _timeout;
+    }
+
+    bool find(const char* target);
+    bool find(const char* target, size_t length);
+    bool findUntil(const char* target, const char* terminator);
+    long parseInt();
+    float parseFloat();
+    size_t readBytes(char* buffer, size_t length);
+    size_t readBytes(uint8_t* buffer, size_t length) {
+      return readBytes(reinterpret_cast<char*>(buffer), length);
+    }
+    size_t readBytesUntil(char terminator, char* buffer, size_t length);
+    String readString();
+    String readStringUntil(char terminator);
+
+  protected:
+    int timedRead();
+    int timedPeek();
+    int peekNextDigit();
+
+    unsigned long _timeout;
+    unsigned long _startMillis;
+};
+
+/**
+   Port série : Serial écrit sur la sortie standard si hote::journal est vrai, Serial1 est relié au modem
+   simulé par brancher().
+*/
+class HardwareSerial : public Stream {
+
+  public:
+    HardwareSerial() :
+      fCible(NULL),
+      fConsole(false),
+      fBaud(0)
+    {}
+
+    void begin(unsigned long baud) {
+      fBaud = baud;
+    }
+    void begin(unsigned long baud, uint16_t) {
+      fBaud = baud;
+    }
+    void end() {}
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    void flush() override;
+    operator bool() const {
+      return true;
+    }
+
+    /**
+       Relie le port à un flux : les octets écrits y sont transmis et les octets lus en viennent.
+    */
+    void brancher(Stream* aCible) {
+      fCible = aCible;
+    }
+
+    /**
+       Fait du port la console du banc.
+    */
+    void console(const bool aConsole) {
+      fConsole = aConsole;
+    }
+
+    unsigned long baud() const {
+      return fBaud;
+    }
+
+  private:
+    Stream* fCible;
+    bool fConsole;
+    unsigned long fBaud;
+};
+
+struct SERCOM {};
+extern SERCOM sercom3;
+
+class Uart : public HardwareSerial {
+
+  public:
+    Uart(SERCOM*, uint8_t, uint8_t, int, int) {}
+    void IrqHandler() {}
+};
+
+int pinPeripheral(uint32_t pin, int type);
+
+extern HardwareSerial Serial;
+extern Uart Serial1;
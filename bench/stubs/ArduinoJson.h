@@ -0,0 +1,522 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   ArduinoJson.h
+   Purpose: Host stand-in of ArduinoJson 5.13 : the parsing subset used by the firmware.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <new>
+#include <type_traits>
+
+/**
+   Reproduit ce qui coûte sur le boîtier dans ArduinoJson 5 : l'arène de blocs malloc() qui doublent,
+   la copie de l'entrée constante dans l'arène, l'analyse sur place (chaînes déséchappées dans la copie)
+   et les nombres conservés en texte, convertis seulement à la lecture par as<T>().
+*/
+class JsonObject;
+class JsonArray;
+class DynamicJsonBuffer;
+
+class JsonVariant {
+
+  public:
+    enum type_t : uint8_t { INDEFINI, TEXTE, CHAINE, OBJET, TABLEAU };
+
+    JsonVariant() :
+      fType(INDEFINI),
+      fTexte(NULL)
+    {}
+
+    template<typename T>
+    struct As {
+      typedef T type;
+      static T lire(const JsonVariant& v) {
+        return v.nombre<T>(typename std::is_floating_point<T>::type());
+      }
+    };
+
+    template<typename T>
+    typename As<T>::type as() const {
+      return As<T>::lire(*this);
+    }
+
+    template<typename T>
+    operator T() const {
+      return as<T>();
+    }
+
+    operator JsonObject&() const;
+    operator JsonArray&() const;
+
+    bool success() const {
+      return fType != INDEFINI;
+    }
+
+    JsonVariant operator[](const char* key) const;
+    JsonVariant operator[](size_t index) const;
+    JsonVariant operator[](int index) const {
+      return (*this)[static_cast<size_t>(index)];
+    }
+
+    type_t fType;
+    union {
+      const char* fTexte;
+      JsonObject* fObjet;
+      JsonArray* fTableau;
+    };
+
+  private:
+    template<typename T>
+    T nombre(std::false_type) const {   // parseInteger() d'ArduinoJson 5
+      if ((fType != TEXTE && fType != CHAINE) || !fTexte) return 0;
+      const char* s = fTexte;
+      if (*s == 't') return 1;   // true
+      bool negatif = false;
+      if (*s == '-') {
+        negatif = true;
+        ++s;
+      } else if (*s == '+') {
+        ++s;
+      }
+      T r = 0;
+      while (isdigit(*s)) r = T(r * 10 + T(*s++ - '0'));
+      return negatif ? T(~r + 1) : r;
+    }
+
+    template<typename T>
+    T nombre(std::true_type) const {    // parseFloat() d'ArduinoJson 5
+      if ((fType != TEXTE && fType != CHAINE) || !fTexte) return 0;
+      if (*fTexte == 't') return 1;   // true
+      return T(strtod(fTexte, NULL));
+    }
+};
+
+template<>
+struct JsonVariant::As<bool> {
+  typedef bool type;
+  static bool lire(const JsonVariant& v) {
+    return v.as<long>() != 0;
+  }
+};
+
+template<>
+struct JsonVariant::As<const char*> {
+  typedef const char* type;
+  static const char* lire(const JsonVariant& v) {
+    return (v.fType == TEXTE || v.fType == CHAINE) ? v.fTexte : NULL;
+  }
+};
+
+template<>
+struct JsonVariant::As<String> {
+  typedef String type;
+  static String lire(const JsonVariant& v) {
+    return String(v.as<const char*>() ? v.fTexte : "");
+  }
+};
+
+template<>
+struct JsonVariant::As<JsonObject> {
+  typedef JsonObject& type;
+  static JsonObject& lire(const JsonVariant& v);
+};
+template<> struct JsonVariant::As<JsonObject&> : JsonVariant::As<JsonObject> {};
+template<> struct JsonVariant::As<const JsonObject&> : JsonVariant::As<JsonObject> {};
+
+template<>
+struct JsonVariant::As<JsonArray> {
+  typedef JsonArray& type;
+  static JsonArray& lire(const JsonVariant& v);
+};
+template<> struct JsonVariant::As<JsonArray&> : JsonVariant::As<JsonArray> {};
+template<> struct JsonVariant::As<const JsonArray&> : JsonVariant::As<JsonArray> {};
+
+/**
+   Objet : liste chaînée de nœuds dans l'arène.
+*/
+class JsonObject {
+
+  public:
+    struct node_type {
+      const char* key;
+      JsonVariant value;
+      node_type* next;
+    };
+
+    explicit JsonObject(DynamicJsonBuffer* aBuffer) :
+      fBuffer(aBuffer),
+      fPremier(NULL)
+    {}
+
+    static JsonObject& invalid() {
+      static JsonObject objet(NULL);
+      return objet;
+    }
+
+    bool success() const {
+      return fBuffer != NULL;
+    }
+
+    bool containsKey(const char* key) const {
+      return trouver(key) != NULL;
+    }
+
+    JsonVariant operator[](const char* key) const {
+      const node_type* n = trouver(key);
+      return n ? n->value : JsonVariant();
+    }
+
+    template<typename T>
+    typename JsonVariant::As<T>::type get(const char* key) const {
+      return (*this)[key].as<T>();
+    }
+
+    size_t size() const {
+      size_t n = 0;
+      for (const node_type* p = fPremier; p; p = p->next) ++n;
+      return n;
+    }
+
+    bool ajouter(const char* key, const JsonVariant& value);
+
+  private:
+    const node_type* trouver(const char* key) const {
+      for (const node_type* p = fPremier; p; p = p->next) {
+        if (!strcmp(p->key, key)) return p;
+      }
+      return NULL;
+    }
+
+    JsonObject(const JsonObject&);
+
+    DynamicJsonBuffer* fBuffer;
+    node_type* fPremier;
+};
+
+/**
+   Tableau : liste chaînée de nœuds dans l'arène.
+*/
+class JsonArray {
+
+  public:
+    struct node_type {
+      JsonVariant value;
+      node_type* next;
+    };
+
+    explicit JsonArray(DynamicJsonBuffer* aBuffer) :
+      fBuffer(aBuffer),
+      fPremier(NULL)
+    {}
+
+    static JsonArray& invalid() {
+      static JsonArray tableau(NULL);
+      return tableau;
+    }
+
+    bool success() const {
+      return fBuffer != NULL;
+    }
+
+    size_t size() const {
+      size_t n = 0;
+      for (const node_type* p = fPremier; p; p = p->next) ++n;
+      return n;
+    }
+
+    JsonVariant operator[](size_t index) const {
+      const node_type* p = fPremier;
+      while (p && index--) p = p->next;
+      return p ? p->value : JsonVariant();
+    }
+
+    bool ajouter(const JsonVariant& value);
+
+  private:
+    JsonArray(const JsonArray&);
+
+    DynamicJsonBuffer* fBuffer;
+    node_type* fPremier;
+};
+
+#define JSON_OBJECT_SIZE(NUMBER_OF_ELEMENTS) (sizeof(JsonObject) + (NUMBER_OF_ELEMENTS) * sizeof(JsonObject::node_type))
+#define JSON_ARRAY_SIZE(NUMBER_OF_ELEMENTS) (sizeof(JsonArray) + (NUMBER_OF_ELEMENTS) * sizeof(JsonArray::node_type))
+
+/**
+   Arène : blocs alloués à la demande, le premier de la taille indiquée, chaque suivant deux fois plus grand.
+*/
+class DynamicJsonBuffer {
+
+  public:
+    DynamicJsonBuffer(size_t initialSize = 256) :
+      fTete(NULL),
+      fProchaine(initialSize)
+    {}
+
+    ~DynamicJsonBuffer() {
+      while (fTete) {
+        bloc_t* suivant = fTete->suivant;
+        free(fTete);
+        fTete = suivant;
+      }
+    }
+
+    void* alloc(size_t bytes) {
+      bytes = (bytes + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+      if (!fTete || (fTete->taille + bytes > fTete->capacite)) {
+        const size_t capacite = max(fProchaine, bytes);
+        bloc_t* b = static_cast<bloc_t*>(malloc(sizeof(bloc_t) + capacite));
+        if (!b) return NULL;
+        b->suivant = fTete;
+        b->capacite = capacite;
+        b->taille = 0;
+        fTete = b;
+        fProchaine *= 2;
+      }
+      void* p = reinterpret_cast<uint8_t*>(fTete + 1) + fTete->taille;
+      fTete->taille += bytes;
+      return p;
+    }
+
+    size_t size() const {
+      size_t n = 0;
+      for (const bloc_t* b = fTete; b; b = b->suivant) n += b->taille;
+      return n;
+    }
+
+    JsonObject& parseObject(char* json, uint8_t nestingLimit = 10) {
+      JsonVariant v;
+      return (json && valeur(json, v, nestingLimit) && (v.fType == JsonVariant::OBJET)) ? *v.fObjet : JsonObject::invalid();
+    }
+
+    JsonObject& parseObject(const char* json, uint8_t nestingLimit = 10) {
+      return parseObject(dupliquer(json), nestingLimit);
+    }
+
+    JsonObject& parseObject(const String& json, uint8_t nestingLimit = 10) {
+      return parseObject(json.c_str(), nestingLimit);
+    }
+
+    JsonArray& parseArray(char* json, uint8_t nestingLimit = 10) {
+      JsonVariant v;
+      return (json && valeur(json, v, nestingLimit) && (v.fType == JsonVariant::TABLEAU)) ? *v.fTableau : JsonArray::invalid();
+    }
+
+    JsonArray& parseArray(const char* json, uint8_t nestingLimit = 10) {
+      return parseArray(dupliquer(json), nestingLimit);
+    }
+
+    JsonArray& parseArray(const String& json, uint8_t nestingLimit = 10) {
+      return parseArray(json.c_str(), nestingLimit);
+    }
+
+  private:
+    struct bloc_t {
+      bloc_t* suivant;
+      size_t capacite;
+      size_t taille;
+    };
+
+    bloc_t* fTete;        ///< Bloc en cours de remplissage, suivi des précédents.
+    size_t fProchaine;    ///< Capacité du prochain bloc.
+
+    char* dupliquer(const char* s) {
+      if (!s) return NULL;
+      const size_t n = strlen(s) + 1;
+      char* d = static_cast<char*>(alloc(n));
+      if (d) memcpy(d, s, n);
+      return d;
+    }
+
+    static void blancs(char*& p) {
+      for (;;) {
+        while (isspace(*p)) ++p;
+        if (p[0] == '/' && p[1] == '*') {
+          p += 2;
+          while (*p && !(p[0] == '*' && p[1] == '/')) ++p;
+          if (*p) p += 2;
+        } else if (p[0] == '/' && p[1] == '/') {
+          while (*p && *p != '\n') ++p;
+        } else {
+          return;
+        }
+      }
+    }
+
+    static bool separateur(const char c) {
+      return !c || strchr(" \t\r\n,:]}", c);
+    }
+
+    /**
+       Lit une chaîne sur place. Entre guillemets, elle est déséchappée à partir du guillemet ouvrant ;
+       nue, elle est décalée d'un caractère vers la gauche sur le caractère qui la précède, déjà lu,
+       pour la terminer sans écraser le séparateur qui la suit.
+    */
+    static const char* chaine(char*& p) {
+      char* const debut = p;
+      char* d = p;
+      const char guillemet = *p;
+      if (guillemet != '"' && guillemet != '\'') {
+        while (!separateur(*p)) ++p;
+        if (p == debut) return NULL;
+        memmove(debut - 1, debut, p - debut);
+        p[-1] = '\0';
+        return debut - 1;
+      }
+      ++p;
+      while (*p && *p != guillemet) {
+        char c = *p++;
+        if (c == '\\' && *p) {
+          c = *p++;
+          switch (c) {
+            case 'b' : c = '\b'; break;
+            case 'f' : c = '\f'; break;
+            case 'n' : c = '\n'; break;
+            case 'r' : c = '\r'; break;
+            case 't' : c = '\t'; break;
+          }
+        }
+        *d++ = c;
+      }
+      if (*p != guillemet) return NULL;
+      ++p;
+      *d = '\0';
+      return debut;
+    }
+
+    bool valeur(char*& p, JsonVariant& v, const uint8_t profondeur);
+};
+
+inline bool JsonObject::ajouter(const char* key, const JsonVariant& value) {
+  void* m = fBuffer->alloc(sizeof(node_type));
+  if (!m) return false;
+  node_type* n = new (m) node_type();
+  n->key = key;
+  n->value = value;
+  node_type** fin = &fPremier;
+  while (*fin) fin = &(*fin)->next;
+  *fin = n;
+  return true;
+}
+
+inline bool JsonArray::ajouter(const JsonVariant& value) {
+  void* m = fBuffer->alloc(sizeof(node_type));
+  if (!m) return false;
+  node_type* n = new (m) node_type();
+  n->value = value;
+  node_type** fin = &fPremier;
+  while (*fin) fin = &(*fin)->next;
+  *fin = n;
+  return true;
+}
+
+inline bool DynamicJsonBuffer::valeur(char*& p, JsonVariant& v, const uint8_t profondeur) {
+  blancs(p);
+  if (*p == '{') {
+    if (!profondeur) return false;
+    ++p;
+    void* m = alloc(sizeof(JsonObject));
+    if (!m) return false;
+    JsonObject* o = new (m) JsonObject(this);
+    blancs(p);
+    if (*p == '}') {
+      ++p;
+    } else {
+      for (;;) {
+        blancs(p);
+        const char* cle = chaine(p);
+        if (!cle) return false;
+        blancs(p);
+        if (*p++ != ':') return false;
+        JsonVariant e;
+        if (!valeur(p, e, profondeur - 1) || !o->ajouter(cle, e)) return false;
+        blancs(p);
+        if (*p == ',') {
+          ++p;
+          continue;
+        }
+        if (*p++ != '}') return false;
+        break;
+      }
+    }
+    v.fType = JsonVariant::OBJET;
+    v.fObjet = o;
+    return true;
+  }
+  if (*p == '[') {
+    if (!profondeur) return false;
+    ++p;
+    void* m = alloc(sizeof(JsonArray));
+    if (!m) return false;
+    JsonArray* a = new (m) JsonArray(this);
+    blancs(p);
+    if (*p == ']') {
+      ++p;
+    } else {
+      for (;;) {
+        JsonVariant e;
+        if (!valeur(p, e, profondeur - 1) || !a->ajouter(e)) return false;
+        blancs(p);
+        if (*p == ',') {
+          ++p;
+          continue;
+        }
+        if (*p++ != ']') return false;
+        break;
+      }
+    }
+    v.fType = JsonVariant::TABLEAU;
+    v.fTableau = a;
+    return true;
+  }
+  const bool guillemets = (*p == '"' || *p == '\'');
+  const char* s = chaine(p);
+  if (!s) return false;
+  v.fType = guillemets ? JsonVariant::CHAINE : JsonVariant::TEXTE;
+  v.fTexte = s;
+  return true;
+}
+
+inline JsonVariant::operator JsonObject&() const {
+  return as<JsonObject&>();
+}
+
+inline JsonVariant::operator JsonArray&() const {
+  return as<JsonArray&>();
+}
+
+inline JsonObject& JsonVariant::As<JsonObject>::lire(const JsonVariant& v) {
+  return (v.fType == OBJET) ? *v.fObjet : JsonObject::invalid();
+}
+
+inline JsonArray& JsonVariant::As<JsonArray>::lire(const JsonVariant& v) {
+  return (v.fType == TABLEAU) ? *v.fTableau : JsonArray::invalid();
+}
+
+inline JsonVariant JsonVariant::operator[](const char* key) const {
+  return as<JsonObject&>()[key];
+}
+
+inline JsonVariant JsonVariant::operator[](size_t index) const {
+  return as<JsonArray&>()[index];
+}
@@ -0,0 +1,57 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   FlashStorage.h
+   Purpose: Host stand-in of the FlashStorage library : a RAM copy that survives hote::Reset.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include "hote.h"
+
+/**
+   Page de flash réservée à une valeur : effacée (0xFF) au lancement, conservée à travers les resets
+   du firmware ; les écritures sont comptées dans hote::ecrituresFlash.
+*/
+template<class T>
+class FlashStorageClass {
+
+  public:
+    FlashStorageClass() {
+      memset(fPage, 0xff, sizeof(fPage));
+    }
+
+    void write(T data) {
+      memcpy(fPage, &data, sizeof(T));
+      ++hote::ecrituresFlash;
+    }
+
+    T read() {
+      T data;
+      memcpy(&data, fPage, sizeof(T));
+      return data;
+    }
+
+  private:
+    uint8_t fPage[sizeof(T)];
+};
+
+#define FlashStorage(name, T) FlashStorageClass<T> name
@@ -0,0 +1,265 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   RTCZero.cpp
+   Purpose: Host stand-in of the RTCZero library, driven by the virtual clock.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#include <RTCZero.h>
+#include "hote.h"
+
+#include <time.h>
+
+namespace {
+  const uint32_t Y2K = 946684800UL;   // 2000-01-01T00:00:00Z
+
+  uint32_t base = Y2K;      // heure au temps virtuel ref
+  uint64_t ref = 0;
+  struct tm alarme = {};    // champs comparés selon le mode
+  RTCZero::Alarm_Match mode = RTCZero::MATCH_OFF;
+  RTCZero::voidFuncPtr rappel = NULL;
+  bool configuree = false;  // comme sur le SAMD, l'heure survit à un reset logiciel
+
+  uint32_t maintenant() {
+    return base + (hote::us - ref) / 1000000ULL;
+  }
+
+  void regler(const uint32_t epoch) {
+    base = epoch;
+    ref = hote::us;
+  }
+
+  struct tm date() {
+    const time_t t = maintenant();
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    return tm;
+  }
+
+  void reglerDate(const struct tm& d) {
+    struct tm tm = d;
+    regler(timegm(&tm));
+  }
+
+  bool correspond(const uint32_t epoch) {
+    const time_t t = epoch;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    switch (mode) {
+      case RTCZero::MATCH_YYMMDDHHMMSS : if (tm.tm_year % 100 != alarme.tm_year % 100) return false;  // fall through
+      case RTCZero::MATCH_MMDDHHMMSS : if (tm.tm_mon != alarme.tm_mon) return false;  // fall through
+      case RTCZero::MATCH_DHHMMSS : if (tm.tm_mday != alarme.tm_mday) return false;  // fall through
+      case RTCZero::MATCH_HHMMSS : if (tm.tm_hour != alarme.tm_hour) return false;  // fall through
+      case RTCZero::MATCH_MMSS : if (tm.tm_min != alarme.tm_min) return false;  // fall through
+      case RTCZero::MATCH_SS : return tm.tm_sec == alarme.tm_sec;
+      default : return false;
+    }
+  }
+
+  /**
+     Prochaine seconde après epoch où l'alarme correspond, 0 si aucune dans les cent ans.
+  */
+  uint32_t prochaine(const uint32_t epoch) {
+    uint32_t pas = 1;
+    uint32_t t = epoch + 1;
+    switch (mode) {
+      case RTCZero::MATCH_OFF : return 0;
+      case RTCZero::MATCH_SS : return t + (alarme.tm_sec - static_cast<int>(t % 60) + 60) % 60;
+      case RTCZero::MATCH_MMSS : return t + (alarme.tm_min * 60 + alarme.tm_sec - static_cast<int>(t % 3600) + 3600) % 3600;
+      default :     // jour par jour à l'heure de l'alarme
+        t += (alarme.tm_hour * 3600 + alarme.tm_min * 60 + alarme.tm_sec - static_cast<int>(t % 86400) + 86400) % 86400;
+        pas = 86400;
+    }
+    for (unsigned i = 0; i < 100 * 366; ++i, t += pas) {
+      if (correspond(t)) return t;
+    }
+    return 0;
+  }
+}
+
+/*
+   Comme sur le SAMD21, l'interruption d'alarme est levée au front suivant du compteur, une seconde après
+   la correspondance : l'alarme de la seconde 59 réveille le firmware à la seconde 0 de la minute suivante.
+*/
+bool hote::attendreAlarme() {
+  const uint32_t t = prochaine(maintenant() - 1);
+  if (!t) return false;
+  hote::us = ref + uint64_t(t + 1 - base) * 1000000ULL;
+  if (rappel) rappel();
+  return true;
+}
+
+void RTCZero::begin(bool resetTime) {
+  if (resetTime || !configuree) regler(Y2K);
+  configuree = true;
+}
+
+void RTCZero::enableAlarm(Alarm_Match match) {
+  mode = match;
+}
+
+void RTCZero::disableAlarm() {
+  mode = MATCH_OFF;
+}
+
+void RTCZero::attachInterrupt(voidFuncPtr callback) {
+  rappel = callback;
+}
+
+void RTCZero::detachInterrupt() {
+  rappel = NULL;
+}
+
+void RTCZero::standbyMode() {
+  hote::attendreAlarme();
+}
+
+uint8_t RTCZero::getSeconds() {
+  return date().tm_sec;
+}
+
+uint8_t RTCZero::getMinutes() {
+  return date().tm_min;
+}
+
+uint8_t RTCZero::getHours() {
+  return date().tm_hour;
+}
+
+uint8_t RTCZero::getDay() {
+  return date().tm_mday;
+}
+
+uint8_t RTCZero::getMonth() {
+  return date().tm_mon + 1;
+}
+
+uint8_t RTCZero::getYear() {
+  return date().tm_year - 100;
+}
+
+void RTCZero::setSeconds(uint8_t seconds) {
+  struct tm d = date();
+  d.tm_sec = seconds;
+  reglerDate(d);
+}
+
+void RTCZero::setMinutes(uint8_t minutes) {
+  struct tm d = date();
+  d.tm_min = minutes;
+  reglerDate(d);
+}
+
+void RTCZero::setHours(uint8_t hours) {
+  struct tm d = date();
+  d.tm_hour = hours;
+  reglerDate(d);
+}
+
+void RTCZero::setTime(uint8_t hours, uint8_t minutes, uint8_t seconds) {
+  struct tm d = date();
+  d.tm_hour = hours;
+  d.tm_min = minutes;
+  d.tm_sec = seconds;
+  reglerDate(d);
+}
+
+void RTCZero::setDay(uint8_t day) {
+  struct tm d = date();
+  d.tm_mday = day;
+  reglerDate(d);
+}
+
+void RTCZero::setMonth(uint8_t month) {
+  struct tm d = date();
+  d.tm_mon = month - 1;
+  reglerDate(d);
+}
+
+void RTCZero::setYear(uint8_t year) {
+  struct tm d = date();
+  d.tm_year = year + 100;
+  reglerDate(d);
+}
+
+void RTCZero::setDate(uint8_t day, uint8_t month, uint8_t year) {
+  struct tm d = date();
+  d.tm_mday = day;
+  d.tm_mon = month - 1;
+  d.tm_year = year + 100;
+  reglerDate(d);
+}
+
+void RTCZero::setAlarmSeconds(uint8_t seconds) {
+  alarme.tm_sec = seconds;
+}
+
+void RTCZero::setAlarmMinutes(uint8_t minutes) {
+  alarme.tm_min = minutes;
+}
+
+void RTCZero::setAlarmHours(uint8_t hours) {
+  alarme.tm_hour = hours;
+}
+
+void RTCZero::setAlarmTime(uint8_t hours, uint8_t minutes, uint8_t seconds) {
+  alarme.tm_hour = hours;
+  alarme.tm_min = minutes;
+  alarme.tm_sec = seconds;
+}
+
+void RTCZero::setAlarmDay(uint8_t day) {
+  alarme.tm_mday = day;
+}
+
+void RTCZero::setAlarmMonth(uint8_t month) {
+  alarme.tm_mon = month - 1;
+}
+
+void RTCZero::setAlarmYear(uint8_t year) {
+  alarme.tm_year = year + 100;
+}
+
+void RTCZero::setAlarmDate(uint8_t day, uint8_t month, uint8_t year) {
+  setAlarmDay(day);
+  setAlarmMonth(month);
+  setAlarmYear(year);
+}
+
+uint32_t RTCZero::getEpoch() {
+  return maintenant();
+}
+
+uint32_t RTCZero::getY2kEpoch() {
+  return maintenant() - Y2K;
+}
+
+void RTCZero::setEpoch(uint32_t ts) {
+  regler(ts);
+}
+
+void RTCZero::setY2kEpoch(uint32_t ts) {
+  regler(ts + Y2K);
+}
+
+void RTCZero::setAlarmEpoch(uint32_t ts) {
+  const time_t t = ts;
+  gmtime_r(&t, &alarme);
+}
@@ -0,0 +1,87 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   RTCZero.h
+   Purpose: Host stand-in of the RTCZero library, driven by the virtual clock.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+/**
+   Horloge temps réel du SAMD : l'heure suit le temps virtuel (voir hote.h), l'alarme est servie par
+   standbyMode() ou hote::attendreAlarme(). Comme sur le processeur, il n'y a qu'une horloge : toutes les
+   instances la partagent.
+*/
+class RTCZero {
+
+  public:
+    enum Alarm_Match : uint8_t {
+      MATCH_OFF,
+      MATCH_SS,
+      MATCH_MMSS,
+      MATCH_HHMMSS,
+      MATCH_DHHMMSS,
+      MATCH_MMDDHHMMSS,
+      MATCH_YYMMDDHHMMSS
+    };
+
+    typedef void (*voidFuncPtr)(void);
+
+    void begin(bool resetTime = false);
+
+    void enableAlarm(Alarm_Match match);
+    void disableAlarm();
+    void attachInterrupt(voidFuncPtr callback);
+    void detachInterrupt();
+    void standbyMode();
+
+    uint8_t getSeconds();
+    uint8_t getMinutes();
+    uint8_t getHours();
+    uint8_t getDay();
+    uint8_t getMonth();
+    uint8_t getYear();
+
+    void setSeconds(uint8_t seconds);
+    void setMinutes(uint8_t minutes);
+    void setHours(uint8_t hours);
+    void setTime(uint8_t hours, uint8_t minutes, uint8_t seconds);
+    void setDay(uint8_t day);
+    void setMonth(uint8_t month);
+    void setYear(uint8_t year);
+    void setDate(uint8_t day, uint8_t month, uint8_t year);
+
+    void setAlarmSeconds(uint8_t seconds);
+    void setAlarmMinutes(uint8_t minutes);
+    void setAlarmHours(uint8_t hours);
+    void setAlarmTime(uint8_t hours, uint8_t minutes, uint8_t seconds);
+    void setAlarmDay(uint8_t day);
+    void setAlarmMonth(uint8_t month);
+    void setAlarmYear(uint8_t year);
+    void setAlarmDate(uint8_t day, uint8_t month, uint8_t year);
+
+    uint32_t getEpoch();
+    uint32_t getY2kEpoch();
+    void setEpoch(uint32_t ts);
+    void setY2kEpoch(uint32_t ts);
+    void setAlarmEpoch(uint32_t ts);
+};
@@ -0,0 +1,162 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   SD.cpp
+   Purpose: Host stand-in of the SD library, backed by a directory of the host.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#include <SD.h>
+#include "hote.h"
+
+#include <sys/stat.h>
+
+namespace {
+  std::string repertoire;   // vide : pas de carte
+
+  struct etat_t {
+    FILE* f;
+    char nom[13];
+  };
+
+  etat_t* etat(void* p) {
+    return static_cast<etat_t*>(p);
+  }
+
+  std::string chemin(const char* filepath) {
+    return repertoire + '/' + filepath;
+  }
+}
+
+void hote::carteSD(const std::string& aRepertoire) {
+  repertoire = aRepertoire;
+  if (repertoire.length()) ::mkdir(repertoire.c_str(), 0755);
+}
+
+SDClass SD;
+
+bool SDClass::begin(uint8_t) {
+  struct stat st;
+  return repertoire.length() && !stat(repertoire.c_str(), &st) && S_ISDIR(st.st_mode);
+}
+
+File SDClass::open(const char* filepath, uint8_t mode) {
+  if (!repertoire.length()) return File();
+  const std::string c = chemin(filepath);
+  FILE* f;
+  if (mode == FILE_READ) {
+    f = fopen(c.c_str(), "rb");
+  } else {    // comme O_CREAT | O_APPEND : création, puis position en fin de fichier
+    f = fopen(c.c_str(), "r+b");
+    if (!f) f = fopen(c.c_str(), "w+b");
+    if (f) fseek(f, 0, SEEK_END);
+  }
+  if (!f) return File();
+  etat_t* e = static_cast<etat_t*>(malloc(sizeof(etat_t)));
+  e->f = f;
+  const char* base = strrchr(filepath, '/');
+  strncpy(e->nom, base ? base + 1 : filepath, sizeof(e->nom) - 1);
+  e->nom[sizeof(e->nom) - 1] = '\0';
+  return File(e);
+}
+
+bool SDClass::exists(const char* filepath) {
+  struct stat st;
+  return repertoire.length() && !stat(chemin(filepath).c_str(), &st);
+}
+
+bool SDClass::mkdir(const char* filepath) {
+  return repertoire.length() && !::mkdir(chemin(filepath).c_str(), 0755);
+}
+
+bool SDClass::remove(const char* filepath) {
+  return repertoire.length() && !::remove(chemin(filepath).c_str());
+}
+
+bool SDClass::rmdir(const char* filepath) {
+  return repertoire.length() && !::remove(chemin(filepath).c_str());
+}
+
+size_t File::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t File::write(const uint8_t* buf, size_t size) {
+  if (!fEtat) return 0;
+  return fwrite(buf, 1, size, etat(fEtat)->f);
+}
+
+int File::available() {
+  if (!fEtat) return 0;
+  const uint32_t n = size() - position();
+  return n > 0x7fff ? 0x7fff : n;   // comme la bibliothèque SD
+}
+
+int File::read() {
+  if (!fEtat) return -1;
+  return fgetc(etat(fEtat)->f);
+}
+
+int File::peek() {
+  if (!fEtat) return -1;
+  FILE* f = etat(fEtat)->f;
+  const int c = fgetc(f);
+  if (c != EOF) ungetc(c, f);
+  return c;
+}
+
+void File::flush() {
+  if (fEtat) fflush(etat(fEtat)->f);
+}
+
+int File::read(void* buf, uint16_t nbyte) {
+  if (!fEtat) return -1;
+  return fread(buf, 1, nbyte, etat(fEtat)->f);
+}
+
+bool File::seek(uint32_t pos) {
+  if (!fEtat || (pos > size())) return false;
+  return !fseek(etat(fEtat)->f, pos, SEEK_SET);
+}
+
+uint32_t File::position() {
+  if (!fEtat) return 0;
+  return ftell(etat(fEtat)->f);
+}
+
+uint32_t File::size() {
+  if (!fEtat) return 0;
+  FILE* f = etat(fEtat)->f;
+  const long p = ftell(f);
+  fseek(f, 0, SEEK_END);
+  const long n = ftell(f);
+  fseek(f, p, SEEK_SET);
+  return n;
+}
+
+void File::close() {
+  if (!fEtat) return;
+  fclose(etat(fEtat)->f);
+  free(fEtat);
+  fEtat = NULL;
+}
+
+const char* File::name() {
+  return fEtat ? etat(fEtat)->nom : "";
+}
@@ -0,0 +1,88 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   SD.h
+   Purpose: Host stand-in of the SD library, backed by a directory of the host (see hote::carteSD()).
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#define FILE_READ 0x01
+#define FILE_WRITE 0x13
+
+/**
+   Fichier ouvert : comme dans la bibliothèque SD, l'état est alloué dans le tas à l'ouverture et libéré par
+   close(), les copies d'un File partageant le même état.
+*/
+class File : public Stream {
+
+  public:
+    File() :
+      fEtat(NULL)
+    {}
+
+    File(void* aEtat) :
+      fEtat(aEtat)
+    {}
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buf, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int peek() override;
+    void flush() override;
+    int read(void* buf, uint16_t nbyte);
+    bool seek(uint32_t pos);
+    uint32_t position();
+    uint32_t size();
+    void close();
+    const char* name();
+    operator bool() {
+      return fEtat != NULL;
+    }
+
+  private:
+    void* fEtat;
+};
+
+class SDClass {
+
+  public:
+    bool begin(uint8_t csPin);
+    File open(const char* filepath, uint8_t mode = FILE_READ);
+    File open(const String& filepath, uint8_t mode = FILE_READ) {
+      return open(filepath.c_str(), mode);
+    }
+    bool exists(const char* filepath);
+    bool exists(const String& filepath) {
+      return exists(filepath.c_str());
+    }
+    bool mkdir(const char* filepath);
+    bool remove(const char* filepath);
+    bool remove(const String& filepath) {
+      return remove(filepath.c_str());
+    }
+    bool rmdir(const char* filepath);
+};
+
+extern SDClass SD;
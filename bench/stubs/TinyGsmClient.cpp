@@ -0,0 +1,462 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   TinyGsmClient.cpp
+   Purpose: Host stand-in of TinyGSM : the SIM800 driver, command for command.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#include <TinyGsmClient.h>
+
+TinyGsm::TinyGsm(Stream& aStream) :
+  stream(aStream),
+  sockets()
+{}
+
+bool TinyGsm::init() {
+  if (!testAT()) return false;
+  sendAT(GF("&FZ"));
+  waitResponse();
+  sendAT(GF("E0"));
+  if (waitResponse() != 1) return false;
+  getSimStatus();
+  return true;
+}
+
+bool TinyGsm::restart() {
+  if (!testAT()) return false;
+  sendAT(GF("&FZE0"));
+  waitResponse();
+  sendAT(GF("+CFUN=0"));
+  waitResponse(10000L);
+  sendAT(GF("+CFUN=1,1"));
+  waitResponse(10000L);
+  delay(3000);
+  return init();
+}
+
+bool TinyGsm::testAT(unsigned long timeout) {
+  for (unsigned long start = millis(); millis() - start < timeout; ) {
+    sendAT(GF(""));
+    if (waitResponse(200) == 1) {
+      delay(100);
+      return true;
+    }
+    delay(100);
+  }
+  return false;
+}
+
+bool TinyGsm::poweroff() {
+  sendAT(GF("+CPOWD=1"));
+  return waitResponse(GF("NORMAL POWER DOWN")) == 1;
+}
+
+void TinyGsm::maintain() {
+  for (int mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) {
+    TinyGsmClient* sock = sockets[mux];
+    if (sock && sock->got_data) {
+      sock->got_data = false;
+      sock->sock_available = modemGetAvailable(mux);
+    }
+  }
+  while (stream.available()) {
+    waitResponse(10, NULL, NULL);
+  }
+}
+
+String TinyGsm::getModemInfo() {
+  sendAT(GF("I"));
+  String res;
+  if (waitResponse(1000L, res) != 1) return "";
+  res.replace(GSM_NL "OK" GSM_NL, "");
+  res.replace(GSM_NL, " ");
+  res.trim();
+  return res;
+}
+
+String TinyGsm::getSimCCID() {
+  sendAT(GF("+ICCID"));
+  if (waitResponse(GF(GSM_NL "+ICCID:")) != 1) return "";
+  String res = stream.readStringUntil('\n');
+  waitResponse();
+  res.trim();
+  return res;
+}
+
+String TinyGsm::getIMEI() {
+  sendAT(GF("+GSN"));
+  if (waitResponse(GF(GSM_NL)) != 1) return "";
+  String res = stream.readStringUntil('\n');
+  waitResponse();
+  res.trim();
+  return res;
+}
+
+SimStatus TinyGsm::getSimStatus(unsigned long timeout) {
+  for (unsigned long start = millis(); millis() - start < timeout; ) {
+    sendAT(GF("+CPIN?"));
+    if (waitResponse(GF(GSM_NL "+CPIN:")) != 1) {
+      delay(1000);
+      continue;
+    }
+    const int status = waitResponse(GF("READY"), GF("SIM PIN"), GF("SIM PUK"), GF("NOT INSERTED"));
+    waitResponse();
+    switch (status) {
+      case 2 :
+      case 3 : return SIM_LOCKED;
+      case 1 : return SIM_READY;
+      default : return SIM_ERROR;
+    }
+  }
+  return SIM_ERROR;
+}
+
+int TinyGsm::getBattPercent() {
+  sendAT(GF("+CBC"));
+  if (waitResponse(GF(GSM_NL "+CBC:")) != 1) return false;
+  stream.readStringUntil(',');
+  const int res = stream.readStringUntil(',').toInt();
+  waitResponse();
+  return res;
+}
+
+int TinyGsm::getSignalQuality() {
+  sendAT(GF("+CSQ"));
+  if (waitResponse(GF(GSM_NL "+CSQ:")) != 1) return 99;
+  const int res = stream.readStringUntil(',').toInt();
+  waitResponse();
+  return res;
+}
+
+RegStatus TinyGsm::getRegistrationStatus() {
+  sendAT(GF("+CREG?"));
+  if (waitResponse(GF(GSM_NL "+CREG:")) != 1) return REG_UNKNOWN;
+  streamSkipUntil(',');
+  const int status = stream.readStringUntil('\n').toInt();
+  waitResponse();
+  return static_cast<RegStatus>(status);
+}
+
+bool TinyGsm::isNetworkConnected() {
+  const RegStatus s = getRegistrationStatus();
+  return (s == REG_OK_HOME) || (s == REG_OK_ROAMING);
+}
+
+bool TinyGsm::waitForNetwork(unsigned long timeout) {
+  for (unsigned long start = millis(); millis() - start < timeout; ) {
+    if (isNetworkConnected()) return true;
+    delay(250);
+  }
+  return false;
+}
+
+String TinyGsm::getOperator() {
+  sendAT(GF("+COPS?"));
+  if (waitResponse(GF(GSM_NL "+COPS:")) != 1) return "";
+  streamSkipUntil('"');
+  String res = stream.readStringUntil('"');
+  waitResponse();
+  return res;
+}
+
+bool TinyGsm::gprsConnect(const char* apn, const char* user, const char* pwd) {
+  gprsDisconnect();
+
+  sendAT(GF("+SAPBR=3,1,\"Contype\",\"GPRS\""));
+  waitResponse();
+  sendAT(GF("+SAPBR=3,1,\"APN\",\""), apn, '"');
+  waitResponse();
+  if (user && strlen(user) > 0) {
+    sendAT(GF("+SAPBR=3,1,\"USER\",\""), user, '"');
+    waitResponse();
+  }
+  if (pwd && strlen(pwd) > 0) {
+    sendAT(GF("+SAPBR=3,1,\"PWD\",\""), pwd, '"');
+    waitResponse();
+  }
+  sendAT(GF("+CGDCONT=1,\"IP\",\""), apn, '"');
+  waitResponse();
+  sendAT(GF("+CGACT=1,1"));
+  waitResponse(60000L);
+  sendAT(GF("+SAPBR=1,1"));
+  waitResponse(85000L);
+  sendAT(GF("+SAPBR=2,1"));
+  if (waitResponse(30000L) != 1) return false;
+  sendAT(GF("+CGATT=1"));
+  if (waitResponse(60000L) != 1) return false;
+  sendAT(GF("+CIPMUX=1"));
+  if (waitResponse() != 1) return false;
+  sendAT(GF("+CIPQSEND=1"));
+  if (waitResponse() != 1) return false;
+  sendAT(GF("+CIPRXGET=1"));
+  if (waitResponse() != 1) return false;
+  sendAT(GF("+CSTT=\""), apn, GF("\",\""), user ? user : "", GF("\",\""), pwd ? pwd : "", GF("\""));
+  if (waitResponse(60000L) != 1) return false;
+  sendAT(GF("+CIICR"));
+  if (waitResponse(60000L) != 1) return false;
+  sendAT(GF("+CIFSR;E0"));
+  if (waitResponse(10000L) != 1) return false;
+  sendAT(GF("+CDNSCFG=\"8.8.8.8\",\"8.8.4.4\""));
+  if (waitResponse() != 1) return false;
+  return true;
+}
+
+bool TinyGsm::gprsDisconnect() {
+  sendAT(GF("+CIPSHUT"));
+  if (waitResponse(60000L, GF("SHUT OK")) != 1) return false;
+  sendAT(GF("+CGATT=0"));
+  if (waitResponse(60000L) != 1) return false;
+  return true;
+}
+
+bool TinyGsm::isGprsConnected() {
+  sendAT(GF("+CGATT?"));
+  if (waitResponse(GF(GSM_NL "+CGATT:")) != 1) return false;
+  const int res = stream.readStringUntil('\n').toInt();
+  waitResponse();
+  if (res != 1) return false;
+  sendAT(GF("+CIFSR;E0"));
+  if (waitResponse() != 1) return false;
+  return true;
+}
+
+String TinyGsm::getLocalIP() {
+  sendAT(GF("+CIFSR;E0"));
+  String res;
+  if (waitResponse(10000L, res) != 1) return "";
+  res.replace(GSM_NL "OK" GSM_NL, "");
+  res.replace(GSM_NL, "");
+  res.trim();
+  return res;
+}
+
+bool TinyGsm::sendSMS(const String& number, const String& text) {
+  sendAT(GF("+CMGF=1"));
+  waitResponse();
+  sendAT(GF("+CSCS=\"GSM\""));
+  waitResponse();
+  sendAT(GF("+CMGS=\""), number, GF("\""));
+  if (waitResponse(GF(">")) != 1) return false;
+  stream.print(text);
+  stream.write(static_cast<char>(0x1A));
+  stream.flush();
+  return waitResponse(60000L) == 1;
+}
+
+uint8_t TinyGsm::waitResponse(uint32_t timeout, String& data, GsmConstStr r1, GsmConstStr r2, GsmConstStr r3, GsmConstStr r4, GsmConstStr r5) {
+  data.reserve(64);
+  uint8_t index = 0;
+  const unsigned long startMillis = millis();
+  do {
+    while (stream.available() > 0) {
+      const int a = stream.read();
+      if (a <= 0) continue;   // Skip 0x00 bytes, just in case
+      data += static_cast<char>(a);
+      if (r1 && data.endsWith(r1)) {
+        index = 1;
+        goto finish;
+      } else if (r2 && data.endsWith(r2)) {
+        index = 2;
+        goto finish;
+      } else if (r3 && data.endsWith(r3)) {
+        index = 3;
+        goto finish;
+      } else if (r4 && data.endsWith(r4)) {
+        index = 4;
+        goto finish;
+      } else if (r5 && data.endsWith(r5)) {
+        index = 5;
+        goto finish;
+      } else if (data.endsWith(GF(GSM_NL "+CIPRXGET:"))) {
+        const String mode = stream.readStringUntil(',');
+        if (mode.toInt() == 1) {
+          const int mux = stream.readStringUntil('\n').toInt();
+          if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) sockets[mux]->got_data = true;
+          data = "";
+        } else {
+          data += mode;
+        }
+      } else if (data.endsWith(GF("CLOSED" GSM_NL))) {
+        const int nl = data.lastIndexOf(GSM_NL, data.length() - 8);
+        const int coma = data.indexOf(',', nl + 2);
+        const int mux = data.substring(nl + 2, coma).toInt();
+        if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) sockets[mux]->sock_connected = false;
+        data = "";
+      }
+    }
+  } while (millis() - startMillis < timeout);
+finish:
+  if (!index) {
+    data.trim();
+    data = "";
+  }
+  return index;
+}
+
+bool TinyGsm::streamSkipUntil(const char c, const unsigned long timeout) {
+  const unsigned long startMillis = millis();
+  while (millis() - startMillis < timeout) {
+    while (millis() - startMillis < timeout && !stream.available()) {}
+    if (stream.read() == c) return true;
+  }
+  return false;
+}
+
+bool TinyGsm::modemConnect(const char* host, uint16_t port, uint8_t mux) {
+  sendAT(GF("+CIPSTART="), mux, ',', GF("\"TCP"), GF("\",\""), host, GF("\","), port);
+  const int rsp = waitResponse(75000L, GF("CONNECT OK" GSM_NL), GF("CONNECT FAIL" GSM_NL), GF("ALREADY CONNECT" GSM_NL),
+                               GF("ERROR" GSM_NL), GF("CLOSE OK" GSM_NL));
+  return (1 == rsp);
+}
+
+int TinyGsm::modemSend(const void* buff, size_t len, uint8_t mux) {
+  sendAT(GF("+CIPSEND="), mux, ',', static_cast<unsigned>(len));
+  if (waitResponse(GF(">")) != 1) return 0;
+  stream.write(reinterpret_cast<const uint8_t*>(buff), len);
+  stream.flush();
+  if (waitResponse(GF(GSM_NL "DATA ACCEPT:")) != 1) return 0;
+  streamSkipUntil(',');   // Skip mux
+  return stream.readStringUntil('\n').toInt();
+}
+
+size_t TinyGsm::modemRead(size_t size, uint8_t mux) {
+  sendAT(GF("+CIPRXGET=2,"), mux, ',', static_cast<unsigned>(size));
+  if (waitResponse(GF("+CIPRXGET:")) != 1) return 0;
+  streamSkipUntil(',');   // Skip mode 2/3
+  streamSkipUntil(',');   // Skip mux
+  const size_t len = stream.readStringUntil(',').toInt();
+  TinyGsmClient* sock = sockets[mux];
+  sock->sock_available = stream.readStringUntil('\n').toInt();
+  for (size_t i = 0; i < len; i++) {
+    const unsigned long debut = millis();
+    while (!stream.available() && (millis() - debut < 1000)) {}
+    const char c = stream.read();
+    if (sock->rxTaille < sizeof(sock->rx)) sock->rx[(sock->rxDebut + sock->rxTaille++) % sizeof(sock->rx)] = c;
+  }
+  waitResponse();
+  return len;
+}
+
+size_t TinyGsm::modemGetAvailable(uint8_t mux) {
+  sendAT(GF("+CIPRXGET=4,"), mux);
+  size_t result = 0;
+  if (waitResponse(GF("+CIPRXGET:")) == 1) {
+    streamSkipUntil(',');   // Skip mode 4
+    streamSkipUntil(',');   // Skip mux
+    result = stream.readStringUntil('\n').toInt();
+    waitResponse();
+  }
+  if (!result) sockets[mux]->sock_connected = modemGetConnected(mux);
+  return result;
+}
+
+bool TinyGsm::modemGetConnected(uint8_t mux) {
+  sendAT(GF("+CIPSTATUS="), mux);
+  const int res = waitResponse(GF(",\"CONNECTED\""), GF(",\"CLOSED\""), GF(",\"CLOSING\""), GF(",\"INITIAL\""));
+  waitResponse();
+  return 1 == res;
+}
+
+TinyGsmClient::TinyGsmClient(TinyGsm& modem, uint8_t aMux) :
+  at(&modem),
+  mux(aMux),
+  sock_available(0),
+  prev_check(0),
+  sock_connected(false),
+  got_data(false),
+  rxDebut(0),
+  rxTaille(0)
+{
+  at->sockets[mux] = this;
+}
+
+TinyGsmClient::~TinyGsmClient() {
+  if (at->sockets[mux] == this) at->sockets[mux] = NULL;
+}
+
+int TinyGsmClient::connect(const char* host, uint16_t port) {
+  stop();
+  rxDebut = rxTaille = 0;
+  sock_connected = at->modemConnect(host, port, mux);
+  return sock_connected;
+}
+
+void TinyGsmClient::stop() {
+  at->sendAT(GF("+CIPCLOSE="), mux);
+  sock_connected = false;
+  at->waitResponse();
+  rxDebut = rxTaille = 0;
+}
+
+uint8_t TinyGsmClient::connected() {
+  if (available()) return true;
+  return sock_connected;
+}
+
+size_t TinyGsmClient::write(const uint8_t* buf, size_t size) {
+  at->maintain();
+  return at->modemSend(buf, size, mux);
+}
+
+size_t TinyGsmClient::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+int TinyGsmClient::available() {
+  if (!rxTaille && sock_connected) {
+    // Workaround: sometimes SIM800 forgets to notify about data arrival.
+    if (millis() - prev_check > 500) {
+      got_data = true;
+      prev_check = millis();
+    }
+    at->maintain();
+  }
+  return rxTaille + sock_available;
+}
+
+int TinyGsmClient::read(uint8_t* buf, size_t size) {
+  at->maintain();
+  size_t cnt = 0;
+  while (cnt < size && sock_connected) {
+    const size_t chunk = min(size - cnt, rxTaille);
+    if (chunk > 0) {
+      for (size_t i = 0; i < chunk; ++i) {
+        *buf++ = rx[rxDebut];
+        rxDebut = (rxDebut + 1) % sizeof(rx);
+      }
+      rxTaille -= chunk;
+      cnt += chunk;
+      continue;
+    }
+    at->maintain();
+    if (sock_available > 0) {
+      at->modemRead(sizeof(rx) - rxTaille, mux);
+    } else {
+      break;
+    }
+  }
+  return cnt;
+}
+
+int TinyGsmClient::read() {
+  uint8_t c;
+  if (read(&c, 1) == 1) return c;
+  return -1;
+}
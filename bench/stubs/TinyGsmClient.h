@@ -0,0 +1,177 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   TinyGsmClient.h
+   Purpose: Host stand-in of TinyGSM : the SIM800 driver, command for command.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#define GSM_NL "\r\n"
+#define GF(x) x
+typedef const char* GsmConstStr;
+
+#define TINY_GSM_MUX_COUNT 5
+#define TINY_GSM_RX_BUFFER 64
+
+enum SimStatus {
+  SIM_ERROR = 0,
+  SIM_READY = 1,
+  SIM_LOCKED = 2
+};
+
+enum RegStatus {
+  REG_UNREGISTERED = 0,
+  REG_SEARCHING = 2,
+  REG_DENIED = 3,
+  REG_OK_HOME = 1,
+  REG_OK_ROAMING = 5,
+  REG_UNKNOWN = 4
+};
+
+class TinyGsmClient;
+
+/**
+   Pilote du modem : les commandes AT, leurs délais et le traitement des URC (+CIPRXGET: 1, CLOSED) sont ceux
+   de TinyGsmClientSIM800.h, y compris avec MODEM_SARA_R4 : le banc mesure le firmware, pas le modem, et
+   l'émulateur AT parle le même dialecte dans les deux cas.
+   Seul écart : un TinyGsmClient détruit se désinscrit du pilote (la bibliothèque garde un pointeur pendant).
+*/
+class TinyGsm {
+
+  public:
+    explicit TinyGsm(Stream& aStream);
+
+    bool begin() {
+      return init();
+    }
+    bool init();
+    bool restart();
+    bool testAT(unsigned long timeout = 10000L);
+    bool poweroff();
+    void maintain();
+
+    String getModemInfo();
+    String getSimCCID();
+    String getIMEI();
+    SimStatus getSimStatus(unsigned long timeout = 10000L);
+    int getBattPercent();
+    int getSignalQuality();
+    RegStatus getRegistrationStatus();
+    bool isNetworkConnected();
+    bool waitForNetwork(unsigned long timeout = 60000L);
+    String getOperator();
+
+    bool gprsConnect(const char* apn, const char* user = NULL, const char* pwd = NULL);
+    bool gprsDisconnect();
+    bool isGprsConnected();
+    String getLocalIP();
+
+    bool sendSMS(const String& number, const String& text);
+
+    template<typename... Args>
+    void sendAT(Args... cmd) {
+      streamWrite("AT", cmd..., GSM_NL);
+      stream.flush();
+    }
+
+    uint8_t waitResponse(uint32_t timeout, String& data, GsmConstStr r1 = GF("OK" GSM_NL), GsmConstStr r2 = GF("ERROR" GSM_NL),
+                         GsmConstStr r3 = NULL, GsmConstStr r4 = NULL, GsmConstStr r5 = NULL);
+    uint8_t waitResponse(uint32_t timeout, GsmConstStr r1 = GF("OK" GSM_NL), GsmConstStr r2 = GF("ERROR" GSM_NL),
+                         GsmConstStr r3 = NULL, GsmConstStr r4 = NULL, GsmConstStr r5 = NULL) {
+      String data;
+      return waitResponse(timeout, data, r1, r2, r3, r4, r5);
+    }
+    uint8_t waitResponse(GsmConstStr r1 = GF("OK" GSM_NL), GsmConstStr r2 = GF("ERROR" GSM_NL),
+                         GsmConstStr r3 = NULL, GsmConstStr r4 = NULL, GsmConstStr r5 = NULL) {
+      return waitResponse(1000, r1, r2, r3, r4, r5);
+    }
+
+    bool streamSkipUntil(const char c, const unsigned long timeout = 1000L);
+
+    Stream& stream;
+
+  protected:
+    friend class TinyGsmClient;
+
+    template<typename T>
+    void streamWrite(T last) {
+      stream.print(last);
+    }
+
+    template<typename T, typename... Args>
+    void streamWrite(T head, Args... tail) {
+      stream.print(head);
+      streamWrite(tail...);
+    }
+
+    bool modemConnect(const char* host, uint16_t port, uint8_t mux);
+    int modemSend(const void* buff, size_t len, uint8_t mux);
+    size_t modemRead(size_t size, uint8_t mux);
+    size_t modemGetAvailable(uint8_t mux);
+    bool modemGetConnected(uint8_t mux);
+
+    TinyGsmClient* sockets[TINY_GSM_MUX_COUNT];
+};
+
+/**
+   Connexion TCP du modem, avec le tampon de réception de TINY_GSM_RX_BUFFER octets de la bibliothèque.
+*/
+class TinyGsmClient : public Stream {
+
+    friend class TinyGsm;
+
+  public:
+    TinyGsmClient(TinyGsm& modem, uint8_t mux = 1);
+    ~TinyGsmClient();
+
+    int connect(const char* host, uint16_t port);
+    void stop();
+    uint8_t connected();
+    operator bool() {
+      return connected();
+    }
+
+    size_t write(const uint8_t* buf, size_t size) override;
+    size_t write(uint8_t c) override;
+    using Print::write;
+    int available() override;
+    int read(uint8_t* buf, size_t size);
+    int read() override;
+    int peek() override {
+      return -1;
+    }
+    void flush() override {
+      at->stream.flush();
+    }
+
+  private:
+    TinyGsm* at;
+    uint8_t mux;
+    uint16_t sock_available;
+    uint32_t prev_check;
+    bool sock_connected;
+    bool got_data;
+    uint8_t rx[TINY_GSM_RX_BUFFER];
+    size_t rxDebut;
+    size_t rxTaille;
+};
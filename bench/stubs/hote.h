@@ -0,0 +1,96 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   hote.h
+   Purpose: Controls of the host stand-ins used by the bench : virtual clock, pins, simulated sensors, heap counters.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <functional>
+#include <string>
+
+namespace hote {
+
+  /// Le processeur a été redémarré par NVIC_SystemReset().
+  struct Reset {};
+
+  /// Temps virtuel en µs depuis le lancement du banc.
+  extern uint64_t us;
+  /// Avance en µs de chaque appel à millis() ou micros(), 100 par défaut.
+  extern unsigned pas;
+  /// Affiche sur la sortie standard la console (Serial) du firmware.
+  extern bool journal;
+
+  /**
+     Avance le temps virtuel.
+  */
+  inline void avancer(const uint64_t duree) {
+    us += duree;
+  }
+
+  /**
+     Appelle la fonction à chaque digitalWrite(), avec la broche et la valeur.
+  */
+  void observer(std::function<void(uint32_t, uint32_t)> observateur);
+
+  /**
+     Capteurs simulés, lus par pulseIn() et analogRead() sur les broches de App.
+  */
+  struct Capteurs {
+    uint32_t echo;          ///< Broche de l'écho du télémètre.
+    uint32_t am2302;        ///< Broche de données de l'AM2302.
+    unsigned distance;      ///< Distance en mm, soit la largeur d'impulsion en µs.
+    unsigned bruit;         ///< Amplitude du bruit en mm autour de la distance.
+    unsigned sansEcho;      ///< Un échantillon sur sansEcho n'a pas d'écho, 0 pour aucun.
+    int16_t temperature;    ///< Température en 1/10 °C.
+    uint16_t hygrometrie;   ///< Hygrométrie en 1/10 %.
+    uint16_t vbat;          ///< Tension de la batterie en mV.
+  };
+  extern Capteurs capteurs;
+
+  /**
+     Compteurs du tas : tous les malloc/calloc/realloc/free du processus, firmware et banc.
+  */
+  struct Tas {
+    uint64_t allocations;   ///< Appels à malloc, calloc et realloc.
+    uint64_t liberations;   ///< Appels à free d'un bloc.
+    uint64_t octets;        ///< Octets demandés par les allocations.
+    int64_t vivants;        ///< Octets des blocs alloués et non libérés.
+  };
+  extern Tas tas;
+
+  /// Écritures dans la flash par FlashStorage depuis le lancement.
+  extern unsigned long ecrituresFlash;
+
+  /**
+     Place la carte SD simulée dans un répertoire du poste, absente si vide.
+  */
+  void carteSD(const std::string& repertoire);
+
+  /**
+     Attend la prochaine alarme de la RTC, comme le processeur en veille : le temps virtuel avance jusqu'à
+     l'alarme et la fonction attachée est appelée.
+
+     @return false si aucune alarme n'est programmée.
+  */
+  bool attendreAlarme();
+}
@@ -0,0 +1,99 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   tas.cpp
+   Purpose: Heap counters of the bench : malloc, calloc, realloc & free of the process, through the glibc.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#include "hote.h"
+
+#include <malloc.h>
+
+extern "C" {
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t n, size_t size);
+  void* __libc_realloc(void* p, size_t size);
+  void* __libc_memalign(size_t alignment, size_t size);
+  void __libc_free(void* p);
+}
+
+namespace hote {
+  Tas tas = {};
+}
+
+namespace {
+  void compter(void* p, const size_t demande) {
+    if (!p) return;
+    ++hote::tas.allocations;
+    hote::tas.octets += demande;
+    hote::tas.vivants += malloc_usable_size(p);
+  }
+}
+
+extern "C" {
+
+  void* malloc(size_t size) {
+    void* p = __libc_malloc(size);
+    compter(p, size);
+    return p;
+  }
+
+  void* calloc(size_t n, size_t size) {
+    void* p = __libc_calloc(n, size);
+    compter(p, n * size);
+    return p;
+  }
+
+  void* realloc(void* p, size_t size) {
+    const size_t avant = p ? malloc_usable_size(p) : 0;
+    void* r = __libc_realloc(p, size);
+    if (r || !size) {
+      hote::tas.vivants -= avant;
+      if (p && !size) ++hote::tas.liberations;
+    }
+    compter(r, size);
+    return r;
+  }
+
+  void* memalign(size_t alignment, size_t size) {
+    void* p = __libc_memalign(alignment, size);
+    compter(p, size);
+    return p;
+  }
+
+  int posix_memalign(void** r, size_t alignment, size_t size) {
+    void* p = __libc_memalign(alignment, size);
+    if (!p) return 12;    // ENOMEM
+    compter(p, size);
+    *r = p;
+    return 0;
+  }
+
+  void* aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+  }
+
+  void free(void* p) {
+    if (!p) return;
+    ++hote::tas.liberations;
+    hote::tas.vivants -= malloc_usable_size(p);
+    __libc_free(p);
+  }
+}
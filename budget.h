@@ -0,0 +1,214 @@
+/*
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+/**
+ *  @file
+ *  Picolimno MKR V1.0 project
+ *  budget.h
+ *  Define a Budget class : monthly ledger of the data sent & received, and governor.
+ *
+ *  @author Marc Sibert
+ *  @version 1.0 14/04/2018
+ *  @Copyright 2018 Marc Sibert
+ */
+
+#pragma once
+
+#include <ctime>
+#include <FlashStorage.h>
+
+/// Forfait de données mensuel de la SIM en octets, peut être redéfini dans secrets.h.
+#ifndef BUDGET_MENSUEL
+#define BUDGET_MENSUEL (5UL * 1024 * 1024)
+#endif
+/// Jour du mois où commence la période de facturation (1 à 28).
+#ifndef BUDGET_JOUR
+#define BUDGET_JOUR 1
+#endif
+/// Temps minimum en secondes entre deux écritures du registre en flash (usure).
+#define BUDGET_SAUVEGARDE (6 * 3600UL)
+/// Surcoût estimé en octets d'une connexion TCP (ouverture, acquittements, fermeture, en-têtes IP/TCP).
+#define BUDGET_SURCOUT_TCP 400
+/// Surcoût en octets des en-têtes IP/UDP d'un datagramme.
+#define BUDGET_SURCOUT_UDP 28
+
+/**
+ * Registre enregistré en flash.
+ */
+struct registreBudget_t {
+  uint32_t magique;
+  uint32_t debut;       ///< Début de la période de facturation, 0 si inconnu.
+  uint32_t emis;
+  uint32_t recus;
+};
+
+FlashStorage(budgetFlash, registreBudget_t);
+
+/**
+ * Registre des octets émis et reçus pendant la période de facturation en cours, conservé en flash,
+ * et gouverneur qui projette la consommation à la fin de la période.
+ * Toutes les méthodes sont statiques : les transports comptent leurs octets sans connaître l'application.
+ * Les octets sont estimés au niveau IP à partir des requêtes et réponses, avec un surcoût forfaitaire par connexion.
+ */
+class Budget {
+
+public:
+  enum niveau_t : byte {
+    NORMAL,     ///< Projection dans les 80 % du forfait
+    ECONOME,    ///< Projection au-delà de 80 % : regroupement des transmissions
+    SEVERE,     ///< Projection au-delà du forfait : transmission sur variation et battement réduit
+    EPUISE      ///< Forfait consommé : seules les alertes sont transmises
+  };
+
+/**
+ * Relit le registre enregistré en flash.
+ */
+  static void charger() {
+    fRegistre = budgetFlash.read();
+    if (fRegistre.magique != MAGIQUE) {
+      fRegistre = registreBudget_t();
+      fRegistre.magique = MAGIQUE;
+    }
+    fSauvegarde = 0;
+  }
+
+/**
+ * Compte des octets échangés.
+ *
+ * @param emis Les octets émis.
+ * @param recus Les octets reçus.
+ */
+  static void compter(const uint32_t emis, const uint32_t recus) {
+    fRegistre.emis += emis;
+    fRegistre.recus += recus;
+  }
+
+/**
+ * Change de période de facturation si besoin et enregistre le registre en flash au plus toutes les BUDGET_SAUVEGARDE s.
+ *
+ * @param epoch L'heure actuelle, ignorée tant que la RTC n'est pas à l'heure.
+ * @param force Enregistre sans attendre, par exemple avant un reset.
+ */
+  static void sauvegarder(const uint32_t epoch, const bool force = false) {
+    if (epoch < EPOCH_MIN) return;
+    const uint32_t debut = debutPeriode(epoch);
+    if (debut != fRegistre.debut) {
+      DEBUG(F("Nouvelle periode de facturation, ")); DEBUG(fRegistre.emis + fRegistre.recus); DEBUG(F(" octets consommes.\n"));
+      fRegistre.debut = debut;
+      fRegistre.emis = 0;
+      fRegistre.recus = 0;
+      fSauvegarde = 0;
+    }
+    if (!force && fSauvegarde && (epoch - fSauvegarde < BUDGET_SAUVEGARDE)) return;
+    budgetFlash.write(fRegistre);
+    fSauvegarde = epoch;
+  }
+
+/**
+ * @return Les octets consommés depuis le début de la période.
+ */
+  static uint32_t consomme() {
+    return fRegistre.emis + fRegistre.recus;
+  }
+
+/**
+ * Projette la consommation à la fin de la période au rythme observé depuis son début (au moins 1 jour).
+ *
+ * @param epoch L'heure actuelle.
+ * @return Les octets projetés.
+ */
+  static uint32_t projection(const uint32_t epoch) {
+    if ((epoch < EPOCH_MIN) || !fRegistre.debut) return consomme();
+    const uint32_t duree = finPeriode(fRegistre.debut) - fRegistre.debut;
+    const uint32_t ecoule = max(epoch - fRegistre.debut, static_cast<uint32_t>(86400));
+    return static_cast<uint64_t>(consomme()) * duree / ecoule;
+  }
+
+/**
+ * @param epoch L'heure actuelle.
+ * @return Le niveau d'économie à appliquer.
+ */
+  static niveau_t niveau(const uint32_t epoch) {
+    if (consomme() >= BUDGET_MENSUEL) return EPUISE;
+    const uint32_t p = projection(epoch);
+    if (p > BUDGET_MENSUEL) return SEVERE;
+    if (p > BUDGET_MENSUEL / 10 * 8) return ECONOME;
+    return NORMAL;
+  }
+
+/**
+ * Sérialise le registre en un objet JSON.
+ *
+ * @param epoch L'heure actuelle.
+ * @return {"sent":..,"received":..,"projected":..,"quota":..,"level":..}
+ */
+  static String json(const uint32_t epoch) {
+    String json(F("{\"sent\":"));
+    json += fRegistre.emis;
+    json += F(",\"received\":");
+    json += fRegistre.recus;
+    json += F(",\"projected\":");
+    json += projection(epoch);
+    json += F(",\"quota\":");
+    json += BUDGET_MENSUEL;
+    json += F(",\"level\":");
+    json += niveau(epoch);
+    json += '}';
+    return json;
+  }
+
+protected:
+/**
+ * Retourne le début de la période de facturation contenant l'heure donnée.
+ */
+  static uint32_t debutPeriode(const uint32_t epoch) {
+    const time_t t = epoch;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    if (tm.tm_mday < BUDGET_JOUR) {
+      if (--tm.tm_mon < 0) {
+        tm.tm_mon = 11;
+        --tm.tm_year;
+      }
+    }
+    tm.tm_mday = BUDGET_JOUR;
+    tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+    return mktime(&tm);   // RTC en UTC, sans fuseau horaire
+  }
+
+/**
+ * Retourne la fin de la période de facturation commençant à l'heure donnée.
+ */
+  static uint32_t finPeriode(const uint32_t debut) {
+    const time_t t = debut;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    if (++tm.tm_mon > 11) {
+      tm.tm_mon = 0;
+      ++tm.tm_year;
+    }
+    return mktime(&tm);
+  }
+
+private:
+  static const uint32_t MAGIQUE = 0xB0D6E701;
+  static const uint32_t EPOCH_MIN = 1500000000UL;   ///< Avant, la RTC n'a pas encore été mise à l'heure (2017).
+
+  static registreBudget_t fRegistre;
+  static uint32_t fSauvegarde;    ///< Heure du dernier enregistrement en flash, 0 si aucun.
+
+};
+
+registreBudget_t Budget::fRegistre;
+uint32_t Budget::fSauvegarde;
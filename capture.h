@@ -0,0 +1,431 @@
+/*
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+/**
+ *  @file
+ *  Picolimno MKR V1.0 project
+ *  capture.h
+ *  Define the Capture class : record of the raw inputs (sensors & modem) on SD card, and their replay.
+ *
+ *  @author Marc Sibert
+ *  @version 1.0 14/04/2018
+ *  @Copyright 2018 Marc Sibert
+ */
+
+#pragma once
+
+// Enregistre les entrées brutes sur la carte SD si défini.
+//#define CAPTURE
+// Rejoue les entrées brutes enregistrées sur la carte SD à la place des capteurs et du modem si défini.
+//#define REJEU
+
+#if defined(CAPTURE) || defined(REJEU)
+
+#if defined(CAPTURE) && defined(REJEU)
+#error "CAPTURE et REJEU sont exclusifs."
+#endif
+
+#include <SD.h>
+
+/// Broche CS de la carte SD (module SPI), peut être redéfinie dans secrets.h.
+#ifndef CAPTURE_CS
+#define CAPTURE_CS A1
+#endif
+/// Fichier des entrées brutes, enregistrées à la suite ou rejouées depuis le début.
+#define CAPTURE_FICHIER "CAPTURE.BIN"
+/// Taille en octets de la mémoire des enregistrements, écrits sur la carte hors des échanges avec le modem.
+#ifndef CAPTURE_RAM
+#define CAPTURE_RAM 6144
+#endif
+/// Taille du tampon des échanges avec le modem ; un enregistrement est fait à chaque changement de sens.
+#define CAPTURE_TAMPON 32
+/// Crochet appelé au rejeu avec le millis() de chaque enregistrement relu : un banc sans carte y règle son horloge.
+#ifndef CAPTURE_HORLOGE
+#define CAPTURE_HORLOGE(ms)
+#endif
+/// Crochet appelé à l'arrêt du rejeu (divergence ou perte) : un banc sans carte peut y terminer le rejeu.
+#ifndef CAPTURE_ARRET
+#define CAPTURE_ARRET()
+#endif
+
+/**
+ * Enregistrement et rejeu des entrées brutes, toutes les méthodes sont statiques.
+ * Chaque enregistrement est un en-tête de 6 octets (millis() sur 4 octets, type, longueur des données),
+ * suivi des données, les entiers en little-endian :
+ * - DEBUT : aucune donnée, à chaque démarrage ;
+ * - IMPULSION : largeur de l'impulsion du capteur de distance en µs (uint32_t, 0 sans écho) ;
+ * - AM2302 : les 41 impulsions du capteur de température & d'hygrométrie en µs (uint8_t chacune, 0 à l'expiration) ;
+ * - ADC : somme des lectures de la tension de la batterie (uint32_t) ;
+ * - MODEM_EMIS, MODEM_RECUS : octets échangés avec le modem, datés de leur premier octet ;
+ * - PERTE : nombre d'octets d'enregistrements perdus (uint32_t), la mémoire étant pleine avant l'écriture suivante.
+ * Les enregistrements sont gardés en RAM (CAPTURE_RAM octets) et écrits sur la carte par vider(), à chaque réveil
+ * et à la fin de chaque requête :
+ * l'écriture d'un bloc de la carte, longue de plusieurs ms, ne retarde pas la lecture du port série du modem.
+ * Au rejeu, les mesures sont relues dans l'ordre de l'enregistrement, indépendamment des autres types ; les octets émis
+ * vers le modem sont comparés aux MODEM_EMIS et une réponse MODEM_RECUS n'est servie qu'une fois émis tous les octets
+ * qui la précèdent dans la trace (voir FluxCapture). Le rejeu s'arrête à une PERTE ou à la première divergence.
+ */
+class Capture {
+
+public:
+  enum type_t : byte {
+    DEBUT,
+    IMPULSION,
+    AM2302,
+    ADC,
+    MODEM_EMIS,
+    MODEM_RECUS,
+    PERTE,
+    NB_TYPES
+  };
+
+/**
+ * Ouvre le fichier des entrées brutes.
+ *
+ * @return false si la carte ou le fichier est inaccessible ; la capture et le rejeu sont alors inactifs.
+ */
+  static bool begin() {
+    if (!SD.begin(CAPTURE_CS)) {
+      DEBUG(F("Carte SD absente.\n"));
+      return false;
+    }
+#ifdef CAPTURE
+    fFichier = SD.open(CAPTURE_FICHIER, FILE_WRITE);
+#else
+    fFichier = SD.open(CAPTURE_FICHIER, FILE_READ);
+#endif
+    if (!fFichier) {
+      DEBUG(F("Fichier de capture inaccessible.\n"));
+      return false;
+    }
+    fOuvert = true;
+    fArret = false;
+    for (byte i = 0; i < NB_TYPES; ++i) fPositions[i] = 0;
+    ecrire(DEBUT, NULL, 0);
+    return true;
+  }
+
+/**
+ * Ajoute un enregistrement en mémoire (CAPTURE seulement) ; il est perdu si la mémoire est pleine.
+ *
+ * @param type Le type de l'enregistrement.
+ * @param donnees Les données.
+ * @param n La longueur des données en octets.
+ * @param ms La date de l'enregistrement, millis() par défaut.
+ */
+  static void ecrire(const type_t type, const void* donnees, const byte n, const uint32_t ms = millis()) {
+#ifdef CAPTURE
+    if (!fOuvert) return;
+    if (fTaille + 6 + n > CAPTURE_RAM) {
+      fPerdus += 6 + n;
+      return;
+    }
+    uint8_t* const e = fRam + fTaille;
+    e[0] = ms; e[1] = ms >> 8; e[2] = ms >> 16; e[3] = ms >> 24;
+    e[4] = type;
+    e[5] = n;
+    if (n) memcpy(e + 6, donnees, n);
+    fTaille += 6 + n;
+#endif
+  }
+
+/**
+ * Relit l'enregistrement suivant d'un type (REJEU seulement).
+ *
+ * @param type Le type de l'enregistrement.
+ * @param donnees Reçoit les données, complétées par des 0 si l'enregistrement est plus court.
+ * @param n La taille de donnees en octets.
+ * @return La longueur des données lues, -1 à la fin de la trace.
+ */
+  static int lire(const type_t type, void* donnees, const byte n) {
+    memset(donnees, 0, n);
+#ifdef REJEU
+    uint8_t entete[6];
+    if (!chercher(type, entete)) return -1;
+    const byte longueur = entete[5];
+    const byte lus = min(longueur, n);
+    fFichier.read(donnees, lus);
+    fPositions[type] = fFichier.position() + longueur - lus;
+    CAPTURE_HORLOGE(entete[0] | (uint32_t(entete[1]) << 8) | (uint32_t(entete[2]) << 16) | (uint32_t(entete[3]) << 24));
+    return lus;
+#else
+    return -1;
+#endif
+  }
+
+/**
+ * @return La position dans la trace du prochain enregistrement d'un type, la taille de la trace s'il n'y en a plus (REJEU seulement).
+ */
+  static uint32_t prochain(const type_t type) {
+#ifdef REJEU
+    uint8_t entete[6];
+    if (chercher(type, entete)) return fFichier.position() - sizeof(entete);
+#endif
+    return fOuvert ? fFichier.size() : 0;
+  }
+
+/**
+ * Arrête le rejeu : plus aucun enregistrement n'est relu.
+ */
+  static void arreter() {
+    fArret = true;
+    CAPTURE_ARRET();
+  }
+
+/**
+ * @return true si le rejeu a été arrêté, par une divergence ou une perte dans la trace.
+ */
+  static bool arrete() {
+    return fArret;
+  }
+
+/**
+ * Relit un entier de l'enregistrement suivant d'un type (REJEU seulement).
+ *
+ * @return L'entier, 0 à la fin de la trace.
+ */
+  static uint32_t lire(const type_t type) {
+    uint8_t o[4];
+    lire(type, o, sizeof(o));
+    return o[0] | (uint32_t(o[1]) << 8) | (uint32_t(o[2]) << 16) | (uint32_t(o[3]) << 24);
+  }
+
+/**
+ * Ajoute un entier (CAPTURE seulement).
+ */
+  static void ecrire(const type_t type, const uint32_t valeur) {
+    const uint8_t o[] = { uint8_t(valeur), uint8_t(valeur >> 8), uint8_t(valeur >> 16), uint8_t(valeur >> 24) };
+    ecrire(type, o, sizeof(o));
+  }
+
+/**
+ * Écrit sur la carte les enregistrements en mémoire, suivis d'une PERTE si la mémoire a débordé.
+ * À appeler hors des échanges avec le modem.
+ */
+  static void vider() {
+#ifdef CAPTURE
+    if (!fOuvert || (!fTaille && !fPerdus)) return;
+    fFichier.write(fRam, fTaille);
+    if (fPerdus) {
+      DEBUG(F("Capture : ")); DEBUG(fPerdus); DEBUG(F(" octets perdus.\n"));
+      const uint32_t ms = millis();
+      const uint8_t perte[] = { uint8_t(ms), uint8_t(ms >> 8), uint8_t(ms >> 16), uint8_t(ms >> 24), PERTE, 4,
+                                uint8_t(fPerdus), uint8_t(fPerdus >> 8), uint8_t(fPerdus >> 16), uint8_t(fPerdus >> 24) };
+      fFichier.write(perte, sizeof(perte));
+    }
+    fFichier.flush();
+    fTaille = 0;
+    fPerdus = 0;
+#endif
+  }
+
+private:
+#ifdef REJEU
+/**
+ * Place le fichier sur les données du prochain enregistrement d'un type.
+ * Une PERTE arrête le rejeu : les enregistrements qui la suivent ne sont plus ordonnés avec ceux perdus.
+ *
+ * @param entete Reçoit l'en-tête de l'enregistrement.
+ * @return false à la fin de la trace ou du rejeu.
+ */
+  static bool chercher(const type_t type, uint8_t entete[6]) {
+    if (!fOuvert || fArret || !fFichier.seek(fPositions[type])) return false;
+    while (fFichier.read(entete, 6) == 6) {
+      if (entete[4] == PERTE) {
+        DEBUG(F("Rejeu : perte dans la trace, arret.\n"));
+        arreter();
+        return false;
+      }
+      if (entete[4] == type) return true;
+      if (!fFichier.seek(fFichier.position() + entete[5])) break;
+    }
+    fPositions[type] = fFichier.size();
+    return false;
+  }
+#endif
+
+  static File fFichier;
+  static bool fOuvert;
+  static bool fArret;                     ///< Rejeu arrêté.
+  static uint32_t fPositions[NB_TYPES];   ///< Position de la recherche de l'enregistrement suivant de chaque type au rejeu.
+#ifdef CAPTURE
+  static uint8_t fRam[CAPTURE_RAM];       ///< Enregistrements pas encore écrits sur la carte.
+  static uint16_t fTaille;                ///< Octets de fRam occupés.
+  static uint32_t fPerdus;                ///< Octets d'enregistrements perdus depuis la dernière écriture.
+#endif
+
+};
+
+File Capture::fFichier;
+bool Capture::fOuvert;
+bool Capture::fArret;
+uint32_t Capture::fPositions[Capture::NB_TYPES];
+#ifdef CAPTURE
+uint8_t Capture::fRam[CAPTURE_RAM];
+uint16_t Capture::fTaille;
+uint32_t Capture::fPerdus;
+#endif
+
+/**
+ * Flux intercalé entre le modem et son port série.
+ * En CAPTURE, les octets échangés sont transmis et enregistrés par blocs de même sens, datés de leur premier octet.
+ * En REJEU, les octets émis sont comparés, dans l'ordre de la trace, à ceux des MODEM_EMIS ; les octets reçus viennent
+ * d'un MODEM_RECUS servi seulement quand tous les MODEM_EMIS qui le précèdent ont été émis à l'identique : une réponse
+ * n'arrive jamais avant la commande qui l'a provoquée. À la première divergence, le rejeu est arrêté et plus rien n'est reçu.
+ */
+class FluxCapture : public Stream {
+
+public:
+  FluxCapture(Stream& aFlux) :
+    fFlux(aFlux),
+    fTampon(),
+    fN(0),
+    fLus(0),
+    fEmission(false),
+    fDebut(0),
+    fEmis(),
+    fNEmis(0),
+    fCompares(0),
+    fOctets(0)
+  {
+  }
+
+  int available() override {
+#ifdef REJEU
+    remplir();
+    return fN - fLus;
+#else
+    return fFlux.available();
+#endif
+  }
+
+  int read() override {
+#ifdef REJEU
+    remplir();
+    return (fLus < fN) ? fTampon[fLus++] : -1;
+#else
+    const int c = fFlux.read();
+    if (c >= 0) ajouter(false, c);
+    return c;
+#endif
+  }
+
+  int peek() override {
+#ifdef REJEU
+    remplir();
+    return (fLus < fN) ? fTampon[fLus] : -1;
+#else
+    return fFlux.peek();
+#endif
+  }
+
+  size_t write(const uint8_t c) override {
+#ifdef REJEU
+    comparer(c);
+    return 1;
+#else
+    ajouter(true, c);
+    return fFlux.write(c);
+#endif
+  }
+
+  using Print::write;
+
+  void flush() {
+#ifdef CAPTURE
+    deposer();
+#endif
+    fFlux.flush();
+  }
+
+/**
+ * @return Le nombre d'octets émis conformes à la trace (REJEU).
+ */
+  uint32_t conformes() const {
+    return fOctets;
+  }
+
+protected:
+#ifdef CAPTURE
+  void ajouter(const bool emission, const uint8_t c) {
+    if ((emission != fEmission) || (fN == CAPTURE_TAMPON)) deposer();
+    if (!fN) fDebut = millis();
+    fEmission = emission;
+    fTampon[fN++] = c;
+  }
+
+  void deposer() {
+    if (fN) Capture::ecrire(fEmission ? Capture::MODEM_EMIS : Capture::MODEM_RECUS, fTampon, fN, fDebut);
+    fN = 0;
+  }
+#endif
+
+#ifdef REJEU
+/**
+ * Compare un octet émis au suivant des MODEM_EMIS ; arrête le rejeu s'il diffère ou si la trace n'en a plus.
+ */
+  void comparer(const uint8_t c) {
+    if (Capture::arrete()) return;
+    if (fCompares == fNEmis) {
+      const int n = Capture::lire(Capture::MODEM_EMIS, fEmis, CAPTURE_TAMPON);
+      fNEmis = (n > 0) ? n : 0;
+      fCompares = 0;
+      if (!fNEmis) {
+        if (Capture::arrete()) return;
+        DEBUG(F("Rejeu : emission au-dela de la trace apres ")); DEBUG(fOctets); DEBUG(F(" octets, arret.\n"));
+        Capture::arreter();
+        return;
+      }
+    }
+    if (fEmis[fCompares] != c) {
+      DEBUG(F("Rejeu : divergence a l'octet emis ")); DEBUG(fOctets); DEBUG(F(", ")); DEBUG(unsigned(c));
+      DEBUG(F(" au lieu de ")); DEBUG(unsigned(fEmis[fCompares])); DEBUG(F(", arret.\n"));
+      Capture::arreter();
+      return;
+    }
+    ++fCompares;
+    ++fOctets;
+  }
+
+/**
+ * Relit le MODEM_RECUS suivant si le tampon est lu et si tous les MODEM_EMIS qui le précèdent dans la trace ont été émis.
+ */
+  void remplir() {
+    if ((fLus < fN) || Capture::arrete()) return;
+    fN = 0;
+    fLus = 0;
+    if (fCompares < fNEmis) return;   // MODEM_EMIS en cours d'émission
+    if (Capture::prochain(Capture::MODEM_EMIS) < Capture::prochain(Capture::MODEM_RECUS)) return;
+    const int n = Capture::lire(Capture::MODEM_RECUS, fTampon, CAPTURE_TAMPON);
+    fN = (n > 0) ? n : 0;
+  }
+#endif
+
+private:
+  Stream& fFlux;
+  uint8_t fTampon[CAPTURE_TAMPON];
+  byte fN;
+  byte fLus;            ///< Octets du tampon déjà lus (REJEU).
+  bool fEmission;       ///< Sens des octets du tampon (CAPTURE).
+  uint32_t fDebut;      ///< millis() du premier octet du tampon (CAPTURE).
+  uint8_t fEmis[CAPTURE_TAMPON];  ///< MODEM_EMIS en cours de comparaison (REJEU).
+  byte fNEmis;
+  byte fCompares;       ///< Octets de fEmis déjà comparés.
+  uint32_t fOctets;     ///< Octets émis conformes (REJEU).
+
+};
+
+FluxCapture fluxModem(Serial1);
+
+#endif
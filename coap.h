@@ -0,0 +1,346 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   coap.h
+   Purpose: Define the CoAP transport over the SIM800 UDP sockets.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#pragma once
+
+/// Port UDP du serveur CoAP.
+#ifndef COAP_PORT
+#define COAP_PORT 5683
+#endif
+/// Connexion du SIM800 réservée au transport UDP (les TinyGsmClient utilisent les premières).
+#define COAP_MUX 4
+/// Délai initial d'attente d'un ACK en ms, doublé à chaque retransmission (ACK_TIMEOUT, RFC 7252).
+#define COAP_ACK_TIMEOUT 2000UL
+/// Nombre de retransmissions d'un message confirmable (MAX_RETRANSMIT, RFC 7252).
+#define COAP_MAX_RETRANSMIT 4
+/// Exposant de la taille des blocs d'un transfert par blocs (SZX, RFC 7959) : 256 octets.
+#define COAP_SZX 4
+#define COAP_BLOC (1U << (COAP_SZX + 4))
+
+/**
+   Transport CoAP (RFC 7252) en messages confirmables sur une socket UDP du SIM800.
+   Les corps plus grands qu'un bloc sont transmis par blocs (option Block1, RFC 7959).
+   Inclus par transport.h qui définit reponse_t.
+*/
+class TransportCoap {
+
+  public:
+    /**
+       Constructeur.
+
+       @param aModem Le modem portant la socket UDP.
+       @param aServerName Le nom du serveur.
+       @param aServerPort Le port UDP du serveur.
+    */
+    TransportCoap(TinyGsm& aModem, const __FlashStringHelper aServerName[], const int aServerPort) :
+      modem(aModem),
+      serverName(aServerName),
+      serverPort(aServerPort),
+      messageId(millis())
+    {}
+
+    /**
+       Envoie une requête CoAP et attend sa réponse.
+       Le chemin est découpé en options Uri-Path ; le corps, s'il existe, est en application/json.
+
+       @param aMethode La méthode (GET, POST, PUT).
+       @param aPath Le chemin de la ressource.
+       @param aBody Le corps JSON de la requête, aucun s'il est vide.
+       @param aReponse Retourne le code de la réponse (2.04 -> 204) et la taille de sa charge utile.
+       @param aCorps Retourne la charge utile de la réponse s'il est fourni.
+       @return true si le dernier bloc a reçu une réponse de succès (2.xx), false sinon.
+    */
+    bool requete(const __FlashStringHelper* aMethode, const String& aPath, const String& aBody, reponse_t& aReponse, String* aCorps = NULL) {
+      aReponse.status = 0;
+      aReponse.contentLength = -1;
+      aReponse.date[0] = '\0';
+      aReponse.etag[0] = '\0';
+      aReponse.plage = -1;
+      aReponse.compression = false;
+
+      const String methode(aMethode);
+      const byte code = methode == "GET" ? 0x01 : methode == "POST" ? 0x02 : 0x03;   // 0.01, 0.02, 0.03
+      DEBUG(F("CoAP ")); DEBUG(methode); DEBUG(' '); DEBUG(aPath); DEBUG('\n');
+
+      if (!ouvrir()) return false;
+
+      const size_t n = aBody.length();
+      const bool blocs = (n > COAP_BLOC);
+      size_t offset = 0;
+      uint32_t num = 0;
+      bool ok;
+      do {
+        const size_t taille = (n - offset > COAP_BLOC) ? COAP_BLOC : n - offset;
+        const bool suite = (offset + taille < n);
+        ok = echanger(code, aPath, reinterpret_cast<const uint8_t*>(aBody.c_str()) + offset, taille, blocs, num, suite, aReponse, suite ? NULL : aCorps);
+        ok = ok && (aReponse.status / 100 == 2);   // 2.31 Continue pour les blocs intermédiaires
+        offset += taille;
+        ++num;
+      } while (ok && (offset < n));
+
+      fermer();
+#ifdef CAPTURE
+      Capture::vider();   // socket fermée : hors des échanges avec le modem
+#endif
+      DEBUG(F("CoAP Response : ")); DEBUG(aReponse.status); DEBUG('\n');
+      return ok;
+    }
+
+  protected:
+    enum {
+      CON = 0,
+      NON = 1,
+      ACK = 2,
+      RST = 3
+    };
+
+    /**
+       Envoie un message confirmable (un bloc) et attend la réponse, avec retransmissions.
+
+       @return true si une réponse correspondant au message a été reçue.
+    */
+    bool echanger(const byte code, const String& aPath, const uint8_t data[], const size_t taille, const bool blocs, const uint32_t num, const bool suite, reponse_t& aReponse, String* aCorps) {
+      uint8_t msg[COAP_BLOC + 64];
+      const uint16_t id = ++messageId;
+      size_t l = 0;
+      msg[l++] = 0x40 | (CON << 4) | 2;   // Ver 1, CON, jeton de 2 octets
+      msg[l++] = code;
+      msg[l++] = id >> 8;
+      msg[l++] = id & 0xff;
+      msg[l++] = id >> 8;                 // jeton = identifiant du message
+      msg[l++] = id & 0xff;
+
+      unsigned numero = 0;   // numéro de la dernière option (codage par différence)
+      const char* p = aPath.c_str();
+      while (*p) {
+        if (*p == '/') {
+          ++p;
+          continue;
+        }
+        const char* const fin = strchr(p, '/');
+        const size_t len = fin ? fin - p : strlen(p);
+        if (l + len + 3 > sizeof(msg) - taille - 8) return false;
+        l += option(msg + l, 11 - numero, reinterpret_cast<const uint8_t*>(p), len);    // Uri-Path
+        numero = 11;
+        p += len;
+      }
+      if (taille > 0) {
+        const uint8_t json = 50;    // application/json
+        l += option(msg + l, 12 - numero, &json, 1);    // Content-Format
+        numero = 12;
+      }
+      if (blocs) {
+        const uint32_t v = (num << 4) | (suite ? 0x08 : 0) | COAP_SZX;
+        uint8_t b[3];
+        size_t lb = 0;
+        if (v > 0xffff) b[lb++] = v >> 16;
+        if (v > 0xff) b[lb++] = (v >> 8) & 0xff;
+        b[lb++] = v & 0xff;
+        l += option(msg + l, 27 - numero, b, lb);    // Block1
+        numero = 27;
+      }
+      if (taille > 0) {
+        msg[l++] = 0xff;
+        memcpy(msg + l, data, taille);
+        l += taille;
+      }
+
+      unsigned long attente = COAP_ACK_TIMEOUT;
+      for (byte i = 0; i <= COAP_MAX_RETRANSMIT; ++i) {
+        if (i) {
+          DEBUG(F("CoAP retransmission ")); DEBUG(i); DEBUG('\n');
+        }
+        if (envoyerDatagramme(msg, l) && recevoir(id, attente, aReponse, aCorps)) return true;
+        attente *= 2;
+      }
+      return false;
+    }
+
+    /**
+       Attend la réponse à un message : ACK portant la réponse, ou ACK vide suivi d'une réponse séparée.
+
+       @return true si la réponse a été reçue, false en cas de RST ou de délai dépassé.
+    */
+    bool recevoir(const uint16_t id, const unsigned long attente, reponse_t& aReponse, String* aCorps) {
+      uint8_t buf[COAP_BLOC + 64];
+      unsigned long debut = millis();
+      while (millis() - debut < attente) {
+        const int n = lireDatagramme(buf, sizeof(buf));
+        if (n <= 0) {
+          delay(100);
+          continue;
+        }
+        if ((n < 4) || ((buf[0] >> 6) != 1)) continue;    // pas un message CoAP v1
+        const byte type = (buf[0] >> 4) & 0x03;
+        const byte tkl = buf[0] & 0x0f;
+        const uint16_t mid = (buf[2] << 8) | buf[3];
+
+        if ((type == RST) && (mid == id)) return false;
+        if ((type == ACK) && (mid == id) && (buf[1] == 0)) {   // ACK vide : la réponse sera séparée
+          debut = millis();
+          continue;
+        }
+        if ((tkl != 2) || (n < 6) || (buf[4] != (id >> 8)) || (buf[5] != (id & 0xff))) continue;   // pas notre jeton
+        if (type == CON) envoyerAck(mid);
+
+        aReponse.status = (buf[1] >> 5) * 100 + (buf[1] & 0x1f);
+
+        // Options : seul ETag (version de la configuration) est retenu, en hexadécimal ; puis charge utile
+        int i = 4 + tkl;
+        unsigned numero = 0;
+        while ((i < n) && (buf[i] != 0xff)) {
+          unsigned d = buf[i] >> 4;
+          int len = buf[i] & 0x0f;
+          ++i;
+          if (d == 13) d = buf[i++] + 13;
+          else if (d == 14) {
+            d = ((buf[i] << 8) | buf[i + 1]) + 269;
+            i += 2;
+          }
+          if (len == 13) len = buf[i++] + 13;
+          else if (len == 14) {
+            len = ((buf[i] << 8) | buf[i + 1]) + 269;
+            i += 2;
+          }
+          numero += d;
+          if ((numero == 4) && (len <= 8) && (i + len <= n)) {    // ETag
+            for (int k = 0; k < len; ++k) snprintf(aReponse.etag + 2 * k, 3, "%02x", buf[i + k]);
+          }
+          i += len;
+        }
+        if ((i < n) && (buf[i] == 0xff)) {
+          aReponse.contentLength = n - i - 1;
+          if (aCorps) aCorps->concat(reinterpret_cast<const char*>(buf + i + 1), n - i - 1);
+        } else {
+          aReponse.contentLength = 0;
+        }
+        return true;
+      }
+      return false;
+    }
+
+    /**
+       Code une option CoAP.
+
+       @param buf Le tampon recevant l'option.
+       @param delta La différence avec le numéro de l'option précédente (< 269).
+       @param valeur La valeur de l'option.
+       @param len La longueur de la valeur (< 269).
+       @return Le nombre d'octets écrits.
+    */
+    static size_t option(uint8_t buf[], const unsigned delta, const uint8_t valeur[], const size_t len) {
+      size_t l = 1;
+      byte d = delta;
+      byte n = len;
+      if (delta >= 13) {
+        d = 13;
+        buf[l++] = delta - 13;
+      }
+      if (len >= 13) {
+        n = 13;
+        buf[l++] = len - 13;
+      }
+      buf[0] = (d << 4) | n;
+      memcpy(buf + l, valeur, len);
+      return l + len;
+    }
+
+    /**
+       Ouvre la socket UDP COAP_MUX vers le serveur.
+    */
+    bool ouvrir() {
+      const String server = serverName;
+      modem.sendAT(GF("+CIPSTART="), COAP_MUX, GF(",\"UDP\",\""), server, GF("\","), serverPort);
+      const uint8_t r = modem.waitResponse(75000L, GF("CONNECT OK" GSM_NL), GF("CONNECT FAIL" GSM_NL), GF("ALREADY CONNECT" GSM_NL), GF("ERROR" GSM_NL));
+      if ((r != 1) && (r != 3)) {
+        DEBUG(F("Error opening UDP socket in ")); DEBUG(F(__PRETTY_FUNCTION__)); DEBUG(F("!\n"));
+        return false;
+      }
+      return true;
+    }
+
+    /**
+       Ferme la socket UDP.
+    */
+    void fermer() {
+      modem.sendAT(GF("+CIPCLOSE="), COAP_MUX, GF(",1"));
+      modem.waitResponse(GF("CLOSE OK"));
+    }
+
+    /**
+       Envoie un datagramme sur la socket UDP.
+    */
+    bool envoyerDatagramme(const uint8_t msg[], const size_t l) {
+      modem.sendAT(GF("+CIPSEND="), COAP_MUX, ',', l);
+      if (modem.waitResponse(GF(">")) != 1) return false;
+      modem.stream.write(msg, l);
+      modem.stream.flush();
+      // "SEND OK" ou, en mode d'envoi rapide (CIPQSEND=1), "DATA ACCEPT:<mux>,<len>"
+      const uint8_t r = modem.waitResponse(10000L, GF("SEND OK" GSM_NL), GF("DATA ACCEPT:"), GF("ERROR" GSM_NL));
+      if (r == 2) modem.stream.readStringUntil('\n');
+      Budget::compter(l + BUDGET_SURCOUT_UDP, 0);
+      return (r == 1) || (r == 2);
+    }
+
+    /**
+       Acquitte un message confirmable reçu (réponse séparée).
+    */
+    void envoyerAck(const uint16_t mid) {
+      const uint8_t ack[4] = { 0x40 | (ACK << 4), 0, static_cast<uint8_t>(mid >> 8), static_cast<uint8_t>(mid & 0xff) };
+      envoyerDatagramme(ack, sizeof(ack));
+    }
+
+    /**
+       Lit les données reçues sur la socket UDP (mode de réception manuel, CIPRXGET=1).
+
+       @return Le nombre d'octets lus, 0 si aucun, -1 en cas d'erreur.
+    */
+    int lireDatagramme(uint8_t buf[], const size_t taille) {
+      modem.sendAT(GF("+CIPRXGET=2,"), COAP_MUX, ',', taille);
+      // +CIPRXGET: 2,<mux>,<lus>,<restants> ; une notification +CIPRXGET: 1,<mux> peut précéder
+      for (byte i = 0; i < 2; ++i) {
+        if (modem.waitResponse(GF("+CIPRXGET:")) != 1) return -1;
+        if (modem.stream.readStringUntil(',').toInt() == 2) break;
+        modem.stream.readStringUntil('\n');
+        if (i) return -1;
+      }
+      modem.stream.readStringUntil(',');    // mux
+      const int lus = modem.stream.readStringUntil(',').toInt();
+      modem.stream.readStringUntil('\n');   // restants
+      int n = 0;
+      const unsigned long debut = millis();
+      while ((n < lus) && (millis() - debut < 1000)) {
+        if (modem.stream.available()) buf[n++] = modem.stream.read();
+      }
+      modem.waitResponse();
+      if (n > 0) Budget::compter(0, n + BUDGET_SURCOUT_UDP);
+      return n;
+    }
+
+  private:
+    TinyGsm& modem;
+    const __FlashStringHelper* serverName;
+    const int serverPort;
+    uint16_t messageId;
+};
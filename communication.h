@@ -24,15 +24,51 @@
 
 #pragma once
 
-//#define TINY_GSM_MODEM_UBLOX
+// Modem LTE-M/NB-IoT SARA-R4 si défini, SIM800 (2G) sinon.
+//#define MODEM_SARA_R4
+#ifdef MODEM_SARA_R4
+#define TINY_GSM_MODEM_SARAR4
+#else
 #define TINY_GSM_MODEM_SIM800
+#endif
 // #define TINY_GSM_RX_BUFFER 512
 // #define TINY_GSM_TX_BUFFER 512
 #include <TinyGsmClient.h>
-#include <ArduinoHttpClient.h>
+#include "pilote.h"
+
+// Transport des échantillons et des états : CoAP sur UDP si défini, http sinon.
+//#define TRANSPORT_COAP
+#include "transport.h"
 
 #define GSM_RESETN 4
 
+/// Numéro de la passerelle SMS recevant les alertes quand le GPRS est indisponible (peut être défini dans secrets.h).
+#ifndef SMS_GATEWAY
+#define SMS_GATEWAY ""
+#endif
+/// Temps maximum en ms accordé à la connexion GPRS avant de basculer une alerte sur SMS.
+#define SMS_DELAI_GPRS 30000UL
+/// Temps maximum en ms accordé à l'enregistrement GSM pour envoyer une alerte par SMS.
+#define SMS_DELAI_GSM 30000UL
+/// Nombre d'alertes transmises par SMS conservées pour être retransmises en http.
+#define SMS_ATTENTE 4
+
+/// Intervalle minimum en secondes entre deux mesures pendant une rafale.
+#define RAFALE_MESURES_MIN 60
+/// Intervalle minimum en secondes entre deux transmissions pendant une rafale : les mesures sont transmises par lots.
+#define RAFALE_TRANSMISSION_MIN (5*60)
+/// Durée maximum d'une rafale en secondes, une commande oubliée prend fin d'elle-même.
+#define RAFALE_DUREE_MAX (6*3600UL)
+/// Avance maximum en secondes du début d'une rafale sur l'horloge du boîtier (décalage des horloges).
+#define RAFALE_AVANCE_MAX 300UL
+
+/// Période de mise à jour de zone en PSM (SARA-R4), en intervalles de transmission : couvre le plus long (palier MINIMAL).
+#define PSM_PERIODE_MULTIPLE 4
+/// Temps actif en secondes du modem après une transmission en PSM, pour recevoir les SMS.
+#define PSM_ACTIF 60
+/// Cycle eDRX maximum en secondes pendant le temps actif.
+#define EDRX_CYCLE 20
+
 //#define LOG 1
 #ifdef LOG
   #include <StreamDebugger.h>
@@ -54,7 +90,35 @@ class Communication {
     struct sample_t {
       uint32_t epoch;
       const __FlashStringHelper* variable;  //
-      float value;
+      int32_t value;      ///< Valeur entière, à diviser par 10^decimales (ex. mm et 1 décimale pour des cm).
+      byte decimales;
+    };
+
+    /**
+       Structure d'un résumé des échantillons d'une variable sur une tranche de temps.
+    */
+    struct resume_t {
+      uint32_t epoch;                       ///< Début de la tranche.
+      uint32_t duree;                       ///< Durée de la tranche en secondes.
+      const __FlashStringHelper* variable;
+      byte decimales;
+      Statistiques stats;
+    };
+
+    /**
+       Paramètres de fonctionnement reçus du serveur, hors règles d'alerte.
+    */
+    struct parametres_t {
+      int startTime;      ///< Début des mesures en min depuis minuit, -1 si aucun.
+      int stopTime;       ///< Fin des mesures en min depuis minuit, -1 si aucune.
+      int reset;          ///< Heure du reset quotidien en min, -1 si aucun.
+      String sms;         ///< Numéro de la passerelle SMS des alertes, vide si aucune.
+      uint32_t raw;       ///< Heure à partir de laquelle le serveur demande les échantillons bruts résumés, 0 sinon.
+      uint16_t rafaleMesures;         ///< Intervalle entre deux mesures pendant la rafale en secondes.
+      uint16_t rafaleTransmission;    ///< Intervalle entre deux transmissions pendant la rafale en secondes.
+      uint32_t rafaleFin;             ///< Heure de fin de la rafale, 0 si aucune.
+      acquisition_t acquisition;      ///< Intervalles et échantillonnage, conservés en flash.
+      bool diagnostic;                ///< Le serveur demande le diagnostic des mesures de distance.
     };
 
     /**
@@ -84,94 +148,81 @@ class Communication {
     }
 
     /**
-       Requète la liste des paramètres et place les réponses dans les paramètres transmis en référence.
+       Indique où appliquer les paramètres reçus, que ce soit en réponse à getParameters() ou dans la réponse
+       à une transmission d'échantillons ou d'état.
+
+       @param aRtc L'horloge mise à l'heure par l'en-tête Date des réponses.
+       @param aAlertes Le moteur d'alertes dont les règles sont mises à jour.
+       @param aParametres Les autres paramètres.
+    */
+    void lier(RTCZero& aRtc, AlertEngine& aAlertes, parametres_t& aParametres) {
+      pRtc = &aRtc;
+      pAlertes = &aAlertes;
+      pParametres = &aParametres;
+    }
+
+#ifdef MISE_A_JOUR
+    /**
+       Télécharge une plage d'une ressource binaire, le delta d'une mise à jour du firmware.
+
+       @param aPath Le chemin de la ressource.
+       @param aDebut La position du premier octet.
+       @param aLongueur Le nombre d'octets demandés.
+       @param aSortie Reçoit les octets de la plage.
+       @return Le nombre d'octets reçus, 0 en cas d'échec.
+    */
+    size_t telecharger(const String& aPath, const uint32_t aDebut, const uint32_t aLongueur, Print& aSortie) const {
+      if (!connectGSMGPRS(GPRS_CONNECTION)) {
+        DEBUG(F("No success connecting GPRS and downloading in ")); DEBUG(F(__PRETTY_FUNCTION__)); DEBUG(F("!\n"));
+        return 0;
+      }
+      reponse_t reponse;
+      const size_t n = uplink.telecharger(aPath, aDebut, aLongueur, aSortie, reponse);
+      if (reponse.status != 206) {
+        DEBUG(F("HTTP Response ")); DEBUG(reponse.status); DEBUG(F(" instead of 206 in ")); DEBUG(F(__PRETTY_FUNCTION__)); DEBUG(F("!\n"));
+      }
+      return n;
+    }
+
+#endif
+    /**
+       Requète la liste des paramètres et les applique aux éléments indiqués par lier().
+       Depuis que les réponses aux transmissions portent la version de la configuration (ETag) et, si elle a changé,
+       les paramètres eux-mêmes, cette requête n'est plus qu'un repli : voir parametresAJour().
 
        @param aIMEI Une chaîne contenant le numéro IMEI du device.
-       @param aRtc Une structure contenant l'heure pour mise à jour à partir de la réponse.
-       @return Une chaîne JSON contenant chaque paramètre et sa valeur.
+       @return true si les paramètres ont été reçus et appliqués.
     */
-    bool getParameters(const String aIMEI, RTCZero& rtc, Alert& alert1, Alert& alert2, byte& startTime, byte& stopTime, int& reset) const {
+    bool getParameters(const String aIMEI) const {
       if (!connectGSMGPRS(GPRS_CONNECTION)) {
         DEBUG(F("No success connecting GPRS and getting parameters in ")); DEBUG(F(__PRETTY_FUNCTION__)); DEBUG(F("!\n"));
         return false;
       }
       
-      // for timing out while loops
-      const unsigned long timeout = 60000; //the timeout in milliseconds
-      unsigned long loopStartingTime;
-      
-      TinyGsmClient client(modem);
-      
-      const String server = serverName;
-      HttpClient http = HttpClient(client, server, serverPort);
-      http.sendHeader(F("Host"), server);
-      http.sendHeader(F("Connection: close"));
-      http.sendHeader(F("Accept: application/json;charset=utf-8"));
-
       const String path = String(F("/device/GSM-")) + aIMEI + F("/parameters");
-      DEBUG("GET "); DEBUG(path); DEBUG('\n');
-
-      int status;
-      for (int i = 0; i < 3; ++i) {
-        const int err = http.get(path);
-        if (err != 0) {
-          DEBUG(F("Error on GET (")); DEBUG(err); DEBUG(F(") in ")); DEBUG(F(__PRETTY_FUNCTION__)); DEBUG(F("!\n"));
-          delay(500);
-          continue;
-        }
-        status = http.responseStatusCode();
-        if (status <= 0) {
-          DEBUG(F("Internal error on GET (")); DEBUG(status); DEBUG(F(") in ")); DEBUG(F(__PRETTY_FUNCTION__)); DEBUG(F("!\n'"));
-          delay(500);
-          continue; // un autre essai!
-        } else {
-          DEBUG(F("HTTP Response : ")); DEBUG(status); DEBUG('\n');
-          break;
-        }
-      }
-      if (status <= 0) return false;
-
-      loopStartingTime = millis();
-      while (!http.endOfHeadersReached() && ((millis() - loopStartingTime) < timeout)) {
-        if (http.headerAvailable()) {
-          const String name = http.readHeaderName();
-          const String value = http.readHeaderValue();
-          DEBUG(F("Header ")); DEBUG(name); DEBUG(':'); DEBUG(value); DEBUG('\n');
-
-          if (name.equalsIgnoreCase(F("Date"))) {
-            struct tm tm;
-            strptime(value.c_str(), "%a, %e %h %Y %H:%M:%S %z", &tm);
-            rtc.setTime(tm.tm_hour, tm.tm_min, tm.tm_sec);
-            rtc.setDate(tm.tm_mday, tm.tm_mon + 1, tm.tm_year % 100);
-          }
-        }
-      }
-
-      const String body = http.responseBody();
-      DEBUG(F("Body: ")); DEBUG(body); DEBUG('\n');
-//      client.stop();
-
-      DynamicJsonBuffer jsonBuffer(JSON_OBJECT_SIZE(6) + 60);
-      const JsonObject& root = jsonBuffer.parseObject(body);
-
-      if (root.containsKey("limit1R") && root.containsKey("hyst1R")) {
-        alert1 = Alert(root["limit1R"], root["hyst1R"]);
-      }
-      if (root.containsKey("limit2O") && root.containsKey("hyst2O")) {
-        alert2 = Alert(root["limit2O"], root["hyst2O"]);
-      }
-
-      startTime = root["start"];
-      stopTime = root["stop"];
+      reponse_t reponse;
+      String body;
+      if (!http.requete(F("GET"), path, String(), reponse, &body)) return false;
+      if (reponse.status / 100 != 2) return false;
+
+      regler(reponse);
+      if (!appliquer(body)) return false;
+      copierVersion(reponse);
+      return true;
+    }
 
-      if (root.containsKey("reset")) {
-        const String s = root["reset"];
-        const byte hh = s.toInt();
-        const byte mm = s.substring(s.indexOf(':') + 1).toInt();
-        reset = hh * 60U + mm;
-      } else reset = -1;
+    /**
+       Indique si la dernière réponse reçue depuis l'appel précédent a confirmé que les paramètres sont à jour,
+       soit parce que sa version est celle déjà appliquée, soit parce qu'elle contenait les nouveaux paramètres.
+       Dans le cas contraire (serveur sans version, version changée sans paramètres, aucune réponse), getParameters()
+       doit être appelée.
 
-      return true;
+       @return true si getParameters() est inutile.
+    */
+    bool parametresAJour() const {
+      const bool r = aJour;
+      aJour = false;
+      return r;
     }
 
     /**
@@ -183,6 +234,86 @@ class Communication {
       return sendSamples(&sample, 1, aIMEI);
     }
 
+    /**
+       Lit les SMS non lus, par exemple pour réveiller un device en veille pendant une crue, puis les efface.
+       Seule la commande de rafale d'un SMS contenant un objet JSON est prise en compte :
+       {"burst":{"mesures":60,"transmission":300,"duree":120}} (voir appliquerRafale()).
+       Seuls les SMS de la passerelle SMS sont pris en compte : sans passerelle définie, tous sont ignorés et effacés,
+       n'importe quel numéro pouvant sinon commander une rafale et vider la batterie.
+       Un modem éteint ou en veille profonde (PSM) n'est pas interrogé : le réseau lui garde ses SMS jusqu'au temps actif
+       qui suit la transmission suivante.
+
+       @return true si une commande a été appliquée.
+    */
+    bool lireSms() const {
+      if (!pParametres || eteint || !pilote.joignable()) return false;
+      modem.sendAT(GF("+CMGF=1"));
+      if (modem.waitResponse() != 1) return false;
+      modem.sendAT(GF("+CMGL=\"REC UNREAD\""));
+      bool applique = false;
+      while (modem.waitResponse(5000L, GF("+CMGL:"), GF("OK" GSM_NL), GF("ERROR" GSM_NL)) == 1) {
+        const String entete = modem.stream.readStringUntil('\n');   // 1,"REC UNREAD","+336...","","18/08/03,10:00:00+08"
+        const String texte = modem.stream.readStringUntil('\n');
+        const int debut = entete.indexOf(F("\",\"")) + 3;
+        const String expediteur = entete.substring(debut, entete.indexOf('"', debut));
+        DEBUG(F("SMS de ")); DEBUG(expediteur); DEBUG(F(" : ")); DEBUG(texte); DEBUG('\n');
+        if (!pParametres->sms.length() || (expediteur != pParametres->sms)) continue;
+
+        DynamicJsonBuffer jsonBuffer(JSON_OBJECT_SIZE(4) + 60);
+        const JsonObject& root = jsonBuffer.parseObject(texte);
+        if (root.success() && root.containsKey("burst")) {
+          appliquerRafale(root["burst"]);
+          applique = true;
+        }
+      }
+      modem.sendAT(GF("+CMGD=1,1"));    // efface tous les SMS lus (3GPP TS 27.005), SIM800 comme SARA-R4
+      modem.waitResponse();
+      return applique;
+    }
+
+    /**
+       Transmet une alerte en http si la connexion GPRS s'établit dans le temps imparti, par SMS sinon.
+       Une alerte transmise par SMS est conservée et retransmise en http, avec le même epoch, lors
+       de la prochaine transmission réussie ; le serveur écarte le doublon.
+       Sans passerelle, il n'y a pas de bascule à préparer : l'alerte suit la connexion complète, avec ses réessais et son hard reset.
+
+       @param sample L'échantillon d'alerte.
+       @param aGateway Le numéro de la passerelle SMS, pas de SMS si vide.
+       @return Le succès de la transmission par l'un ou l'autre moyen, ou pas.
+    */
+    bool sendAlert(const sample_t& sample, const String& aIMEI, const String& aGateway) const {
+      if (aGateway.length() == 0) return sendSample(sample, aIMEI);
+      if (connectGSMGPRS(GPRS_CONNECTION, 1, SMS_DELAI_GPRS) && sendSample(sample, aIMEI)) return true;
+
+      DEBUG(F("GPRS indisponible, alerte par SMS au ")); DEBUG(aGateway); DEBUG('\n');
+      if (!connectGSMGPRS(GSM_CONNECTION, 1, SMS_DELAI_GSM)) {
+        DEBUG(F("No success connecting GSM in ")); DEBUG(F(__PRETTY_FUNCTION__)); DEBUG(F("!\n"));
+        return false;
+      }
+
+      String texte(F("GSM-"));
+      texte += aIMEI;
+      texte += ' ';
+      texte += sample.epoch;
+      texte += ' ';
+      texte += sample.variable;
+      texte += ' ';
+      texte += valeur(sample);
+      DEBUG(F("SMS: ")); DEBUG(texte); DEBUG('\n');
+      if (!modem.sendSMS(aGateway, texte)) {
+        DEBUG(F("Error sending SMS in ")); DEBUG(F(__PRETTY_FUNCTION__)); DEBUG(F("!\n"));
+        return false;
+      }
+
+      if (nbAttente < SMS_ATTENTE) {
+        attente[nbAttente++] = sample;
+      } else {  // on oublie la plus ancienne
+        for (byte i = 1; i < SMS_ATTENTE; ++i) attente[i - 1] = attente[i];
+        attente[SMS_ATTENTE - 1] = sample;
+      }
+      return true;
+    }
+
     /**
        Transmet plusieurs échantillons sample_t sérialisés sous la forme JSON d'un tableau d'éléments.
        @param samples Les échantillons à traduire en JSON avant de les transmettre. Tout le tableau est transmis.
@@ -197,77 +328,63 @@ class Communication {
        Transmet plusieurs échantillons sample_t sérialisés sous la forme JSON d'un tableau d'éléments.
        @param samples Les échantillons à traduire en JSON avant de les transmettre.
        @param n Le nombre d'échantillons du tableau à transmettre (premiers).
+       @param aResume Un résumé ajouté au tableau, celui de l'intervalle de transmission, ou NULL.
        @return Le succès de la transmission, ou pas.
     */
-    bool sendSamples(const sample_t samples[], const size_t n, const String& aIMEI) const {
+    bool sendSamples(const sample_t samples[], const size_t n, const String& aIMEI, const resume_t* aResume = NULL) const {
       if (!connectGSMGPRS(GPRS_CONNECTION)) {
         DEBUG(F("No success connecting GPRS and sending samples in ")); DEBUG(F(__PRETTY_FUNCTION__)); DEBUG(F("!\n"));
         return false;
       }
 
-      // for timing out while loops
-      const unsigned long timeout = 60000; //the timeout in milliseconds
-      unsigned long loopStartingTime;
+      const String path = String(F("/device/GSM-")) + aIMEI + F("/samples");
 
-      TinyGsmClient client(modem);
-      
-      const String server = serverName;
-      HttpClient http = HttpClient(client, server, serverPort);
-      http.sendHeader(F("Host"), server);
-      http.sendHeader(F("Connection: close"));
+      const String json = Communication::json(samples, n, aResume);
+      DEBUG(json); DEBUG('\n');
+      Memoire::point(Memoire::COMMUNICATION);
+
+      reponse_t reponse;
+      String corps;
+      if (!uplink.requete(F("PUT"), path, json, reponse, &corps)) return false;
+      suivre(reponse, corps);
+
+      // Retransmission en http des alertes déjà envoyées par SMS
+      if (nbAttente > 0) {
+        const byte n = nbAttente;
+        nbAttente = 0;    // évite la récursion
+        if (!sendSamples(attente, n, aIMEI)) nbAttente = n;
+      }
+      return true;
+    }
+
+    /**
+       Transmet des résumés sérialisés sous la forme JSON d'un tableau d'éléments, sur la même ressource que les échantillons :
+       {"epoch":..,"key":..,"period":..,"n":..,"min":..,"max":..,"mean":..,"last":..}.
+       @param resumes Les résumés à transmettre.
+       @param n Le nombre de résumés du tableau à transmettre (premiers).
+       @return Le succès de la transmission, ou pas.
+    */
+    bool sendSummaries(const resume_t resumes[], const size_t n, const String& aIMEI) const {
+      if (!connectGSMGPRS(GPRS_CONNECTION)) {
+        DEBUG(F("No success connecting GPRS and sending summaries in ")); DEBUG(F(__PRETTY_FUNCTION__)); DEBUG(F("!\n"));
+        return false;
+      }
 
       const String path = String(F("/device/GSM-")) + aIMEI + F("/samples");
-      DEBUG("PUT "); DEBUG(path); DEBUG('\n');
 
       String json('[');
       for (size_t i = 0; i < n; ++i) {
-        const sample_t& sample = samples[i];
-        json += (i ? F(",{") : F("{"));
-        json += F("\"epoch\":\"");
-        json += sample.epoch;
-        json += F("\",\"key\":\"");
-        json += sample.variable;
-        json += F("\",\"value\":\"");
-        json += String(sample.value);
-        json += F("\"}");
+        if (i) json += ',';
+        json += resume(resumes[i]);
       }
       json += ']';
       DEBUG(json); DEBUG('\n');
+      Memoire::point(Memoire::COMMUNICATION);
 
-      const String contentType(F("application/json"));
-
-      int status;
-      for (int i = 0; i < 3; ++i) {
-        const int err = http.put(path, contentType, json);
-        if (err != 0) {
-          DEBUG(F("Error on PUT (")); DEBUG(err); DEBUG(F(") in ")); DEBUG(F(__PRETTY_FUNCTION__)); DEBUG(F("!\n"));
-          delay(500);
-          continue;
-        }
-        status = http.responseStatusCode();
-        if (status <= 0) {
-          DEBUG(F("Internal error on PUT (")); DEBUG(status); DEBUG(F(")!\n'"));
-          delay(500);
-          continue; // un autre essai!
-        } else {
-          DEBUG(F("HTTP Response : ")); DEBUG(status); DEBUG('\n');
-          break;
-        }
-      }
-      if (status <= 0) return false;
-
-     loopStartingTime = millis();
-      while (!http.endOfHeadersReached() && ((millis() - loopStartingTime) < timeout)) {
-        if (http.headerAvailable()) {
-          const String name = http.readHeaderName();
-          const String value = http.readHeaderValue();
-          DEBUG(F("Header ")); DEBUG(name); DEBUG(':'); DEBUG(value); DEBUG('\n');
-        }
-      }
-      const String body = http.responseBody();
-      DEBUG(F("Body: ")); DEBUG(body); DEBUG('\n');
-
-//      client.stop();
+      reponse_t reponse;
+      String corps;
+      if (!uplink.requete(F("PUT"), path, json, reponse, &corps)) return false;
+      suivre(reponse, corps);
       return true;
     }
 
@@ -276,30 +393,24 @@ class Communication {
        - L'heure mémorisée au moment de la transmission ;
        - L'état tel que passé en paramètre ;
        - L'IP du périphérique ;
+       - Les diagnostics mémoire (voir Memoire::json()) ;
+       - La consommation du forfait de données (voir Budget::json()) ;
+       - L'état de la batterie et le palier d'énergie (voir Energie::json()) ;
+       - Les serveurs de l'API, leur temps de réponse et leurs échecs (voir Serveurs::json()) ;
+       - en CAPTURE et REJEU, ni la mémoire ni les serveurs, qui ne se rejouent pas à l'identique ;
+       - Le diagnostic des mesures de distance s'il est fourni (voir Diagnostic::json()).
 
        @param aState L'état transmis dans le flux Json.
+       @param aDiagnostic L'objet Json du diagnostic des mesures de distance, vide si aucun.
        @return Le succès de la transmission, ou pas.
     */
-    bool sendStatus(RTCZero& aRTC, const String& aState, const String& aIMEI) const {
+    bool sendStatus(RTCZero& aRTC, const String& aState, const String& aIMEI, const Energie& aEnergie, const String& aDiagnostic = String()) const {
       if (!connectGSMGPRS(GPRS_CONNECTION)) {
         DEBUG(F("No success connecting GPRS and sending status in ")); DEBUG(F(__PRETTY_FUNCTION__)); DEBUG(F("!\n"));
         return false;
       }
 
-      // for timing out while loops
-      const unsigned long timeout = 60000; //the timeout in milliseconds
-      unsigned long loopStartingTime;
-      
-
-      TinyGsmClient client(modem);
-      
-      const String server = serverName;
-      HttpClient http = HttpClient(client, server, serverPort);
-      http.sendHeader(F("Host"), server);
-      http.sendHeader(F("Connection: close"));
-
       const String path = String(F("/device/GSM-")) + aIMEI + F("/status");
-      DEBUG("PUT "); DEBUG(path); DEBUG('\n');
 
       char buffer[25];
       snprintf(buffer, sizeof(buffer), "%04d-%02d-%02dT%02d:%02d:%02dZ", 2000 + aRTC.getYear(), aRTC.getMonth(), aRTC.getDay(), aRTC.getHours(), aRTC.getMinutes(), aRTC.getSeconds() );
@@ -309,43 +420,93 @@ class Communication {
       json += aState;
       json += F("\",\"IP\":\"");
       json += modem.getLocalIP();
-      json += F("\"}");
-      const String contentType(F("application/json"));
-
-      int status;
-      for (int i = 0; i < 3; ++i) {
-        const int err = http.put(path, contentType, json);
-        if (err != 0) {
-          DEBUG(F("Error on PUT (")); DEBUG(err); DEBUG(F(") in ")); DEBUG(F(__PRETTY_FUNCTION__)); DEBUG(F("!\n"));
-          delay(500);
-          continue;
-        }
-        status = http.responseStatusCode();
-        if (status <= 0) {
-          DEBUG(F("Internal error on PUT (")); DEBUG(status); DEBUG(F(") in ")); DEBUG(F(__PRETTY_FUNCTION__)); DEBUG(F("!\n"));
-          delay(500);
-          continue; // un autre essai!
-        } else {
-          DEBUG(F("HTTP Response : ")); DEBUG(status); DEBUG('\n');
-          break;
-        }
+#if defined(CAPTURE) || defined(REJEU)
+      // La mémoire dépend de la compilation et les temps de réponse des serveurs de l'horloge, ni l'une ni les autres
+      // ne se rejouent à l'identique : pas de diagnostic d'exécution
+      json += F("\",\"data\":");
+      json += Budget::json(aRTC.getEpoch());
+      json += F(",\"power\":");
+      json += aEnergie.json();
+#else
+      json += F("\",\"mem\":");
+      json += Memoire::json();
+      json += F(",\"data\":");
+      json += Budget::json(aRTC.getEpoch());
+      json += F(",\"power\":");
+      json += aEnergie.json();
+      json += F(",\"servers\":");
+      json += Serveurs::json();
+#endif
+      json += F(",\"fw\":");
+      json += FIRMWARE_VERSION;
+      if (aDiagnostic.length()) {
+        json += F(",\"range\":");
+        json += aDiagnostic;
       }
-      if (status <= 0) return false;
+      json += '}';
 
+      reponse_t reponse;
+      String corps;
+      if (!uplink.requete(F("PUT"), path, json, reponse, &corps)) return false;
+      suivre(reponse, corps);
+      return true;
+    }
 
-      loopStartingTime = millis();
-      while (!http.endOfHeadersReached() && ((millis() - loopStartingTime) < timeout)) {
-        if (http.headerAvailable()) {
-          const String name = http.readHeaderName();
-          const String value = http.readHeaderValue();
-          DEBUG(F("Header ")); DEBUG(name); DEBUG(':'); DEBUG(value); DEBUG('\n');
-        }
-      }
-      const String body = http.responseBody();
-      DEBUG(F("Body: ")); DEBUG(body); DEBUG('\n');
+    /**
+       Négocie la veille du modem avec le réseau (PSM & eDRX), sans effet avec le SIM800.
+       Le modem reste alors enregistré pendant sa veille et une transmission au réveil ne refait pas l'attachement ;
+       les SMS ne sont reçus que pendant le temps actif suivant chaque transmission.
+
+       @param aPeriode La période de mise à jour de zone en secondes, au moins l'intervalle entre deux transmissions.
+       @param aActif Le temps actif en secondes après une transmission.
+       @param aCycle Le cycle eDRX maximum en secondes pendant le temps actif.
+       @return true si la veille a été acceptée.
+    */
+    bool economiser(const uint32_t aPeriode, const uint32_t aActif, const uint32_t aCycle) const {
+      return pilote.economiser(aPeriode, aActif, aCycle);
+    }
 
-//      client.stop();
-      return true;
+    /**
+       Éteint le modem jusqu'à la prochaine connexion, qui le rallumera par un reset matériel.
+       Les SMS ne sont plus lus pendant ce temps.
+       Un modem en PSM n'est pas éteint : sa veille consomme aussi peu et conserve l'enregistrement.
+
+       @param complet Éteint aussi un modem en PSM, pour une longue dormance.
+    */
+    void eteindre(const bool complet = false) const {
+      if (!complet && pilote.veilleProfonde()) return;
+      DEBUG(F("Extinction du modem.\n"));
+      modem.poweroff();
+      eteint = true;
+    }
+
+    /**
+       Un modem en veille profonde (PSM) est réveillé d'abord : il ne répondrait pas à AT+CSQ.
+
+       @return La qualité du signal (CSQ, 0 à 31), 99 si inconnue ou si le modem est éteint.
+    */
+    int qualiteSignal() const {
+      if (eteint) return 99;
+      pilote.reveiller();
+      return modem.getSignalQuality();
+    }
+
+    /**
+       Retourne la durée du dernier attachement GPRS, puis l'oublie.
+
+       @return La durée en ms, 0 si aucun attachement n'a eu lieu depuis l'appel précédent.
+    */
+    unsigned long dureeAttache() const {
+      const unsigned long d = attache;
+      attache = 0;
+      return d;
+    }
+
+    /**
+       @return true si le modem a été éteint par eteindre() et pas encore rallumé.
+    */
+    bool estEteint() const {
+      return eteint;
     }
 
     /**
@@ -378,6 +539,345 @@ class Communication {
     }
 
   protected:
+    /**
+       Exploite la réponse à une transmission : mise à l'heure et, si la version de la configuration a changé,
+       application des paramètres contenus dans le corps.
+
+       @param reponse La réponse.
+       @param corps Le corps de la réponse, vide s'il ne contient pas de paramètres.
+    */
+    void suivre(const reponse_t& reponse, const String& corps) const {
+      if (reponse.status / 100 != 2) return;
+      regler(reponse);
+      if (!reponse.etag[0]) return;   // Serveur sans version : repli sur getParameters()
+      if (!strcmp(version, reponse.etag)) {
+        aJour = true;
+        return;
+      }
+      DEBUG(F("Nouvelle configuration ")); DEBUG(reponse.etag); DEBUG('\n');
+      aJour = corps.length() && appliquer(corps);   // Sans corps, une réponse antérieure ne doit pas dispenser de getParameters()
+      if (aJour) copierVersion(reponse);
+    }
+
+    /**
+       Met la RTC à l'heure de l'en-tête Date d'une réponse.
+    */
+    void regler(const reponse_t& reponse) const {
+      if (!pRtc || !reponse.date[0]) return;
+      struct tm tm;
+      strptime(reponse.date, "%a, %e %h %Y %H:%M:%S %z", &tm);
+      pRtc->setTime(tm.tm_hour, tm.tm_min, tm.tm_sec);
+      pRtc->setDate(tm.tm_mday, tm.tm_mon + 1, tm.tm_year % 100);
+    }
+
+    void copierVersion(const reponse_t& reponse) const {
+      strncpy(version, reponse.etag, sizeof(version) - 1);
+      version[sizeof(version) - 1] = '\0';
+    }
+
+    /**
+       Applique les paramètres d'un objet JSON aux éléments indiqués par lier().
+
+       @param body L'objet JSON des paramètres.
+       @return false si le corps n'est pas un objet JSON.
+    */
+    bool appliquer(const String& body) const {
+      if (!pAlertes || !pParametres) return false;
+      AlertEngine& alertes = *pAlertes;
+      parametres_t& parametres = *pParametres;
+
+      DynamicJsonBuffer jsonBuffer(JSON_OBJECT_SIZE(6) + 60);
+      const JsonObject& root = jsonBuffer.parseObject(body);
+      Memoire::point(Memoire::PARAMETRES);
+      if (!root.success()) return false;
+
+      // Alertes historiques Rouge & Orange : seuils de niveau
+      if (root.containsKey("limit1R") && root.containsKey("hyst1R")) {
+        configurerNiveau(alertes, 0, root["limit1R"], root["hyst1R"]);
+      }
+      if (root.containsKey("limit2O") && root.containsKey("hyst2O")) {
+        configurerNiveau(alertes, 1, root["limit2O"], root["hyst2O"]);
+      }
+
+      // Intervalle des mesures avant les règles, qui en dépendent
+      if (root.containsKey("acquisition")) appliquerAcquisition(root["acquisition"]);
+
+      // Règles supplémentaires : [{"type":"niveau"|"vitesse","sens":"montee"|"descente","seuil":cm|cm/min,"ecart":..,"fenetre":min,"n":mesures},...]
+      if (root.containsKey("rules")) {
+        const JsonArray& regles = root["rules"].as<JsonArray>();
+        for (byte i = 2; i < ALERT_REGLES_MAX; ++i) {
+          if (i - 2U >= regles.size()) {
+            alertes.desactiver(i);
+            continue;
+          }
+          const JsonObject& r = regles[i - 2];
+          const String type = r["type"];
+          const String sens = r["sens"];
+          AlertEngine::regle_t regle;
+          regle.type = type.equalsIgnoreCase(F("vitesse")) ? AlertEngine::VITESSE : AlertEngine::NIVEAU;
+          regle.sens = sens.equalsIgnoreCase(F("descente")) ? AlertEngine::DESCENTE : AlertEngine::MONTEE;
+          const long echelle = (regle.type == AlertEngine::VITESSE) ? 100 : 10;   // cm/min -> 1/100 cm/min, cm -> mm
+          regle.seuil = lround(r["seuil"].as<float>() * echelle);
+          regle.ecart = lround(r["ecart"].as<float>() * echelle);
+          regle.fenetre = r.containsKey("fenetre") ? r["fenetre"].as<uint16_t>() : 15;
+          const uint16_t fenetreMax = AlertEngine::fenetreMax(parametres.acquisition.mesures);
+          if ((regle.type == AlertEngine::VITESSE) && (regle.fenetre > fenetreMax)) {
+            DEBUG(F("Regle alert")); DEBUG(i + 1); DEBUG(F(" : fenetre de ")); DEBUG(regle.fenetre);
+            DEBUG(F(" min ramenee a ")); DEBUG(fenetreMax); DEBUG(F(" min (historique)\n"));
+            regle.fenetre = fenetreMax;
+          }
+          regle.persistance = r.containsKey("n") ? r["n"].as<byte>() : 1;
+          alertes.configurer(i, regle);
+        }
+      }
+
+      // Fenêtre de mesure "HH:MM" ou heure entière, 0 ou vide si aucune ; absente, la fenêtre en cours est conservée
+      if (root.containsKey("start")) {
+        const int debut = minutes(root["start"].as<String>());
+        parametres.startTime = (debut > 0) ? debut : -1;
+      }
+      if (root.containsKey("stop")) {
+        const int fin = minutes(root["stop"].as<String>());
+        parametres.stopTime = (fin > 0) ? fin : -1;
+      }
+
+      if (root.containsKey("reset")) parametres.reset = minutes(root["reset"].as<String>());
+
+      if (root.containsKey("sms")) {
+        const String s = root["sms"];
+        parametres.sms = s;
+      }
+
+      if (root.containsKey("raw")) parametres.raw = root["raw"].as<uint32_t>();
+      if (root.containsKey("diag")) parametres.diagnostic = root["diag"].as<bool>();
+
+      if (root.containsKey("burst")) appliquerRafale(root["burst"]);
+      if (root.containsKey("servers")) appliquerServeurs(root["servers"]);
+#ifdef MISE_A_JOUR
+      if (root.containsKey("firmware")) appliquerFirmware(root["firmware"]);
+#endif
+
+      return true;
+    }
+
+    /**
+       Convertit une heure de la journée en minutes depuis minuit.
+
+       @param s L'heure "HH:MM", ou "HH" pour une heure entière.
+       @return Les minutes depuis minuit, -1 si la chaîne est vide ou l'heure invalide.
+    */
+    static int minutes(const String& s) {
+      if (!s.length()) return -1;
+      const int deuxPoints = s.indexOf(':');
+      const long hh = s.toInt();
+      const long mm = (deuxPoints < 0) ? 0 : s.substring(deuxPoints + 1).toInt();
+      if ((hh < 0) || (hh > 23) || (mm < 0) || (mm > 59)) return -1;
+      return hh * 60 + mm;
+    }
+
+#ifdef MISE_A_JOUR
+    /**
+       Annonce une mise à jour du firmware {"version":..,"fromSize":..,"fromSha256":..,"path":..,"size":..,"sha256":..} :
+       le delta de la ressource path (size octets) transforme l'image de fromSize octets et de SHA-256 fromSha256
+       en la version version, dont l'image a pour SHA-256 sha256. Voir MiseAJour.
+
+       @param firmware L'objet JSON de la mise à jour.
+    */
+    void appliquerFirmware(const JsonObject& firmware) const {
+      const uint16_t version = min(firmware["version"].as<unsigned long>(), 0xffffUL);
+      if (!MiseAJour::annoncer(version, firmware["fromSize"].as<uint32_t>(), firmware["fromSha256"].as<String>(),
+                               firmware["path"].as<String>(), firmware["size"].as<uint32_t>(), firmware["sha256"].as<String>())) {
+        DEBUG(F("Mise a jour ignoree.\n"));
+      }
+    }
+
+#endif
+    /**
+       Applique une liste de serveurs de l'API ["hote:port",...] par ordre de préférence, le port 80 par défaut.
+       Les serveurs au nom trop long sont ignorés ; une liste vide rétablit le serveur compilé.
+
+       @param liste Le tableau JSON des serveurs.
+    */
+    void appliquerServeurs(const JsonArray& liste) const {
+      serveur_t serveurs[SERVEURS_MAX];
+      byte n = 0;
+      for (size_t i = 0; (i < liste.size()) && (n < SERVEURS_MAX); ++i) {
+        const String s = liste[i].as<String>();
+        const int deuxPoints = s.indexOf(':');
+        const String hote = (deuxPoints < 0) ? s : s.substring(0, deuxPoints);
+        const long port = (deuxPoints < 0) ? 80 : s.substring(deuxPoints + 1).toInt();
+        if (!hote.length() || (hote.length() >= SERVEURS_HOTE) || (port <= 0) || (port > 0xffff)) continue;
+        strcpy(serveurs[n].hote, hote.c_str());
+        serveurs[n].port = port;
+        ++n;
+      }
+      Serveurs::configurer(serveurs, n);
+    }
+
+    /**
+       Applique des paramètres d'acquisition {"mesures":s,"transmission":s,"echantillons":n,"tentatives":n,"petites":bool}.
+       Les clés absentes conservent leur valeur, les valeurs hors bornes ne sont pas tronquées ; l'ensemble est refusé s'il n'est pas valide (voir Acquisition::valide()),
+       sinon il est enregistré en flash et survit aux resets. Un nouvel intervalle de transmission renégocie la veille du modem (voir economiser()).
+
+       @param objet L'objet JSON des paramètres.
+    */
+    void appliquerAcquisition(const JsonObject& objet) const {
+      acquisition_t a = pParametres->acquisition;
+      if (objet.containsKey("mesures")) a.mesures = min(objet["mesures"].as<unsigned long>(), 0xffffUL);
+      if (objet.containsKey("transmission")) a.transmission = min(objet["transmission"].as<unsigned long>(), 0xffffUL);
+      if (objet.containsKey("echantillons")) a.echantillons = min(objet["echantillons"].as<unsigned long>(), 0xffUL);
+      if (objet.containsKey("tentatives")) a.tentatives = min(objet["tentatives"].as<unsigned long>(), 0xffUL);
+      if (objet.containsKey("petites")) a.petitesTrames = objet["petites"].as<bool>();
+      if (!Acquisition::valide(a)) {
+        DEBUG(F("Parametres d'acquisition invalides, ignores.\n"));
+        return;
+      }
+      const bool periode = (a.transmission != pParametres->acquisition.transmission);
+      pParametres->acquisition = a;
+      Acquisition::enregistrer(a);
+      if (periode) economiser(PSM_PERIODE_MULTIPLE * a.transmission, PSM_ACTIF, EDRX_CYCLE);
+      DEBUG(F("Acquisition : mesures ")); DEBUG(a.mesures); DEBUG(F("s, transmissions ")); DEBUG(a.transmission);
+      DEBUG(F("s, ")); DEBUG(a.echantillons); DEBUG(F(" echantillons pour ")); DEBUG(a.tentatives); DEBUG(F(" tentatives\n"));
+    }
+
+    /**
+       Applique une commande de rafale {"mesures":s,"transmission":s,"duree":min,"debut":epoch}.
+       Les intervalles sont arrondis à la minute et bornés par RAFALE_MESURES_MIN et RAFALE_TRANSMISSION_MIN,
+       la durée par RAFALE_DUREE_MAX ; une durée nulle met fin à la rafale.
+       Sans "debut", la rafale commence à la réception ; avec, une même commande reçue plusieurs fois ne la prolonge pas.
+       Un début postérieur à la réception est ramené à celle-ci, et la commande est ignorée s'il la dépasse de plus
+       de RAFALE_AVANCE_MAX : la rafale ne dure jamais plus de RAFALE_DUREE_MAX à partir de la réception.
+
+       @param rafale L'objet JSON de la commande.
+    */
+    void appliquerRafale(const JsonObject& rafale) const {
+      parametres_t& parametres = *pParametres;
+      const uint32_t maintenant = pRtc ? pRtc->getEpoch() : 0;
+      const uint32_t debut = rafale.containsKey("debut") ? rafale["debut"].as<uint32_t>() : maintenant;
+      if (debut > maintenant + RAFALE_AVANCE_MAX) {
+        DEBUG(F("Rafale future ignoree : debut ")); DEBUG(debut); DEBUG(F(", heure ")); DEBUG(maintenant); DEBUG('\n');
+        return;
+      }
+      const uint32_t duree = min(60UL * rafale["duree"].as<uint16_t>(), RAFALE_DUREE_MAX);
+      const uint16_t mesures = rafale["mesures"].as<uint16_t>() / 60 * 60;
+      const uint16_t transmission = rafale["transmission"].as<uint16_t>() / 60 * 60;
+      parametres.rafaleMesures = max(mesures, static_cast<uint16_t>(RAFALE_MESURES_MIN));
+      parametres.rafaleTransmission = max(transmission, static_cast<uint16_t>(RAFALE_TRANSMISSION_MIN));
+      const uint32_t fin = min(debut, maintenant) + duree;
+      parametres.rafaleFin = (fin > maintenant) ? fin : 0;
+      DEBUG(F("Rafale : mesures ")); DEBUG(parametres.rafaleMesures); DEBUG(F("s, transmissions ")); DEBUG(parametres.rafaleTransmission);
+      DEBUG(F("s, fin ")); DEBUG(parametres.rafaleFin); DEBUG('\n');
+    }
+
+    /**
+       Sérialise des échantillons en un tableau JSON.
+
+       @param samples Les échantillons.
+       @param n Le nombre d'échantillons du tableau à sérialiser (premiers).
+       @param aResume Un résumé ajouté au tableau, ou NULL.
+       @return [{"epoch":..,"key":..,"value":..},...] suivi du résumé.
+    */
+    static String json(const sample_t samples[], const size_t n, const resume_t* aResume) {
+      String json('[');
+      for (size_t i = 0; i < n; ++i) {
+        const sample_t& sample = samples[i];
+        json += (i ? F(",{") : F("{"));
+        json += F("\"epoch\":\"");
+        json += sample.epoch;
+        json += F("\",\"key\":\"");
+        json += sample.variable;
+        json += F("\",\"value\":\"");
+        json += valeur(sample);
+        json += F("\"}");
+      }
+      if (aResume) {
+        if (n) json += ',';
+        json += resume(*aResume);
+      }
+      json += ']';
+      return json;
+    }
+
+    /**
+       Sérialise un résumé en un objet JSON.
+
+       @param r Le résumé.
+       @return {"epoch":..,"key":..,"period":..,"n":..,"min":..,"max":..,"mean":..,"last":..[,"sd":..]} ;
+               sd, l'écart-type, seulement à partir de 2 valeurs.
+    */
+    static String resume(const resume_t& r) {
+      String json(F("{\"epoch\":\""));
+      json += r.epoch;
+      json += F("\",\"key\":\"");
+      json += r.variable;
+      json += F("\",\"period\":\"");
+      json += r.duree;
+      json += F("\",\"n\":\"");
+      json += r.stats.n();
+      json += F("\",\"min\":\"");
+      json += valeur(r.stats.min(), r.decimales);
+      json += F("\",\"max\":\"");
+      json += valeur(r.stats.max(), r.decimales);
+      json += F("\",\"mean\":\"");
+      json += valeur(r.stats.moyenne(), r.decimales);
+      json += F("\",\"last\":\"");
+      json += valeur(r.stats.dernier(), r.decimales);
+      if (r.stats.n() > 1) {
+        json += F("\",\"sd\":\"");
+        json += valeur(r.stats.ecartType(), r.decimales);
+      }
+      json += F("\"}");
+      return json;
+    }
+
+    /**
+       Convertit la valeur entière d'un échantillon en chaîne décimale, sans calcul flottant.
+
+       @param sample L'échantillon.
+       @return La valeur, par exemple 1234 avec 1 décimale donne "123.4".
+    */
+    static String valeur(const sample_t& sample) {
+      return valeur(sample.value, sample.decimales);
+    }
+
+    /**
+       Convertit une valeur entière en chaîne décimale, sans calcul flottant.
+
+       @param value La valeur entière.
+       @param decimales Le nombre de décimales.
+       @return La valeur, par exemple 1234 avec 1 décimale donne "123.4".
+    */
+    static String valeur(const int32_t value, const byte decimales) {
+      char buffer[16];
+      const uint32_t v = value < 0 ? -value : value;
+      if (!decimales) {
+        snprintf(buffer, sizeof(buffer), "%s%lu", value < 0 ? "-" : "", static_cast<unsigned long>(v));
+      } else {
+        uint32_t p = 1;
+        for (byte i = 0; i < decimales; ++i) p *= 10;
+        snprintf(buffer, sizeof(buffer), "%s%lu.%0*lu", value < 0 ? "-" : "", static_cast<unsigned long>(v / p), decimales, static_cast<unsigned long>(v % p));
+      }
+      return String(buffer);
+    }
+
+    /**
+       Configure une alerte historique de niveau (montée de l'eau sous le seuil).
+       Un seuil et un écart nuls désactivent l'alerte.
+
+       @param alertes Le moteur d'alertes.
+       @param i L'indice de la règle.
+       @param seuil Le seuil en cm.
+       @param ecart L'hystérésis en cm.
+    */
+    static void configurerNiveau(AlertEngine& alertes, const byte i, const float seuil, const float ecart) {
+      if (seuil == 0 && ecart == 0) {
+        alertes.desactiver(i);
+        return;
+      }
+      const AlertEngine::regle_t regle = { AlertEngine::NIVEAU, AlertEngine::MONTEE, static_cast<int32_t>(lround(seuil * 10)), static_cast<int32_t>(lround(ecart * 10)), 0, 1 };
+      alertes.configurer(i, regle);
+    }
+
     /**
        Etats possible de la connexion GSM.
     */
@@ -399,6 +899,8 @@ class Communication {
     Communication(const __FlashStringHelper aApn[], const __FlashStringHelper aLogin[], const __FlashStringHelper aPassword[], const __FlashStringHelper aServerName[], const int aServerPort) :
 #ifdef LOG
       modem(debugger),
+#elif defined(CAPTURE) || defined(REJEU)
+      modem(fluxModem),
 #else
       modem(Serial1),
 #endif
@@ -406,7 +908,23 @@ class Communication {
       apnLogin(aLogin),
       apnPassword(aPassword),
       serverName(aServerName),
-      serverPort(aServerPort)
+      serverPort(aServerPort),
+      http(modem, aServerName, aServerPort),
+#ifdef TRANSPORT_COAP
+      uplink(modem, aServerName, COAP_PORT),
+#else
+      uplink(modem, aServerName, aServerPort),
+#endif
+      pilote(modem),
+      attente(),
+      nbAttente(0),
+      pRtc(NULL),
+      pAlertes(NULL),
+      pParametres(NULL),
+      version(),
+      aJour(false),
+      eteint(false),
+      attache(0)
     {}
 
     /**
@@ -414,9 +932,11 @@ class Communication {
 
        @param state État demandé (IDLE, GSM_CONNECTION, GPRS_CONNECTION).
        @param retry Nombre de réessais pour obtenir l'état demandé, 10 par défaut.
+       @param aBudget Temps maximum en ms, 0 sans limite ; une connexion limitée ne fait pas de hard reset.
        @return L'état de la connexion, true si ok, false en cas d'erreur.
     */
-    bool connectGSMGPRS(const state_t aState, const byte aRetry = 5) const {
+    bool connectGSMGPRS(const state_t aState, const byte aRetry = 5, const unsigned long aBudget = 0) const {
+      const unsigned long debut = millis();
       DEBUG(F("Connect")); 
       //DEBUG(aState);
       DEBUG(F("..."));
@@ -424,7 +944,15 @@ class Communication {
       // test if modem replies to AT command. Else, hard Reset via pulse sent to GSM_RESETN
       // Note : testAT is a tinyGSM function, with a 10000 ms timeout
       // check tinyGsmClientSIM800.h
-      if(!modem.testAT()) {
+      // Une connexion limitée n'attend pas plus que son budget et ne fait pas de hard reset d'un modem allumé qui ne répond pas ;
+      // un modem éteint par eteindre() est rallumé, le temps du redémarrage étant décompté du budget.
+      pilote.reveiller();
+      if (eteint || !modem.testAT(aBudget ? min(aBudget, 10000UL) : 10000UL)) {
+        if (aBudget && !eteint) {
+          DEBUG(F("Modem does not reply, no hard reset within connection budget!\n"));
+          return false;
+        }
+        eteint = false;
         // hard reset
         // pinMode(GSM_RESETN, OUTPUT);
         digitalWrite(GSM_RESETN, LOW);
@@ -455,6 +983,7 @@ class Communication {
             case GSM_CONNECTION :
               for (int i = 0; i < aRetry; ++i) {
                 DEBUG(i+1); DEBUG('/'); DEBUG(aRetry); DEBUG(',');
+                if (aBudget && (millis() - debut > aBudget)) break;
                 if (modem.isNetworkConnected()) {
                   if (aState == GSM_CONNECTION_ONLY) {
                     if (modem.isGprsConnected() && modem.gprsDisconnect()) return true;
@@ -462,7 +991,7 @@ class Communication {
                     return true;
                   }
                 } else {  // not yet connected
-                  if (!modem.waitForNetwork()) {
+                  if (!modem.waitForNetwork(attenteReseau(debut, aBudget))) {
                     DEBUG(F("Error in waitForNetwork()\n"));
                     delay(500);
                     continue;
@@ -484,9 +1013,10 @@ class Communication {
               for (int i = 0; i < aRetry; ++i) {
                 DEBUG(i + 1); DEBUG('/'); DEBUG(aRetry); DEBUG(',');
                 if (modem.isGprsConnected()) return true;
+                if (aBudget && (millis() - debut > aBudget)) break;
     
                 if (!modem.isNetworkConnected()) {
-                  if (!modem.waitForNetwork()) {
+                  if (!modem.waitForNetwork(attenteReseau(debut, aBudget))) {
                     DEBUG(F("Error in waitForNetwork()!\n"));
                     delay(500);
                     continue;
@@ -513,12 +1043,19 @@ class Communication {
                   delay(500);
                   continue;
                 } // GPRS connected now
-    
+
+                attache = millis() - debut;
                 return true;
               }
               break;
           }
 
+        // Une connexion limitée dans le temps abandonne plutôt que de faire un hard reset.
+        if (aBudget) {
+          DEBUG(F("Connection budget exceeded!\n"));
+          return false;
+        }
+
         // If connection not working at first try, redo it after  modem hard reset.
         // hard reset
         // pinMode(GSM_RESETN, OUTPUT);
@@ -606,7 +1143,8 @@ class Communication {
                   delay(500);
                   continue;
                 } // GPRS connected now
-    
+
+                attache = millis() - debut;
                 return true;
               }
               break;
@@ -618,6 +1156,19 @@ class Communication {
           
     }
 
+    /**
+       Calcule le temps d'attente du réseau restant dans le budget d'une connexion.
+
+       @param debut Le début de la connexion (millis()).
+       @param aBudget Le budget en ms, 0 sans limite.
+       @return Le temps d'attente en ms.
+    */
+    static unsigned long attenteReseau(const unsigned long debut, const unsigned long aBudget) {
+      if (!aBudget) return 60000L;
+      const unsigned long ecoule = millis() - debut;
+      return (ecoule < aBudget) ? aBudget - ecoule : 1;
+    }
+
     /*
 
         DEBUG(F("Waiting for network... "));
@@ -665,6 +1216,21 @@ class Communication {
     const __FlashStringHelper* apnPassword;
     const __FlashStringHelper* serverName;
     const int serverPort;
+
+    mutable TransportHttp http;   ///< Transport des paramètres.
+    mutable Transport uplink;     ///< Transport des échantillons et des états (http ou CoAP).
+    mutable Pilote pilote;        ///< Veille propre au modem (PSM & eDRX).
+
+    mutable sample_t attente[SMS_ATTENTE];   ///< Alertes transmises par SMS, à retransmettre en http.
+    mutable byte nbAttente;
+
+    RTCZero* pRtc;                    ///< Horloge mise à l'heure par les réponses.
+    AlertEngine* pAlertes;            ///< Règles d'alerte mises à jour par les réponses.
+    parametres_t* pParametres;        ///< Paramètres mis à jour par les réponses.
+    mutable char version[24];         ///< Version (ETag) des paramètres appliqués, vide si aucune.
+    mutable bool aJour;               ///< La dernière réponse a confirmé la version des paramètres.
+    mutable bool eteint;              ///< Le modem a été éteint par eteindre().
+    mutable unsigned long attache;    ///< Durée en ms du dernier attachement GPRS, 0 si aucun.
 };
 
 Communication* Communication::pCommunication;
@@ -0,0 +1,142 @@
+/*
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+/**
+ *  @file
+ *  Picolimno MKR V1.0 project
+ *  diagnostic.h
+ *  Define a Diagnostic class : histogram of the raw ultrasonic pulses and reject causes.
+ *
+ *  @author Marc Sibert
+ *  @version 1.0 14/04/2018
+ *  @Copyright 2018 Marc Sibert
+ */
+
+#pragma once
+
+/// Nombre de classes de l'histogramme des impulsions.
+#define DIAGNOSTIC_CLASSES 16
+/// Largeur d'une classe en µs ; la dernière reçoit aussi les impulsions plus longues.
+#define DIAGNOSTIC_LARGEUR 625
+
+/**
+ * Diagnostic des mesures de distance, accumulé en mémoire fixe entre deux transmissions du diagnostic :
+ * - histogramme des largeurs d'impulsion brutes, valides ou non ;
+ * - nombre d'échantillons rejetés par cause (pas d'écho, impulsion trop courte ou trop longue) ;
+ * - nombre de tentatives matérielles par mesure et nombre de mesures invalides.
+ * Un histogramme étalé évoque de la végétation ou de la mousse, des impulsions courtes un obstacle dans le boîtier,
+ * des absences d'écho un transducteur défaillant.
+ * Les compteurs saturent au lieu de déborder.
+ */
+class Diagnostic {
+
+public:
+  Diagnostic() {
+    raz();
+  }
+
+/**
+ * Oublie tous les compteurs.
+ */
+  void raz() {
+    for (byte i = 0; i < DIAGNOSTIC_CLASSES; ++i) fClasses[i] = 0;
+    fAbsents = fCourts = fLongs = 0;
+    fMesures = fInvalides = 0;
+    fTentatives = 0;
+    fTentativesMax = 0;
+  }
+
+/**
+ * Compte une impulsion brute du capteur.
+ *
+ * @param pulse La largeur de l'impulsion en µs, 0 si aucun écho.
+ */
+  void impulsion(const unsigned long pulse) {
+    if (!pulse) {
+      incrementer(fAbsents);
+      return;
+    }
+    incrementer(fClasses[min(pulse / DIAGNOSTIC_LARGEUR, DIAGNOSTIC_CLASSES - 1UL)]);
+    if (pulse < RANGE_IMPULSION_MIN) incrementer(fCourts);
+    else if (pulse > RANGE_IMPULSION_MAX) incrementer(fLongs);
+  }
+
+/**
+ * Compte une mesure de distance.
+ *
+ * @param tentatives Le nombre de mesures matérielles faites pour obtenir les échantillons.
+ * @param valide false si les échantillons valides étaient insuffisants.
+ */
+  void mesure(const unsigned tentatives, const bool valide) {
+    incrementer(fMesures);
+    if (!valide) incrementer(fInvalides);
+    if (fTentatives + tentatives >= fTentatives) fTentatives += tentatives;
+    if (tentatives > fTentativesMax) fTentativesMax = min(tentatives, 0xffffU);
+  }
+
+/**
+ * @return true si aucune mesure n'a été comptée.
+ */
+  bool vide() const {
+    return !fMesures;
+  }
+
+/**
+ * Sérialise le diagnostic en un objet JSON.
+ *
+ * @return {"n":..,"invalid":..,"attempts":..,"maxAttempts":..,"timeout":..,"short":..,"long":..,"width":..,"hist":[..]} ;
+ *         attempts est le total des tentatives, width la largeur des classes en µs.
+ */
+  String json() const {
+    String json(F("{\"n\":"));
+    json += fMesures;
+    json += F(",\"invalid\":");
+    json += fInvalides;
+    json += F(",\"attempts\":");
+    json += fTentatives;
+    json += F(",\"maxAttempts\":");
+    json += fTentativesMax;
+    json += F(",\"timeout\":");
+    json += fAbsents;
+    json += F(",\"short\":");
+    json += fCourts;
+    json += F(",\"long\":");
+    json += fLongs;
+    json += F(",\"width\":");
+    json += DIAGNOSTIC_LARGEUR;
+    json += F(",\"hist\":[");
+    for (byte i = 0; i < DIAGNOSTIC_CLASSES; ++i) {
+      if (i) json += ',';
+      json += fClasses[i];
+    }
+    json += F("]}");
+    return json;
+  }
+
+protected:
+  static void incrementer(uint16_t& compteur) {
+    if (compteur < 0xffff) ++compteur;
+  }
+
+private:
+  uint16_t fClasses[DIAGNOSTIC_CLASSES];    ///< Impulsions reçues par classe de largeur.
+  uint16_t fAbsents;          ///< Pas d'écho avant l'expiration.
+  uint16_t fCourts;           ///< Impulsions plus courtes que RANGE_IMPULSION_MIN.
+  uint16_t fLongs;            ///< Impulsions plus longues que RANGE_IMPULSION_MAX.
+  uint16_t fMesures;
+  uint16_t fInvalides;        ///< Mesures sans assez d'échantillons valides.
+  uint32_t fTentatives;       ///< Total des mesures matérielles.
+  uint16_t fTentativesMax;    ///< Plus grand nombre de mesures matérielles d'une mesure.
+
+};
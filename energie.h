@@ -0,0 +1,200 @@
+/*
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+/**
+ *  @file
+ *  Picolimno MKR V1.0 project
+ *  energie.h
+ *  Define an Energie class : battery trend and degradation tiers.
+ *
+ *  @author Marc Sibert
+ *  @version 1.0 14/04/2018
+ *  @Copyright 2018 Marc Sibert
+ */
+
+#pragma once
+
+/// Tensions lissées en mV en deçà desquelles les paliers REDUIT, ECONOME, MINIMAL et SURVIE s'appliquent.
+#define ENERGIE_SEUIL_REDUIT 3750
+#define ENERGIE_SEUIL_ECONOME 3650
+#define ENERGIE_SEUIL_MINIMAL 3550
+#define ENERGIE_SEUIL_SURVIE 3450
+/// Écart en mV à regagner au-dessus d'un seuil pour revenir au palier précédent.
+#define ENERGIE_HYSTERESIS 50
+/// Tension en mV considérée comme batterie vide pour l'estimation de l'autonomie.
+#define ENERGIE_VBAT_VIDE 3300
+/// Autonomie estimée en heures en deçà de laquelle le palier suivant s'applique par anticipation.
+#define ENERGIE_AUTONOMIE_MIN (3 * 24)
+/// Temps minimum en secondes entre deux estimations de la tendance.
+#define ENERGIE_PERIODE_TENDANCE (6 * 3600UL)
+
+/**
+ * Politique d'énergie.
+ * Suit la tension de la batterie lissée (moyenne exponentielle, 1/8), sa tendance en mV/jour et l'autonomie restante,
+ * et en déduit un palier de dégradation du fonctionnement :
+ * - REDUIT : moitié moins d'échantillons par mesure de distance ;
+ * - ECONOME : intervalles doublés, température & hygrométrie non mesurées ;
+ * - MINIMAL : intervalles quadruplés, modem éteint entre deux transmissions ;
+ * - SURVIE : plus de veille d'alerte entre les mesures.
+ * Tous les calculs sont faits en entiers.
+ */
+class Energie {
+
+public:
+  enum palier_t : byte {
+    NORMAL,
+    REDUIT,
+    ECONOME,
+    MINIMAL,
+    SURVIE
+  };
+
+  Energie() :
+    fLisse(0),
+    fReference(0),
+    fEpochReference(0),
+    fTendance(0),
+    fPalier(NORMAL)
+  {
+  }
+
+/**
+ * Ajoute une mesure de la tension de la batterie et met à jour le palier.
+ *
+ * @param epoch L'heure de la mesure.
+ * @param vbat La tension en mV.
+ * @return true si le palier a changé.
+ */
+  bool mettreAJour(const uint32_t epoch, const uint16_t vbat) {
+    if (!fLisse) {
+      fLisse = vbat * 16L;
+      fReference = fLisse;
+      fEpochReference = epoch;
+    } else {
+      fLisse += (vbat * 16L - fLisse) / 8;
+    }
+
+    if (epoch - fEpochReference >= ENERGIE_PERIODE_TENDANCE) {
+      const int32_t pente = (fLisse - fReference) * 86400L / 16 / static_cast<int32_t>(epoch - fEpochReference);   // mV/jour
+      fTendance = fTendance ? fTendance + (pente - fTendance) / 4 : pente;
+      fReference = fLisse;
+      fEpochReference = epoch;
+    }
+
+    const palier_t precedent = fPalier;
+    const uint16_t seuils[] = { ENERGIE_SEUIL_REDUIT, ENERGIE_SEUIL_ECONOME, ENERGIE_SEUIL_MINIMAL, ENERGIE_SEUIL_SURVIE };
+    const uint16_t v = tension();
+    byte palier = NORMAL;
+    for (byte i = 0; i < 4; ++i) {
+      if (v < seuils[i] + (precedent > i ? ENERGIE_HYSTERESIS : 0)) palier = i + 1;
+    }
+    if ((autonomie() < ENERGIE_AUTONOMIE_MIN) && (palier < SURVIE)) ++palier;
+    fPalier = static_cast<palier_t>(palier);
+
+    if (fPalier != precedent) {
+      DEBUG(F("Palier d'energie ")); DEBUG(precedent); DEBUG(F(" -> ")); DEBUG(fPalier); DEBUG('\n');
+    }
+    return fPalier != precedent;
+  }
+
+  palier_t palier() const {
+    return fPalier;
+  }
+
+/**
+ * @return La tension lissée en mV, 0 si aucune mesure.
+ */
+  uint16_t tension() const {
+    return (fLisse + 8) / 16;
+  }
+
+/**
+ * @return La tendance de la tension lissée en mV/jour.
+ */
+  int32_t tendance() const {
+    return fTendance;
+  }
+
+/**
+ * @return L'autonomie restante estimée en heures, 0xffff si la tension ne baisse pas.
+ */
+  uint16_t autonomie() const {
+    if (fTendance >= 0) return 0xffff;
+    const int32_t reste = static_cast<int32_t>(tension()) - ENERGIE_VBAT_VIDE;
+    if (reste <= 0) return 0;
+    return min(reste * 24L / -fTendance, 0xfffeL);
+  }
+
+/**
+ * @param nominal Le nombre nominal d'échantillons matériels par mesure.
+ * @return Le nombre d'échantillons à obtenir selon le palier.
+ */
+  unsigned echantillons(const unsigned nominal) const {
+    return (fPalier >= REDUIT) ? nominal / 2 : nominal;
+  }
+
+/**
+ * @return Le multiplicateur des intervalles de mesure et de transmission.
+ */
+  byte multiplicateur() const {
+    return (fPalier >= MINIMAL) ? 4 : (fPalier >= ECONOME) ? 2 : 1;
+  }
+
+/**
+ * @return true si la température et l'hygrométrie doivent être mesurées.
+ */
+  bool environnement() const {
+    return fPalier < ECONOME;
+  }
+
+/**
+ * @return true si le modem doit être éteint entre deux transmissions.
+ */
+  bool modemEteint() const {
+    return fPalier >= MINIMAL;
+  }
+
+/**
+ * @return true si la veille d'alerte entre les mesures est maintenue.
+ */
+  bool veilleAlertes() const {
+    return fPalier < SURVIE;
+  }
+
+/**
+ * Sérialise l'état en un objet JSON.
+ *
+ * @return {"tier":..,"vbat":..,"trend":..,"runtime":..} ; vbat en mV, trend en mV/jour, runtime en heures.
+ */
+  String json() const {
+    String json(F("{\"tier\":"));
+    json += fPalier;
+    json += F(",\"vbat\":");
+    json += tension();
+    json += F(",\"trend\":");
+    json += fTendance;
+    json += F(",\"runtime\":");
+    json += autonomie();
+    json += '}';
+    return json;
+  }
+
+private:
+  int32_t fLisse;             ///< Tension lissée en 1/16 mV.
+  int32_t fReference;         ///< Tension lissée lors de la dernière estimation de la tendance.
+  uint32_t fEpochReference;
+  int32_t fTendance;          ///< mV/jour, lissée.
+  palier_t fPalier;
+
+};
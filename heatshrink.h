@@ -0,0 +1,251 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   heatshrink.h
+   Purpose: Define a streaming LZSS encoder producing the heatshrink format, and its streaming decoder.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#pragma once
+
+/// Taille de la fenêtre en puissance de 2 (-w de heatshrink) : 256 octets.
+#define HEATSHRINK_FENETRE 8
+/// Longueur maximale d'une répétition en puissance de 2 (-l de heatshrink) : 16 octets.
+#define HEATSHRINK_LONGUEUR 4
+/// Taille du tampon de sortie en octets : chaque tampon plein est écrit en une fois (un AT+CIPSEND vers le modem).
+#define HEATSHRINK_TAMPON 256
+/// Taille de la fenêtre du décodage en puissance de 2 (-w de heatshrink) : 1 Ko de RAM.
+#define HEATSHRINK_DECODAGE_FENETRE 10
+/// Longueur maximale d'une répétition du décodage en puissance de 2 (-l de heatshrink).
+#define HEATSHRINK_DECODAGE_LONGUEUR 5
+
+/**
+   Compresseur LZSS au format heatshrink (https://github.com/atomicobject/heatshrink), décodable par
+   "heatshrink -d -w 8 -l 4".
+   Le texte source étant déjà en RAM, la fenêtre est le texte lui-même : seul un tampon fixe de sortie est nécessaire,
+   sans allocation, écrit dans la sortie à chaque fois qu'il est plein.
+   Chaque élément est soit un littéral (bit 1 puis 8 bits), soit une répétition (bit 0, distance - 1 sur
+   HEATSHRINK_FENETRE bits, longueur - 1 sur HEATSHRINK_LONGUEUR bits) ; les bits sont écrits poids fort en tête.
+*/
+class Heatshrink {
+
+  public:
+    /**
+       Compresse un texte.
+       Sans sortie, seule la taille compressée est calculée, ce qui permet d'annoncer un Content-Length
+       avant de compresser une seconde fois directement vers le modem.
+
+       @param aSource Le texte à compresser.
+       @param aTaille La taille du texte.
+       @param aSortie Le flux recevant le texte compressé, ou NULL.
+       @param aEntete Un texte écrit tel quel avant le texte compressé, dans les mêmes tampons (les en-têtes http).
+       @return La taille du texte compressé en octets, sans l'en-tête.
+    */
+    static size_t compresser(const char aSource[], const size_t aTaille, Print* aSortie, const String& aEntete = String()) {
+      Heatshrink h(aSortie);
+      if (aSortie) {
+        for (size_t i = 0; i < aEntete.length(); ++i) h.ajouter(aEntete[i]);
+      }
+      return h.coder(aSource, aTaille);
+    }
+
+  protected:
+    Heatshrink(Print* aSortie) :
+      sortie(aSortie),
+      tampon(),
+      n(0),
+      octet(0),
+      bits(0),
+      total(0)
+    {}
+
+    /**
+       Compresse le texte vers la sortie choisie à la construction.
+
+       @return La taille du texte compressé en octets.
+    */
+    size_t coder(const char aSource[], const size_t aTaille) {
+      size_t i = 0;
+      while (i < aTaille) {
+        size_t distance = 0;
+        const size_t longueur = chercher(aSource, aTaille, i, distance);
+        if (longueur > 1) {   // 13 bits au lieu de 18 pour 2 littéraux
+          ecrire(0, 1);
+          ecrire(distance - 1, HEATSHRINK_FENETRE);
+          ecrire(longueur - 1, HEATSHRINK_LONGUEUR);
+          i += longueur;
+        } else {
+          ecrire(1, 1);
+          ecrire(static_cast<uint8_t>(aSource[i]), 8);
+          ++i;
+        }
+      }
+      terminer();
+      return total;
+    }
+
+    /**
+       Cherche la plus longue répétition dans la fenêtre précédant la position.
+
+       @param distance Retourne la distance de la répétition trouvée.
+       @return La longueur de la répétition, 0 si aucune.
+    */
+    static size_t chercher(const char aSource[], const size_t aTaille, const size_t aPosition, size_t& distance) {
+      const size_t fenetre = 1U << HEATSHRINK_FENETRE;
+      const size_t max = min(static_cast<size_t>(1U << HEATSHRINK_LONGUEUR), aTaille - aPosition);
+      const size_t debut = (aPosition > fenetre) ? aPosition - fenetre : 0;
+      size_t meilleure = 0;
+      for (size_t j = aPosition; j-- > debut; ) {   // de la plus proche à la plus lointaine
+        if (aSource[j] != aSource[aPosition]) continue;
+        size_t l = 1;
+        while ((l < max) && (aSource[j + l] == aSource[aPosition + l])) ++l;
+        if (l > meilleure) {
+          meilleure = l;
+          distance = aPosition - j;
+          if (l == max) break;
+        }
+      }
+      return meilleure;
+    }
+
+    /**
+       Ajoute les nb bits de poids faible de la valeur.
+    */
+    void ecrire(const uint16_t valeur, const byte nb) {
+      for (byte b = nb; b-- > 0; ) {
+        octet = (octet << 1) | ((valeur >> b) & 1);
+        if (++bits == 8) {
+          pousser(octet);
+          octet = 0;
+          bits = 0;
+        }
+      }
+    }
+
+    /**
+       Complète le dernier octet par des 0 et vide le tampon.
+    */
+    void terminer() {
+      if (bits) pousser(octet << (8 - bits));
+      bits = 0;
+      if (sortie && n) sortie->write(tampon, n);
+      n = 0;
+    }
+
+    void pousser(const uint8_t o) {
+      ++total;
+      if (sortie) ajouter(o);
+    }
+
+    /**
+       Ajoute un octet au tampon, écrit dans la sortie une fois plein.
+    */
+    void ajouter(const uint8_t o) {
+      tampon[n++] = o;
+      if (n == HEATSHRINK_TAMPON) {
+        sortie->write(tampon, n);
+        n = 0;
+      }
+    }
+
+  private:
+    Print* const sortie;
+    uint8_t tampon[HEATSHRINK_TAMPON];
+    size_t n;
+    uint8_t octet;
+    byte bits;
+    size_t total;
+};
+
+/**
+   Décompresseur au fil de l'eau du format heatshrink, produit par
+   "heatshrink -e -w 10 -l 5" (voir HEATSHRINK_DECODAGE_*).
+   Seule la fenêtre des derniers octets produits est en RAM : la source est lue au besoin, octet par octet.
+*/
+class DecompresseurHeatshrink {
+
+  public:
+    DecompresseurHeatshrink(Stream& aSource) :
+      source(aSource),
+      fenetre(),
+      position(0),
+      distance(0),
+      restant(0),
+      octet(0),
+      bits(0)
+    {}
+
+    /**
+       @return L'octet décompressé suivant, -1 à la fin de la source.
+    */
+    int lire() {
+      if (!restant) {
+        const int litteral = lireBits(1);
+        if (litteral < 0) return -1;
+        if (litteral) {
+          const int c = lireBits(8);
+          return (c < 0) ? -1 : produire(c);
+        }
+        const int d = lireBits(HEATSHRINK_DECODAGE_FENETRE);
+        const int l = lireBits(HEATSHRINK_DECODAGE_LONGUEUR);
+        if ((d < 0) || (l < 0)) return -1;    // bits de bourrage du dernier octet
+        distance = d + 1;
+        restant = l + 1;
+      }
+      --restant;
+      return produire(fenetre[(position - distance) & MASQUE]);
+    }
+
+  protected:
+    int produire(const uint8_t c) {
+      fenetre[position++ & MASQUE] = c;
+      return c;
+    }
+
+    /**
+       Lit nb bits, poids fort en tête.
+
+       @return Les bits, -1 à la fin de la source.
+    */
+    int lireBits(const byte nb) {
+      int valeur = 0;
+      for (byte b = 0; b < nb; ++b) {
+        if (!bits) {
+          const int c = source.read();
+          if (c < 0) return -1;
+          octet = c;
+          bits = 8;
+        }
+        --bits;
+        valeur = (valeur << 1) | ((octet >> bits) & 1);
+      }
+      return valeur;
+    }
+
+  private:
+    static const uint16_t MASQUE = (1U << HEATSHRINK_DECODAGE_FENETRE) - 1;
+
+    Stream& source;
+    uint8_t fenetre[1U << HEATSHRINK_DECODAGE_FENETRE];   ///< Derniers octets produits.
+    uint16_t position;    ///< Position d'écriture dans la fenêtre (modulo sa taille).
+    uint16_t distance;    ///< Distance de la répétition en cours.
+    uint16_t restant;     ///< Octets restant à produire de la répétition en cours.
+    uint8_t octet;
+    byte bits;            ///< Bits restant à lire de octet.
+};
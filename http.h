@@ -0,0 +1,359 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   http.h
+   Purpose: Define the minimal http/1.0 transport over a TinyGsmClient.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#pragma once
+
+#include "heatshrink.h"
+#include "serveurs.h"
+
+/// Temps maximum en ms sans recevoir d'octet de la réponse http.
+#define HTTP_TIMEOUT 10000UL
+
+/// Taille minimale en octets d'un corps compressé, en deçà le gain ne compense pas l'en-tête Content-Encoding.
+#define HTTP_COMPRESSION_MIN 200
+
+/**
+   Transport http/1.0 minimal : une connexion par requête, fermée par le serveur après la réponse.
+   Inclus par transport.h qui définit reponse_t.
+*/
+class TransportHttp {
+
+  public:
+    /**
+       Constructeur.
+
+       @param aModem Le modem portant la connexion TCP.
+       @param aServerName Le nom du serveur compilé, utilisé tant qu'aucune liste de serveurs n'a été reçue (voir Serveurs).
+       @param aServerPort Le port du serveur compilé.
+    */
+    TransportHttp(TinyGsm& aModem, const __FlashStringHelper aServerName[], const int aServerPort) :
+      modem(aModem),
+      compression(false)
+    {
+      Serveurs::defaut(aServerName, aServerPort);
+    }
+
+    /**
+       Envoie une requête http/1.0 minimale et lit sa réponse, avec 3 essais.
+       En http/1.0, le serveur ne répond ni en "chunked" ni en keep-alive : un corps sans Content-Length se termine
+       par la fermeture de la connexion, sans garder la radio allumée jusqu'à HTTP_TIMEOUT.
+       La requête (en-têtes et corps) est écrite en une seule fois pour tenir dans un minimum de paquets
+       et ne contient que Host et, s'il y a un corps, Content-Type & Content-Length. Par rapport à
+       ArduinoHttpClient 0.3.x, qui écrit chaque élément par un print distinct, cela économise User-Agent et Connection,
+       soit 46 octets, et un AT+CIPSEND par élément ; mesuré par bench/requetes.cpp (en-têtes, AT+CIPSEND) :
+       GET /parameters 79 octets en 1 au lieu de 125 en 17, PUT /samples (corps de 54 octets) et PUT /status (421 octets)
+       128 octets en 1 au lieu de 174 en 26.
+       Dès qu'une réponse a annoncé "Accept-Encoding: heatshrink", les corps d'au moins HTTP_COMPRESSION_MIN octets sont
+       compressés (Content-Encoding: heatshrink, fenêtre 8, longueur 4) au fil de l'eau vers le modem, à la suite des en-têtes,
+       par blocs fixes de HEATSHRINK_TAMPON octets (un AT+CIPSEND par bloc plein, sans allocation) ; un lot JSON d'échantillons
+       est ainsi réduit à environ 30 % de sa taille. Un refus 415 désactive la compression et la requête est répétée en clair.
+       Chaque essai vise le serveur choisi par Serveurs::choisir() : un serveur en défaut est évité, un nouvel essai
+       bascule sur un autre serveur, et le délai de réponse est adapté au temps de réponse mesuré du serveur.
+       Une erreur du serveur (statut 5xx) compte comme une absence de réponse : le serveur est noté en échec et
+       l'essai suivant vise un autre serveur.
+
+       @param aMethode La méthode http (GET, PUT).
+       @param aPath Le chemin de la ressource.
+       @param aBody Le corps JSON de la requête, aucun s'il est vide.
+       @param aReponse Retourne le statut et les en-têtes utiles de la réponse.
+       @param aCorps Retourne le corps de la réponse s'il est fourni, sinon le corps est ignoré.
+       @return true si la réponse est un succès (2xx), false sinon, comme pour CoAP : une requête refusée (4xx) n'est pas
+               transmise et ses échantillons restent dans l'arriéré, mais le serveur qui l'a refusée n'est pas noté en échec.
+    */
+    bool requete(const __FlashStringHelper* aMethode, const String& aPath, const String& aBody, reponse_t& aReponse, String* aCorps = NULL) {
+      // 1re passe de compression pour connaître Content-Length, la 2nde écrira vers le modem à la suite des en-têtes
+      const bool compresse = compression && (aBody.length() >= HTTP_COMPRESSION_MIN);
+      size_t taille = aBody.length();
+      if (compresse) {
+        const unsigned long debut = micros();
+        taille = Heatshrink::compresser(aBody.c_str(), aBody.length(), NULL);
+        DEBUG(F("Compression : ")); DEBUG(aBody.length()); DEBUG(F(" -> ")); DEBUG(taille); DEBUG(F(" octets en ")); DEBUG(micros() - debut); DEBUG(F(" us\n"));
+      }
+      DEBUG(aMethode); DEBUG(' '); DEBUG(aPath); DEBUG('\n');
+
+      TinyGsmClient client(modem);
+      String req;
+      byte serveurReq = Serveurs::AUCUN;    // serveur de l'en-tête Host de req
+      uint16_t essayes = 0;
+      aReponse.status = 0;
+      for (int i = 0; i < 3; ++i) {
+        byte s = Serveurs::choisir(essayes);
+        if (s == Serveurs::AUCUN) s = Serveurs::choisir();    // tous essayés : le meilleur à nouveau
+        essayes |= 1U << s;
+        const serveur_t& serveur = Serveurs::serveur(s);
+        if (s != serveurReq) {
+          req = String();   // libère la requête précédente avant d'en construire une autre
+          req = construire(aMethode, aPath, serveur.hote, compresse ? String() : aBody, aBody.length() ? taille : 0, compresse);
+          serveurReq = s;
+        }
+
+        const unsigned long debut = millis();
+        if (!client.connect(serveur.hote, serveur.port)) {
+          DEBUG(F("Error on connect to ")); DEBUG(serveur.hote); DEBUG(F(" in ")); DEBUG(F(__PRETTY_FUNCTION__)); DEBUG(F("!\n"));
+          Serveurs::noter(s, false, millis() - debut);
+          delay(500);
+          continue;
+        }
+        if (compresse) {
+          Heatshrink::compresser(aBody.c_str(), aBody.length(), &client, req);
+        } else {
+          client.write(reinterpret_cast<const uint8_t*>(req.c_str()), req.length());
+        }
+        size_t lus = 0;
+        const bool ok = lireReponse(client, aReponse, aCorps, lus, Serveurs::delai(s, HTTP_TIMEOUT)) && !erreurServeur(aReponse);
+        Budget::compter(req.length() + (compresse ? taille : 0) + BUDGET_SURCOUT_TCP, lus);
+        Serveurs::noter(s, ok, millis() - debut);
+        if (ok) break;
+        DEBUG(F("Internal error on ")); DEBUG(aMethode); DEBUG(F(" (")); DEBUG(aReponse.status); DEBUG(F(") in ")); DEBUG(F(__PRETTY_FUNCTION__)); DEBUG(F("!\n"));
+        client.stop();
+        delay(500);   // un autre essai!
+      }
+      client.stop();
+#ifdef CAPTURE
+      Capture::vider();   // connexion fermée : hors des échanges avec le modem
+#endif
+
+      if (aReponse.compression) compression = true;
+      if (compresse && (aReponse.status == 415)) {    // Unsupported Media Type : le serveur ne décode plus
+        compression = false;
+        return requete(aMethode, aPath, aBody, aReponse, aCorps);
+      }
+      return aReponse.status / 100 == 2;
+    }
+
+    /**
+       Télécharge une plage d'une ressource binaire (GET avec Range), en un essai sur le serveur choisi par Serveurs::choisir().
+       Le corps n'est écrit dans la sortie que pour une réponse 206 (Partial Content) dont le Content-Range commence à aDebut :
+       un serveur qui ignore Range, ou un intermédiaire qui renvoie une autre plage, ne peut pas mêler d'autres octets à une reprise.
+
+       @param aPath Le chemin de la ressource.
+       @param aDebut La position du premier octet.
+       @param aLongueur Le nombre d'octets demandés.
+       @param aSortie Reçoit les octets de la plage.
+       @param aReponse Retourne le statut et les en-têtes utiles de la réponse.
+       @return Le nombre d'octets écrits dans la sortie, éventuellement moins que demandé si la connexion est coupée.
+    */
+    size_t telecharger(const String& aPath, const uint32_t aDebut, const uint32_t aLongueur, Print& aSortie, reponse_t& aReponse) {
+      DEBUG(F("GET ")); DEBUG(aPath); DEBUG(' '); DEBUG(aDebut); DEBUG('+'); DEBUG(aLongueur); DEBUG('\n');
+      const byte s = Serveurs::choisir();
+      const serveur_t& serveur = Serveurs::serveur(s);
+      String plage(F("Range: bytes="));
+      plage += aDebut;
+      plage += '-';
+      plage += aDebut + aLongueur - 1;
+      const String req = construire(F("GET"), aPath, serveur.hote, String(), 0, false, plage);
+
+      TinyGsmClient client(modem);
+      const unsigned long debut = millis();
+      aReponse.status = 0;
+      if (!client.connect(serveur.hote, serveur.port)) {
+        DEBUG(F("Error on connect to ")); DEBUG(serveur.hote); DEBUG(F(" in ")); DEBUG(F(__PRETTY_FUNCTION__)); DEBUG(F("!\n"));
+        Serveurs::noter(s, false, millis() - debut);
+        return 0;
+      }
+      client.write(reinterpret_cast<const uint8_t*>(req.c_str()), req.length());
+      size_t lus = 0;
+      size_t ecrits = 0;
+      const bool ok = lireReponse(client, aReponse, NULL, lus, Serveurs::delai(s, HTTP_TIMEOUT), &aSortie, &ecrits, aDebut) && !erreurServeur(aReponse);
+      Budget::compter(req.length() + BUDGET_SURCOUT_TCP, lus);
+      Serveurs::noter(s, ok, millis() - debut);
+      client.stop();
+#ifdef CAPTURE
+      Capture::vider();
+#endif
+      return ecrits;
+    }
+
+  protected:
+    /**
+       @return true si le serveur a répondu par une erreur (5xx) : il est en défaut et la requête n'a pas abouti.
+    */
+    static bool erreurServeur(const reponse_t& aReponse) {
+      return aReponse.status >= 500;
+    }
+
+    /**
+       Construit les en-têtes d'une requête, suivis du corps s'il est fourni.
+
+       @param aHote Le serveur visé (Host).
+       @param aBody Le corps à ajouter, vide s'il est compressé à part ou absent.
+       @param aTaille La taille du corps transmis (Content-Length), 0 sans corps.
+       @param aCompresse true si le corps est compressé.
+       @param aEntete Un en-tête supplémentaire, sans fin de ligne, aucun s'il est vide.
+    */
+    static String construire(const __FlashStringHelper* aMethode, const String& aPath, const char aHote[], const String& aBody, const size_t aTaille, const bool aCompresse, const String& aEntete = String()) {
+      String req(aMethode);
+      req.reserve(aPath.length() + strlen(aHote) + aBody.length() + 120);
+      req += ' ';
+      req += aPath;
+      req += F(" HTTP/1.0\r\nHost: ");
+      req += aHote;
+      if (aEntete.length()) {
+        req += F("\r\n");
+        req += aEntete;
+      }
+      if (aTaille) {
+        req += F("\r\nContent-Type: application/json");
+        if (aCompresse) req += F("\r\nContent-Encoding: heatshrink");
+        req += F("\r\nContent-Length: ");
+        req += aTaille;
+      }
+      req += F("\r\n\r\n");
+      req += aBody;
+      return req;
+    }
+
+    /**
+       Lit la ligne de statut, les en-têtes utiles puis le corps d'une réponse http.
+       Les en-têtes sont lus dans un tampon fixe, sans allocation.
+
+       @param client La connexion ouverte.
+       @param aReponse Retourne le statut et les en-têtes utiles.
+       @param aCorps Retourne le corps s'il est fourni.
+       @param lus Compte les octets lus.
+       @param delai Le temps maximum en ms sans recevoir d'octet.
+       @param aSortie Reçoit le corps binaire d'une réponse 206 si elle est fournie.
+       @param ecrits Compte les octets écrits dans aSortie.
+       @param aPlage Le premier octet attendu de la plage : le corps n'est écrit dans aSortie que si Content-Range commence là.
+       @return true si la ligne de statut est valide et tous les en-têtes ont été lus.
+    */
+    static bool lireReponse(TinyGsmClient& client, reponse_t& aReponse, String* aCorps, size_t& lus, const unsigned long delai,
+                            Print* aSortie = NULL, size_t* ecrits = NULL, const long aPlage = -1) {
+      aReponse.status = 0;
+      aReponse.contentLength = -1;
+      if (aCorps) *aCorps = String();   // corps d'un essai précédent
+      aReponse.date[0] = '\0';
+      aReponse.etag[0] = '\0';
+      aReponse.plage = -1;
+      aReponse.compression = false;
+
+      char ligne[64];
+      if (!lireLigne(client, ligne, sizeof(ligne), lus, delai) || strncmp(ligne, "HTTP/", 5)) return false;
+      const char* const sp = strchr(ligne, ' ');
+      aReponse.status = sp ? atoi(sp + 1) : 0;
+      if (aReponse.status <= 0) return false;
+      DEBUG(F("HTTP Response : ")); DEBUG(aReponse.status); DEBUG('\n');
+
+      for (;;) {
+        if (!lireLigne(client, ligne, sizeof(ligne), lus, delai)) return false;
+        if (!ligne[0]) break;   // fin des en-têtes
+        if (!strncasecmp(ligne, "Content-Length:", 15)) {
+          aReponse.contentLength = atol(ligne + 15);
+        } else if (!strncasecmp(ligne, "Date:", 5)) {
+          copierValeur(aReponse.date, sizeof(aReponse.date), ligne + 5);
+        } else if (!strncasecmp(ligne, "ETag:", 5)) {
+          copierValeur(aReponse.etag, sizeof(aReponse.etag), ligne + 5);
+          retirerGuillemets(aReponse.etag);
+        } else if (!strncasecmp(ligne, "Content-Range:", 14)) {   // bytes <debut>-<fin>/<total>
+          const char* const octets = strstr(ligne + 14, "bytes ");
+          if (octets && isdigit(octets[6])) aReponse.plage = atol(octets + 6);
+        } else if (!strncasecmp(ligne, "Accept-Encoding:", 16)) {
+          aReponse.compression = (strstr(ligne + 16, "heatshrink") != NULL);
+        }
+      }
+
+      // Corps : Content-Length octets, ou jusqu'à la fermeture de la connexion
+      if (aCorps && aReponse.contentLength > 0) aCorps->reserve(aReponse.contentLength);
+      if ((aReponse.status != 206) || (aReponse.plage < 0) || (aReponse.plage != aPlage)) {
+        if (aSortie) {
+          DEBUG(F("Plage ")); DEBUG(aReponse.plage); DEBUG(F(" au lieu de ")); DEBUG(aPlage); DEBUG(F(", ignoree.\n"));
+        }
+        aSortie = NULL;
+      }
+      long n = 0;
+      unsigned long dernier = millis();
+      while ((aReponse.contentLength < 0 || n < aReponse.contentLength) && (millis() - dernier < delai)) {
+        if (!client.available()) {
+          if (!client.connected()) break;
+          continue;
+        }
+        const int c = client.read();
+        if (c < 0) continue;
+        dernier = millis();
+        ++n;
+        ++lus;
+        if (aCorps) *aCorps += static_cast<char>(c);
+        if (aSortie && aSortie->write(static_cast<uint8_t>(c))) ++*ecrits;
+      }
+      if (aCorps) {
+        DEBUG(F("Body: ")); DEBUG(*aCorps); DEBUG('\n');
+      }
+      return true;
+    }
+
+    /**
+       Lit une ligne terminée par LF ; CR est ignoré et les caractères au delà du tampon sont perdus.
+
+       @param client La connexion ouverte.
+       @param ligne Le tampon recevant la ligne terminée par '\0'.
+       @param taille La taille du tampon.
+       @param lus Compte les octets lus.
+       @param delai Le temps maximum en ms sans recevoir d'octet.
+       @return false si la connexion est fermée ou si le délai est dépassé avant la fin de ligne.
+    */
+    static bool lireLigne(TinyGsmClient& client, char ligne[], const size_t taille, size_t& lus, const unsigned long delai) {
+      size_t n = 0;
+      unsigned long dernier = millis();
+      while (millis() - dernier < delai) {
+        if (!client.available()) {
+          if (!client.connected()) break;
+          continue;
+        }
+        const int c = client.read();
+        if (c < 0) continue;
+        dernier = millis();
+        ++lus;
+        if (c == '\n') {
+          ligne[n] = '\0';
+          return true;
+        }
+        if ((c != '\r') && (n < taille - 1)) ligne[n++] = c;
+      }
+      ligne[n] = '\0';
+      return false;
+    }
+
+    /**
+       Copie la valeur d'un en-tête sans les espaces de tête.
+    */
+    static void copierValeur(char dest[], const size_t taille, const char* valeur) {
+      while (*valeur == ' ') ++valeur;
+      strncpy(dest, valeur, taille - 1);
+      dest[taille - 1] = '\0';
+    }
+
+    /**
+       Retire les guillemets d'un ETag : la version est alors celle que porte l'option ETag de CoAP, en hexadécimal.
+    */
+    static void retirerGuillemets(char etag[]) {
+      const size_t l = strlen(etag);
+      if ((l < 2) || (etag[0] != '"') || (etag[l - 1] != '"')) return;
+      memmove(etag, etag + 1, l - 2);
+      etag[l - 2] = '\0';
+    }
+
+  private:
+    TinyGsm& modem;
+    bool compression;     ///< Le serveur a annoncé accepter les corps heatshrink.
+};
@@ -0,0 +1,157 @@
+/*
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+/**
+ *  @file
+ *  Picolimno MKR V1.0 project
+ *  liaison.h
+ *  Define a Liaison class : link quality history per hour of day, and upload deferral.
+ *
+ *  @author Marc Sibert
+ *  @version 1.0 14/04/2018
+ *  @Copyright 2018 Marc Sibert
+ */
+
+#pragma once
+
+#include <FlashStorage.h>
+
+/// Qualité de signal (CSQ) à partir de laquelle une transmission n'est jamais différée.
+#define LIAISON_CSQ_BON 15
+/// Gain de CSQ qu'une heure doit habituellement offrir pour justifier d'y différer une transmission.
+#define LIAISON_GAIN 4
+/// Temps maximum en secondes pendant lequel une transmission peut être différée (échéance).
+#define LIAISON_TOLERANCE 3600UL
+
+/**
+ * Registre enregistré en flash : l'historique par heure, sans le report en cours.
+ */
+struct registreLiaison_t {
+  uint32_t magique;
+  uint16_t csq[24];
+  uint16_t attache[24];
+};
+
+FlashStorage(liaisonFlash, registreLiaison_t);
+
+/**
+ * Modèle de la qualité de la liaison.
+ * Conserve, pour chaque heure de la journée, la moyenne glissante (1/4) du CSQ et de la durée d'attachement GPRS.
+ * Une transmission non urgente peut être différée si le signal est faible et qu'une heure proche, dans la tolérance,
+ * offre habituellement un meilleur signal ou un attachement deux fois plus rapide ; l'échéance n'est jamais dépassée.
+ * Les alertes ne passent pas par ce modèle.
+ * L'historique est enregistré en flash avant le reset quotidien et la dormance, et relu au démarrage :
+ * sans lui, chaque reset ferait réapprendre une journée entière avant le premier report.
+ */
+class Liaison {
+
+public:
+  Liaison() :
+    fCsq(),
+    fAttache(),
+    fDebutReport(0)
+  {
+  }
+
+/**
+ * Enregistre la qualité de signal mesurée.
+ *
+ * @param heure L'heure de la journée (0 à 23).
+ * @param csq La qualité de signal (0 à 31, 99 si inconnue).
+ */
+  void noter(const byte heure, const int csq) {
+    if ((heure > 23) || (csq < 0) || (csq > 31)) return;
+    const uint16_t v = csq * 16 + 1;    // 1/16 de CSQ, 0 réservé à l'absence d'historique
+    fCsq[heure] = fCsq[heure] ? fCsq[heure] + (static_cast<int>(v) - fCsq[heure]) / 4 : v;
+  }
+
+/**
+ * Enregistre la durée d'un attachement GPRS.
+ *
+ * @param heure L'heure de la journée (0 à 23).
+ * @param ms La durée en ms, 0 si aucun attachement n'a eu lieu.
+ */
+  void noterAttache(const byte heure, const unsigned long ms) {
+    if ((heure > 23) || !ms) return;
+    const uint16_t v = min(ms / 100 + 1, 0xffffUL);    // 1/10 s
+    fAttache[heure] = fAttache[heure] ? fAttache[heure] + (static_cast<long>(v) - fAttache[heure]) / 4 : v;
+  }
+
+/**
+ * Indique si une transmission non urgente doit être différée.
+ *
+ * @param epoch L'heure actuelle.
+ * @param heure L'heure de la journée (0 à 23).
+ * @param csq La qualité de signal actuelle (99 si inconnue).
+ * @return true si la transmission doit être différée.
+ */
+  bool differer(const uint32_t epoch, const byte heure, const int csq) {
+    if ((csq < 0) || (csq > 31) || (csq >= LIAISON_CSQ_BON) || (heure > 23)) return false;
+    const uint32_t reste = fDebutReport ? LIAISON_TOLERANCE - min(epoch - fDebutReport, static_cast<uint32_t>(LIAISON_TOLERANCE)) : LIAISON_TOLERANCE;
+    if (!reste) {
+      DEBUG(F("Echeance de report atteinte.\n"));
+      return false;
+    }
+
+    for (byte h = 1; h <= (reste + 3599) / 3600; ++h) {
+      const byte autre = (heure + h) % 24;
+      const bool signal = fCsq[autre] && (fCsq[autre] / 16 >= csq + LIAISON_GAIN);
+      const bool attache = fAttache[autre] && fAttache[heure] && (fAttache[autre] * 2 <= fAttache[heure]);
+      if (signal || attache) {
+        DEBUG(F("Liaison meilleure vers ")); DEBUG(autre); DEBUG(F("h, CSQ ")); DEBUG(fCsq[autre] / 16); DEBUG(F(" au lieu de ")); DEBUG(csq); DEBUG('\n');
+        if (!fDebutReport) fDebutReport = epoch;
+        return true;
+      }
+    }
+    return false;
+  }
+
+/**
+ * Relit l'historique enregistré en flash ; il reste vide si la flash n'en contient pas.
+ */
+  void charger() {
+    const registreLiaison_t r = liaisonFlash.read();
+    if (r.magique != MAGIQUE) return;
+    memcpy(fCsq, r.csq, sizeof(fCsq));
+    memcpy(fAttache, r.attache, sizeof(fAttache));
+  }
+
+/**
+ * Enregistre l'historique en flash s'il a changé (usure) ; à n'appeler que rarement, avant un reset ou une dormance.
+ */
+  void enregistrer() const {
+    const registreLiaison_t e = liaisonFlash.read();
+    if ((e.magique == MAGIQUE) && !memcmp(e.csq, fCsq, sizeof(fCsq)) && !memcmp(e.attache, fAttache, sizeof(fAttache))) return;
+    registreLiaison_t r;
+    r.magique = MAGIQUE;
+    memcpy(r.csq, fCsq, sizeof(r.csq));
+    memcpy(r.attache, fAttache, sizeof(r.attache));
+    liaisonFlash.write(r);
+  }
+
+/**
+ * Signale qu'une transmission a eu lieu : le prochain report ouvrira une nouvelle échéance.
+ */
+  void transmis() {
+    fDebutReport = 0;
+  }
+
+private:
+  uint16_t fCsq[24];          ///< CSQ moyen par heure en 1/16 (+1), 0 si inconnu.
+  uint16_t fAttache[24];      ///< Durée moyenne d'attachement par heure en 1/10 s (+1), 0 si inconnue.
+  uint32_t fDebutReport;      ///< Heure du premier report de la transmission en attente, 0 si aucun.
+
+  static const uint32_t MAGIQUE = 0x11A150E1;
+
+};
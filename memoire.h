@@ -0,0 +1,202 @@
+/*
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+/**
+ *  @file
+ *  Picolimno MKR V1.0 project
+ *  memoire.h
+ *  Memory diagnostics : stack high-water mark, heap usage and per-subsystem peaks.
+ *
+ *  @author Marc Sibert
+ *  @version 1.0 14/04/2018
+ *  @Copyright 2018 Marc Sibert
+ */
+
+#pragma once
+
+#include <malloc.h>
+
+extern "C" char* sbrk(int incr);
+
+/// Motif peint entre le tas et la pile pour en mesurer le plus haut niveau atteint.
+#define MEMOIRE_MOTIF 0xA5
+/// Octets laissés intacts sous la pile courante lors de la peinture.
+#define MEMOIRE_GARDE 64
+
+/**
+ * Diagnostics mémoire, toutes les méthodes sont statiques.
+ * - L'espace libre entre le haut du tas et la pile est peint au démarrage ; le plus petit écart
+ *   atteint depuis (high-water mark de la pile) est celui des octets de motif encore intacts.
+ * - Les appels à malloc/free sont comptés par les crochets __malloc_lock()/__malloc_unlock() de la newlib,
+ *   qui suivent aussi le plus haut niveau atteint par le tas.
+ * - Chaque sous-système enregistre, à ses points les plus profonds, le plus petit espace libre rencontré.
+ */
+class Memoire {
+
+public:
+  enum sousSysteme_t : byte {
+    MESURE,           ///< Mesures des capteurs
+    COMMUNICATION,    ///< Requêtes & réponses
+    PARAMETRES,       ///< Analyse des paramètres (JSON)
+    NB_SOUS_SYSTEMES
+  };
+
+/**
+ * Peint l'espace libre entre le tas et la pile.
+ * @warning À appeler une seule fois, au plus tôt, depuis une fonction peu profonde.
+ */
+  static void peindre() {
+    char marqueur;
+    uint8_t* p = reinterpret_cast<uint8_t*>(sbrk(0));
+    uint8_t* const fin = reinterpret_cast<uint8_t*>(&marqueur) - MEMOIRE_GARDE;
+    while (p < fin) *p++ = MEMOIRE_MOTIF;
+    for (byte i = 0; i < NB_SOUS_SYSTEMES; ++i) fPics[i] = 0xffffffff;
+  }
+
+/**
+ * @return L'espace libre actuel entre le haut du tas et la pile, en octets.
+ */
+  static uint32_t libre() {
+    char marqueur;
+    return &marqueur - sbrk(0);
+  }
+
+/**
+ * @return Le plus petit espace entre le haut du tas et la pile atteint depuis peindre(), en octets.
+ */
+  static uint32_t minLibre() {
+    char marqueur;
+    const uint8_t* const debut = reinterpret_cast<const uint8_t*>(sbrk(0));
+    const uint8_t* p = debut;
+    while ((p < reinterpret_cast<const uint8_t*>(&marqueur)) && (*p == MEMOIRE_MOTIF)) ++p;
+    return p - debut;
+  }
+
+/**
+ * @return Les octets alloués dans le tas.
+ */
+  static uint32_t tas() {
+    return mallinfo().uordblks;
+  }
+
+/**
+ * Retourne une borne haute de la fragmentation du tas : part de la mémoire libre piégée dans des trous du tas,
+ * inutilisables pour un bloc plus grand qu'eux.
+ * La newlib-nano du SAMD n'a pas de bloc supérieur (keepcost toujours nul) : tous les blocs libérés sont comptés
+ * comme des trous, même ceux qui touchent l'espace libre et qu'un malloc pourrait encore étendre.
+ *
+ * @return La fragmentation en %, par excès.
+ */
+  static byte fragmentation() {
+    const struct mallinfo mi = mallinfo();
+    const uint32_t trous = mi.fordblks - mi.keepcost;   // libres sous le bloc supérieur du tas
+    const uint32_t total = mi.fordblks + libre();
+    return total ? (trous * 100UL) / total : 0;
+  }
+
+/**
+ * @return Une borne basse du plus grand bloc allouable : l'espace libre et le bloc supérieur du tas qui le touche
+ *         (toujours nul avec la newlib-nano), sans les trous du tas dont un seul peut être plus grand.
+ */
+  static uint32_t plusGrandBloc() {
+    return mallinfo().keepcost + libre();
+  }
+
+/**
+ * Enregistre l'espace libre au point courant d'un sous-système.
+ *
+ * @param s Le sous-système.
+ */
+  static void point(const sousSysteme_t s) {
+    const uint32_t l = libre();
+    if (l < fPics[s]) fPics[s] = l;
+  }
+
+/**
+ * @param s Le sous-système.
+ * @return Le plus petit espace libre enregistré par le sous-système, 0 si aucun.
+ */
+  static uint32_t pic(const sousSysteme_t s) {
+    return (fPics[s] == 0xffffffff) ? 0 : fPics[s];
+  }
+
+/**
+ * Sérialise les diagnostics en un objet JSON.
+ *
+ * @return {"free":..,"minFree":..,"heap":..,"heapMax":..,"blockMin":..,"fragMax":..,"heapOps":..,"peaks":[mesure,communication,parametres]}
+ */
+  static String json() {
+    String json(F("{\"free\":"));
+    json += libre();
+    json += F(",\"minFree\":");
+    json += minLibre();
+    json += F(",\"heap\":");
+    json += tas();
+    json += F(",\"heapMax\":");
+    json += fHautTas - (reinterpret_cast<uintptr_t>(sbrk(0)) - mallinfo().arena);   // depuis la base du tas
+    json += F(",\"blockMin\":");
+    json += plusGrandBloc();
+    json += F(",\"fragMax\":");
+    json += fragmentation();
+    json += F(",\"heapOps\":");
+    json += fAllocations;
+    json += F(",\"peaks\":[");
+    for (byte i = 0; i < NB_SOUS_SYSTEMES; ++i) {
+      if (i) json += ',';
+      json += pic(static_cast<sousSysteme_t>(i));
+    }
+    json += F("]}");
+    return json;
+  }
+
+/**
+ * @return Les opérations du tas (malloc/free) depuis le démarrage.
+ */
+  static uint32_t allocations() {
+    return fAllocations;
+  }
+
+/**
+ * Crochets d'allocation appelés par la newlib autour de chaque malloc/free :
+ * comptent les opérations et suivent le plus haut niveau du tas.
+ */
+  static void verrou() {
+    ++fAllocations;
+  }
+
+  static void deverrou() {
+    const uintptr_t haut = reinterpret_cast<uintptr_t>(sbrk(0));
+    if (haut > fHautTas) fHautTas = haut;
+  }
+
+private:
+  static uint32_t fPics[NB_SOUS_SYSTEMES];
+  static uint32_t fAllocations;
+  static uintptr_t fHautTas;
+
+};
+
+uint32_t Memoire::fPics[Memoire::NB_SOUS_SYSTEMES];
+uint32_t Memoire::fAllocations;
+uintptr_t Memoire::fHautTas;
+
+extern "C" {
+  void __malloc_lock(struct _reent*) {
+    Memoire::verrou();
+  }
+
+  void __malloc_unlock(struct _reent*) {
+    Memoire::deverrou();
+  }
+}
@@ -0,0 +1,380 @@
+/*
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+/**
+ *  @file
+ *  Picolimno MKR V1.0 project
+ *  miseajour.h
+ *  Define the MiseAJour class : firmware updates by binary delta, staged on the SD card and installed by SDU.
+ *
+ *  @author Marc Sibert
+ *  @version 1.0 14/04/2018
+ *  @Copyright 2018 Marc Sibert
+ */
+
+#pragma once
+
+/// Version du firmware, transmise dans les statuts ; un delta n'est appliqué qu'à l'image dont il porte l'empreinte.
+#define FIRMWARE_VERSION 1
+
+// Met à jour le firmware par delta téléchargé sur la carte SD si défini (transport http seulement).
+//#define MISE_A_JOUR
+
+#ifdef MISE_A_JOUR
+
+#ifdef TRANSPORT_COAP
+#error "MISE_A_JOUR télécharge par plages http (Range), indisponibles en CoAP."
+#endif
+#if defined(CAPTURE) || defined(REJEU)
+#error "MISE_A_JOUR, CAPTURE et REJEU se partagent la carte SD et sont exclusifs."
+#endif
+
+#include <SD.h>
+#include <SDU.h>    // Chargeur en tête du firmware : installe UPDATE.BIN au démarrage
+#include "heatshrink.h"
+#include "sha256.h"
+
+/// Broche CS de la carte SD (module SPI), peut être redéfinie dans secrets.h.
+#ifndef MISE_A_JOUR_CS
+#define MISE_A_JOUR_CS A1
+#endif
+/// Taille en octets d'une plage téléchargée.
+#define MISE_A_JOUR_BLOC 2048
+/// Nombre maximum d'octets téléchargés à chaque transmission, la suite à la transmission suivante.
+#define MISE_A_JOUR_TRANSMISSION (16 * 1024UL)
+/// Adresse en flash du firmware en cours, chargeur SDU compris (après le bootloader).
+#define MISE_A_JOUR_ORIGINE 0x2000
+/// Taille maximum d'une image (flash de 256 Ko du SAMD21).
+#define MISE_A_JOUR_FLASH (256 * 1024UL - MISE_A_JOUR_ORIGINE)
+/// Image en cours lue par le delta, redéfinissable pour appliquer un delta hors du SAMD21.
+#ifndef MISE_A_JOUR_EN_COURS
+#define MISE_A_JOUR_EN_COURS reinterpret_cast<const uint8_t*>(MISE_A_JOUR_ORIGINE)
+#endif
+/// Fichiers de la carte : delta téléchargé, empreinte de l'image visée par ce delta, empreinte du dernier delta invalide,
+/// image reconstruite, image à installer.
+#define MISE_A_JOUR_DELTA "DELTA.BIN"
+#define MISE_A_JOUR_EMPREINTE "DELTA.SHA"
+#define MISE_A_JOUR_REFUSEE "DELTA.REF"
+#define MISE_A_JOUR_IMAGE "NOUVEAU.BIN"
+#define MISE_A_JOUR_SDU "UPDATE.BIN"
+/// Taille du tampon d'écriture de l'image.
+#define MISE_A_JOUR_TAMPON 256
+
+/**
+ * Mise à jour du firmware annoncée dans les paramètres, toutes les méthodes sont statiques.
+ * Un delta n'est retenu que si l'empreinte annoncée de l'image à laquelle il s'applique est celle des premiers octets de la flash :
+ * le numéro de version ne suffit pas, deux compilations d'une même version différant (options, secrets.h).
+ * Le delta est téléchargé par plages de MISE_A_JOUR_BLOC octets dans DELTA.BIN ; une coupure ou un redémarrage
+ * reprend à la taille du fichier, tant que l'empreinte annoncée reste celle de DELTA.SHA.
+ * Le delta est compressé par "heatshrink -e -w 10 -l 5" ; décompressé, c'est un en-tête "PLD1" suivi de la taille
+ * de la nouvelle image (uint32_t), puis de blocs à la manière de bsdiff, les entiers en little-endian :
+ * x (uint32_t), y (uint32_t), z (int32_t), x octets ajoutés aux x octets de l'image en cours à partir de la position
+ * courante, y octets nouveaux, puis la position courante avance de x + z.
+ * L'image reconstruite est vérifiée par son SHA-256 avant d'être copiée en UPDATE.BIN et le processeur redémarré :
+ * le chargeur SDU l'installe puis efface le fichier, ou la réinstalle au démarrage suivant s'il a été interrompu.
+ */
+class MiseAJour {
+
+public:
+/**
+ * Prépare la carte SD, efface une image reconstruite mais pas installée et relit l'empreinte du dernier delta invalide.
+ *
+ * @return false si la carte est inaccessible ; les mises à jour sont alors ignorées.
+ */
+  static bool begin() {
+    if (!SD.begin(MISE_A_JOUR_CS)) {
+      DEBUG(F("Carte SD absente, pas de mise a jour.\n"));
+      return false;
+    }
+    SD.remove(MISE_A_JOUR_IMAGE);
+    lireEmpreinte(MISE_A_JOUR_REFUSEE, fRefusee);
+    fCarte = true;
+    return true;
+  }
+
+/**
+ * Prend en compte une mise à jour annoncée dans les paramètres.
+ *
+ * @param version La version du nouveau firmware.
+ * @param tailleBase La taille de l'image à laquelle s'applique le delta.
+ * @param empreinteBase Le SHA-256 de cette image en hexadécimal, qui doit être celle en cours.
+ * @param chemin La ressource du delta.
+ * @param taille La taille du delta en octets.
+ * @param empreinte Le SHA-256 de la nouvelle image en hexadécimal.
+ * @return true si la mise à jour est retenue.
+ */
+  static bool annoncer(const uint16_t version, const uint32_t tailleBase, const String& empreinteBase,
+                       const String& chemin, const uint32_t taille, const String& empreinte) {
+    if (!fCarte || (version == FIRMWARE_VERSION)) return false;
+    if (!chemin.length() || (chemin.length() >= sizeof(fChemin)) || !taille || (empreinte.length() != 64)) return false;
+    if (!strcasecmp(empreinte.c_str(), fRefusee)) return false;   // Delta déjà essayé sans succès
+    if (fAnnoncee && !strcasecmp(empreinte.c_str(), fEmpreinte)) return true;
+    if (!enCours(tailleBase, empreinteBase)) {
+      DEBUG(F("Delta pour une autre image que celle en cours.\n"));
+      return false;
+    }
+
+    strcpy(fChemin, chemin.c_str());
+    strcpy(fEmpreinte, empreinte.c_str());
+    fTaille = taille;
+    fVersion = version;
+
+// Un delta partiel d'une autre image est effacé, sinon le téléchargement reprend
+    char precedente[65];
+    lireEmpreinte(MISE_A_JOUR_EMPREINTE, precedente);
+    if (strcasecmp(precedente, fEmpreinte)) {
+      SD.remove(MISE_A_JOUR_DELTA);
+      if (!ecrireEmpreinte(MISE_A_JOUR_EMPREINTE, fEmpreinte)) return false;
+    }
+    fAnnoncee = true;
+    DEBUG(F("Mise a jour ")); DEBUG(FIRMWARE_VERSION); DEBUG(F(" -> ")); DEBUG(version); DEBUG(F(" annoncee, ")); DEBUG(taille); DEBUG(F(" octets.\n"));
+    return true;
+  }
+
+/**
+ * @return true si une mise à jour est en cours.
+ */
+  static bool annoncee() {
+    return fAnnoncee;
+  }
+
+/**
+ * Ouvre le delta pour y ajouter la plage suivante.
+ *
+ * @return Le fichier ouvert en fin, à fermer après la plage.
+ */
+  static File delta() {
+    File f = SD.open(MISE_A_JOUR_DELTA, FILE_WRITE);
+    fPosition = f ? f.size() : 0;
+    return f;
+  }
+
+/**
+ * @return La position de la plage suivante, à jour après delta().
+ */
+  static uint32_t position() {
+    return fPosition;
+  }
+
+/**
+ * @return Le nombre d'octets du delta restant à télécharger, à jour après delta().
+ */
+  static uint32_t restant() {
+    return (fPosition < fTaille) ? fTaille - fPosition : 0;
+  }
+
+  static const char* chemin() {
+    return fChemin;
+  }
+
+  static uint16_t version() {
+    return fVersion;
+  }
+
+/**
+ * Reconstruit la nouvelle image à partir de l'image en cours et du delta téléchargé, puis la vérifie.
+ * En cas d'échec, le delta est effacé et n'est plus retenu tant que l'empreinte annoncée ne change pas, même après un redémarrage (DELTA.REF).
+ *
+ * @return true si l'image reconstruite a l'empreinte annoncée.
+ */
+  static bool reconstruire() {
+    SD.remove(MISE_A_JOUR_IMAGE);
+    File source = SD.open(MISE_A_JOUR_DELTA, FILE_READ);
+    File image = SD.open(MISE_A_JOUR_IMAGE, FILE_WRITE);
+    bool ok = source && image && appliquer(source, image);
+    source.close();
+    image.close();
+    if (ok) ok = verifier(MISE_A_JOUR_IMAGE);
+    if (!ok) {
+      DEBUG(F("Mise a jour invalide, abandon.\n"));
+      strcpy(fRefusee, fEmpreinte);
+      ecrireEmpreinte(MISE_A_JOUR_REFUSEE, fRefusee);
+      effacer();
+    }
+    return ok;
+  }
+
+/**
+ * Copie l'image vérifiée en UPDATE.BIN, la vérifie à nouveau puis redémarre sur le chargeur SDU.
+ * La librairie SD ne sachant pas renommer, la copie est la seule fenêtre où une coupure laisserait une image partielle.
+ *
+ * @return false si la copie a échoué ; sinon la méthode ne retourne pas.
+ */
+  static bool installer() {
+    SD.remove(MISE_A_JOUR_SDU);
+    File source = SD.open(MISE_A_JOUR_IMAGE, FILE_READ);
+    File cible = SD.open(MISE_A_JOUR_SDU, FILE_WRITE);
+    bool ok = source && cible;
+    uint8_t tampon[MISE_A_JOUR_TAMPON];
+    while (ok) {
+      const int n = source.read(tampon, sizeof(tampon));
+      if (n <= 0) break;
+      ok = (cible.write(tampon, n) == static_cast<size_t>(n));
+    }
+    source.close();
+    cible.close();
+    if (!ok || !verifier(MISE_A_JOUR_SDU)) {
+      SD.remove(MISE_A_JOUR_SDU);
+      return false;
+    }
+    effacer();
+    DEBUG(F("Installation du firmware ")); DEBUG(fVersion); DEBUG(F(" au redemarrage.\n"));
+    delay(100);
+    NVIC_SystemReset();
+    return true;
+  }
+
+protected:
+/**
+ * Indique si l'image en cours commence par l'image annoncée ; l'empreinte calculée est conservée pour les annonces suivantes.
+ *
+ * @param taille La taille de l'image annoncée.
+ * @param empreinte Son SHA-256 en hexadécimal.
+ * @return true si les taille premiers octets de la flash ont cette empreinte.
+ */
+  static bool enCours(const uint32_t taille, const String& empreinte) {
+    if (!taille || (taille > MISE_A_JOUR_FLASH) || (empreinte.length() != 64)) return false;
+    if (taille != fTailleEnCours) {
+      Sha256 sha;
+      sha.ajouter(MISE_A_JOUR_EN_COURS, taille);
+      sha.fin(fEnCours);
+      fTailleEnCours = taille;
+    }
+    return Sha256::egale(fEnCours, empreinte.c_str());
+  }
+
+/**
+ * Applique le delta décompressé à l'image en cours en flash.
+ *
+ * @return true si le delta est complet et cohérent.
+ */
+  static bool appliquer(File& source, File& image) {
+    DecompresseurHeatshrink delta(source);
+    const uint8_t* const ancienne = MISE_A_JOUR_EN_COURS;
+    uint8_t entete[4];
+    for (byte i = 0; i < sizeof(entete); ++i) entete[i] = delta.lire();
+    uint32_t taille = 0;
+    if (memcmp(entete, "PLD1", 4) || !lire(delta, taille) || (taille > MISE_A_JOUR_FLASH)) return false;
+
+    uint8_t tampon[MISE_A_JOUR_TAMPON];
+    size_t n = 0;
+    uint32_t ecrits = 0;
+    int32_t courante = 0;   // Position dans l'image en cours
+    while (ecrits < taille) {
+      uint32_t x, y, z;
+      if (!lire(delta, x) || !lire(delta, y) || !lire(delta, z)) return false;
+      if ((x > taille - ecrits) || (y > taille - ecrits - x) || (courante < 0) || (courante + x > MISE_A_JOUR_FLASH)) return false;
+      for (uint32_t i = 0; i < x + y; ++i) {
+        const int c = delta.lire();
+        if (c < 0) return false;
+        tampon[n++] = (i < x) ? ancienne[courante + i] + c : c;
+        if (n == sizeof(tampon)) {
+          if (image.write(tampon, n) != n) return false;
+          n = 0;
+        }
+      }
+      ecrits += x + y;
+      courante += x + static_cast<int32_t>(z);
+    }
+    return (image.write(tampon, n) == n);
+  }
+
+  static bool lire(DecompresseurHeatshrink& delta, uint32_t& valeur) {
+    valeur = 0;
+    for (byte i = 0; i < 4; ++i) {
+      const int c = delta.lire();
+      if (c < 0) return false;
+      valeur |= static_cast<uint32_t>(c) << (8 * i);
+    }
+    return true;
+  }
+
+/**
+ * @return true si le SHA-256 du fichier est l'empreinte annoncée.
+ */
+  static bool verifier(const char nom[]) {
+    File f = SD.open(nom, FILE_READ);
+    if (!f) return false;
+    Sha256 sha;
+    uint8_t tampon[MISE_A_JOUR_TAMPON];
+    int n;
+    while ((n = f.read(tampon, sizeof(tampon))) > 0) sha.ajouter(tampon, n);
+    f.close();
+    uint8_t empreinte[32];
+    sha.fin(empreinte);
+    return Sha256::egale(empreinte, fEmpreinte);
+  }
+
+/**
+ * Lit une empreinte de 64 caractères hexadécimaux.
+ *
+ * @param nom Le fichier.
+ * @param empreinte Retourne l'empreinte, vide si le fichier est absent.
+ */
+  static void lireEmpreinte(const char nom[], char empreinte[65]) {
+    empreinte[0] = '\0';
+    File f = SD.open(nom, FILE_READ);
+    if (!f) return;
+    const int n = f.read(empreinte, 64);
+    empreinte[(n > 0) ? n : 0] = '\0';
+    f.close();
+  }
+
+/**
+ * Remplace le fichier par une empreinte de 64 caractères hexadécimaux.
+ *
+ * @return false si le fichier n'a pu être écrit.
+ */
+  static bool ecrireEmpreinte(const char nom[], const char empreinte[65]) {
+    SD.remove(nom);
+    File f = SD.open(nom, FILE_WRITE);
+    if (!f) return false;
+    f.write(reinterpret_cast<const uint8_t*>(empreinte), 64);
+    f.close();
+    return true;
+  }
+
+  static void effacer() {
+    SD.remove(MISE_A_JOUR_DELTA);
+    SD.remove(MISE_A_JOUR_EMPREINTE);
+    SD.remove(MISE_A_JOUR_IMAGE);
+    fAnnoncee = false;
+  }
+
+private:
+  static bool fCarte;
+  static bool fAnnoncee;
+  static uint16_t fVersion;
+  static char fChemin[48];
+  static uint32_t fTaille;      ///< Taille du delta en octets.
+  static uint32_t fPosition;    ///< Octets du delta déjà téléchargés.
+  static char fEmpreinte[65];   ///< SHA-256 de la nouvelle image, en hexadécimal.
+  static char fRefusee[65];     ///< Empreinte du dernier delta invalide.
+  static uint32_t fTailleEnCours;   ///< Taille de l'image en cours dont l'empreinte a été calculée, 0 si aucune.
+  static uint8_t fEnCours[32];      ///< SHA-256 des fTailleEnCours premiers octets de l'image en cours.
+
+};
+
+bool MiseAJour::fCarte;
+bool MiseAJour::fAnnoncee;
+uint16_t MiseAJour::fVersion;
+char MiseAJour::fChemin[48];
+uint32_t MiseAJour::fTaille;
+uint32_t MiseAJour::fPosition;
+char MiseAJour::fEmpreinte[65];
+char MiseAJour::fRefusee[65];
+uint32_t MiseAJour::fTailleEnCours;
+uint8_t MiseAJour::fEnCours[32];
+
+#endif
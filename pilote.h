@@ -0,0 +1,188 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   pilote.h
+   Purpose: Define the modem drivers : power saving specifics of the SIM800 (2G) & SARA-R4 (LTE-M/NB-IoT).
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#pragma once
+
+/// Broche PWR_ON du SARA-R4, réveille le modem de sa veille profonde (PSM).
+#define MODEM_PWR_ON 7
+
+/*
+   Chaque pilote offre la même interface, sans méthode virtuelle :
+   - un constructeur (TinyGsm& modem) ;
+   - bool economiser(uint32_t periode, uint32_t actif, uint32_t cycle) : négocie la veille avec le réseau ;
+   - void reveiller() : rend le modem joignable en AT avant une connexion ;
+   - bool veilleProfonde() const : true si le modem garde son enregistrement en veille (inutile de l'éteindre) ;
+   - bool joignable() const : true si le modem répond en AT et reçoit les SMS, false pendant sa veille profonde.
+   Le pilote est choisi à la compilation par MODEM_SARA_R4, avec le modem TinyGSM correspondant.
+*/
+
+/**
+   Pilote du SIM800 : pas de veille négociée avec le réseau en 2G.
+*/
+class PiloteSim800 {
+
+  public:
+    PiloteSim800(TinyGsm& aModem) {}
+
+    bool economiser(const uint32_t aPeriode, const uint32_t aActif, const uint32_t aCycle) {
+      return false;
+    }
+
+    void reveiller() {}
+
+    bool veilleProfonde() const {
+      return false;
+    }
+
+    bool joignable() const {
+      return true;
+    }
+};
+
+/**
+   Pilote du SARA-R4 (LTE-M/NB-IoT).
+   En Power Saving Mode, le modem reste enregistré et son contexte PDP est conservé tout en ne consommant que
+   quelques µA : une transmission au réveil n'a pas à refaire l'attachement.
+   Les minuteries sont codées selon 3GPP TS 24.008 (§10.5.7.3 & 10.5.7.4a) et le cycle eDRX selon TS 24.008 §10.5.5.32.
+*/
+class PiloteSaraR4 {
+
+  public:
+    PiloteSaraR4(TinyGsm& aModem) :
+      modem(aModem),
+      psm(false),
+      tempsActif(0),
+      reveil(0)
+    {}
+
+    /**
+       Demande le PSM et l'eDRX au réseau.
+
+       @param aPeriode La période de mise à jour de zone (T3412 étendu) en secondes, au moins l'intervalle entre deux transmissions.
+       @param aActif Le temps actif après une transmission (T3324) en secondes, pour recevoir réponses et SMS.
+       @param aCycle Le cycle eDRX maximum en secondes pendant le temps actif.
+       @return true si le modem a accepté la demande de PSM.
+    */
+    bool economiser(const uint32_t aPeriode, const uint32_t aActif, const uint32_t aCycle) {
+      const String tau = minuterie(aPeriode, true);
+      const String actif = minuterie(aActif, false);
+      DEBUG(F("PSM T3412 ")); DEBUG(tau); DEBUG(F(", T3324 ")); DEBUG(actif); DEBUG('\n');
+      modem.sendAT(GF("+CPSMS=1,,,\""), tau, GF("\",\""), actif, '"');
+      psm = (modem.waitResponse() == 1);
+      tempsActif = aActif;
+      reveil = millis();
+
+      const String edrx = cycleEdrx(aCycle);
+      modem.sendAT(GF("+CEDRXS=1,4,\""), edrx, '"');    // 4 : E-UTRAN (LTE-M)
+      modem.waitResponse();
+      return psm;
+    }
+
+    /**
+       Sort le modem de sa veille profonde par une impulsion sur PWR_ON s'il ne répond pas.
+    */
+    void reveiller() {
+      reveil = millis();
+      if (!psm || modem.testAT(500)) return;
+      pinMode(MODEM_PWR_ON, OUTPUT);
+      digitalWrite(MODEM_PWR_ON, LOW);
+      delay(200);
+      digitalWrite(MODEM_PWR_ON, HIGH);
+      modem.testAT(5000);
+    }
+
+    bool veilleProfonde() const {
+      return psm;
+    }
+
+    /**
+       Le modem ne reste éveillé que le temps actif (T3324) qui suit la fin de ses échanges avec le réseau ; il est
+       compté ici depuis le dernier réveil, qui précède chaque connexion, ce qui le raccourcit sans jamais le dépasser.
+
+       @return true hors PSM ou pendant le temps actif.
+    */
+    bool joignable() const {
+      return !psm || (millis() - reveil < 1000UL * tempsActif);
+    }
+
+    /**
+       Code une durée en minuterie GPRS : 3 bits d'unité puis 5 bits de valeur, arrondie au-dessus.
+
+       @param s La durée en secondes.
+       @param t3412 true pour T3412 étendu (GPRS timer 3), false pour T3324 (GPRS timer 2).
+       @return La minuterie en 8 caractères binaires, "11100000" (désactivée) si la durée est trop grande.
+    */
+    static String minuterie(const uint32_t s, const bool t3412) {
+      // unités croissantes en secondes et leur code
+      static const uint32_t unites3412[] = { 2, 30, 60, 600, 3600, 36000, 1152000 };
+      static const byte codes3412[] = { 0b011, 0b100, 0b101, 0b000, 0b001, 0b010, 0b110 };
+      static const uint32_t unites3324[] = { 2, 60, 360 };
+      static const byte codes3324[] = { 0b000, 0b001, 0b010 };
+      const uint32_t* const unites = t3412 ? unites3412 : unites3324;
+      const byte* const codes = t3412 ? codes3412 : codes3324;
+      const byte n = t3412 ? sizeof(codes3412) : sizeof(codes3324);
+
+      byte octet = 0b11100000;
+      for (byte i = 0; i < n; ++i) {
+        const uint32_t valeur = (s + unites[i] - 1) / unites[i];
+        if (valeur <= 31) {
+          octet = (codes[i] << 5) | valeur;
+          break;
+        }
+      }
+      String bits;
+      for (byte b = 8; b-- > 0; ) bits += (octet >> b) & 1 ? '1' : '0';
+      return bits;
+    }
+
+    /**
+       Code le plus long cycle eDRX LTE-M ne dépassant pas la durée (5,12 s au minimum).
+
+       @param s La durée en secondes.
+       @return Le cycle en 4 caractères binaires.
+    */
+    static String cycleEdrx(const uint32_t s) {
+      // cycles en 1/100 s des valeurs 0000 à 1111
+      static const uint32_t cycles[] = { 512, 1024, 2048, 4096, 6144, 8192, 10240, 12288, 14336, 16384, 32768, 65536, 131072, 262144, 524288, 1048576 };
+      byte code = 0;
+      for (byte i = 1; i < 16; ++i) {
+        if (cycles[i] <= s * 100) code = i;
+      }
+      String bits;
+      for (byte b = 4; b-- > 0; ) bits += (code >> b) & 1 ? '1' : '0';
+      return bits;
+    }
+
+  private:
+    TinyGsm& modem;
+    bool psm;     ///< Le PSM a été accepté.
+    uint32_t tempsActif;  ///< Temps actif (T3324) demandé, en secondes.
+    unsigned long reveil; ///< millis() du dernier réveil du modem.
+};
+
+#ifdef MODEM_SARA_R4
+typedef PiloteSaraR4 Pilote;
+#else
+typedef PiloteSim800 Pilote;
+#endif
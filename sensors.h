@@ -25,6 +25,12 @@
 
 #pragma once
 
+/// Largeurs d'impulsion en µs en deçà et au-delà desquelles un échantillon de distance est invalide.
+#define RANGE_IMPULSION_MIN 600
+#define RANGE_IMPULSION_MAX 9000
+/// Nombre d'impulsions d'une lecture de l'AM2302 : réponse puis 40 bits.
+#define AM2302_IMPULSIONS 41
+
 /**
  * Classe définissant les méthodes d'accès aux capteurs ainsi que de leur initilisation et celle du contrôleur.
  * La méthode begin() permet une intialisation tardive (lazy setup).
@@ -39,43 +45,52 @@ private:
 
 protected:
 
-  bool readAM2302(float& aTemp, float& aHygro) const {
+  bool readAM2302(int16_t& aTemp, uint16_t& aHygro) const {
+    uint8_t p[AM2302_IMPULSIONS];   // réponse (80 µs) puis 16 bits d'hygrométrie, 16 bits de température & 8 bits de contrôle
+#ifdef REJEU
+    Capture::lire(Capture::AM2302, p, sizeof(p));
+#else
     pinMode(amDataPin, OUTPUT);
     digitalWrite(amDataPin, LOW);   // down
     delayMicroseconds(1000);    // wait 1 ms
     pinMode(amDataPin, INPUT_PULLUP);
     
-    const unsigned p = pulseIn(amDataPin, LOW, 150U);    
-    if (p < 70 || p > 90) return false;   // should be about 80 ms or an error
+    p[0] = min(pulseIn(amDataPin, LOW, 150U), 255UL);
+    for (byte i = 1; i < AM2302_IMPULSIONS; ++i) {
+      p[i] = p[i - 1] ? min(pulseIn(amDataPin, HIGH, 150U), 255UL) : 0;   // plus rien après une expiration
+    }
+#ifdef CAPTURE
+    Capture::ecrire(Capture::AM2302, p, sizeof(p));
+#endif
+#endif
+
+    if (p[0] < 70 || p[0] > 90) return false;   // should be about 80 ms or an error
 
     uint16_t hygro = 0;
-    for (byte i = 16; i > 0; --i) {
-      const unsigned p = pulseIn(amDataPin, HIGH, 150U);
-      if (!p) return false;   // timeout
+    for (byte i = 1; i <= 16; ++i) {
+      if (!p[i]) return false;   // timeout
       hygro *= 2;
-      if (p > 50) ++hygro;
+      if (p[i] > 50) ++hygro;
     }
 
     uint16_t temp = 0;
-    for (byte i = 16; i > 0; --i) {
-      const unsigned p = pulseIn(amDataPin, HIGH, 150U);
-      if (!p) return false;   // timeout
+    for (byte i = 17; i <= 32; ++i) {
+      if (!p[i]) return false;   // timeout
       temp *= 2;
-      if (p > 50) ++temp;
+      if (p[i] > 50) ++temp;
     }
 
     uint8_t chk = 0;
-    for (byte i = 8; i > 0; --i) {
-      const unsigned p = pulseIn(amDataPin, HIGH, 150U);
-      if (!p) return false;   // timeout
+    for (byte i = 33; i <= 40; ++i) {
+      if (!p[i]) return false;   // timeout
       chk *= 2;
-      if (p > 50) ++chk;
+      if (p[i] > 50) ++chk;
     }
 
     if ( ((temp & 0xff00) / 256 + (temp & 0x00ff) + (hygro & 0xff00) / 256 + (hygro & 0x00ff) - chk) & 0x00ff ) return false;
   
-    aHygro = hygro / 10.0f;
-    aTemp = (temp & 0x8000 ? -1 : 1) * (temp & 0x7fff) / 10.0f;
+    aHygro = hygro;   // le capteur donne des 1/10 de %, soit des pour-mille
+    aTemp = (temp & 0x8000 ? -10 : 10) * static_cast<int16_t>(temp & 0x7fff);   // 1/10 °C -> 1/100 °C
 
     return true;
   }
@@ -110,21 +125,47 @@ public:
   };
 
 /**
- * Retourne la distance mesurée par le capteur Maxbotix MBxxxx.
- * "To calculate the distance, use a scale factor of 58uS per cm." 
- * ou pas !!! je comprends pas, mais la mesure est correcte.
- * 
- * @return La distance mesurée exprimée en mm ou 0 si la mesure est invalide (hors interval).
+ * Retourne l'impulsion brute du capteur Maxbotix MBxxxx, sans la valider.
+ *
+ * @return La largeur de l'impulsion en µs, 0 si aucun écho avant l'expiration.
  */
-  unsigned long sampleRange() const {
+  unsigned long samplePulse() const {
     digitalWrite(mbTriggerPin, HIGH);
     delayMicroseconds(100); 
     digitalWrite(mbTriggerPin, LOW);
 
     const unsigned long start = millis();
+#ifdef REJEU
+    const unsigned long pulse = Capture::lire(Capture::IMPULSION);
+#else
     const unsigned long pulse = pulseIn(mbEchoPin, HIGH, 170000UL); // attendre env. 148 ms (mesure et calcul)
+#endif
     while (millis() - start < 170) ;  // attendre en tout 166ms avant la fin de toute la transmission
-    return (pulse < 600) || (pulse > 9000) ? 0 : pulse; // Hors interval : retour 0 == mesure invalide
+#ifdef CAPTURE
+    Capture::ecrire(Capture::IMPULSION, pulse);
+#endif
+    return pulse;
+  }
+
+/**
+ * Convertit une impulsion brute en distance.
+ * "To calculate the distance, use a scale factor of 58uS per cm." 
+ * ou pas !!! je comprends pas, mais la mesure est correcte.
+ *
+ * @param pulse La largeur de l'impulsion en µs.
+ * @return La distance exprimée en mm ou 0 si l'impulsion est invalide (hors interval).
+ */
+  static unsigned long range(const unsigned long pulse) {
+    return (pulse < RANGE_IMPULSION_MIN) || (pulse > RANGE_IMPULSION_MAX) ? 0 : pulse; // Hors interval : retour 0 == mesure invalide
+  }
+
+/**
+ * Retourne la distance mesurée par le capteur Maxbotix MBxxxx.
+ * 
+ * @return La distance mesurée exprimée en mm ou 0 si la mesure est invalide (hors interval).
+ */
+  unsigned long sampleRange() const {
+    return range(samplePulse());
   }
 
 /**
@@ -132,11 +173,11 @@ public:
  * @see https://cdn-shop.adafruit.com/datasheets/Digital+humidity+and+temperature+sensor+AM2302.pdf
  * @note Lance deux fois la mesure car la première et parfois suspecte.
  * 
- * @param aTemp Retourne la température mesurée en °C.
- * @param aHygro Retourne le taux d'humidité dans l'air en %H.
+ * @param aTemp Retourne la température mesurée en 1/100 °C.
+ * @param aHygro Retourne le taux d'humidité dans l'air en pour-mille (1/10 %H).
  * @return Le succès de la collecte des résultats, ou pas ; en cas d'échec, les paramètres précédents doivent être ignorés.
  */
-  bool sampleAM2302(float& aTemp, float& aHygro) const {
+  bool sampleAM2302(int16_t& aTemp, uint16_t& aHygro) const {
     readAM2302(aTemp, aHygro);
     delay(500);
     return readAM2302(aTemp, aHygro);
@@ -147,14 +188,22 @@ public:
  * Mesure la tension de la batterie LiPo.
  * La valeur est une moyenne sur 10 échantillons successifs.
  * 
- * @return La tension en volts.
+ * @return La tension en mV.
  */
-  float sampleBattery() const {
+  uint16_t sampleBattery() const {
     unsigned long a = 0;
+#ifdef REJEU
+    a = Capture::lire(Capture::ADC);
+#else
     for (int i = 0; i < 10; ++i) {
       a += analogRead(ADC_BATTERY);
     }
-    return(a * (3.3f * 153) / (1024 * 120.0f) / 10.0f);
+#ifdef CAPTURE
+    Capture::ecrire(Capture::ADC, a);
+#endif
+#endif
+    // a * 3300mV * 153 / (1024 * 120) / 10, fraction réduite pour rester sur 32 bits
+    return(a * 5049UL / 12288UL);
   }
 };
 
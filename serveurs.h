@@ -0,0 +1,261 @@
+/*
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+/**
+ *  @file
+ *  Picolimno MKR V1.0 project
+ *  serveurs.h
+ *  Define a Serveurs class : list of the API endpoints, latency tracking and circuit breakers.
+ *
+ *  @author Marc Sibert
+ *  @version 1.0 14/04/2018
+ *  @Copyright 2018 Marc Sibert
+ */
+
+#pragma once
+
+#include <FlashStorage.h>
+
+/// Nombre maximum de serveurs de l'API.
+#define SERVEURS_MAX 3
+/// Taille maximum du nom d'un serveur, zéro final compris.
+#define SERVEURS_HOTE 32
+/// Temps de réponse en ms supposé d'un serveur pas encore mesuré.
+#define SERVEURS_RTT_INCONNU 2000
+/// Nombre d'échecs consécutifs ouvrant le disjoncteur d'un serveur.
+#define SERVEURS_SEUIL 2
+/// Durée en ms pendant laquelle un serveur en défaut est évité, doublée à chaque nouvel échec (jusqu'à x16).
+#define SERVEURS_PAUSE (5 * 60000UL)
+/// Délai minimum en ms accordé à une réponse quand le temps de réponse du serveur est connu.
+#define SERVEURS_DELAI_MIN 3000UL
+
+/**
+ * Serveur de l'API.
+ */
+struct serveur_t {
+  char hote[SERVEURS_HOTE];
+  uint16_t port;
+};
+
+/**
+ * Registre enregistré en flash.
+ */
+struct registreServeurs_t {
+  uint32_t magique;
+  byte n;
+  serveur_t serveurs[SERVEURS_MAX];
+};
+
+FlashStorage(serveursFlash, registreServeurs_t);
+
+/**
+ * Liste ordonnée des serveurs de l'API, reçue avec les paramètres et conservée en flash ; à défaut, le serveur compilé.
+ * Le serveur compilé reste en fin de liste en dernier recours, essayé seulement quand tous les serveurs reçus ont échoué
+ * ou sont évités : une liste erronée ne peut pas couper définitivement le boîtier de l'API, qui lui renverra une liste valide.
+ * Pour chaque serveur sont suivis le temps de réponse (moyenne glissante 1/4) et les échecs consécutifs ;
+ * au-delà de SERVEURS_SEUIL échecs, son disjoncteur s'ouvre et il est évité pendant une pause croissante,
+ * puis réessayé une fois (semi-ouvert).
+ * Une requête vise le serveur disponible le plus rapide, l'ordre de la liste départageant les égalités,
+ * et chaque nouvel essai vise un serveur pas encore essayé s'il y en a un.
+ * Toutes les méthodes sont statiques : les transports choisissent leur serveur sans connaître l'application.
+ */
+class Serveurs {
+
+public:
+  static const byte AUCUN = 0xff;
+
+/**
+ * Indique le serveur compilé, utilisé tant qu'aucune liste n'a été reçue.
+ *
+ * @param hote Le nom du serveur.
+ * @param port Le port du serveur.
+ */
+  static void defaut(const __FlashStringHelper* hote, const uint16_t port) {
+    const String h(hote);
+    strncpy(fDefaut.hote, h.c_str(), SERVEURS_HOTE - 1);
+    fDefaut.hote[SERVEURS_HOTE - 1] = '\0';
+    fDefaut.port = port;
+    if (!fN) remplacer(&fDefaut, 1);
+  }
+
+/**
+ * Relit la liste enregistrée en flash.
+ */
+  static void charger() {
+    const registreServeurs_t r = serveursFlash.read();
+    if ((r.magique == MAGIQUE) && r.n && (r.n <= SERVEURS_MAX)) remplacer(r.serveurs, r.n);
+  }
+
+/**
+ * Remplace la liste et l'enregistre en flash si elle a changé ; une liste vide rétablit le serveur compilé.
+ *
+ * @param liste Les serveurs par ordre de préférence.
+ * @param n Le nombre de serveurs.
+ */
+  static void configurer(const serveur_t liste[], const byte n) {
+    registreServeurs_t r = registreServeurs_t();
+    r.magique = MAGIQUE;
+    r.n = min(n, static_cast<byte>(SERVEURS_MAX));
+    for (byte i = 0; i < r.n; ++i) r.serveurs[i] = liste[i];
+    if (!r.n) {
+      r.n = 1;
+      r.serveurs[0] = fDefaut;
+    }
+
+    bool identique = (r.n == fRecus);
+    for (byte i = 0; identique && (i < fRecus); ++i) {
+      identique = !strcmp(r.serveurs[i].hote, fListe[i].hote) && (r.serveurs[i].port == fListe[i].port);
+    }
+    if (identique) return;
+    remplacer(r.serveurs, r.n);
+    serveursFlash.write(r);
+    DEBUG(F("Serveurs : ")); DEBUG(fRecus); DEBUG('\n');
+  }
+
+/**
+ * Choisit le serveur d'un essai.
+ *
+ * @param essayes Les serveurs déjà essayés pour la requête (bit i pour le serveur i).
+ * @return Le serveur reçu disponible le plus rapide parmi ceux pas encore essayés, sinon le serveur compilé de
+ *         dernier recours, sinon celui dont la pause finit le plus tôt, AUCUN si tous ont été essayés.
+ */
+  static byte choisir(const uint16_t essayes = 0) {
+    byte choix = AUCUN;
+    byte repli = AUCUN;
+    for (byte i = 0; i < fN; ++i) {
+      if (essayes & (1U << i)) continue;
+      if (ouvert(i)) {
+        if ((repli == AUCUN) || (static_cast<long>(fReprise[i] - fReprise[repli]) < 0)) repli = i;
+        continue;
+      }
+      if (i == fSecours) continue;    // dernier recours
+      if ((choix == AUCUN) || (rtt(i) < rtt(choix))) choix = i;
+    }
+    if ((choix == AUCUN) && (fSecours != AUCUN) && !(essayes & (1U << fSecours)) && !ouvert(fSecours)) choix = fSecours;
+    return (choix != AUCUN) ? choix : repli;
+  }
+
+/**
+ * @return Le serveur i.
+ */
+  static const serveur_t& serveur(const byte i) {
+    return fListe[i];
+  }
+
+/**
+ * @param i Le serveur.
+ * @param maximum Le délai maximum en ms.
+ * @return Le délai accordé à une réponse du serveur : 4 fois son temps de réponse s'il est connu, dans les limites.
+ */
+  static unsigned long delai(const byte i, const unsigned long maximum) {
+    if (!fRtt[i]) return maximum;
+    return min(max(4UL * fRtt[i], SERVEURS_DELAI_MIN), maximum);
+  }
+
+/**
+ * Enregistre le résultat d'un essai.
+ *
+ * @param i Le serveur.
+ * @param ok true si une réponse a été reçue.
+ * @param ms La durée de l'essai en ms.
+ */
+  static void noter(const byte i, const bool ok, const unsigned long ms) {
+    if (i >= fN) return;
+    if (ok) {
+      const uint16_t v = min(ms, 0xffffUL);
+      fRtt[i] = fRtt[i] ? fRtt[i] + (static_cast<long>(v) - fRtt[i]) / 4 : v;
+      fEchecs[i] = 0;
+      return;
+    }
+    if (fEchecs[i] < 0xff) ++fEchecs[i];
+    if (fEchecs[i] >= SERVEURS_SEUIL) {
+      fReprise[i] = millis() + (SERVEURS_PAUSE << min(fEchecs[i] - SERVEURS_SEUIL, 4));
+      DEBUG(F("Serveur ")); DEBUG(fListe[i].hote); DEBUG(F(" evite apres ")); DEBUG(fEchecs[i]); DEBUG(F(" echecs.\n"));
+    }
+  }
+
+/**
+ * Sérialise l'état des serveurs en un tableau JSON.
+ *
+ * @return [{"host":..,"port":..,"rtt":..,"fails":..},...] ; rtt en ms, 0 si inconnu.
+ */
+  static String json() {
+    String json('[');
+    for (byte i = 0; i < fN; ++i) {
+      if (i) json += ',';
+      json += F("{\"host\":\"");
+      json += fListe[i].hote;
+      json += F("\",\"port\":");
+      json += fListe[i].port;
+      json += F(",\"rtt\":");
+      json += fRtt[i];
+      json += F(",\"fails\":");
+      json += fEchecs[i];
+      json += '}';
+    }
+    json += ']';
+    return json;
+  }
+
+protected:
+  static void remplacer(const serveur_t liste[], const byte n) {
+    fRecus = n;
+    fN = n;
+    fSecours = AUCUN;
+    bool present = !fDefaut.hote[0];
+    for (byte i = 0; i < n; ++i) {
+      fListe[i] = liste[i];
+      present |= !strcmp(liste[i].hote, fDefaut.hote) && (liste[i].port == fDefaut.port);
+    }
+    if (!present) {   // serveur compilé ajouté en dernier recours
+      fSecours = fN;
+      fListe[fN++] = fDefaut;
+    }
+    for (byte i = 0; i < fN; ++i) {
+      fRtt[i] = 0;
+      fEchecs[i] = 0;
+      fReprise[i] = 0;
+    }
+  }
+
+  static bool ouvert(const byte i) {
+    return (fEchecs[i] >= SERVEURS_SEUIL) && (static_cast<long>(millis() - fReprise[i]) < 0);
+  }
+
+  static unsigned long rtt(const byte i) {
+    return fRtt[i] ? fRtt[i] : SERVEURS_RTT_INCONNU;
+  }
+
+private:
+  static const uint32_t MAGIQUE = 0x5E87E501;
+
+  static serveur_t fDefaut;
+  static serveur_t fListe[SERVEURS_MAX + 1];   ///< Serveurs reçus, suivis du serveur compilé s'il n'en fait pas partie.
+  static byte fN;
+  static byte fRecus;                         ///< Nombre de serveurs reçus, en tête de liste.
+  static byte fSecours;                       ///< Indice du serveur compilé de dernier recours, AUCUN s'il a été reçu.
+  static uint16_t fRtt[SERVEURS_MAX + 1];     ///< Temps de réponse lissé en ms, 0 si inconnu.
+  static byte fEchecs[SERVEURS_MAX + 1];      ///< Échecs consécutifs.
+  static unsigned long fReprise[SERVEURS_MAX + 1];  ///< millis() de fin de la pause d'un serveur en défaut.
+
+};
+
+serveur_t Serveurs::fDefaut;
+serveur_t Serveurs::fListe[SERVEURS_MAX + 1];
+byte Serveurs::fN;
+byte Serveurs::fRecus;
+byte Serveurs::fSecours = Serveurs::AUCUN;
+uint16_t Serveurs::fRtt[SERVEURS_MAX + 1];
+byte Serveurs::fEchecs[SERVEURS_MAX + 1];
+unsigned long Serveurs::fReprise[SERVEURS_MAX + 1];
@@ -0,0 +1,142 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   sha256.h
+   Purpose: Define a streaming SHA-256 (FIPS 180-4) used to verify the firmware images.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#pragma once
+
+/**
+   Empreinte SHA-256 calculée au fil de l'eau : 64 octets de bloc et 8 mots d'état en RAM,
+   quelle que soit la taille des données.
+*/
+class Sha256 {
+
+  public:
+    Sha256() {
+      debut();
+    }
+
+    /**
+       Recommence une empreinte.
+    */
+    void debut() {
+      static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+      };
+      for (byte i = 0; i < 8; ++i) etat[i] = initial[i];
+      n = 0;
+      total = 0;
+    }
+
+    /**
+       Ajoute des données à l'empreinte.
+    */
+    void ajouter(const uint8_t donnees[], const size_t taille) {
+      for (size_t i = 0; i < taille; ++i) {
+        bloc[n++] = donnees[i];
+        if (n == sizeof(bloc)) {
+          transformer();
+          n = 0;
+        }
+      }
+      total += taille;
+    }
+
+    /**
+       Termine l'empreinte.
+
+       @param empreinte Reçoit les 32 octets de l'empreinte.
+    */
+    void fin(uint8_t empreinte[32]) {
+      const uint64_t bits = total * 8;
+      const uint8_t un = 0x80;
+      const uint8_t zero = 0;
+      ajouter(&un, 1);
+      while (n != 56) ajouter(&zero, 1);
+      for (byte i = 8; i-- > 0; ) bloc[n++] = bits >> (8 * i);
+      transformer();
+      for (byte i = 0; i < 32; ++i) empreinte[i] = etat[i / 4] >> (24 - 8 * (i % 4));
+    }
+
+    /**
+       Compare une empreinte à sa forme hexadécimale (64 caractères, casse indifférente).
+    */
+    static bool egale(const uint8_t empreinte[32], const char hexa[]) {
+      if (strlen(hexa) != 64) return false;
+      for (byte i = 0; i < 32; ++i) {
+        char o[3] = { hexa[2 * i], hexa[2 * i + 1], '\0' };
+        char* fin;
+        if ((strtoul(o, &fin, 16) != empreinte[i]) || *fin) return false;
+      }
+      return true;
+    }
+
+  protected:
+    static uint32_t rotation(const uint32_t x, const byte n) {
+      return (x >> n) | (x << (32 - n));
+    }
+
+    void transformer() {
+      static const uint32_t k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+      };
+      uint32_t w[16];   // fenêtre glissante du message étendu
+      for (byte i = 0; i < 16; ++i) {
+        w[i] = (uint32_t(bloc[4 * i]) << 24) | (uint32_t(bloc[4 * i + 1]) << 16) | (uint32_t(bloc[4 * i + 2]) << 8) | bloc[4 * i + 3];
+      }
+      uint32_t a = etat[0], b = etat[1], c = etat[2], d = etat[3], e = etat[4], f = etat[5], g = etat[6], h = etat[7];
+      for (byte i = 0; i < 64; ++i) {
+        if (i >= 16) {
+          const uint32_t w15 = w[(i + 1) & 15];
+          const uint32_t w2 = w[(i + 14) & 15];
+          const uint32_t s0 = rotation(w15, 7) ^ rotation(w15, 18) ^ (w15 >> 3);
+          const uint32_t s1 = rotation(w2, 17) ^ rotation(w2, 19) ^ (w2 >> 10);
+          w[i & 15] += s0 + w[(i + 9) & 15] + s1;
+        }
+        const uint32_t t1 = h + (rotation(e, 6) ^ rotation(e, 11) ^ rotation(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i & 15];
+        const uint32_t t2 = (rotation(a, 2) ^ rotation(a, 13) ^ rotation(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+      }
+      etat[0] += a; etat[1] += b; etat[2] += c; etat[3] += d;
+      etat[4] += e; etat[5] += f; etat[6] += g; etat[7] += h;
+    }
+
+  private:
+    uint32_t etat[8];
+    uint8_t bloc[64];
+    byte n;           ///< Octets en attente dans bloc.
+    uint64_t total;   ///< Octets ajoutés.
+};
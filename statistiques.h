@@ -0,0 +1,182 @@
+/*
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+/**
+ *  @file
+ *  Picolimno MKR V1.0 project
+ *  statistiques.h
+ *  Define a Statistiques class : running summary of a variable in O(1) memory.
+ *
+ *  @author Marc Sibert
+ *  @version 1.0 14/04/2018
+ *  @Copyright 2018 Marc Sibert
+ */
+
+#pragma once
+
+/**
+ * Résumé d'une suite de valeurs entières : nombre, minimum, maximum, moyenne, écart-type, dernière valeur
+ * et heures de la première et de la dernière valeur.
+ * La mémoire occupée ne dépend pas du nombre de valeurs.
+ * La somme des carrés des écarts à la moyenne est tenue à jour par la méthode de Welford, en virgule fixe
+ * (moyenne au 1/256 tirée de la somme) : pas de soustraction de deux grandes sommes de carrés, pas de flottants.
+ */
+class Statistiques {
+
+public:
+  Statistiques() {
+    raz();
+  }
+
+/**
+ * Oublie toutes les valeurs.
+ */
+  void raz() {
+    fN = 0;
+    fMin = 0;
+    fMax = 0;
+    fSomme = 0;
+    fM2 = 0;
+    fDernier = 0;
+    fPremierEpoch = 0;
+    fDernierEpoch = 0;
+  }
+
+/**
+ * Ajoute une valeur.
+ *
+ * @param epoch L'heure de la valeur.
+ * @param value La valeur.
+ */
+  void ajouter(const uint32_t epoch, const int32_t value) {
+    if (!fN) {
+      fMin = fMax = value;
+      fPremierEpoch = epoch;
+    } else {
+      if (value < fMin) fMin = value;
+      if (value > fMax) fMax = value;
+    }
+    const int64_t x = static_cast<int64_t>(value) << DECALAGE;
+    const int64_t ecart = fN ? x - moyenneFixe() : 0;
+    ++fN;
+    fSomme += value;
+    fM2 += ecart * (x - moyenneFixe());
+    fDernier = value;
+    fDernierEpoch = epoch;
+  }
+
+/**
+ * Ajoute toutes les valeurs d'un autre résumé, supposé postérieur.
+ *
+ * @param s L'autre résumé.
+ */
+  void fusionner(const Statistiques& s) {
+    if (!s.fN) return;
+    if (!fN) {
+      *this = s;
+      return;
+    }
+    if (s.fMin < fMin) fMin = s.fMin;
+    if (s.fMax > fMax) fMax = s.fMax;
+// Combinaison de Chan et al. : M2 = M2a + M2b + (moyb - moya)² . na . nb / n
+    const int64_t ecart = s.moyenneFixe() - moyenneFixe();
+    const uint16_t n = fN + s.fN;
+    fM2 += s.fM2 + ecart * ecart * fN / n * s.fN;
+    fN = n;
+    fSomme += s.fSomme;
+    fDernier = s.fDernier;
+    fDernierEpoch = s.fDernierEpoch;
+  }
+
+  uint16_t n() const {
+    return fN;
+  }
+
+  int32_t min() const {
+    return fMin;
+  }
+
+  int32_t max() const {
+    return fMax;
+  }
+
+/**
+ * @return La moyenne arrondie à l'entier le plus proche, 0 si aucune valeur.
+ */
+  int32_t moyenne() const {
+    if (!fN) return 0;
+    return (fSomme >= 0) ? (fSomme + fN / 2) / fN : (fSomme - fN / 2) / fN;
+  }
+
+/**
+ * @return La variance de l'échantillon (n - 1) en unités², arrondie, 0 si moins de 2 valeurs.
+ */
+  int32_t variance() const {
+    if (fN < 2) return 0;
+    const int64_t v = (fM2 + (static_cast<int64_t>(fN - 1) << (2 * DECALAGE - 1))) / (fN - 1) >> (2 * DECALAGE);
+    if (v < 0) return 0;    // Arrondis de la virgule fixe
+    return (v > 0x7fffffffLL) ? 0x7fffffff : v;
+  }
+
+/**
+ * @return L'écart-type de l'échantillon, arrondi, dans l'unité des valeurs.
+ */
+  int32_t ecartType() const {
+    uint32_t v = variance();
+    uint32_t r = 0;
+    uint32_t b = 1UL << 30;
+    while (b > v) b >>= 2;
+    while (b) {     // Racine carrée entière, bit à bit
+      if (v >= r + b) {
+        v -= r + b;
+        r = (r >> 1) + b;
+      } else {
+        r >>= 1;
+      }
+      b >>= 2;
+    }
+    return (v > r) ? r + 1 : r;
+  }
+
+  int32_t dernier() const {
+    return fDernier;
+  }
+
+  uint32_t premierEpoch() const {
+    return fPremierEpoch;
+  }
+
+  uint32_t dernierEpoch() const {
+    return fDernierEpoch;
+  }
+
+protected:
+/**
+ * @return La moyenne en virgule fixe (1 << DECALAGE), 0 si aucune valeur.
+ */
+  int64_t moyenneFixe() const {
+    return fN ? (static_cast<int64_t>(fSomme) << DECALAGE) / fN : 0;
+  }
+
+private:
+  static const byte DECALAGE = 8;   ///< Bits de la partie fractionnaire de la moyenne.
+
+  uint16_t fN;
+  int32_t fMin, fMax;
+  int32_t fSomme;
+  int64_t fM2;          ///< Somme des carrés des écarts à la moyenne, en virgule fixe (1 << 2 * DECALAGE).
+  int32_t fDernier;
+  uint32_t fPremierEpoch, fDernierEpoch;
+
+};
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+
+"""
+Picolimno MKR V1.0 project
+capture.py
+Purpose: Decode a CAPTURE.BIN trace (capture.h) on the host : one line per record, and per type counts.
+
+Chaque enregistrement est un en-tête de 6 octets (millis() sur 4 octets, type, longueur) suivi des données, en little-endian.
+Les impulsions de l'AM2302 sont décodées comme par Sensors::readAM2302() (bit à 1 au-delà de 50 µs) ; les échanges avec le
+modem sont regroupés par sens, les caractères non imprimables en \\xNN ; une PERTE donne le nombre d'octets d'enregistrements
+perdus, la mémoire de la capture ayant débordé.
+
+@author Marc SIBERT
+@version 1.0 03/08/2018
+"""
+
+import argparse
+import struct
+import sys
+
+TYPES = ("DEBUT", "IMPULSION", "AM2302", "ADC", "MODEM_EMIS", "MODEM_RECUS", "PERTE")
+
+
+def lire(fichier):
+    """Itère sur les enregistrements (millis, type, données) ; un enregistrement tronqué termine la lecture."""
+    with open(fichier, "rb") as f:
+        contenu = f.read()
+    i = 0
+    while i + 6 <= len(contenu):
+        millis, genre, n = struct.unpack_from("<IBB", contenu, i)
+        if i + 6 + n > len(contenu):
+            break
+        yield millis, genre, contenu[i + 6:i + 6 + n]
+        i += 6 + n
+
+
+def am2302(impulsions):
+    """Décode les 41 impulsions (la 1re est l'accusé du capteur) en (température °C, hygrométrie %) ou une erreur."""
+    if len(impulsions) != 41 or 0 in impulsions:
+        return "expiration"
+    if not 70 <= impulsions[0] <= 90:
+        return "accuse %d us" % impulsions[0]
+    bits = [1 if p > 50 else 0 for p in impulsions[1:]]
+    octets = [int("".join(map(str, bits[k:k + 8])), 2) for k in range(0, 40, 8)]
+    if (sum(octets[:4]) & 0xff) != octets[4]:
+        return "checksum"
+    hygro = (octets[0] << 8 | octets[1]) / 10.0
+    temp = ((octets[2] & 0x7f) << 8 | octets[3]) / 10.0
+    return "%.1f C %.1f %%" % (-temp if octets[2] & 0x80 else temp, hygro)
+
+
+def texte(donnees):
+    return "".join(chr(c) if 32 <= c < 127 else ("\\r" if c == 13 else "\\n" if c == 10 else "\\x%02x" % c) for c in donnees)
+
+
+def main():
+    p = argparse.ArgumentParser(description="Décode une trace CAPTURE.BIN")
+    p.add_argument("fichier")
+    p.add_argument("--types", help="types affichés, séparés par des virgules (tous par défaut)")
+    args = p.parse_args()
+    choisis = set(args.types.upper().split(",")) if args.types else set(TYPES)
+
+    comptes = [0] * len(TYPES)
+    for millis, genre, donnees in lire(args.fichier):
+        nom = TYPES[genre] if genre < len(TYPES) else "?%d" % genre
+        if genre < len(TYPES):
+            comptes[genre] += 1
+        if nom not in choisis:
+            continue
+        if nom == "IMPULSION":
+            valeur = "%d us" % struct.unpack("<I", donnees)[0]
+        elif nom == "ADC":
+            valeur = "somme %d" % struct.unpack("<I", donnees)[0]
+        elif nom == "AM2302":
+            valeur = am2302(donnees)
+        elif nom == "PERTE":
+            valeur = "%d octets perdus" % struct.unpack("<I", donnees)[0]
+        elif nom.startswith("MODEM"):
+            valeur = texte(donnees)
+        else:
+            valeur = ""
+        print("%10d %-11s %s" % (millis, nom, valeur))
+    print(", ".join("%s %d" % (t, c) for t, c in zip(TYPES, comptes)), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
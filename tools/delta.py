@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+
+"""
+Picolimno MKR V1.0 project
+delta.py
+Purpose: Build the firmware delta applied by MiseAJour (miseajour.h) and print its announcement for the parameters.
+
+Le delta est "PLD1", la taille de la nouvelle image, puis des blocs à la manière de bsdiff, entiers 32 bits
+little-endian : x, y, z, x octets à ajouter aux octets de l'ancienne image depuis la position courante, y octets
+nouveaux, puis la position courante avance de x + z. Il est compressé comme par "heatshrink -e -w 10 -l 5".
+Les correspondances sont cherchées dans un index de l'ancienne image par blocs de 8 octets, au lieu du tri des suffixes
+de bsdiff, puis étendues comme par bsdiff : en avant tant que les octets égaux l'emportent, en arrière depuis la
+correspondance suivante. Un code recompilé diffère surtout par des adresses décalées, que les octets ajoutés réduisent
+à des différences presque toutes nulles, que heatshrink compresse bien.
+
+Les deux images sont les .bin complets (chargeur SDU compris). L'annonce affichée est l'objet "firmware" des paramètres :
+    delta.py ancienne.bin nouvelle.bin 1-2.hs --version 2
+    {"version":2,"fromSize":...,"fromSha256":"...","path":"/firmware/1-2.hs","size":...,"sha256":"..."}
+
+@author Marc SIBERT
+@version 1.0 03/08/2018
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import struct
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import heatshrink   # noqa: E402
+
+BLOC = 8            # octets d'une clé de l'index
+CANDIDATS = 8       # positions gardées par clé, les premières de l'ancienne image
+FENETRE = 10        # HEATSHRINK_DECODAGE_FENETRE de heatshrink.h
+LONGUEUR = 5        # HEATSHRINK_DECODAGE_LONGUEUR de heatshrink.h
+
+
+def indexer(ancienne):
+    """Positions de l'ancienne image par bloc de 8 octets."""
+    index = {}
+    for i in range(len(ancienne) - BLOC + 1):
+        positions = index.setdefault(ancienne[i:i + BLOC], [])
+        if len(positions) < CANDIDATS:
+            positions.append(i)
+    return index
+
+
+def commun(a, i, b, j):
+    """Nombre d'octets égaux de a[i:] et b[j:]."""
+    n = 0
+    fin = min(len(a) - i, len(b) - j)
+    while n + 64 <= fin and a[i + n:i + n + 64] == b[j + n:j + n + 64]:
+        n += 64
+    while n < fin and a[i + n] == b[j + n]:
+        n += 1
+    return n
+
+
+def chercher(index, ancienne, nouvelle, scan):
+    """La plus longue correspondance exacte de nouvelle[scan:] parmi les candidats de l'index : (position, longueur)."""
+    meilleure, position = 0, 0
+    for p in index.get(nouvelle[scan:scan + BLOC], ()):
+        n = commun(ancienne, p, nouvelle, scan)
+        if n > meilleure:
+            meilleure, position = n, p
+    return position, meilleure
+
+
+def blocs(ancienne, nouvelle):
+    """Itère sur les blocs (x, y, z) du delta, comme bsdiff avec l'index à la place du tri des suffixes."""
+    index = indexer(ancienne)
+    taille = len(nouvelle)
+    scan, pos, longueur = 0, 0, 0
+    derniere, derniere_pos, decalage = 0, 0, 0
+    while scan < taille:
+        score = 0
+        scan += longueur
+        scsc = scan
+        while scan < taille:
+            pos, longueur = chercher(index, ancienne, nouvelle, scan)
+            while scsc < scan + longueur:   # octets égaux en poursuivant l'alignement précédent
+                if scsc + decalage < len(ancienne) and ancienne[scsc + decalage] == nouvelle[scsc]:
+                    score += 1
+                scsc += 1
+            if (longueur == score and longueur) or longueur > score + BLOC:
+                break
+            if scan + decalage < len(ancienne) and ancienne[scan + decalage] == nouvelle[scan]:
+                score -= 1
+            scan += 1
+
+        if longueur != score or scan == taille:
+            # Extension en avant de la correspondance précédente
+            s, meilleur, avant = 0, 0, 0
+            for i in range(min(scan - derniere, len(ancienne) - derniere_pos)):
+                if ancienne[derniere_pos + i] == nouvelle[derniere + i]:
+                    s += 1
+                if s * 2 - (i + 1) > meilleur * 2 - avant:
+                    meilleur, avant = s, i + 1
+            # Extension en arrière de la nouvelle correspondance
+            arriere = 0
+            if scan < taille:
+                s, meilleur = 0, 0
+                for i in range(1, min(scan - derniere, pos) + 1):
+                    if ancienne[pos - i] == nouvelle[scan - i]:
+                        s += 1
+                    if s * 2 - i > meilleur * 2 - arriere:
+                        meilleur, arriere = s, i
+            # Chevauchement des deux extensions : partagé au mieux
+            if derniere + avant > scan - arriere:
+                chevauchement = derniere + avant - (scan - arriere)
+                s, meilleur, partage = 0, 0, 0
+                for i in range(chevauchement):
+                    if nouvelle[derniere + avant - chevauchement + i] == ancienne[derniere_pos + avant - chevauchement + i]:
+                        s += 1
+                    if nouvelle[scan - arriere + i] == ancienne[pos - arriere + i]:
+                        s -= 1
+                    if s > meilleur:
+                        meilleur, partage = s, i + 1
+                avant += partage - chevauchement
+                arriere -= partage
+
+            x = avant
+            y = (scan - arriere) - (derniere + avant)
+            z = (pos - arriere) - (derniere_pos + avant) if scan < taille else 0
+            ajout = bytes((nouvelle[derniere + i] - ancienne[derniere_pos + i]) & 0xff for i in range(x))
+            yield x, y, z, ajout, nouvelle[derniere + avant:derniere + avant + y]
+            derniere, derniere_pos, decalage = scan - arriere, pos - arriere, pos - scan
+
+
+def delta(ancienne, nouvelle):
+    """Le delta PLD1 non compressé."""
+    sortie = bytearray(b"PLD1")
+    sortie += struct.pack("<I", len(nouvelle))
+    for x, y, z, ajout, nouveaux in blocs(ancienne, nouvelle):
+        sortie += struct.pack("<IIi", x, y, z)
+        sortie += ajout
+        sortie += nouveaux
+    return bytes(sortie)
+
+
+def appliquer(ancienne, pld):
+    """Applique un delta PLD1 non compressé comme MiseAJour::appliquer(), pour vérifier le delta produit."""
+    if pld[:4] != b"PLD1":
+        raise ValueError("en-tete PLD1 absent")
+    taille, = struct.unpack_from("<I", pld, 4)
+    i, courante = 8, 0
+    nouvelle = bytearray()
+    while len(nouvelle) < taille:
+        x, y, z = struct.unpack_from("<IIi", pld, i)
+        i += 12
+        nouvelle += bytes((ancienne[courante + k] + pld[i + k]) & 0xff for k in range(x))
+        nouvelle += pld[i + x:i + x + y]
+        i += x + y
+        courante += x + z
+    return bytes(nouvelle)
+
+
+def main():
+    p = argparse.ArgumentParser(description="Construit le delta de firmware de MiseAJour et affiche son annonce")
+    p.add_argument("ancienne", help=".bin complet de l'image en cours")
+    p.add_argument("nouvelle", help=".bin complet de la nouvelle image")
+    p.add_argument("sortie", help="delta compressé, servi sous /firmware/ (serveur.py --firmwares)")
+    p.add_argument("--version", type=int, required=True, help="FIRMWARE_VERSION de la nouvelle image")
+    p.add_argument("--chemin", help="ressource annoncée, /firmware/<sortie> par défaut")
+    args = p.parse_args()
+
+    with open(args.ancienne, "rb") as f:
+        ancienne = f.read()
+    with open(args.nouvelle, "rb") as f:
+        nouvelle = f.read()
+    pld = delta(ancienne, nouvelle)
+    if appliquer(ancienne, pld) != nouvelle:
+        sys.exit("Delta incoherent.")
+    compresse = heatshrink.compresser(pld, FENETRE, LONGUEUR)
+    if heatshrink.decompresser(compresse, FENETRE, LONGUEUR)[:len(pld)] != pld:
+        sys.exit("Compression incoherente.")
+    with open(args.sortie, "wb") as f:
+        f.write(compresse)
+    print("%d -> %d octets : delta %d octets, %d compresse" % (len(ancienne), len(nouvelle), len(pld), len(compresse)),
+          file=sys.stderr)
+    print(json.dumps({
+        "version": args.version,
+        "fromSize": len(ancienne),
+        "fromSha256": hashlib.sha256(ancienne).hexdigest(),
+        "path": args.chemin or "/firmware/" + os.path.basename(args.sortie),
+        "size": len(compresse),
+        "sha256": hashlib.sha256(nouvelle).hexdigest(),
+    }, separators=(",", ":")))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,218 @@
+#!/usr/bin/env python3
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+
+"""
+Picolimno MKR V1.0 project
+flotte.py
+Purpose: Fleet load generator replaying the App::loop() traffic of many simulated devices against the API.
+
+Chaque boîtier simulé suit le cycle de App::loop() en temps accéléré :
+- au démarrage, GET parameters puis un statut "Starting" ;
+- à chaque transmission, distance, température, hygrométrie et batterie, en petites trames (une requête par
+  échantillon, puis le résumé de l'intervalle) ou regroupées avec le résumé en une requête ;
+- une fois par jour, un statut "Diagnostic".
+Les requêtes sont construites comme TransportHttp::construire() (Host, Content-Type, Content-Length seulement), une
+connexion par requête, et les corps d'au moins 200 octets sont compressés heatshrink dès que le serveur l'accepte.
+
+Mesures : requêtes par seconde, octets par boîtier et par jour (requêtes, réponses et BUDGET_SURCOUT_TCP par requête,
+comme Budget::compter()), latence médiane, p95, p99 et maximale, erreurs.
+
+@author Marc SIBERT
+@version 1.0 03/08/2018
+"""
+
+import argparse
+import asyncio
+import json
+import os
+import random
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import heatshrink   # noqa: E402
+
+SURCOUT_TCP = 400           # BUDGET_SURCOUT_TCP de budget.h
+COMPRESSION_MIN = 200       # HTTP_COMPRESSION_MIN de http.h
+MESURE = 300                # INTERVAL_MESURES d'acquisition.h
+DELAI = 10.0                # HTTP_TIMEOUT de http.h, en secondes
+
+
+class Mesures:
+    def __init__(self):
+        self.latences = []
+        self.octets = 0
+        self.erreurs = 0
+        self.statuts = {}
+
+    def noter(self, latence, octets, statut):
+        self.latences.append(latence)
+        self.octets += octets
+        self.statuts[statut] = self.statuts.get(statut, 0) + 1
+        if not 200 <= statut < 300:
+            self.erreurs += 1
+
+    def centile(self, c):
+        if not self.latences:
+            return 0.0
+        triees = sorted(self.latences)
+        return triees[min(len(triees) - 1, int(c / 100.0 * len(triees)))]
+
+
+class Boitier:
+    def __init__(self, args, numero, mesures, connexions):
+        self.args = args
+        self.imei = "%015d" % (860000000000000 + numero)
+        self.mesures = mesures
+        self.connexions = connexions
+        self.compression = False
+        self.distance = random.randint(800, 4000)       # mm
+
+    async def requete(self, methode, ressource, corps=None):
+        chemin = "/device/GSM-%s/%s" % (self.imei, ressource)
+        entetes = "%s %s HTTP/1.0\r\nHost: %s" % (methode, chemin, self.args.hote)
+        donnees = b""
+        if corps is not None:
+            donnees = json.dumps(corps, separators=(",", ":")).encode()
+            compresse = self.compression and len(donnees) >= COMPRESSION_MIN
+            if compresse:
+                donnees = heatshrink.compresser(donnees)
+            entetes += "\r\nContent-Type: application/json"
+            if compresse:
+                entetes += "\r\nContent-Encoding: heatshrink"
+            entetes += "\r\nContent-Length: %d" % len(donnees)
+        requete = (entetes + "\r\n\r\n").encode() + donnees
+
+        async with self.connexions:
+            debut = time.monotonic()
+            statut, recus = 0, 0
+            try:
+                lecteur, ecrivain = await asyncio.wait_for(
+                    asyncio.open_connection(self.args.hote, self.args.port), DELAI)
+                ecrivain.write(requete)
+                await ecrivain.drain()
+                brut = await asyncio.wait_for(lecteur.readuntil(b"\r\n\r\n"), DELAI)
+                recus = len(brut)
+                lignes = brut.decode("latin-1").split("\r\n")
+                statut = int(lignes[0].split()[1])
+                longueur = 0
+                for ligne in lignes[1:]:
+                    nom, _, valeur = ligne.partition(":")
+                    if nom.lower() == "content-length":
+                        longueur = int(valeur)
+                    elif nom.lower() == "accept-encoding" and "heatshrink" in valeur:
+                        self.compression = True
+                if longueur:
+                    recus += len(await asyncio.wait_for(lecteur.readexactly(longueur), DELAI))
+                if statut == 415:
+                    self.compression = False
+                ecrivain.close()
+            except (OSError, asyncio.TimeoutError, asyncio.IncompleteReadError, ValueError, IndexError):
+                statut = 0
+            self.mesures.noter(time.monotonic() - debut, len(requete) + recus + SURCOUT_TCP, statut)
+
+    def echantillons(self, epoch):
+        self.distance = max(300, self.distance + random.randint(-20, 20))
+        return [
+            {"epoch": str(epoch), "key": "range", "value": "%.1f" % (self.distance / 10.0)},
+            {"epoch": str(epoch), "key": "temp", "value": "%.2f" % random.uniform(5, 25)},
+            {"epoch": str(epoch), "key": "hygro", "value": "%.1f" % random.uniform(40, 95)},
+            {"epoch": str(epoch), "key": "vbat", "value": "%.3f" % random.uniform(3.7, 4.1)},
+        ]
+
+    def resume(self, epoch):
+        d = self.distance / 10.0
+        n = self.args.transmission // MESURE
+        return {"epoch": str(epoch - (n - 1) * MESURE), "key": "range", "period": str((n - 1) * MESURE), "n": str(n),
+                "min": "%.1f" % (d - 1), "max": "%.1f" % (d + 1), "mean": "%.1f" % d, "last": "%.1f" % d, "sd": "0.6"}
+
+    def statut(self, etat, epoch):
+        statut = {"timestamp": time.strftime("%Y-%m-%dT%H:%M:%SZ", time.gmtime(epoch)), "status": etat, "IP": "10.0.0.1",
+                  "mem": {"free": 14000, "minFree": 11900, "heap": 3100, "heapMax": 4800, "blockMin": 14000,
+                          "fragMax": 4, "heapOps": 5200, "peaks": [12900, 12100, 12400]},
+                  "data": {"sent": 120000, "received": 40000, "projected": 2400000, "quota": 5242880, "level": 0},
+                  "power": {"tier": 0, "vbat": 3950, "trend": -12, "runtime": 65535},
+                  "servers": [{"host": self.args.hote, "port": self.args.port, "rtt": 900, "fails": 0}], "fw": 1}
+        if etat == "Diagnostic":
+            statut["range"] = {"n": 96, "invalid": 0, "attempts": 2100, "maxAttempts": 31, "timeout": 3, "short": 0,
+                               "long": 1, "width": 625, "hist": [0] * 4 + [400, 1300, 200] + [0] * 9}
+        return statut
+
+    async def vivre(self, debut_reel, origine):
+        """Rejoue le cycle du boîtier sur args.jours jours simulés, en temps accéléré."""
+        args = self.args
+        acceleration = args.acceleration
+
+        async def attendre(simule):
+            reste = debut_reel + (simule - origine) / acceleration - time.monotonic()
+            if reste > 0:
+                await asyncio.sleep(reste)
+
+        await self.requete("GET", "parameters")
+        await self.requete("PUT", "status", self.statut("Starting", origine))
+        decalage = random.randrange(0, args.transmission, 60)     # boîtiers démarrés à des minutes différentes
+        epoch = origine + decalage
+        fin = origine + args.jours * 86400
+        diagnostic = origine + 86400
+        while epoch < fin:
+            await attendre(epoch)
+            echantillons = self.echantillons(epoch)
+            if args.petites:
+                for e in echantillons:
+                    await self.requete("PUT", "samples", [e])
+                await self.requete("PUT", "samples", [self.resume(epoch)])
+            else:
+                await self.requete("PUT", "samples", echantillons + [self.resume(epoch)])
+            if epoch >= diagnostic:
+                await self.requete("PUT", "status", self.statut("Diagnostic", epoch))
+                diagnostic += 86400
+            epoch += args.transmission
+
+
+async def flotte(args):
+    mesures = Mesures()
+    connexions = asyncio.Semaphore(args.connexions)
+    boitiers = [Boitier(args, i, mesures, connexions) for i in range(args.boitiers)]
+    origine = int(time.time()) // 60 * 60
+    debut = time.monotonic()
+    await asyncio.gather(*(b.vivre(debut, origine) for b in boitiers))
+    return mesures, time.monotonic() - debut
+
+
+def main():
+    p = argparse.ArgumentParser(description="Générateur de charge d'une flotte de boîtiers picolimno")
+    p.add_argument("--hote", default="localhost")
+    p.add_argument("--port", type=int, default=8080)
+    p.add_argument("--boitiers", type=int, default=1000)
+    p.add_argument("--jours", type=float, default=1.0, help="durée simulée en jours")
+    p.add_argument("--acceleration", type=float, default=3600.0, help="secondes simulées par seconde réelle")
+    p.add_argument("--transmission", type=int, default=900, help="intervalle de transmission en secondes")
+    p.add_argument("--petites", action="store_true", help="petites trames : une requête par échantillon")
+    p.add_argument("--connexions", type=int, default=200, help="connexions simultanées au plus")
+    p.add_argument("--graine", type=int, default=1)
+    args = p.parse_args()
+    random.seed(args.graine)
+
+    mesures, duree = asyncio.run(flotte(args))
+    n = len(mesures.latences)
+    print("%d boitiers, %g jour(s) simules en %.1f s" % (args.boitiers, args.jours, duree))
+    print("requetes      : %d (%.1f/s), erreurs %d %s" % (n, n / duree if duree else 0, mesures.erreurs,
+                                                          json.dumps(mesures.statuts, sort_keys=True)))
+    print("octets        : %.0f par boitier et par jour" % (mesures.octets / args.boitiers / args.jours))
+    print("latence (ms)  : p50 %.1f  p95 %.1f  p99 %.1f  max %.1f" % tuple(
+        1000 * v for v in (mesures.centile(50), mesures.centile(95), mesures.centile(99), max(mesures.latences or [0]))))
+    return 1 if mesures.erreurs else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,109 @@
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+
+"""
+Picolimno MKR V1.0 project
+heatshrink.py
+Purpose: LZSS heatshrink format, the same encoding as heatshrink.h (window 2^8, repetition 2^4 by default).
+
+@author Marc SIBERT
+@version 1.0 03/08/2018
+"""
+
+
+def compresser(source, fenetre=8, longueur=4):
+    """Compresse des octets comme Heatshrink::compresser() du boîtier (recherche gloutonne de la plus proche répétition).
+
+    Les positions précédentes sont chaînées par leurs 2 premiers octets, de la plus proche à la plus lointaine : seules
+    celles qui peuvent donner une répétition (au moins 2 octets) sont comparées, dans le même ordre que le boîtier,
+    d'où la même sortie, assez vite pour une image de firmware en fenêtre de 2^10.
+    """
+    taille_fenetre = 1 << fenetre
+    longueur_max = 1 << longueur
+    tete = {}                           # 2 octets -> dernière position
+    precedente = [-1] * len(source)     # position -> position précédente aux mêmes 2 octets
+    chainees = 0                        # positions déjà chaînées
+    bits = []
+    i = 0
+    while i < len(source):
+        while chainees < min(i, len(source) - 1):
+            cle = source[chainees] << 8 | source[chainees + 1]
+            precedente[chainees] = tete.get(cle, -1)
+            tete[cle] = chainees
+            chainees += 1
+        meilleure, distance = 0, 0
+        fin = min(longueur_max, len(source) - i)
+        j = tete.get(source[i] << 8 | source[i + 1], -1) if fin > 1 else -1
+        while j >= max(i - taille_fenetre, 0):    # de la plus proche à la plus lointaine
+            n = 2
+            while n < fin and source[j + n] == source[i + n]:
+                n += 1
+            if n > meilleure:
+                meilleure, distance = n, i - j
+                if n == fin:
+                    break
+            j = precedente[j]
+        if meilleure > 1:
+            bits.append((0, 1))
+            bits.append((distance - 1, fenetre))
+            bits.append((meilleure - 1, longueur))
+            i += meilleure
+        else:
+            bits.append((1, 1))
+            bits.append((source[i], 8))
+            i += 1
+    sortie = bytearray()
+    octet, n = 0, 0
+    for valeur, nb in bits:
+        for b in range(nb - 1, -1, -1):
+            octet = (octet << 1) | ((valeur >> b) & 1)
+            n += 1
+            if n == 8:
+                sortie.append(octet)
+                octet, n = 0, 0
+    if n:
+        sortie.append(octet << (8 - n))
+    return bytes(sortie)
+
+
+def decompresser(source, fenetre=8, longueur=4):
+    """Décompresse des octets au format heatshrink ; les bits de bourrage du dernier octet sont ignorés."""
+    sortie = bytearray()
+    position = [0]      # en bits
+
+    def lire(nb):
+        if position[0] + nb > len(source) * 8:
+            return None
+        valeur = 0
+        for _ in range(nb):
+            p = position[0]
+            valeur = (valeur << 1) | ((source[p >> 3] >> (7 - (p & 7))) & 1)
+            position[0] += 1
+        return valeur
+
+    while True:
+        litteral = lire(1)
+        if litteral is None:
+            break
+        if litteral:
+            c = lire(8)
+            if c is None:
+                break
+            sortie.append(c)
+            continue
+        distance = lire(fenetre)
+        n = lire(longueur)
+        if distance is None or n is None:
+            break
+        for _ in range(n + 1):
+            sortie.append(sortie[-(distance + 1)] if distance < len(sortie) else 0)
+    return bytes(sortie)
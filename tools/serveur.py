@@ -0,0 +1,447 @@
+#!/usr/bin/env python3
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+
+"""
+Picolimno MKR V1.0 project
+serveur.py
+Purpose: Local stand-in for api.picolimno.fr : the three device resources, firmware deltas and pluggable storage.
+
+Ressources (voir la section Protocole du README) :
+- GET /device/GSM-<imei>/parameters : paramètres du boîtier, ETag et Date ;
+- PUT /device/GSM-<imei>/samples : échantillons et résumés, corps JSON éventuellement compressé heatshrink ;
+- PUT /device/GSM-<imei>/status : statuts ;
+- GET /firmware/<fichier> : deltas de firmware, par plages (Range, réponse 206).
+Les réponses aux PUT portent l'ETag de la configuration du boîtier et, quand celle-ci n'a pas encore été remise
+au boîtier, les paramètres eux-mêmes.
+
+Avec --coap-port, les mêmes ressources sont aussi servies en CoAP sur UDP, comme TransportCoap (coap.h) les utilise :
+messages confirmables dont la réponse est dans l'ACK, un message retransmis recevant la même réponse ; corps de plus
+d'un bloc en Block1, chaque bloc intermédiaire acquitté par 2.31 Continue. La réponse au dernier bloc d'un PUT est
+2.04 Changed, avec l'ETag en binaire (les 8 octets de l'empreinte) et, s'ils n'ont pas été remis et que la réponse
+tient dans le tampon de 320 octets du boîtier, les paramètres ; sinon le boîtier les demande par GET en http.
+
+Le fichier des paramètres (--parametres) est un objet JSON {"defaut":{...},"GSM-<imei>":{...}} relu à chaque
+modification ; les paramètres d'un boîtier sont ceux par défaut complétés par les siens.
+
+Stockages (--stockage) : "memoire" (compteurs seulement, pour la charge), "jsonl:<répertoire>" (un fichier par
+boîtier et par ressource) ou "sqlite:<fichier>". Un autre stockage s'ajoute en dérivant de Stockage.
+
+@author Marc SIBERT
+@version 1.0 03/08/2018
+"""
+
+import argparse
+import collections
+import email.utils
+import hashlib
+import json
+import os
+import random
+import re
+import socket
+import sqlite3
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import heatshrink   # noqa: E402
+
+class Serveur(ThreadingHTTPServer):
+    daemon_threads = True
+    request_queue_size = 256    # la flotte ouvre des centaines de connexions à la fois
+
+
+CHEMIN = re.compile(r"^/device/(GSM-[0-9A-Za-z]+)/(parameters|samples|status)$")
+
+
+class Stockage:
+    """Stockage des échantillons et des statuts reçus ; les méthodes sont appelées depuis plusieurs fils."""
+
+    def __init__(self):
+        self.verrou = threading.Lock()
+        self.echantillons = 0
+        self.resumes = 0
+        self.statuts = 0
+
+    def enregistrer_echantillons(self, boitier, elements):
+        with self.verrou:
+            for e in elements:
+                if "period" in e:
+                    self.resumes += 1
+                else:
+                    self.echantillons += 1
+            self.ecrire(boitier, "samples", elements)
+
+    def enregistrer_statut(self, boitier, statut):
+        with self.verrou:
+            self.statuts += 1
+            self.ecrire(boitier, "status", [statut])
+
+    def ecrire(self, boitier, ressource, elements):
+        """À redéfinir : conserve les éléments, appelé sous le verrou."""
+
+    def resume(self):
+        return "%d echantillons, %d resumes, %d statuts" % (self.echantillons, self.resumes, self.statuts)
+
+
+class StockageJsonl(Stockage):
+    """Un fichier JSON Lines par boîtier et par ressource."""
+
+    def __init__(self, repertoire):
+        super().__init__()
+        self.repertoire = repertoire
+        os.makedirs(repertoire, exist_ok=True)
+
+    def ecrire(self, boitier, ressource, elements):
+        with open(os.path.join(self.repertoire, "%s.%s.jsonl" % (boitier, ressource)), "a") as f:
+            recu = int(time.time())
+            for e in elements:
+                f.write(json.dumps({"recu": recu, **e}) + "\n")
+
+
+class StockageSqlite(Stockage):
+    """Une table par ressource, le corps de chaque élément en JSON."""
+
+    def __init__(self, fichier):
+        super().__init__()
+        self.base = sqlite3.connect(fichier, check_same_thread=False)
+        for table in ("samples", "status"):
+            self.base.execute("CREATE TABLE IF NOT EXISTS %s (recu INTEGER, boitier TEXT, corps TEXT)" % table)
+
+    def ecrire(self, boitier, ressource, elements):
+        recu = int(time.time())
+        self.base.executemany("INSERT INTO %s VALUES (?, ?, ?)" % ressource,
+                              [(recu, boitier, json.dumps(e)) for e in elements])
+        self.base.commit()
+
+
+def creer_stockage(description):
+    if description == "memoire":
+        return Stockage()
+    genre, _, argument = description.partition(":")
+    if genre == "jsonl" and argument:
+        return StockageJsonl(argument)
+    if genre == "sqlite" and argument:
+        return StockageSqlite(argument)
+    raise ValueError("stockage inconnu : " + description)
+
+
+class Configuration:
+    """Paramètres par boîtier, relus quand le fichier change ; l'ETag est l'empreinte des paramètres du boîtier."""
+
+    def __init__(self, fichier):
+        self.fichier = fichier
+        self.date = None
+        self.contenu = {}
+        self.remis = {}     # boîtier -> ETag déjà remis
+        self.verrou = threading.Lock()
+
+    def parametres(self, boitier):
+        with self.verrou:
+            if self.fichier:
+                date = os.path.getmtime(self.fichier)
+                if date != self.date:
+                    with open(self.fichier) as f:
+                        self.contenu = json.load(f)
+                    self.date = date
+            parametres = dict(self.contenu.get("defaut", {}))
+            parametres.update(self.contenu.get(boitier, {}))
+        corps = json.dumps(parametres, separators=(",", ":")).encode()
+        return corps, '"%s"' % hashlib.sha1(corps).hexdigest()[:16]
+
+    def a_remettre(self, boitier, etag):
+        """Indique si les paramètres doivent accompagner la réponse, et les considère alors comme remis."""
+        with self.verrou:
+            if self.remis.get(boitier) == etag:
+                return False
+            self.remis[boitier] = etag
+            return True
+
+
+class Gestionnaire(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    server_version = "picolimno-local"
+
+    def log_message(self, format, *args):
+        if self.server.bavard:
+            super().log_message(format, *args)
+
+    def repondre(self, statut, corps=b"", etag=None, entetes=()):
+        self.send_response(statut)
+        self.send_header("Date", email.utils.formatdate(usegmt=True))
+        if etag:
+            self.send_header("ETag", etag)
+        if self.server.compression:
+            self.send_header("Accept-Encoding", "heatshrink")
+        for nom, valeur in entetes:
+            self.send_header(nom, valeur)
+        self.send_header("Content-Length", str(len(corps)))
+        self.end_headers()
+        self.wfile.write(corps)
+
+    def do_GET(self):
+        if self.path.startswith("/firmware/"):
+            return self.firmware()
+        m = CHEMIN.match(self.path)
+        if not m or m.group(2) != "parameters":
+            return self.repondre(404)
+        corps, etag = self.server.configuration.parametres(m.group(1))
+        self.server.configuration.a_remettre(m.group(1), etag)
+        self.repondre(200, corps, etag)
+
+    def do_PUT(self):
+        m = CHEMIN.match(self.path)
+        longueur = int(self.headers.get("Content-Length", 0))
+        corps = self.rfile.read(longueur)
+        if not m or m.group(2) == "parameters":
+            return self.repondre(404)
+        if random.randrange(100) < self.server.pannes:
+            return self.repondre(503)
+        codage = self.headers.get("Content-Encoding", "")
+        if codage == "heatshrink":
+            if not self.server.compression:
+                return self.repondre(415)
+            corps = heatshrink.decompresser(corps)
+        elif codage:
+            return self.repondre(415)
+        try:
+            contenu = json.loads(corps)
+        except ValueError:
+            return self.repondre(400)
+        boitier, ressource = m.group(1), m.group(2)
+        if ressource == "samples":
+            self.server.stockage.enregistrer_echantillons(boitier, contenu if isinstance(contenu, list) else [contenu])
+        else:
+            self.server.stockage.enregistrer_statut(boitier, contenu)
+        parametres, etag = self.server.configuration.parametres(boitier)
+        self.repondre(200, parametres if self.server.configuration.a_remettre(boitier, etag) else b"", etag)
+
+    def firmware(self):
+        nom = os.path.basename(self.path)
+        chemin = os.path.join(self.server.firmwares or "", nom)
+        if not self.server.firmwares or not os.path.isfile(chemin):
+            return self.repondre(404)
+        with open(chemin, "rb") as f:
+            contenu = f.read()
+        plage = re.match(r"bytes=(\d+)-(\d*)$", self.headers.get("Range", ""))
+        if not plage:
+            return self.repondre(200, contenu)
+        debut = int(plage.group(1))
+        fin = min(int(plage.group(2)) if plage.group(2) else len(contenu) - 1, len(contenu) - 1)
+        if debut > fin:
+            return self.repondre(416, entetes=[("Content-Range", "bytes */%d" % len(contenu))])
+        self.repondre(206, contenu[debut:fin + 1], entetes=[("Content-Range", "bytes %d-%d/%d" % (debut, fin, len(contenu)))])
+
+
+# CoAP (RFC 7252, RFC 7959) : types, codes et options utilisés par TransportCoap
+CON, NON, ACK, RST = 0, 1, 2, 3
+GET, PUT = 0x01, 0x03
+ETAG, URI_PATH, CONTENT_FORMAT, BLOCK1 = 4, 11, 12, 27
+TAMPON_COAP = 320       # tampon de réception de TransportCoap : COAP_BLOC + 64
+
+
+def code_coap(classe, detail):
+    return (classe << 5) | detail
+
+
+def lire_coap(datagramme):
+    """Décode un message CoAP : (type, code, mid, jeton, [(option, valeur)], charge utile), None s'il est invalide."""
+    try:
+        if datagramme[0] >> 6 != 1 or datagramme[0] & 0x0f > 8:
+            return None
+        i = 4 + (datagramme[0] & 0x0f)
+        options, numero = [], 0
+        while i < len(datagramme) and datagramme[i] != 0xff:
+            champs = [datagramme[i] >> 4, datagramme[i] & 0x0f]
+            i += 1
+            for k, v in enumerate(champs):
+                if v == 13:
+                    champs[k] = datagramme[i] + 13
+                    i += 1
+                elif v == 14:
+                    champs[k] = (datagramme[i] << 8 | datagramme[i + 1]) + 269
+                    i += 2
+                elif v == 15:
+                    return None
+            numero += champs[0]
+            options.append((numero, datagramme[i:i + champs[1]]))
+            i += champs[1]
+        if len(datagramme) < 4 or i > len(datagramme):
+            return None
+        return ((datagramme[0] >> 4) & 3, datagramme[1], datagramme[2] << 8 | datagramme[3],
+                datagramme[4:4 + (datagramme[0] & 0x0f)], options, datagramme[i + 1:])
+    except IndexError:
+        return None
+
+
+def ecrire_coap(type_, code, mid, jeton, options=(), charge=b""):
+    """Code un message CoAP, les options dans l'ordre de leurs numéros."""
+    message = bytearray([0x40 | type_ << 4 | len(jeton), code, mid >> 8, mid & 0xff]) + jeton
+    numero = 0
+    for option, valeur in sorted(options, key=lambda o: o[0]):
+        entete = bytearray([0])
+        champs = []
+        for v in (option - numero, len(valeur)):
+            if v >= 269:
+                champs.append(14)
+                entete += bytes([(v - 269) >> 8, (v - 269) & 0xff])
+            elif v >= 13:
+                champs.append(13)
+                entete.append(v - 13)
+            else:
+                champs.append(v)
+        entete[0] = champs[0] << 4 | champs[1]
+        message += entete + valeur
+        numero = option
+    if charge:
+        message += b"\xff" + charge
+    return bytes(message)
+
+
+def entier_coap(valeur):
+    """Valeur d'une option entière : octets de poids fort en tête, sans zéro inutile."""
+    return valeur.to_bytes((valeur.bit_length() + 7) // 8, "big")
+
+
+class ServeurCoap(threading.Thread):
+    """Les ressources des boîtiers en CoAP sur UDP, avec le stockage et la configuration du serveur http."""
+
+    MEMOIRE = 256       # réponses gardées pour les retransmissions
+
+    def __init__(self, port, serveur):
+        super().__init__(daemon=True)
+        self.socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.socket.bind(("", port))
+        self.serveur = serveur
+        self.blocs = {}                                 # (adresse, chemin) -> corps reçu des blocs précédents
+        self.reponses = collections.OrderedDict()       # (adresse, mid) -> réponse déjà envoyée
+
+    def run(self):
+        while True:
+            datagramme, adresse = self.socket.recvfrom(2048)
+            message = lire_coap(datagramme)
+            if not message or message[0] != CON:
+                continue    # ACK d'une réponse, RST ou message invalide
+            cle = (adresse, message[2])
+            reponse = self.reponses.get(cle)
+            if reponse is None:
+                reponse = self.traiter(adresse, *message[1:])
+                self.reponses[cle] = reponse
+                if len(self.reponses) > self.MEMOIRE:
+                    self.reponses.popitem(last=False)
+            elif self.serveur.bavard:
+                sys.stderr.write("%s - CoAP mid %d retransmis\n" % (adresse[0], message[2]))
+            self.socket.sendto(reponse, adresse)
+
+    def traiter(self, adresse, code, mid, jeton, options, charge):
+        chemin = "/" + "/".join(v.decode("utf-8", "replace") for n, v in options if n == URI_PATH)
+        statut, options_reponse, corps = self.ressource(adresse, code, chemin, options, charge)
+        if self.serveur.bavard:
+            sys.stderr.write("%s - CoAP %d.%02d %s %d octets -> %d.%02d\n" % (adresse[0], code >> 5, code & 0x1f, chemin,
+                                                                              len(charge), statut >> 5, statut & 0x1f))
+        return ecrire_coap(ACK, statut, mid, jeton, options_reponse, corps)
+
+    def ressource(self, adresse, code, chemin, options, charge):
+        """Traite une requête : (code de la réponse, options, charge utile)."""
+        m = CHEMIN.match(chemin)
+        if not m:
+            return code_coap(4, 4), [], b""
+        boitier, ressource = m.group(1), m.group(2)
+        configuration = self.serveur.configuration
+        if code == GET:
+            if ressource != "parameters":
+                return code_coap(4, 5), [], b""
+            parametres, etag = configuration.parametres(boitier)
+            options_reponse = [(ETAG, bytes.fromhex(etag.strip('"'))), (CONTENT_FORMAT, bytes([50]))]
+            if len(ecrire_coap(ACK, 0, 0, b"\0\0", options_reponse, parametres)) > TAMPON_COAP:
+                return code_coap(5, 1), [], b""    # il faudrait Block2, que le boîtier ne connaît pas
+            configuration.a_remettre(boitier, etag)
+            return code_coap(2, 5), options_reponse, parametres
+        if code != PUT or ressource == "parameters":
+            return code_coap(4, 5), [], b""
+
+        bloc = next((v for n, v in options if n == BLOCK1), None)
+        if bloc is not None:
+            valeur = int.from_bytes(bloc, "big")
+            numero, suite, taille = valeur >> 4, valeur >> 3 & 1, 1 << ((valeur & 7) + 4)
+            cle = (adresse, chemin)
+            if numero == 0:
+                self.blocs[cle] = b""
+            recu = self.blocs.get(cle)
+            if recu is None or len(recu) != numero * taille:
+                self.blocs.pop(cle, None)
+                return code_coap(4, 8), [], b""    # Request Entity Incomplete : bloc hors séquence
+            if suite:
+                if len(charge) != taille:
+                    return code_coap(4, 0), [], b""
+                self.blocs[cle] = recu + charge
+                return code_coap(2, 31), [(BLOCK1, bloc)], b""
+            charge = recu + charge
+            del self.blocs[cle]
+
+        if random.randrange(100) < self.serveur.pannes:
+            return code_coap(5, 3), [], b""
+        try:
+            contenu = json.loads(charge)
+        except ValueError:
+            return code_coap(4, 0), [], b""
+        if ressource == "samples":
+            self.serveur.stockage.enregistrer_echantillons(boitier, contenu if isinstance(contenu, list) else [contenu])
+        else:
+            self.serveur.stockage.enregistrer_statut(boitier, contenu)
+        parametres, etag = configuration.parametres(boitier)
+        options_reponse = [(ETAG, bytes.fromhex(etag.strip('"')))]
+        if bloc is not None:
+            options_reponse.append((BLOCK1, bloc))
+        avec = options_reponse + [(CONTENT_FORMAT, bytes([50]))]
+        if len(ecrire_coap(ACK, 0, 0, b"\0\0", avec, parametres)) <= TAMPON_COAP and configuration.a_remettre(boitier, etag):
+            return code_coap(2, 4), avec, parametres
+        return code_coap(2, 4), options_reponse, b""
+
+
+def main():
+    p = argparse.ArgumentParser(description="Serveur local de l'API picolimno")
+    p.add_argument("--port", type=int, default=8080)
+    p.add_argument("--coap-port", type=int, help="port UDP des mêmes ressources en CoAP (coap.h : 5683), aucun par défaut")
+    p.add_argument("--parametres", help="fichier JSON des paramètres {\"defaut\":{...},\"GSM-<imei>\":{...}}")
+    p.add_argument("--stockage", default="memoire", help="memoire, jsonl:<répertoire> ou sqlite:<fichier>")
+    p.add_argument("--firmwares", help="répertoire des deltas servis sous /firmware/")
+    p.add_argument("--sans-compression", action="store_true", help="ne pas annoncer Accept-Encoding: heatshrink")
+    p.add_argument("--pannes", type=int, default=0, help="pourcentage de PUT refusés par 503, pour essayer la bascule")
+    p.add_argument("--bavard", action="store_true", help="journal de chaque requête")
+    args = p.parse_args()
+
+    serveur = Serveur(("", args.port), Gestionnaire)
+    serveur.stockage = creer_stockage(args.stockage)
+    serveur.configuration = Configuration(args.parametres)
+    serveur.firmwares = args.firmwares
+    serveur.compression = not args.sans_compression
+    serveur.pannes = args.pannes
+    serveur.bavard = args.bavard
+    if args.coap_port:
+        ServeurCoap(args.coap_port, serveur).start()
+        print("Serveur local sur le port %d, CoAP sur le port UDP %d, stockage %s" % (args.port, args.coap_port, args.stockage))
+    else:
+        print("Serveur local sur le port %d, stockage %s" % (args.port, args.stockage))
+    sys.stdout.flush()
+    try:
+        serveur.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    print(serveur.stockage.resume())
+
+
+if __name__ == "__main__":
+    main()
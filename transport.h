@@ -0,0 +1,57 @@
+/*
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/**
+   @file
+   Picolimno MKR V1.0 project
+   transport.h
+   Purpose: Define the transports used by Communication to reach the API server.
+
+   @author Marc SIBERT
+   @version 1.0 03/08/2018
+*/
+
+#pragma once
+
+/**
+   Éléments utiles d'une réponse, les autres en-têtes sont ignorés.
+   Pour CoAP, le statut est la classe et le détail du code de réponse (2.04 -> 204).
+*/
+struct reponse_t {
+  int status;           ///< Code de la ligne de statut, <= 0 en cas d'erreur.
+  long contentLength;   ///< Valeur de Content-Length, -1 si absent.
+  char date[32];        ///< Valeur de Date, vide si absent.
+  char etag[24];        ///< Valeur de ETag sans guillemets (CoAP : en hexadécimal), vide si absent.
+  long plage;           ///< Premier octet de Content-Range d'une réponse partielle, -1 si absent.
+  bool compression;     ///< Le serveur accepte les corps compressés heatshrink (Accept-Encoding, RFC 7694).
+};
+
+/*
+   Chaque transport offre la même interface, sans méthode virtuelle :
+   - un constructeur (TinyGsm& modem, const __FlashStringHelper* serveur, int port) ;
+   - bool requete(const __FlashStringHelper* methode, const String& path, const String& body, reponse_t& reponse, String* corps = NULL),
+     vraie seulement pour une réponse de succès (2xx en http, 2.xx en CoAP).
+   Le transport des échantillons et des états est choisi à la compilation par TRANSPORT_COAP.
+*/
+#include "http.h"
+#include "coap.h"
+
+#ifdef TRANSPORT_COAP
+#ifdef MODEM_SARA_R4
+#error "TRANSPORT_COAP utilise les commandes UDP du SIM800 (CIPSTART, CIPRXGET...), indisponibles sur le SARA-R4."
+#endif
+typedef TransportCoap Transport;
+#else
+typedef TransportHttp Transport;
+#endif